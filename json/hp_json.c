@@ -1,5 +1,16 @@
+#include <stdlib.h>
 #include <string.h>
+#include <ctype.h>
 #include <assert.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#if defined(__SSE2__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#include "num/hp_num.h"
 
 #include "hp_json.h"
 
@@ -17,6 +28,17 @@ hp_json_stream_ungetc(struct hp_json_stream *st, char c)
   return (hp_stream_ungetc(st->iost, c));
 }
 
+/* Contiguous input, if the stream has it; at end of data, some streams
+   offer free space for writing instead, so that is excluded
+*/
+
+static inline
+int
+hp_json_stream_window(struct hp_json_stream *st, char **p)
+{
+  return (hp_stream_eof(st->iost) ? 0 : hp_stream_get_window(st->iost, p));
+}
+
 static inline
 int
 hp_json_stream_putc(struct hp_json_stream *st, char c)
@@ -112,6 +134,12 @@ hp_json_int_tostring(struct hp_json_stream *st, int val)
   HP_JSON_NUM_TOSTRING(16, "%d");
 }
 
+int
+hp_json_llong_tostring(struct hp_json_stream *st, long long val)
+{
+  HP_JSON_NUM_TOSTRING(24, "%lld");
+}
+
 int
 hp_json_hex_tostring(struct hp_json_stream *st, int val)
 {
@@ -217,9 +245,7 @@ enum hp_json_parse_state {
 
 enum hp_json_parse_tok {
   HP_JSON_PARSE_TOK_EOF,
-  HP_JSON_PARSE_TOK_INT,
-  HP_JSON_PARSE_TOK_HEX,
-  HP_JSON_PARSE_TOK_FLOAT,
+  HP_JSON_PARSE_TOK_NUM,
   HP_JSON_PARSE_TOK_STRING,
   HP_JSON_PARSE_TOK_LSQBR,
   HP_JSON_PARSE_TOK_COMMA,
@@ -229,50 +255,300 @@ enum hp_json_parse_tok {
   HP_JSON_PARSE_TOK_RBR
 };
 
+/* Number of leading whitespace bytes, as for isspace() */
+
+static inline
+int
+hp_json_is_ws(char c)
+{
+  return (c == ' ' || (unsigned char)(c - '\t') <= '\r' - '\t');
+}
+
+static unsigned
+hp_json_ws_span(char *p, unsigned n)
+{
+  unsigned result = 0, bits;
+
+  /* Usually none, or one separating space */
+
+  if (n == 0 || !hp_json_is_ws(p[0]))  return (0);
+
+#ifdef __AVX2__
+  {
+    __m256i v;
+
+    for ( ; result + 32 <= n; result += 32) {
+      v = _mm256_loadu_si256((__m256i *)(p + result));
+      bits = ~_mm256_movemask_epi8(
+	        _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')),
+				_mm256_cmpeq_epi8(_mm256_min_epu8(_mm256_sub_epi8(v, _mm256_set1_epi8('\t')),
+								  _mm256_set1_epi8('\r' - '\t')
+								  ),
+						  _mm256_sub_epi8(v, _mm256_set1_epi8('\t'))
+						  )
+				)
+				   );
+      if (bits)  return (result + __builtin_ctz(bits));
+    }
+  }
+#endif
+
+#ifdef __SSE2__
+  {
+    __m128i v;
+
+    for ( ; result + 16 <= n; result += 16) {
+      v = _mm_loadu_si128((__m128i *)(p + result));
+      bits = ~_mm_movemask_epi8(
+	        _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')),
+			     _mm_cmpeq_epi8(_mm_min_epu8(_mm_sub_epi8(v, _mm_set1_epi8('\t')),
+							 _mm_set1_epi8('\r' - '\t')
+							 ),
+					    _mm_sub_epi8(v, _mm_set1_epi8('\t'))
+					    )
+			     )
+				) & 0xffff;
+      if (bits)  return (result + __builtin_ctz(bits));
+    }
+  }
+#endif
+
+  for ( ; result < n && hp_json_is_ws(p[result]); ++result);
+
+  return (result);
+}
+
+/* Number of leading bytes of a string needing no attention: neither quote
+   nor backslash
+*/
+
+static unsigned
+hp_json_str_span(char *p, unsigned n)
+{
+  unsigned result = 0, bits;
+
+#ifdef __AVX2__
+  {
+    __m256i v;
+
+    for ( ; result + 32 <= n; result += 32) {
+      v = _mm256_loadu_si256((__m256i *)(p + result));
+      bits = _mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('"')),
+						  _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\\'))
+						  )
+				  );
+      if (bits)  return (result + __builtin_ctz(bits));
+    }
+  }
+#endif
+
+#ifdef __SSE2__
+  {
+    __m128i v;
+
+    for ( ; result + 16 <= n; result += 16) {
+      v = _mm_loadu_si128((__m128i *)(p + result));
+      bits = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('"')),
+					    _mm_cmpeq_epi8(v, _mm_set1_epi8('\\'))
+					    )
+			       );
+      if (bits)  return (result + __builtin_ctz(bits));
+    }
+  }
+#endif
+
+  for ( ; result < n && p[result] != '"' && p[result] != '\\'; ++result);
+
+  return (result);
+}
+
+/* Number of leading bytes, outside strings, that cannot change nesting:
+   none of quote and brackets
+*/
+
+static unsigned
+hp_json_struct_span(char *p, unsigned n)
+{
+  static const char stops[] = "\"[]{}";
+
+  unsigned result = 0, bits, i;
+
+#ifdef __AVX2__
+  {
+    __m256i v, m;
+
+    for ( ; result + 32 <= n; result += 32) {
+      v = _mm256_loadu_si256((__m256i *)(p + result));
+      m = _mm256_cmpeq_epi8(v, _mm256_set1_epi8(stops[0]));
+      for (i = 1; i < sizeof(stops) - 1; ++i) {
+	m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8(stops[i])));
+      }
+      if (bits = _mm256_movemask_epi8(m))  return (result + __builtin_ctz(bits));
+    }
+  }
+#endif
+
+#ifdef __SSE2__
+  {
+    __m128i v, m;
+
+    for ( ; result + 16 <= n; result += 16) {
+      v = _mm_loadu_si128((__m128i *)(p + result));
+      m = _mm_cmpeq_epi8(v, _mm_set1_epi8(stops[0]));
+      for (i = 1; i < sizeof(stops) - 1; ++i) {
+	m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8(stops[i])));
+      }
+      if (bits = _mm_movemask_epi8(m))  return (result + __builtin_ctz(bits));
+    }
+  }
+#endif
+
+  for ( ; result < n && memchr(stops, p[result], sizeof(stops) - 1) == 0; ++result);
+
+  return (result);
+}
+
+/* Whitespace skipped within window, if any; returns bytes skipped */
+
+static unsigned
+hp_json_ws_skip(struct hp_json_stream *st)
+{
+  char     *p;
+  unsigned result = 0, k;
+  int      n;
+
+  while ((n = hp_json_stream_window(st, &p)) > 0) {
+    k = hp_json_ws_span(p, n);
+    hp_stream_commit(st->iost, k);
+    result += k;
+    if (k < n)  break;
+  }
+
+  return (result);
+}
+
+static inline
+int
+hp_json_is_num_c(char c)
+{
+  return (c >= '0' && c <= '9' || c == '.' || c == '+' || c == '-'
+	  || (c | 0x20) >= 'a' && (c | 0x20) <= 'f' || (c | 0x20) == 'x'
+	  );
+}
+
+struct hp_json_tok {
+  unsigned      code;
+  char          *p;		/* Text of number or string */
+  unsigned      len;
+  unsigned char esc;		/* String text still has escapes */
+};
+
+/* Tokenizer; numbers are collected in tokbuf, string contents in strbuf.
+   If the stream has a window, whitespace and string contents are scanned
+   within it, a vector at a time, and only the bytes around them go through
+   getc.  A number wholly within the window is not copied at all, nor is a
+   string if strbuf is 0; such a string must be wholly within the window.
+*/
+
 static int
-hp_json_parse_tok(struct hp_json_stream *st, unsigned *tok, char *tokbuf, unsigned tokbufsize)
+hp_json_parse_tok(struct hp_json_stream *st,
+		  struct hp_json_tok    *tok,
+		  char                  *tokbuf,
+		  unsigned              tokbufsize,
+		  char                  *strbuf,
+		  unsigned              strbufsize
+		  )
 {
-  char     c;
-  unsigned result = 0;
-  
+  char     c, *p;
+  unsigned result = hp_json_ws_skip(st), k;
+  int      n;
+
+  tok->esc = 0;
+
+  if ((n = hp_json_stream_window(st, &p)) > 0) {
+    c = p[0];
+    if (c == '-' || c == '+' || c >= '0' && c <= '9') {
+      for (k = 1; k < n && hp_json_is_num_c(p[k]); ++k);
+      if (k < n) {
+	tok->code = HP_JSON_PARSE_TOK_NUM;
+	tok->p    = p;
+	tok->len  = k;
+	hp_stream_commit(st->iost, k);
+
+	return (result + k);
+      }
+    } else if (c == '"' && strbuf == 0) {
+      for (k = 1; ; k += 2) {
+	if (k > n)  return (-1);
+	k += hp_json_str_span(p + k, n - k);
+	if (k == n)  return (-1);
+	if (p[k] == '"')  break;
+	tok->esc = 1;
+      }
+
+      tok->code = HP_JSON_PARSE_TOK_STRING;
+      tok->p    = p + 1;
+      tok->len  = k - 1;
+      hp_stream_commit(st->iost, k + 1);
+
+      return (result + k + 1);
+    }
+  }
+
   do {
     c = hp_json_stream_getc(st);
     if (c == -1) {
-      *tok = HP_JSON_PARSE_TOK_EOF;
+      tok->code = HP_JSON_PARSE_TOK_EOF;
       return (result);
     }
     ++result;
-  } while (isspace(c));
+  } while (hp_json_is_ws(c));
 
   switch (c) {
   case '[':
-    *tok = HP_JSON_PARSE_TOK_LSQBR;
+    tok->code = HP_JSON_PARSE_TOK_LSQBR;
     return (result);
 
   case ',':
-    *tok = HP_JSON_PARSE_TOK_COMMA;
+    tok->code = HP_JSON_PARSE_TOK_COMMA;
     return (result);
 
   case ']':
-    *tok = HP_JSON_PARSE_TOK_RSQBR;
+    tok->code = HP_JSON_PARSE_TOK_RSQBR;
     return (result);
 
   case '{':
-    *tok = HP_JSON_PARSE_TOK_LBR;
+    tok->code = HP_JSON_PARSE_TOK_LBR;
     return (result);
 
   case ':':
-    *tok = HP_JSON_PARSE_TOK_COLON;
+    tok->code = HP_JSON_PARSE_TOK_COLON;
     return (result);
 
   case '}':
-    *tok = HP_JSON_PARSE_TOK_RBR;
+    tok->code = HP_JSON_PARSE_TOK_RBR;
     return (result);
 
   case '"':
-    assert(tokbufsize > 0);
-    
-    for (*tok = HP_JSON_PARSE_TOK_STRING, --tokbufsize; tokbufsize; ++tokbuf, --tokbufsize) {
+    if (strbuf == 0 || strbufsize == 0)  return (-1);
+
+    tok->code = HP_JSON_PARSE_TOK_STRING;
+    tok->p    = strbuf;
+
+    for (--strbufsize;;) {
+      /* Plain run, straight from window */
+
+      if ((n = hp_json_stream_window(st, &p)) > 0) {
+	k = hp_json_str_span(p, n);
+	if (k > strbufsize)  return (-1);
+	memcpy(strbuf, p, k);
+	strbuf     += k;
+	strbufsize -= k;
+	hp_stream_commit(st->iost, k);
+	result += k;
+	if (k == n)  continue;
+      }
+
       c = hp_json_stream_getc(st);
       ++result;
       if (c == -1)  return (-1);
@@ -283,92 +559,75 @@ hp_json_parse_tok(struct hp_json_stream *st, unsigned *tok, char *tokbuf, unsign
 	if (c == -1)  return (-1);
 	break;
       case '"':
-	*tokbuf = 0;
+	*strbuf  = 0;
+	tok->len = strbuf - tok->p;
 	return (result);
       default:
 	;
       }
 
-      *tokbuf = c;
+      if (strbufsize == 0)  return (-1);
+      *strbuf++ = c;
+      --strbufsize;
     }
   }    
 
-  if (c == '+' || c == '-' || c >= '0' && c <= '9') {
-    unsigned n, ecnt;
-    
+  /* Collect the characters of a number; hp_num_parse() validates and
+     classifies it
+  */
+
+  if (c == '-' || c == '+' || c >= '0' && c <= '9') {
     assert(tokbufsize > 0);
 
-    *tok = HP_JSON_PARSE_TOK_INT;
+    tok->code = HP_JSON_PARSE_TOK_NUM;
+    tok->p    = tokbuf;
 
-    for (--tokbufsize, n = 0;;) {
+    for (--tokbufsize;;) {
       if (tokbufsize == 0)  return (-1);
       *tokbuf++ = c;
       --tokbufsize;
-      ++n;
-      
+
       c = hp_json_stream_getc(st);
-      if (c == -1) {
-      done:
-	switch (c = tokbuf[-1]) {
-	case '+':
-	case '-':
-	  return (-1);
-	}
-	if ((c | 0x20) == 'e')  return (-1);
-
-	*tokbuf = 0;
-	return (result);
-      }
+      if (c == -1)  break;
       ++result;
-      
-      switch (*tok) {
-      case  HP_JSON_PARSE_TOK_INT:
-	if (n == 1 && (c | 0x20) == 'x' || tokbuf[-1] == '0') {
-	  *tok = HP_JSON_PARSE_TOK_HEX;
-	  break;
-	}
-	
-	if (c == '.') {
-	  *tok = HP_JSON_PARSE_TOK_FLOAT;
-	  ecnt = 0;
-	  break;
-	}
-	
-	if (c >= '0' && c <= '9')  break;
-
-	hp_json_stream_ungetc(st, c);
-	--result;
-	goto done;
-
-      case HP_JSON_PARSE_TOK_HEX:
-	
-	if (c >= '0' && c <= '9' || (c |= 0x20) >= 'a' && c <= 'f')  break;
 
+      if (!hp_json_is_num_c(c)) {
 	hp_json_stream_ungetc(st, c);
 	--result;
-	goto done;
-
-      case HP_JSON_PARSE_TOK_FLOAT:
-	if (c >= '0' && c <= '9')  break;
-	if ((c | 0x20) == 'e') {
-	  if (++ecnt == 1)  break;
-	  return (-1);
-	}
-	if (c == '+' || c == '-') {
-	  if ((tokbuf[-1] | 0x20) == 'e')  break;
-	  return (-1);
-	}
-
-	hp_json_stream_ungetc(st, c);
-	--result;
-	goto done;
+	break;
       }
     }
+
+    *tokbuf  = 0;
+    tok->len = tokbuf - tok->p;
+    return (result);
   }
 
   return (-1);
 }
 
+/* Value or key consumed from st */
+
+static void
+hp_json_parse_after(struct hp_json_stream *st)
+{
+  switch (st->state) {
+  case HP_JSON_PARSE_STATE_ARRAY_OBJ:
+    ++st->item_cnt;
+    st->state = HP_JSON_PARSE_STATE_ARRAY_COMMA;
+    break;
+  case HP_JSON_PARSE_STATE_DICT_KEY:
+    st->state = HP_JSON_PARSE_STATE_DICT_COLON;
+    break;
+  case HP_JSON_PARSE_STATE_DICT_VAL:
+    ++st->item_cnt;
+    st->state = HP_JSON_PARSE_STATE_DICT_COMMA;
+    break;
+  default:
+    ;
+  }
+}
+
 struct hp_json_stream *
 hp_json_stream_parse_init(struct hp_json_stream *st,
 			  struct hp_stream      *iost
@@ -389,14 +648,15 @@ hp_json_parse(struct hp_json_stream   *st,
 	      )
 {
   struct hp_json_stream *ust = 0;
-  unsigned              tok;
+  struct hp_json_tok    tok[1];
   char                  tokbuf[64];
+  struct hp_num         num[1];
   int                   n, result = 0;
 
  again:
-  TRYN(hp_json_parse_tok(st, &tok, tokbuf, sizeof(tokbuf)));
+  TRYN(hp_json_parse_tok(st, tok, tokbuf, sizeof(tokbuf), pval->strbuf, pval->strbufsize));
 
-  switch (tok) {
+  switch (tok->code) {
   case HP_JSON_PARSE_TOK_EOF:
     if (st->state != HP_JSON_PARSE_STATE_OBJ)  return (-1);
 
@@ -471,58 +731,604 @@ hp_json_parse(struct hp_json_stream   *st,
 
     break;
     
-  case HP_JSON_PARSE_TOK_INT:
-    sscanf(tokbuf, "%d", &pval->intval);
+  case HP_JSON_PARSE_TOK_NUM:
+    if (hp_num_parse(num, tok->len, tok->p) < 0)  return (-1);
+
+    if (num->type == HP_NUM_TYPE_INT) {
+      pval->code   = HP_JSON_PARSE_INT;
+      pval->intval = num->u.intval;
+    } else {
+      pval->code     = HP_JSON_PARSE_FLOAT;
+      pval->floatval = num->u.floatval;
+    }
+    ust = st;
+
+    break;
 
-    pval->code = HP_JSON_PARSE_INT;
-    ust        = st;
+  case HP_JSON_PARSE_TOK_STRING:
+    pval->code    = HP_JSON_PARSE_STRING;
+    pval->str     = tok->p;
+    pval->str_len = tok->len;
+    pval->str_esc = tok->esc;
+    ust           = st;
 
     break;
 
-  case HP_JSON_PARSE_TOK_HEX:
-    sscanf(tokbuf + 2, "%x", &pval->intval);
+  default:
+    return (-1);
+  }
 
-    pval->code = HP_JSON_PARSE_INT;
-    ust        = st;
+  /* Top-level container has no parent */
 
-    break;
+  if (ust != 0)  hp_json_parse_after(ust);
 
-  case HP_JSON_PARSE_TOK_FLOAT:
-    sscanf(tokbuf, "%lg", &pval->floatval);
+  return (result);
+}
 
-    pval->code = HP_JSON_PARSE_FLOAT;
-    ust        = st;
 
-    break;
+/* Skipping without decoding: only quotes, escapes and brackets are
+   looked at, so skipped data is not validated beyond that
+*/
 
-  case HP_JSON_PARSE_TOK_STRING:
-    if (pval->strbufsize <= n)  return (-1);
-    strcpy(pval->strbuf, tokbuf);
+struct hp_json_skip {
+  unsigned      depth;
+  unsigned char in_str, esc;
+};
 
-    pval->code = HP_JSON_PARSE_STRING;
-    ust        = st;
+/* Returns 1 if c ends the value */
 
-    break;
+static inline
+int
+hp_json_skip_c(struct hp_json_skip *sk, char c)
+{
+  if (sk->esc) {
+    sk->esc = 0;
+
+    return (0);
+  }
+
+  if (sk->in_str) {
+    if (c == '\\') {
+      sk->esc = 1;
+    } else if (c == '"') {
+      sk->in_str = 0;
+
+      return (sk->depth == 0);
+    }
+
+    return (0);
+  }
 
+  switch (c) {
+  case '"':
+    sk->in_str = 1;
+    break;
+  case '[':
+  case '{':
+    ++sk->depth;
+    break;
+  case ']':
+  case '}':
+    return (--sk->depth == 0);
   default:
-    return (-1);
+    ;
   }
 
-  switch (ust->state) {
-  case HP_JSON_PARSE_STATE_ARRAY_OBJ:
-    ++ust->item_cnt;
-    ust->state = HP_JSON_PARSE_STATE_ARRAY_COMMA;
+  return (0);
+}
+
+static int
+hp_json_skip_raw(struct hp_json_stream *st, struct hp_json_skip *sk)
+{
+  char     *p;
+  unsigned i, result = 0;
+  int      n, c;
+
+  while ((n = hp_json_stream_window(st, &p)) > 0) {
+    for (i = 0; i < n; ) {
+      if (!sk->esc)  i += sk->in_str ? hp_json_str_span(p + i, n - i) : hp_json_struct_span(p + i, n - i);
+      if (i == n)  break;
+      if (hp_json_skip_c(sk, p[i++])) {
+	hp_stream_commit(st->iost, i);
+
+	return (result + i);
+      }
+    }
+    hp_stream_commit(st->iost, n);
+    result += n;
+  }
+  if (n == 0)  return (-1);	/* Truncated */
+
+  /* No window */
+
+  while ((c = hp_json_stream_getc(st)) != -1) {
+    ++result;
+    if (hp_json_skip_c(sk, c))  return (result);
+  }
+
+  return (-1);
+}
+
+/* Next significant character, left unread */
+
+static int
+hp_json_peek(struct hp_json_stream *st, unsigned *cnt)
+{
+  int c;
+
+  *cnt += hp_json_ws_skip(st);
+  while ((c = hp_json_stream_getc(st)) != -1 && hp_json_is_ws(c))  ++*cnt;
+  if (c != -1)  hp_json_stream_ungetc(st, c);
+
+  return (c);
+}
+
+/** ************************************************************************
+
+\brief Skip next value
+
+The next value in st is passed over without being decoded; arrays and
+dicts are skipped by counting brackets.
+
+\param[in] st JSON stream, at a value
+
+\returns Number of bytes consumed, or -1 on error, including at the end
+of an array or dict
+
+*/
+
+int
+hp_json_skip(struct hp_json_stream *st)
+{
+  struct hp_json_skip sk[1];
+  struct hp_json_tok  tok[1];
+  char                tokbuf[64];
+  unsigned            result = 0;
+  int                 c, n;
+
+  c = hp_json_peek(st, &result);
+
+  /* Pending separator */
+
+  switch (st->state) {
+  case HP_JSON_PARSE_STATE_ARRAY_COMMA:
+    if (c != ',')  return (-1);
+    st->state = HP_JSON_PARSE_STATE_ARRAY_OBJ;
     break;
-  case HP_JSON_PARSE_STATE_DICT_KEY:
-    ust->state = HP_JSON_PARSE_STATE_DICT_COLON;
+  case HP_JSON_PARSE_STATE_DICT_COLON:
+    if (c != ':')  return (-1);
+    st->state = HP_JSON_PARSE_STATE_DICT_VAL;
     break;
+  case HP_JSON_PARSE_STATE_OBJ:
+  case HP_JSON_PARSE_STATE_ARRAY_OBJ:
   case HP_JSON_PARSE_STATE_DICT_VAL:
-    ++ust->item_cnt;
-    ust->state = HP_JSON_PARSE_STATE_DICT_COMMA;
+    goto val;
+  default:
+    return (-1);
+  }
+  hp_json_stream_getc(st);
+  ++result;
+  c = hp_json_peek(st, &result);
+
+ val:
+  memset(sk, 0, sizeof(*sk));
+  switch (c) {
+  case '[':
+  case '{':
+  case '"':
+    TRYN(hp_json_skip_raw(st, sk));
     break;
+
+  case -1:
+  case ']':
+  case '}':
+    return (-1);
+
   default:
-    ;
+    TRYN(hp_json_parse_tok(st, tok, tokbuf, sizeof(tokbuf), 0, 0));
+    if (tok->code != HP_JSON_PARSE_TOK_NUM)  return (-1);
   }
 
+  hp_json_parse_after(st);
+
   return (result);
 }
+
+/* String value equal to s, allowing for escapes */
+
+static int
+hp_json_str_eq(struct hp_json_parseval *pval, const char *s, unsigned n)
+{
+  const char *p = pval->str, *e = p + pval->str_len;
+
+  if (!pval->str_esc)  return (pval->str_len == n && memcmp(p, s, n) == 0);
+
+  for ( ; p < e; ++p, ++s, --n) {
+    if (*p == '\\' && ++p == e)  return (0);
+    if (n == 0 || *p != *s)  return (0);
+  }
+
+  return (n == 0);
+}
+
+/** ************************************************************************
+
+\brief Parse value at path
+
+The path is a sequence of dict keys, separated by '.', and array indices
+in brackets, e.g. "a.b[3].c"; keys cannot contain '.' or '['.  Values
+along the way that are not on the path are skipped, as by hp_json_skip(),
+and the value at the end of the path is then parsed, as by
+hp_json_parse().
+
+Each array or dict entered along the path is read through the next of
+lvls, chained to st as by hp_json_parse(), so st stays usable: parsing can
+go on in the innermost container entered, after the value found, and back
+out through st.  If st is between entries of a dict, rather than at a
+value, a leading key is looked for among its remaining entries, and takes
+no level; e.g. after path "a" from {"a": 1, "b": 3}, path "b" from lvls[0]
+finds 3.
+
+\param[in] st JSON stream, at a value or between entries of a dict
+\param[in] path Path, relative to st
+\param[out] pval Value found; keys along the path go through it too
+\param[out] cst Stream for contents of an array or dict found
+\param[out] lvls Streams for containers entered, one per path component
+\param[in] nlvls Number of lvls
+
+\returns Number of bytes consumed, or -1 if not found or on error
+
+*/
+
+int
+hp_json_path(struct hp_json_stream   *st,
+	     const char              *path,
+	     struct hp_json_parseval *pval,
+	     struct hp_json_stream   *cst,
+	     struct hp_json_stream   *lvls,
+	     unsigned                nlvls
+	     )
+{
+  struct hp_json_stream *cur = st;
+  unsigned              k = 0, len;
+  unsigned long         i, idx;
+  char                  *e;
+  int                   n, result = 0;
+
+  for (;;) {
+    if (*path == '.')  ++path;
+
+    if (*path == 0) {
+      TRYN(hp_json_parse(cur, pval, cst));
+      if (pval->code == HP_JSON_PARSE_ARRAY_END || pval->code == HP_JSON_PARSE_DICT_END)  return (-1);
+
+      return (result);
+    }
+
+    if (*path == '[') {
+      idx = strtoul(path + 1, &e, 10);
+      if (e == path + 1 || *e != ']')  return (-1);
+      path = e + 1;
+
+      if (k == nlvls)  return (-1);
+      TRYN(hp_json_parse(cur, pval, &lvls[k]));
+      if (pval->code != HP_JSON_PARSE_ARRAY_BEGIN)  return (-1);
+      cur = &lvls[k++];
+
+      for (i = 0; i < idx; ++i)  TRYN(hp_json_skip(cur));
+
+      continue;
+    }
+
+    len = strcspn(path, ".[");
+
+    if (cur->state != HP_JSON_PARSE_STATE_DICT_KEY && cur->state != HP_JSON_PARSE_STATE_DICT_COMMA) {
+      if (k == nlvls)  return (-1);
+      TRYN(hp_json_parse(cur, pval, &lvls[k]));
+      if (pval->code != HP_JSON_PARSE_DICT_BEGIN)  return (-1);
+      cur = &lvls[k++];
+    }
+
+    for (;;) {
+      TRYN(hp_json_parse(cur, pval, 0));
+      if (pval->code != HP_JSON_PARSE_STRING)  return (-1);
+      if (hp_json_str_eq(pval, path, len))  break;
+      TRYN(hp_json_skip(cur));
+    }
+    path += len;
+  }
+}
+
+/** ************************************************************************
+
+\brief Unescape string value
+
+Removes the escapes from a string value returned without copying, i.e.
+with str_esc set, in the same way that hp_json_parse() does when copying.
+
+\param[out] dst Destination; may be the string itself
+\param[in] dst_size Size of dst, including a terminating NUL
+\param[in] src String value
+\param[in] n Length of src
+
+\returns Length of unescaped string, or -1 if it does not fit
+
+*/
+
+int
+hp_json_unescape(char *dst, unsigned dst_size, const char *src, unsigned n)
+{
+  const char *e = src + n;
+  char       *q = dst;
+
+  for ( ; src < e; ++src) {
+    if (*src == '\\' && ++src == e)  break;
+    if (q - dst + 1 >= dst_size)  return (-1);
+    *q++ = *src;
+  }
+  if (dst_size == 0)  return (-1);
+  *q = 0;
+
+  return (q - dst);
+}
+
+/* JSON Lines: chunks are claimed in order, from a ring of 2 per worker when
+   ordered; a slot is reused once delivered
+*/
+
+struct hp_json_lines_rec {
+  unsigned long long ofs;
+  void               *result;
+  unsigned           worker;
+};
+
+struct hp_json_lines_chunk {
+  struct hp_json_lines_rec *recs;
+  unsigned                 cnt, size;
+  unsigned char            done;
+};
+
+struct hp_json_lines_run {
+  struct hp_json_lines       *jl;
+  char                       *buf;
+  unsigned long long         len, next;	/* Start of next chunk */
+  unsigned                   chunk_size;
+  struct hp_json_lines_chunk *ring;
+  unsigned                   ring_size;
+  unsigned long long         claimed, delivered;	/* Chunk counts */
+  pthread_mutex_t            mutex;
+  pthread_cond_t             cond;
+  atomic_uchar               err;	/* Also read unlocked, to stop early */
+};
+
+struct hp_json_lines_worker {
+  struct hp_json_lines_run *run;
+  unsigned                 idx;
+  pthread_t                thread;
+};
+
+static int
+hp_json_lines_rec_add(struct hp_json_lines_chunk *c, unsigned worker, unsigned long long ofs, void *result)
+{
+  struct hp_json_lines_rec *p;
+  unsigned                 n;
+
+  if (c->cnt == c->size) {
+    n = c->size ? 2 * c->size : 64;
+    if ((p = realloc(c->recs, n * sizeof(*p))) == 0)  return (-1);
+    c->recs = p;
+    c->size = n;
+  }
+  p = &c->recs[c->cnt++];
+  p->ofs    = ofs;
+  p->result = result;
+  p->worker = worker;
+
+  return (0);
+}
+
+static void
+hp_json_lines_discard(struct hp_json_lines *jl, struct hp_json_lines_rec *r, unsigned n)
+{
+  if (jl->discard == 0)  return;
+
+  for ( ; n; --n, ++r)  (*jl->discard)(jl->arg, r->result);
+}
+
+/* Parse records in buf[ofs .. end); into chunk c, or delivered at once if
+   c is 0
+*/
+
+static int
+hp_json_lines_chunk(struct hp_json_lines_run   *run,
+		    unsigned                   worker,
+		    struct hp_json_lines_chunk *c,
+		    unsigned long long         ofs,
+		    unsigned long long         end
+		    )
+{
+  struct hp_json_lines  *jl = run->jl;
+  struct hp_stream_buf  sb[1];
+  struct hp_json_stream st[1];
+  char                  *p, *q, *e = run->buf + end;
+  void                  *result;
+
+  for (p = run->buf + ofs; p < e; p = q + 1) {
+    if ((q = memchr(p, '\n', e - p)) == 0)  q = e;
+    if (hp_json_ws_span(p, q - p) == q - p)  continue; /* Blank */
+
+    result = 0;
+    hp_json_stream_parse_init(st, hp_stream_buf_init(sb, p, q - p)->base);
+    TRY((*jl->parse)(jl->arg, worker, p - run->buf, st, &result));
+    if (c == 0 ? atomic_load_explicit(&run->err, memory_order_relaxed)
+	: hp_json_lines_rec_add(c, worker, p - run->buf, result) < 0
+	) {
+      if (jl->discard != 0)  (*jl->discard)(jl->arg, result);
+
+      return (-1);
+    }
+    if (c == 0)  TRY((*jl->deliver)(jl->arg, worker, p - run->buf, result));
+  }
+
+  return (0);
+}
+
+static void *
+hp_json_lines_thread(void *arg)
+{
+  struct hp_json_lines_worker *w   = (struct hp_json_lines_worker *) arg;
+  struct hp_json_lines_run    *run = w->run;
+  struct hp_json_lines_chunk  *c   = 0;
+  unsigned long long          ofs, end;
+  char                        *q;
+  int                         k;
+
+  pthread_mutex_lock(&run->mutex);
+  for (;;) {
+    while (!run->err
+	   && run->next < run->len
+	   && run->ring != 0
+	   && run->claimed - run->delivered >= run->ring_size
+	   ) {
+      pthread_cond_wait(&run->cond, &run->mutex);
+    }
+    if (run->err || run->next >= run->len)  break;
+
+    /* Claim next chunk, ending after a newline */
+
+    ofs = run->next;
+    if ((end = ofs + run->chunk_size) >= run->len) {
+      end = run->len;
+    } else if ((q = memchr(run->buf + end, '\n', run->len - end)) == 0) {
+      end = run->len;
+    } else {
+      end = q + 1 - run->buf;
+    }
+    run->next = end;
+    if (run->ring != 0)  c = &run->ring[run->claimed % run->ring_size];
+    ++run->claimed;
+    pthread_mutex_unlock(&run->mutex);
+
+    k = hp_json_lines_chunk(run, w->idx, c, ofs, end);
+
+    pthread_mutex_lock(&run->mutex);
+    if (k < 0)  run->err = 1;
+    if (c != 0)  c->done = 1;
+    pthread_cond_broadcast(&run->cond);
+  }
+  pthread_cond_broadcast(&run->cond);
+  pthread_mutex_unlock(&run->mutex);
+
+  return (0);
+}
+
+/* Deliver chunks in order, as they complete */
+
+static void
+hp_json_lines_deliver(struct hp_json_lines_run *run)
+{
+  struct hp_json_lines       *jl = run->jl;
+  struct hp_json_lines_chunk *c;
+  struct hp_json_lines_rec   *r;
+  unsigned                   n;
+  int                        k;
+
+  pthread_mutex_lock(&run->mutex);
+  for (;;) {
+    c = &run->ring[run->delivered % run->ring_size];
+    while (!run->err
+	   && !(run->delivered < run->claimed && c->done)
+	   && !(run->delivered == run->claimed && run->next >= run->len)
+	   ) {
+      pthread_cond_wait(&run->cond, &run->mutex);
+    }
+    if (run->err || run->delivered == run->claimed)  break;
+    pthread_mutex_unlock(&run->mutex);
+
+    for (k = 0, r = c->recs, n = c->cnt; n && k >= 0; --n, ++r) {
+      k = (*jl->deliver)(jl->arg, r->worker, r->ofs, r->result);
+    }
+    hp_json_lines_discard(jl, r, n);
+
+    pthread_mutex_lock(&run->mutex);
+    if (k < 0)  run->err = 1;
+    c->cnt  = 0;
+    c->done = 0;
+    ++run->delivered;
+    pthread_cond_broadcast(&run->cond);
+  }
+  pthread_mutex_unlock(&run->mutex);
+}
+
+/** ************************************************************************
+
+\brief Parse JSON Lines in parallel
+
+See struct hp_json_lines.
+
+\param[in] jl Callbacks and settings
+\param[in] buf Records, newline-terminated; the last one need not be
+\param[in] len Length of buf
+
+\returns 0 on success, -1 if a callback failed or no thread could be
+started
+
+*/
+
+int
+hp_json_lines_parse(struct hp_json_lines *jl, char *buf, unsigned long long len)
+{
+  struct hp_json_lines_run    run[1];
+  struct hp_json_lines_worker *w;
+  unsigned                    n = jl->nthreads, i, started;
+  long                        k;
+
+  if (n == 0)  n = (k = sysconf(_SC_NPROCESSORS_ONLN)) > 0 ? k : 1;
+  if (n > HP_JSON_LINES_THREADS_MAX)  n = HP_JSON_LINES_THREADS_MAX;
+
+  memset(run, 0, sizeof(*run));
+  atomic_init(&run->err, 0);
+  run->jl         = jl;
+  run->buf        = buf;
+  run->len        = len;
+  run->chunk_size = jl->chunk_size ? jl->chunk_size : HP_JSON_LINES_CHUNK_SIZE_DFLT;
+
+  if ((w = calloc(n, sizeof(*w))) == 0)  return (-1);
+  if (!(jl->flags & HP_JSON_LINES_UNORDERED)) {
+    run->ring_size = 2 * n;
+    if ((run->ring = calloc(run->ring_size, sizeof(*run->ring))) == 0) {
+      free(w);
+
+      return (-1);
+    }
+  }
+
+  pthread_mutex_init(&run->mutex, 0);
+  pthread_cond_init(&run->cond, 0);
+  for (started = 0; started < n; ++started) {
+    w[started].run = run;
+    w[started].idx = started;
+    if (pthread_create(&w[started].thread, 0, hp_json_lines_thread, &w[started]) != 0)  break;
+  }
+
+  if (started == 0) {
+    run->err = 1;
+  } else if (run->ring != 0) {
+    hp_json_lines_deliver(run);
+  }
+
+  for (i = 0; i < started; ++i)  pthread_join(w[i].thread, 0);
+
+  pthread_cond_destroy(&run->cond);
+  pthread_mutex_destroy(&run->mutex);
+  if (run->ring != 0) {
+    for (i = 0; i < run->ring_size; ++i) {
+      hp_json_lines_discard(jl, run->ring[i].recs, run->ring[i].cnt);
+      free(run->ring[i].recs);
+    }
+    free(run->ring);
+  }
+  free(w);
+
+  return (run->err ? -1 : 0);
+}
@@ -11,6 +11,7 @@ struct hp_json_stream *hp_json_stream_tostring_init(struct hp_json_stream *st,
 						    );
 
 int hp_json_int_tostring(struct hp_json_stream *st, int val);
+int hp_json_llong_tostring(struct hp_json_stream *st, long long val);
 int hp_json_hex_tostring(struct hp_json_stream *st, int val);
 int hp_json_float_tostring(struct hp_json_stream *st, double val);
 int hp_json_string_tostring(struct hp_json_stream *st, char *s);
@@ -34,12 +35,23 @@ enum {
   HP_JSON_PARSE_DICT_END
 };
 
+/* String values are copied to strbuf, unescaped and NUL-terminated.  If
+   strbuf is 0, they are instead left in place: str points into the stream's
+   window, and is valid only as long as that is, and str_esc says whether
+   hp_json_unescape() is needed.  This needs each string to lie wholly
+   within the window, as for buffer and mmap streams.  Either way, str and
+   str_len give the value.
+*/
+
 struct hp_json_parseval {
-  unsigned code;
-  int      intval;
-  double   floatval;
-  char     *strbuf;
-  unsigned strbufsize;
+  unsigned      code;
+  long long     intval;
+  double        floatval;
+  char          *strbuf;
+  unsigned      strbufsize;
+  char          *str;
+  unsigned      str_len;
+  unsigned char str_esc;
 };
 
 int
@@ -48,5 +60,57 @@ hp_json_parse(struct hp_json_stream   *st,
 	      struct hp_json_stream   *cst
 	      );
 
+/* On-demand access: skip a value unread, or go straight to one by path */
+
+int hp_json_skip(struct hp_json_stream *st);
+int hp_json_unescape(char *dst, unsigned dst_size, const char *src, unsigned n);
+int
+hp_json_path(struct hp_json_stream   *st,
+	     const char              *path,
+	     struct hp_json_parseval *pval,
+	     struct hp_json_stream   *cst,
+	     struct hp_json_stream   *lvls,
+	     unsigned                nlvls
+	     );
+
+/* JSON Lines (NDJSON): one value per line, parsed on a pool of threads
+
+   The buffer is cut into chunks at line boundaries, and workers take
+   chunks in turn.  For each record, parse() is called on a worker, with a
+   JSON stream over just that line; the record is named by its offset in
+   the buffer, and blank lines are skipped.  What parse() leaves in *result
+   is then passed to deliver().
+
+   By default, deliver() is called from the calling thread, in record
+   order; at most 2 chunks per worker are parsed ahead of it.  With
+   HP_JSON_LINES_UNORDERED, it is instead called by the worker, straight
+   after parse(), and so concurrently.  worker (0 .. nthreads - 1) is the
+   thread that parsed the record, for per-thread state.
+
+   A callback returning -1 stops the run.  Results parse() made that are
+   then not passed to deliver() are passed to discard(), if set, from any
+   thread; a result deliver() fails on stays with deliver().
+*/
+
+enum {
+  HP_JSON_LINES_UNORDERED = 1 << 0,
+  HP_JSON_LINES_CHUNK_SIZE_DFLT = 1 << 20,
+  HP_JSON_LINES_THREADS_MAX = 256
+};
+
+struct hp_json_lines {
+  int      (*parse)(void *arg, unsigned worker, unsigned long long ofs,
+		    struct hp_json_stream *st, void **result
+		    );
+  int      (*deliver)(void *arg, unsigned worker, unsigned long long ofs, void *result);
+  void     (*discard)(void *arg, void *result);
+  void     *arg;
+  unsigned nthreads;		/* 0 for one per online CPU */
+  unsigned chunk_size;		/* 0 for default */
+  unsigned flags;
+};
+
+int hp_json_lines_parse(struct hp_json_lines *jl, char *buf, unsigned long long len);
+
 
 #define ARRAY_SIZE(a)  (sizeof(a) / sizeof((a)[0]))
@@ -1,3 +1,4 @@
+#include <stdlib.h>
 #include <string.h>
 #include <assert.h>
 
@@ -138,6 +139,464 @@ test_json_parse(struct hp_json_stream *st, struct test *t)
   return (result);
 }
 
+/* Same tokens whether or not the stream has a window; the memory stream's
+   small chunks split whitespace runs and strings across windows
+*/
+
+int
+test_json_tokens(struct hp_stream *iost, char *strs, unsigned strs_size)
+{
+  struct hp_json_parseval pval[1];
+  struct hp_json_stream   st[1], ast[1];
+  char                    strbuf[1024];
+  int                     cnt = 0;
+
+  pval->strbuf     = strbuf;
+  pval->strbufsize = sizeof(strbuf);
+
+  hp_json_stream_parse_init(st, iost);
+  assert(hp_json_parse(st, pval, ast) > 0 && pval->code == HP_JSON_PARSE_ARRAY_BEGIN);
+
+  for (;;) {
+    assert(hp_json_parse(ast, pval, 0) > 0);
+    if (pval->code == HP_JSON_PARSE_ARRAY_END)  break;
+    if (pval->code == HP_JSON_PARSE_STRING) {
+      assert(strlen(strbuf) < strs_size);
+      strcpy(strs, strbuf);
+      strs      += strlen(strbuf) + 1;
+      strs_size -= strlen(strbuf) + 1;
+    } else {
+      assert(pval->code == HP_JSON_PARSE_INT && pval->intval == cnt);
+    }
+    ++cnt;
+  }
+
+  return (cnt);
+}
+
+void
+test_json_window(void)
+{
+  static char           text[20000], strs1[20000], strs2[20000];
+  struct hp_stream_mem  stm[1];
+  struct hp_stream_file stf[1];
+  FILE                  *fp;
+  unsigned              i, j, n = 0;
+
+  n += sprintf(text + n, "[");
+  for (i = 0; i < 100; ++i) {
+    if (i > 0)  n += sprintf(text + n, ",%*s", i % 40, "");
+    if (i % 2 == 0) {
+      n += sprintf(text + n, "%u", i);
+      continue;
+    }
+    text[n++] = '"';
+    for (j = 0; j < 3 * i; ++j) {
+      text[n++] = j % 37 == 5 ? '\\' : 'a' + j % 26;
+      if (text[n - 1] == '\\')  text[n++] = '"';
+    }
+    text[n++] = '"';
+  }
+  n += sprintf(text + n, "\n\t ]");
+
+  hp_stream_mem_init(stm, 0);
+  assert(hp_stream_write(stm->base, text, n) == n);
+  hp_stream_seek(stm->base, 0, SEEK_SET);
+  assert(test_json_tokens(stm->base, strs1, sizeof(strs1)) == 100);
+  hp_stream_mem_fini(stm);
+
+  assert((fp = tmpfile()) != 0);
+  fwrite(text, 1, n, fp);
+  rewind(fp);
+  hp_stream_file_init(stf, fp);
+  assert(test_json_tokens(stf->base, strs2, sizeof(strs2)) == 100);
+  fclose(fp);
+
+  assert(memcmp(strs1, strs2, sizeof(strs1)) == 0);
+  assert(strcmp(strs1, "abc") == 0 && strcmp(strs1 + 4, "abcde\"ghi") == 0);
+}
+
+char doc[] =
+  "{\"x\": \"skip \\\"this\\\" [ { \","
+  " \"a\": {\"n\": [1, {\"q\": \"}]\"}, 2],"
+  "        \"b\": [10, [20, 21], {\"c\": 7}, {\"c\": 42, \"d\": [1, 2]}],"
+  "        \"s\": \"hit\"},"
+  " \"z\": [5, 6]}";
+
+/* Query by path, on a stream with a window or without */
+
+int
+test_json_query(int windowed, const char *path, struct hp_json_parseval *pval, struct hp_json_stream *cst)
+{
+  static struct hp_stream_buf  stb[1];
+  static struct hp_stream_file stf[1];
+  static FILE                  *fp;
+  static struct hp_json_stream st[1], lvls[4];
+
+  if (fp != 0)  fclose(fp);
+  fp = 0;
+  if (windowed) {
+    hp_stream_buf_init(stb, doc, strlen(doc));
+    hp_json_stream_parse_init(st, stb->base);
+  } else {
+    assert((fp = fmemopen(doc, strlen(doc), "r")) != 0);
+    hp_json_stream_parse_init(st, hp_stream_file_init(stf, fp)->base);
+  }
+
+  return (hp_json_path(st, path, pval, cst, lvls, ARRAY_SIZE(lvls)));
+}
+
+void
+test_json_path(void)
+{
+  struct hp_json_parseval pval[1];
+  struct hp_json_stream   st[1], cst[1], lvls[1];
+  struct hp_stream_buf    stb[1];
+  char                    strbuf[16], text[32];
+  int                     w;
+
+  pval->strbuf     = strbuf;
+  pval->strbufsize = sizeof(strbuf);
+
+  for (w = 0; w < 2; ++w) {
+    assert(test_json_query(w, "a.b[3].c", pval, 0) > 0 && pval->code == HP_JSON_PARSE_INT && pval->intval == 42);
+    assert(test_json_query(w, "a.b[2].c", pval, 0) > 0 && pval->intval == 7);
+    assert(test_json_query(w, "a.s", pval, 0) > 0 && pval->code == HP_JSON_PARSE_STRING && strcmp(strbuf, "hit") == 0);
+    assert(test_json_query(w, "z[1]", pval, 0) > 0 && pval->code == HP_JSON_PARSE_INT && pval->intval == 6);
+    assert(test_json_query(w, "", pval, cst) > 0 && pval->code == HP_JSON_PARSE_DICT_BEGIN);
+
+    /* Container found, read to its end */
+
+    assert(test_json_query(w, "a.b[1]", pval, cst) > 0 && pval->code == HP_JSON_PARSE_ARRAY_BEGIN);
+    assert(hp_json_parse(cst, pval, 0) > 0 && pval->intval == 20);
+    assert(hp_json_parse(cst, pval, 0) > 0 && pval->intval == 21);
+    assert(hp_json_parse(cst, pval, 0) > 0 && pval->code == HP_JSON_PARSE_ARRAY_END);
+    assert(hp_json_skip(cst->parent) > 0);
+    assert(hp_json_parse(cst->parent, pval, cst) > 0 && pval->code == HP_JSON_PARSE_DICT_BEGIN);
+
+    /* Not found, or too deep for the levels given */
+
+    assert(test_json_query(w, "a.b[3].d[1]", pval, 0) == -1);
+
+    assert(test_json_query(w, "a.q", pval, 0) == -1);
+    assert(test_json_query(w, "a.b[4]", pval, 0) == -1);
+    assert(test_json_query(w, "x.y", pval, 0) == -1);
+    assert(test_json_query(w, "a[0]", pval, 0) == -1);
+    assert(test_json_query(w, "z[1", pval, 0) == -1);
+  }
+
+  /* Skipping, mixed with parsing */
+
+  hp_stream_buf_init(stb, doc, strlen(doc));
+  hp_json_stream_parse_init(st, stb->base);
+  assert(hp_json_parse(st, pval, cst) > 0 && pval->code == HP_JSON_PARSE_DICT_BEGIN);
+  assert(hp_json_skip(cst) == -1);
+  assert(hp_json_parse(cst, pval, 0) > 0 && strcmp(strbuf, "x") == 0);
+  assert(hp_json_skip(cst) > 0);
+  assert(hp_json_parse(cst, pval, 0) > 0 && strcmp(strbuf, "a") == 0);
+  assert(hp_json_skip(cst) > 0);
+  assert(hp_json_parse(cst, pval, 0) > 0 && strcmp(strbuf, "z") == 0);
+  assert(hp_json_skip(cst) > 0);
+  assert(hp_json_skip(cst) == -1);
+  assert(hp_json_parse(cst, pval, 0) > 0 && pval->code == HP_JSON_PARSE_DICT_END);
+  assert(hp_json_parse(st, pval, 0) == 0 && pval->code == HP_JSON_PARSE_EOF);
+
+  /* Integers wider than int */
+
+  strcpy(text, "[3000000000, -12345678901234]");
+  hp_stream_buf_init(stb, text, strlen(text));
+  hp_json_stream_parse_init(st, stb->base);
+  assert(hp_json_path(st, "[0]", pval, 0, lvls, 1) > 0 && pval->code == HP_JSON_PARSE_INT && pval->intval == 3000000000LL);
+  assert(hp_json_parse(lvls, pval, 0) > 0 && pval->code == HP_JSON_PARSE_INT && pval->intval == -12345678901234LL);
+
+  /* Leading plus, as before numbers were scanned by hp_num; within the
+     window, and at its end
+  */
+
+  strcpy(text, "[+5, +2.5] +7");
+  hp_stream_buf_init(stb, text, strlen(text));
+  hp_json_stream_parse_init(st, stb->base);
+  assert(hp_json_path(st, "[0]", pval, 0, lvls, 1) > 0 && pval->code == HP_JSON_PARSE_INT && pval->intval == 5);
+  assert(hp_json_parse(lvls, pval, 0) > 0 && pval->code == HP_JSON_PARSE_FLOAT && pval->floatval == 2.5);
+  assert(hp_json_parse(lvls, pval, 0) > 0 && pval->code == HP_JSON_PARSE_ARRAY_END);
+  assert(hp_json_parse(st, pval, 0) > 0 && pval->code == HP_JSON_PARSE_INT && pval->intval == 7);
+
+  /* Several lookups, then parsing on, in the same document */
+
+  strcpy(text, "{\"a\": 1, \"b\": 3} [4]");
+  hp_stream_buf_init(stb, text, strlen(text));
+  hp_json_stream_parse_init(st, stb->base);
+  assert(hp_json_path(st, "a", pval, 0, lvls, 1) > 0 && pval->intval == 1);
+  assert(hp_json_path(lvls, "b", pval, 0, lvls + 1, 0) > 0 && pval->intval == 3);
+  assert(hp_json_parse(lvls, pval, 0) > 0 && pval->code == HP_JSON_PARSE_DICT_END);
+  assert(hp_json_path(st, "[0]", pval, 0, lvls, 1) > 0 && pval->intval == 4);
+  assert(hp_json_parse(lvls, pval, 0) > 0 && pval->code == HP_JSON_PARSE_ARRAY_END);
+  assert(hp_json_parse(st, pval, 0) == 0 && pval->code == HP_JSON_PARSE_EOF);
+
+  hp_stream_buf_init(stb, text, 16);
+  hp_json_stream_parse_init(st, stb->base);
+  assert(hp_json_path(st, "b", pval, 0, lvls, 1) > 0 && pval->intval == 3);
+  assert(hp_json_path(lvls, "a", pval, 0, lvls + 1, 0) == -1);
+}
+
+/* Strings left in place, for streams with the whole input in a window */
+
+void
+test_json_view(void)
+{
+  static char             text[1000], big[600];
+  struct hp_json_parseval pval[1];
+  struct hp_json_stream   st[1], ast[1], lvls[2];
+  struct hp_stream_buf    stb[1];
+  struct hp_stream_mem    stm[1];
+  struct hp_stream_file   stf[1];
+  FILE                    *fp;
+  char                    out[600];
+  int                     n;
+
+  memset(big, 'b', 300);
+  n = sprintf(text, "[\"plain\", \"%s\", \"es\\\"c\\\\d\", 1.%0100d, \"\"]", big, 5);
+
+  pval->strbuf     = 0;
+  pval->strbufsize = 0;
+
+  hp_stream_buf_init(stb, text, n);
+  hp_json_stream_parse_init(st, stb->base);
+  assert(hp_json_parse(st, pval, ast) > 0 && pval->code == HP_JSON_PARSE_ARRAY_BEGIN);
+  assert(hp_json_parse(ast, pval, 0) > 0 && pval->code == HP_JSON_PARSE_STRING);
+  assert(pval->str == text + 2 && pval->str_len == 5 && !pval->str_esc);
+  assert(hp_json_parse(ast, pval, 0) > 0 && pval->str_len == 300 && !pval->str_esc);
+  assert(memcmp(pval->str, big, 300) == 0);
+  assert(hp_json_parse(ast, pval, 0) > 0 && pval->str_len == 8 && pval->str_esc);
+  assert(hp_json_unescape(out, sizeof(out), pval->str, pval->str_len) == 6 && strcmp(out, "es\"c\\d") == 0);
+  assert(hp_json_unescape(out, 6, pval->str, pval->str_len) == -1);
+  assert(hp_json_unescape(pval->str, pval->str_len + 1, pval->str, pval->str_len) == 6);
+  assert(strcmp(pval->str, "es\"c\\d") == 0);
+
+  /* Long number, parsed in place */
+
+  assert(hp_json_parse(ast, pval, 0) > 0 && pval->code == HP_JSON_PARSE_FLOAT && pval->floatval == 1.0);
+  assert(hp_json_parse(ast, pval, 0) > 0 && pval->code == HP_JSON_PARSE_STRING && pval->str_len == 0);
+  assert(hp_json_parse(ast, pval, 0) > 0 && pval->code == HP_JSON_PARSE_ARRAY_END);
+
+  /* Copying still reports str and str_len */
+
+  pval->strbuf     = out;
+  pval->strbufsize = sizeof(out);
+  hp_stream_buf_init(stb, text, n);
+  hp_json_stream_parse_init(st, stb->base);
+  assert(hp_json_parse(st, pval, ast) > 0);
+  assert(hp_json_parse(ast, pval, 0) > 0 && pval->str == out && pval->str_len == 5 && strcmp(out, "plain") == 0);
+  assert(hp_json_parse(ast, pval, 0) > 0 && pval->str_len == 300);
+
+  /* Path keys compared in place, escapes allowed */
+
+  pval->strbuf = 0;
+  n = sprintf(text, "{\"a\": 1, \"k\\ey\": {\"x%s\": 2, \"y\": 3}}", big);
+  hp_stream_buf_init(stb, text, n);
+  hp_json_stream_parse_init(st, stb->base);
+  assert(hp_json_path(st, "key.y", pval, 0, lvls, 2) > 0 && pval->intval == 3);
+  hp_stream_buf_init(stb, text, n);
+  hp_json_stream_parse_init(st, stb->base);
+  assert(hp_json_path(st, "a", pval, 0, lvls, 2) > 0 && pval->code == HP_JSON_PARSE_INT && pval->intval == 1);
+  assert(hp_json_path(lvls, "key.y", pval, 0, lvls + 1, 1) > 0 && pval->intval == 3);
+
+  /* String split across windows cannot be left in place */
+
+  hp_stream_mem_init(stm, 0);
+  hp_stream_write(stm->base, text, n);
+  hp_stream_seek(stm->base, HP_STREAM_MEM_CHUNK_MIN - 10, SEEK_SET);
+  hp_stream_puts(stm->base, "\"straddling chunks\"");
+  hp_stream_seek(stm->base, HP_STREAM_MEM_CHUNK_MIN - 10, SEEK_SET);
+  hp_json_stream_parse_init(st, stm->base);
+  assert(hp_json_parse(st, pval, 0) == -1);
+  hp_stream_mem_fini(stm);
+
+  /* Nor can it with no window at all, whatever strbufsize says */
+
+  pval->strbufsize = sizeof(out);
+  assert((fp = fmemopen(text, n, "r")) != 0);
+  hp_json_stream_parse_init(st, hp_stream_file_init(stf, fp)->base);
+  assert(hp_json_parse(st, pval, ast) > 0 && pval->code == HP_JSON_PARSE_DICT_BEGIN);
+  assert(hp_json_parse(ast, pval, 0) == -1);
+  fclose(fp);
+}
+
+/* JSON Lines, over several workers and chunk sizes, ordered or not */
+
+enum {
+  LINES_CNT = 20000
+};
+
+struct test_lines {
+  char               *buf;
+  unsigned           nthreads;
+  unsigned long long next, last_ofs;
+  unsigned long long cnt, sum;
+  unsigned long long parsed, failed, discarded;
+  unsigned           fail_at;	/* Record whose parse fails, if nonzero */
+  unsigned           stop_after; /* Deliveries before deliver fails, if nonzero */
+};
+
+static int
+test_lines_parse(void *arg, unsigned worker, unsigned long long ofs, struct hp_json_stream *st, void **result)
+{
+  struct test_lines       *tl = (struct test_lines *) arg;
+  struct hp_json_parseval pval[1];
+  struct hp_json_stream   lvls[1];
+
+  assert(worker < tl->nthreads && tl->buf[ofs] == '{');
+
+  pval->strbuf     = 0;
+  pval->strbufsize = 0;
+  if (hp_json_path(st, "id", pval, 0, lvls, 1) < 0 || pval->code != HP_JSON_PARSE_INT)  return (-1);
+  if (tl->fail_at != 0 && pval->intval == tl->fail_at)  return (-1);
+  *result = (void *)(long) (pval->intval + 1);
+  __sync_fetch_and_add(&tl->parsed, 1);
+
+  return (0);
+}
+
+static int
+test_lines_deliver(void *arg, unsigned worker, unsigned long long ofs, void *result)
+{
+  struct test_lines *tl = (struct test_lines *) arg;
+
+  assert(worker < tl->nthreads && result != 0);
+  if (tl->stop_after != 0 && tl->cnt == tl->stop_after) {
+    ++tl->failed;
+
+    return (-1);
+  }
+  assert((long) result == tl->next + 1);
+  assert(tl->next == 0 || ofs > tl->last_ofs);
+  ++tl->next;
+  tl->last_ofs = ofs;
+  ++tl->cnt;
+
+  return (0);
+}
+
+static int
+test_lines_deliver_unordered(void *arg, unsigned worker, unsigned long long ofs, void *result)
+{
+  struct test_lines *tl = (struct test_lines *) arg;
+
+  assert(worker < tl->nthreads && result != 0);
+  if (tl->stop_after != 0 && __sync_fetch_and_add(&tl->cnt, 1) >= tl->stop_after) {
+    __sync_fetch_and_add(&tl->failed, 1);
+
+    return (-1);
+  }
+  __sync_fetch_and_add(&tl->sum, (long) result - 1);
+  if (tl->stop_after == 0)  __sync_fetch_and_add(&tl->cnt, 1);
+
+  return (0);
+}
+
+static void
+test_lines_discard(void *arg, void *result)
+{
+  struct test_lines *tl = (struct test_lines *) arg;
+
+  assert(result != 0);
+  __sync_fetch_and_add(&tl->discarded, 1);
+}
+
+void
+test_json_lines(void)
+{
+  static const unsigned nthreads[]    = { 1, 4 };
+  static const unsigned chunk_sizes[] = { 1, 100, 0 };
+  struct test_lines     tl[1];
+  struct hp_json_lines  jl[1];
+  char                  *buf;
+  unsigned              i, j, k, n;
+
+  /* Blank lines, CRLF, and no final newline */
+
+  assert((buf = malloc(64 * LINES_CNT)) != 0);
+  for (n = i = 0; i < LINES_CNT; ++i) {
+    if (i % 100 == 0)  n += sprintf(buf + n, i % 200 ? "\n" : " \t\r\n");
+    n += sprintf(buf + n, "{\"name\": \"rec\", \"id\": %u, \"v\": [%u, 2]}%s",
+		 i, i, i + 1 == LINES_CNT ? "" : i % 3 ? "\n" : "\r\n"
+		 );
+  }
+
+  for (i = 0; i < ARRAY_SIZE(nthreads); ++i) {
+    for (j = 0; j < ARRAY_SIZE(chunk_sizes); ++j) {
+      for (k = 0; k < 2; ++k) {
+	memset(tl, 0, sizeof(tl));
+	tl->buf      = buf;
+	tl->nthreads = nthreads[i];
+
+	memset(jl, 0, sizeof(jl));
+	jl->parse      = test_lines_parse;
+	jl->deliver    = k ? test_lines_deliver_unordered : test_lines_deliver;
+	jl->arg        = tl;
+	jl->nthreads   = nthreads[i];
+	jl->chunk_size = chunk_sizes[j];
+	jl->flags      = k ? HP_JSON_LINES_UNORDERED : 0;
+
+	assert(hp_json_lines_parse(jl, buf, n) == 0);
+	assert(tl->cnt == LINES_CNT);
+	if (k)  assert(tl->sum == (unsigned long long) LINES_CNT * (LINES_CNT - 1) / 2);
+      }
+    }
+  }
+
+  /* Failing callbacks stop the run */
+
+  memset(tl, 0, sizeof(tl));
+  tl->buf      = buf;
+  tl->nthreads = 4;
+  tl->fail_at  = LINES_CNT / 2;
+  jl->deliver  = test_lines_deliver;
+  jl->flags    = 0;
+  jl->nthreads = 4;
+  assert(hp_json_lines_parse(jl, buf, n) == -1);
+  assert(tl->cnt < LINES_CNT / 2);
+
+  /* Results not delivered are discarded */
+
+  memset(tl, 0, sizeof(tl));
+  tl->buf      = buf;
+  tl->nthreads = 4;
+  tl->fail_at  = LINES_CNT / 2;
+  jl->discard  = test_lines_discard;
+  assert(hp_json_lines_parse(jl, buf, n) == -1);
+  assert(tl->parsed == tl->cnt + tl->discarded);
+
+  memset(tl, 0, sizeof(tl));
+  tl->buf        = buf;
+  tl->nthreads   = 4;
+  tl->stop_after = 1000;
+  assert(hp_json_lines_parse(jl, buf, n) == -1);
+  assert(tl->cnt == 1000);
+  assert(tl->failed == 1 && tl->parsed == tl->cnt + tl->failed + tl->discarded);
+
+  /* Nothing, and only blanks */
+
+  jl->nthreads = 0;
+  assert(hp_json_lines_parse(jl, buf, 0) == 0);
+  assert(hp_json_lines_parse(jl, "\n \n\n", 4) == 0);
+  assert(tl->cnt == 1000);
+
+  /* Unordered, a worker stops delivering once another fails */
+
+  memset(tl, 0, sizeof(tl));
+  tl->buf        = buf;
+  tl->nthreads   = 4;
+  tl->stop_after = 1000;
+  jl->deliver    = test_lines_deliver_unordered;
+  jl->flags      = HP_JSON_LINES_UNORDERED;
+  jl->nthreads   = 4;
+  assert(hp_json_lines_parse(jl, buf, n) == -1);
+  assert(tl->parsed == tl->cnt + tl->discarded);
+
+  free(buf);
+}
+
 
 struct test test_out[1] = { {
     42, 3.14, { 2, 3, 5, 7, 11 }, "sam"
@@ -173,5 +632,10 @@ main(void)
   assert(memcmp(test_in->a, test_out->a, sizeof(test_in->a)) == 0);
   assert(strcmp(test_in->s, test_out->s) == 0);
 
+  test_json_window();
+  test_json_path();
+  test_json_view();
+  test_json_lines();
+
   return (0);
 }
@@ -0,0 +1,734 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "shared/hp_common.h"
+#include "hp_lz.h"
+
+/* Codec */
+
+enum {
+  HP_LZ_MIN_MATCH  = 4,
+  HP_LZ_LAST_LITS  = 5,		/* Literals always ending a block */
+  HP_LZ_MF_LIMIT   = 12,	/* No match starts this close to end */
+  HP_LZ_HASH_BITS  = 12,
+  HP_LZ_MAX_OFS    = 65535,
+  HP_LZ_SKIP_SHIFT = 6		/* Step faster through incompressible data */
+};
+
+static inline uint32
+get32(const uint8 *p)
+{
+  uint32 result;
+
+  memcpy(&result, p, sizeof(result));
+
+  return (result);
+}
+
+static inline unsigned
+hash32(uint32 x)
+{
+  return ((x * 2654435761U) >> (32 - HP_LZ_HASH_BITS));
+}
+
+/* Worst case compressed size, for incompressible input */
+
+unsigned
+hp_lz_bound(unsigned n)
+{
+  return (n + n / 255 + 16);
+}
+
+/* Length field continuation: 255s, then remainder */
+
+static uint8 *
+hp_lz_len_put(uint8 *op, unsigned n)
+{
+  for ( ; n >= 255; n -= 255)  *op++ = 255;
+  *op++ = n;
+
+  return (op);
+}
+
+static uint8 *
+hp_lz_seq_put(uint8 *op, uint8 *oend, const uint8 *lit, unsigned lit_len, unsigned ofs, unsigned match_len)
+{
+  uint8 *token;
+
+  /* Token, lengths, literals, offset */
+
+  if (lit_len + lit_len / 255 + match_len / 255 + 8 > oend - op)  return (0);
+
+  token = op++;
+  if (lit_len >= 15) {
+    *token = 15 << 4;
+    op = hp_lz_len_put(op, lit_len - 15);
+  } else {
+    *token = lit_len << 4;
+  }
+
+  memcpy(op, lit, lit_len);
+  op += lit_len;
+
+  if (match_len == 0)  return (op);
+
+  *op++ = ofs;
+  *op++ = ofs >> 8;
+
+  match_len -= HP_LZ_MIN_MATCH;
+  if (match_len >= 15) {
+    *token |= 15;
+    op = hp_lz_len_put(op, match_len - 15);
+  } else {
+    *token |= match_len;
+  }
+
+  return (op);
+}
+
+/* Returns compressed size, or 0 if it would not fit in dst_size */
+
+int
+hp_lz_compress(const char *src, unsigned n, char *dst, unsigned dst_size)
+{
+  uint32      tbl[1 << HP_LZ_HASH_BITS];
+  const uint8 *base = (const uint8 *) src, *ip = base, *anchor = base, *end = base + n, *ref, *p, *q;
+  uint8       *op = (uint8 *) dst, *oend = op + dst_size;
+  uint32      seq;
+  unsigned    h;
+
+  if (n > HP_LZ_MF_LIMIT) {
+    const uint8 *mf_limit = end - HP_LZ_MF_LIMIT, *match_limit = end - HP_LZ_LAST_LITS;
+
+    memset(tbl, 0, sizeof(tbl));
+
+    for (++ip; ip < mf_limit; ) {
+      seq    = get32(ip);
+      h      = hash32(seq);
+      ref    = base + tbl[h];
+      tbl[h] = ip - base;
+
+      if (ip - ref > HP_LZ_MAX_OFS || get32(ref) != seq) {
+	ip += 1 + ((ip - anchor) >> HP_LZ_SKIP_SHIFT);
+	continue;
+      }
+
+      /* Extend backwards, then forwards */
+
+      for ( ; ip > anchor && ref > base && ip[-1] == ref[-1]; --ip, --ref);
+      for (p = ip + HP_LZ_MIN_MATCH, q = ref + HP_LZ_MIN_MATCH; p < match_limit && *p == *q; ++p, ++q);
+
+      if ((op = hp_lz_seq_put(op, oend, anchor, ip - anchor, ip - ref, p - ip)) == 0)  return (0);
+
+      anchor = ip = p;
+      if (ip - 2 > base)  tbl[hash32(get32(ip - 2))] = ip - 2 - base;
+    }
+  }
+
+  if ((op = hp_lz_seq_put(op, oend, anchor, end - anchor, 0, 0)) == 0)  return (0);
+
+  return (op - (uint8 *) dst);
+}
+
+static int
+hp_lz_len_get(const uint8 **pip, const uint8 *iend, unsigned *n, unsigned limit)
+{
+  const uint8 *ip = *pip;
+  unsigned    b;
+
+  do {
+    if (ip >= iend)  return (-1);
+    *n += b = *ip++;
+    if (*n > limit)  return (-1);
+  } while (b == 255);
+
+  *pip = ip;
+
+  return (0);
+}
+
+/* Returns decompressed size, or -1 if input is malformed or would overrun
+   dst_size; never reads or writes out of bounds
+*/
+
+int
+hp_lz_decompress(const char *src, unsigned n, char *dst, unsigned dst_size)
+{
+  const uint8 *ip = (const uint8 *) src, *iend = ip + n;
+  uint8       *op = (uint8 *) dst, *oend = op + dst_size, *ref;
+  unsigned    token, len, ofs;
+
+  for (;;) {
+    if (ip >= iend)  return (-1);
+    token = *ip++;
+
+    len = token >> 4;
+    if (len == 15 && hp_lz_len_get(&ip, iend, &len, dst_size) < 0)  return (-1);
+    if (len > iend - ip || len > oend - op)  return (-1);
+    memcpy(op, ip, len);
+    op += len;
+    ip += len;
+
+    /* Last sequence has literals only */
+
+    if (ip == iend)  break;
+
+    if (iend - ip < 2)  return (-1);
+    ofs = ip[0] | ip[1] << 8;
+    ip += 2;
+    if (ofs == 0 || ofs > op - (uint8 *) dst)  return (-1);
+
+    len = token & 15;
+    if (len == 15 && hp_lz_len_get(&ip, iend, &len, dst_size) < 0)  return (-1);
+    len += HP_LZ_MIN_MATCH;
+    if (len > oend - op)  return (-1);
+
+    ref = op - ofs;
+    if (ofs >= len) {
+      memcpy(op, ref, len);
+      op += len;
+    } else {
+      /* Overlapping: repeats the last ofs bytes */
+
+      for ( ; len; --len)  *op++ = *ref++;
+    }
+  }
+
+  return (op - (uint8 *) dst);
+}
+
+/* Compressed stream */
+
+enum {
+  HP_LZ_HDR_SIZE    = 8,
+  HP_LZ_FOOTER_SIZE = 12,
+  HP_LZ_STORED      = 0x80000000U
+};
+
+#define HP_LZ_POS_MAX  0xffffffffULL
+
+static const char hp_lz_magic[]  = "HPLZ";
+static const char hp_lz_footer[] = "HPLX";
+
+static void
+put32(char *p, uint32 val)
+{
+  p[0] = val;
+  p[1] = val >> 8;
+  p[2] = val >> 16;
+  p[3] = val >> 24;
+}
+
+static uint32
+get32le(const char *p)
+{
+  const uint8 *q = (const uint8 *) p;
+
+  return (q[0] | q[1] << 8 | q[2] << 16 | (uint32) q[3] << 24);
+}
+
+/* Exactly n bytes from underlying stream */
+
+static int
+hp_stream_lz_in(struct hp_stream_lz *st, char *buf, unsigned n)
+{
+  int k;
+
+  for ( ; n; buf += k, n -= k) {
+    if ((k = hp_stream_read(st->iost, buf, n)) <= 0)  return (-1);
+  }
+
+  return (0);
+}
+
+/* Offsets and lengths are 32-bit in the format, so a stream stops at 4 GB,
+   compressed or not, rather than write an index that cannot address it
+*/
+
+static int
+hp_stream_lz_out(struct hp_stream_lz *st, const char *buf, unsigned n)
+{
+  if (st->comp_pos + (unsigned long long) n > HP_LZ_POS_MAX)  return (-1);
+  if (hp_stream_write(st->iost, buf, n) < 0)  return (-1);
+
+  st->comp_pos += n;
+
+  return (0);
+}
+
+static int
+hp_stream_lz_hdr_out(struct hp_stream_lz *st, uint32 a, uint32 b)
+{
+  char hdr[HP_LZ_HDR_SIZE];
+
+  put32(hdr, a);
+  put32(hdr + 4, b);
+
+  return (hp_stream_lz_out(st, hdr, sizeof(hdr)));
+}
+
+/* Write current block.  A failed write may leave part of a block in the
+   underlying stream, so it sets err, and the writer refuses all further
+   output.
+*/
+
+static int
+hp_stream_lz_block_out(struct hp_stream_lz *st)
+{
+  unsigned *p, pos = st->comp_pos;
+  int      k;
+
+  if (st->err)  return (-1);
+  if (st->len == 0)  return (0);
+  if (st->raw_pos + st->len > HP_LZ_POS_MAX)  goto err;
+
+  if (st->index_cnt == st->index_size) {
+    if ((p = realloc(st->index, 2 * (st->index_size + 8) * sizeof(*p))) == 0)  goto err;
+    st->index      = p;
+    st->index_size = 2 * (st->index_size + 8);
+  }
+
+  k = hp_lz_compress(st->raw, st->len, st->comp, hp_lz_bound(st->block_size));
+  if (k == 0 || k >= st->len) {
+    if (hp_stream_lz_hdr_out(st, st->len, st->len | HP_LZ_STORED) < 0
+	|| hp_stream_lz_out(st, st->raw, st->len) < 0
+	) {
+      goto err;
+    }
+  } else if (hp_stream_lz_hdr_out(st, st->len, k) < 0
+	     || hp_stream_lz_out(st, st->comp, k) < 0
+	     ) {
+    goto err;
+  }
+
+  st->index[st->index_cnt++] = pos;
+  st->raw_pos += st->len;
+  st->len     = 0;
+
+  return (0);
+
+ err:
+  st->err = 1;
+
+  return (-1);
+}
+
+/* Next block; end of blocks sets eof */
+
+static int
+hp_stream_lz_block_in(struct hp_stream_lz *st)
+{
+  char     hdr[HP_LZ_HDR_SIZE];
+  unsigned raw_len, stored_len;
+
+  st->raw_pos += st->len;
+  st->len = st->ofs = 0;
+
+  if (st->eof || st->err)  return (-1);
+
+  if (hp_stream_lz_in(st, hdr, sizeof(hdr)) < 0)  goto err;
+  raw_len    = get32le(hdr);
+  stored_len = get32le(hdr + 4);
+
+  if (raw_len == 0) {
+    st->eof = 1;
+
+    return (-1);
+  }
+  if (raw_len > st->block_size)  goto err;
+
+  if (stored_len & HP_LZ_STORED) {
+    if ((stored_len & ~HP_LZ_STORED) != raw_len || hp_stream_lz_in(st, st->raw, raw_len) < 0)  goto err;
+  } else if (stored_len > hp_lz_bound(st->block_size)
+	     || hp_stream_lz_in(st, st->comp, stored_len) < 0
+	     || hp_lz_decompress(st->comp, stored_len, st->raw, raw_len) != raw_len
+	     ) {
+    goto err;
+  }
+
+  st->len = raw_len;
+
+  return (0);
+
+ err:
+  st->err = 1;
+
+  return (-1);
+}
+
+static int
+hp_stream_lz_getc(struct hp_stream *st)
+{
+  struct hp_stream_lz *stz = (struct hp_stream_lz *) st;
+
+  if (stz->writing)  return (-1);
+  if (stz->ofs >= stz->len && hp_stream_lz_block_in(stz) < 0)  return (-1);
+
+  return ((unsigned char) stz->raw[stz->ofs++]);
+}
+
+static int
+hp_stream_lz_ungetc(struct hp_stream *st, char c)
+{
+  struct hp_stream_lz *stz = (struct hp_stream_lz *) st;
+
+  if (stz->writing || stz->ofs == 0)  return (-1);
+
+  --stz->ofs;
+
+  return ((unsigned char) c);
+}
+
+static int
+hp_stream_lz_read(struct hp_stream *st, char *buf, unsigned n)
+{
+  struct hp_stream_lz *stz = (struct hp_stream_lz *) st;
+  unsigned            k, result = 0;
+
+  if (stz->writing)  return (-1);
+
+  for ( ; n; buf += k, n -= k, result += k) {
+    if (stz->ofs >= stz->len && hp_stream_lz_block_in(stz) < 0) {
+      if (stz->err && result == 0)  return (-1);
+      break;
+    }
+
+    k = stz->len - stz->ofs;
+    if (k > n)  k = n;
+    memcpy(buf, stz->raw + stz->ofs, k);
+    stz->ofs += k;
+  }
+
+  return (result);
+}
+
+static int
+hp_stream_lz_write(struct hp_stream *st, const char *buf, unsigned n)
+{
+  struct hp_stream_lz *stz = (struct hp_stream_lz *) st;
+  unsigned            k, result = n;
+
+  if (!stz->writing || stz->err)  return (-1);
+
+  for ( ; n; buf += k, n -= k) {
+    k = stz->block_size - stz->len;
+    if (k > n)  k = n;
+    memcpy(stz->raw + stz->len, buf, k);
+    stz->len += k;
+
+    if (stz->len == stz->block_size && hp_stream_lz_block_out(stz) < 0)  return (-1);
+  }
+
+  return (result);
+}
+
+static int
+hp_stream_lz_putc(struct hp_stream *st, char c)
+{
+  struct hp_stream_lz *stz = (struct hp_stream_lz *) st;
+
+  if (!stz->writing || stz->err)  return (-1);
+
+  stz->raw[stz->len++] = c;
+  if (stz->len == stz->block_size && hp_stream_lz_block_out(stz) < 0)  return (-1);
+
+  return ((unsigned char) c);
+}
+
+/* Window is free block space for a writer, or rest of block for a reader */
+
+static int
+hp_stream_lz_get_window(struct hp_stream *st, char **p)
+{
+  struct hp_stream_lz *stz = (struct hp_stream_lz *) st;
+
+  if (stz->writing) {
+    if (stz->err)  return (-1);
+    *p = stz->raw + stz->len;
+
+    return (stz->block_size - stz->len);
+  }
+
+  if (stz->ofs >= stz->len && hp_stream_lz_block_in(stz) < 0)  return (stz->err ? -1 : 0);
+  *p = stz->raw + stz->ofs;
+
+  return (stz->len - stz->ofs);
+}
+
+static int
+hp_stream_lz_commit(struct hp_stream *st, unsigned n)
+{
+  struct hp_stream_lz *stz = (struct hp_stream_lz *) st;
+
+  if (stz->writing) {
+    if (stz->err || n > stz->block_size - stz->len)  return (-1);
+    stz->len += n;
+    if (stz->len == stz->block_size && hp_stream_lz_block_out(stz) < 0)  return (-1);
+  } else {
+    if (n > stz->len - stz->ofs)  return (-1);
+    stz->ofs += n;
+  }
+
+  return (n);
+}
+
+static int
+hp_stream_lz_tell(struct hp_stream *st)
+{
+  struct hp_stream_lz *stz = (struct hp_stream_lz *) st;
+
+  return (stz->raw_pos + (stz->writing ? stz->len : stz->ofs));
+}
+
+static int
+hp_stream_lz_index_in(struct hp_stream_lz *st)
+{
+  char     buf[HP_LZ_FOOTER_SIZE];
+  unsigned i;
+
+  if (hp_stream_seek(st->iost, -HP_LZ_FOOTER_SIZE, SEEK_END) < 0
+      || hp_stream_lz_in(st, buf, sizeof(buf)) < 0
+      || memcmp(buf + 8, hp_lz_footer, 4) != 0
+      || hp_stream_seek(st->iost, st->base_ofs + get32le(buf), SEEK_SET) < 0
+      ) {
+    return (-1);
+  }
+  st->raw_total = get32le(buf + 4);
+
+  if (hp_stream_lz_in(st, buf, 4) < 0)  return (-1);
+  st->index_cnt = get32le(buf);
+  if (st->index_cnt != (st->raw_total + st->block_size - 1) / st->block_size
+      || (st->index = malloc((st->index_cnt + 1) * sizeof(st->index[0]))) == 0
+      ) {
+    return (-1);
+  }
+  st->index_size = st->index_cnt;
+
+  for (i = 0; i < st->index_cnt; ++i) {
+    if (hp_stream_lz_in(st, buf, 4) < 0)  return (-1);
+    st->index[i] = get32le(buf);
+  }
+
+  return (0);
+}
+
+static int
+hp_stream_lz_seek(struct hp_stream *st, int ofs, int whence)
+{
+  struct hp_stream_lz *stz = (struct hp_stream_lz *) st;
+  long long           target;
+  unsigned            blk;
+  int                 pos, k;
+
+  if (stz->writing)  return (-1);
+
+  if (stz->index == 0) {
+    /* Load index, then put underlying stream back, so that a failed seek
+       leaves reading where it was
+    */
+
+    if ((pos = hp_stream_tell(stz->iost)) < 0)  return (-1);
+    k = hp_stream_lz_index_in(stz);
+    if (hp_stream_seek(stz->iost, pos, SEEK_SET) < 0) {
+      stz->err = 1;
+      k = -1;
+    }
+    if (k < 0) {
+      free(stz->index);
+      stz->index = 0;
+
+      return (-1);
+    }
+  }
+
+  switch (whence) {
+  case SEEK_SET:
+    target = ofs;
+    break;
+  case SEEK_CUR:
+    target = stz->raw_pos + stz->ofs + ofs;
+    break;
+  case SEEK_END:
+    target = (long long) stz->raw_total + ofs;
+    break;
+  default:
+    return (-1);
+  }
+
+  if (target < 0 || target > stz->raw_total)  return (-1);
+
+  /* Within current block, no I/O */
+
+  if (stz->len != 0 && target >= stz->raw_pos && target < stz->raw_pos + stz->len) {
+    stz->ofs = target - stz->raw_pos;
+
+    return (0);
+  }
+
+  stz->err = stz->eof = 0;
+  if (target == stz->raw_total) {
+    /* At end */
+
+    stz->raw_pos = target;
+    stz->len = stz->ofs = 0;
+    stz->eof = 1;
+
+    return (0);
+  }
+
+  blk = target / stz->block_size;
+  if (hp_stream_seek(stz->iost, stz->base_ofs + stz->index[blk], SEEK_SET) < 0)  return (-1);
+  stz->raw_pos = (long long) blk * stz->block_size;
+  stz->len     = 0;
+  if (hp_stream_lz_block_in(stz) < 0)  return (-1);
+  stz->ofs = target - stz->raw_pos;
+
+  return (0);
+}
+
+static int
+hp_stream_lz_eof(struct hp_stream *st)
+{
+  struct hp_stream_lz *stz = (struct hp_stream_lz *) st;
+
+  return (!stz->writing && stz->ofs >= stz->len && stz->eof);
+}
+
+static struct hp_stream_lz *
+hp_stream_lz_init(struct hp_stream_lz *st, struct hp_stream *iost, unsigned block_size, unsigned writing)
+{
+  memset(st, 0, sizeof(*st));
+
+  hp_stream_init(st->base,
+		 hp_stream_lz_getc,
+		 hp_stream_lz_ungetc,
+		 hp_stream_lz_putc,
+		 hp_stream_lz_tell,
+		 hp_stream_lz_seek,
+		 hp_stream_lz_eof
+		 );
+  hp_stream_bulk_init(st->base,
+		      hp_stream_lz_read,
+		      hp_stream_lz_write,
+		      hp_stream_lz_get_window,
+		      hp_stream_lz_commit
+		      );
+
+  st->iost       = iost;
+  st->block_size = block_size;
+  st->writing    = writing;
+  st->base_ofs   = hp_stream_tell(iost);
+  if (st->base_ofs < 0)  st->base_ofs = 0; /* Not seekable */
+
+  if ((st->raw = malloc(block_size)) == 0
+      || (st->comp = malloc(hp_lz_bound(block_size))) == 0
+      ) {
+    free(st->raw);
+
+    return (0);
+  }
+
+  return (st);
+}
+
+struct hp_stream_lz *
+hp_stream_lz_writer_init(struct hp_stream_lz *st, struct hp_stream *iost, unsigned block_size)
+{
+  char hdr[HP_LZ_HDR_SIZE];
+
+  if (block_size == 0)  block_size = HP_LZ_BLOCK_SIZE_DFLT;
+  if (block_size > HP_LZ_BLOCK_SIZE_MAX)  return (0);
+
+  if (hp_stream_lz_init(st, iost, block_size, 1) == 0)  return (0);
+
+  memcpy(hdr, hp_lz_magic, 4);
+  put32(hdr + 4, block_size);
+  if (hp_stream_lz_out(st, hdr, sizeof(hdr)) < 0) {
+    hp_stream_lz_fini(st);
+
+    return (0);
+  }
+
+  return (st);
+}
+
+struct hp_stream_lz *
+hp_stream_lz_reader_init(struct hp_stream_lz *st, struct hp_stream *iost)
+{
+  struct hp_stream_lz tmp[1];
+  char                hdr[HP_LZ_HDR_SIZE];
+  unsigned            block_size;
+
+  tmp->iost = iost;
+  if (hp_stream_lz_in(tmp, hdr, sizeof(hdr)) < 0
+      || memcmp(hdr, hp_lz_magic, 4) != 0
+      || (block_size = get32le(hdr + 4)) == 0
+      || block_size > HP_LZ_BLOCK_SIZE_MAX
+      ) {
+    return (0);
+  }
+
+  if (hp_stream_lz_init(st, iost, block_size, 0) == 0)  return (0);
+  st->base_ofs -= HP_LZ_HDR_SIZE;
+  if (st->base_ofs < 0)  st->base_ofs = 0;
+
+  return (st);
+}
+
+/** ************************************************************************
+
+\brief Finish compressed stream
+
+For a writer, the last block is written, then the index and footer;
+nothing is written to the underlying stream after this.  Buffers are freed,
+for reader or writer.
+
+\param[in] st Compressed stream
+
+\returns 0 on success, -1 on write error
+
+*/
+
+int
+hp_stream_lz_fini(struct hp_stream_lz *st)
+{
+  char     buf[HP_LZ_FOOTER_SIZE];
+  unsigned i, index_ofs;
+  int      result = 0;
+
+  if (st->writing) {
+    if (hp_stream_lz_block_out(st) < 0 || hp_stream_lz_hdr_out(st, 0, 0) < 0) {
+      result = -1;
+      goto done;
+    }
+
+    index_ofs = st->comp_pos;
+    put32(buf, st->index_cnt);
+    if (hp_stream_lz_out(st, buf, 4) < 0) {
+      result = -1;
+      goto done;
+    }
+    for (i = 0; i < st->index_cnt; ++i) {
+      put32(buf, st->index[i]);
+      if (hp_stream_lz_out(st, buf, 4) < 0) {
+	result = -1;
+	goto done;
+      }
+    }
+
+    put32(buf, index_ofs);
+    put32(buf + 4, st->raw_pos);
+    memcpy(buf + 8, hp_lz_footer, 4);
+    if (hp_stream_lz_out(st, buf, sizeof(buf)) < 0)  result = -1;
+  }
+
+ done:
+  free(st->raw);
+  free(st->comp);
+  free(st->index);
+  st->raw = st->comp = 0;
+  st->index = 0;
+  st->index_cnt = st->index_size = 0;
+
+  return (result);
+}
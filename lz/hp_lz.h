@@ -0,0 +1,65 @@
+#ifndef __HP_LZ_H
+#define __HP_LZ_H
+
+/** ************************************************************************
+
+\file hp_lz.h
+
+Block compression, and compressed streams
+
+The codec is LZ77 with byte-aligned sequences, in the LZ4 block format:
+fast in both directions, at a modest ratio, and needing no library.
+
+A compressed stream wraps any hp_stream.  Data is cut into fixed-size
+blocks, each compressed on its own, so that a reader can start at any
+block.  The layout is
+
+  "HPLZ" block-size
+  { raw-len stored-len data } ...      one per block
+  0 0                                  end of blocks
+  block-cnt { offset } ...             index: offset of each block
+  index-offset raw-len "HPLX"          footer
+
+where all integers are 32-bit little-endian.  Offsets count from the start
+of the compressed stream.  Neither the compressed nor the uncompressed
+length may therefore exceed 4 GB; a writer fails once it would.  The top bit of stored-len is set if the block is
+stored uncompressed, which is done when compression does not help.
+
+Reading is sequential, and needs no index.  Seeking needs one, and a
+seekable underlying stream.  Writers cannot seek.
+
+***************************************************************************/
+
+#include "stream/hp_stream.h"
+
+unsigned hp_lz_bound(unsigned n);
+int hp_lz_compress(const char *src, unsigned n, char *dst, unsigned dst_size);
+int hp_lz_decompress(const char *src, unsigned n, char *dst, unsigned dst_size);
+
+enum {
+  HP_LZ_BLOCK_SIZE_DFLT = 1 << 16,
+  HP_LZ_BLOCK_SIZE_MAX  = 1 << 22
+};
+
+struct hp_stream_lz {
+  struct hp_stream base[1];
+  struct hp_stream *iost;	/* Underlying stream */
+  unsigned         block_size;
+  char             *raw;	/* Current block, uncompressed */
+  char             *comp;	/* Current block, compressed */
+  unsigned         len;		/* Bytes in raw */
+  unsigned         ofs;		/* Read position in raw */
+  long long        raw_pos;	/* Uncompressed offset of raw[0] */
+  unsigned         comp_pos;	/* Offset in compressed stream */
+  int              base_ofs;	/* Offset of compressed stream in underlying */
+  unsigned         *index;	/* Block offsets */
+  unsigned         index_cnt, index_size;
+  unsigned         raw_total;	/* Uncompressed length, from footer */
+  unsigned char    writing, eof, err;
+};
+
+struct hp_stream_lz *hp_stream_lz_writer_init(struct hp_stream_lz *st, struct hp_stream *iost, unsigned block_size);
+struct hp_stream_lz *hp_stream_lz_reader_init(struct hp_stream_lz *st, struct hp_stream *iost);
+int hp_stream_lz_fini(struct hp_stream_lz *st);
+
+#endif /* __HP_LZ_H */
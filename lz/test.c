@@ -0,0 +1,229 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <unistd.h>
+
+#include "hp_lz.h"
+
+enum { DATA_SIZE = 300000 };
+
+static char data[DATA_SIZE], back[DATA_SIZE];
+
+/* Text-like data: words from a small vocabulary */
+
+static void
+data_fill(void)
+{
+  static const char * const words[] = { "alpha ", "beta ", "gamma ", "delta ", "epsilon\n", "zeta, " };
+  unsigned i, k;
+
+  srand(1);
+  for (i = 0; i < DATA_SIZE; i += k) {
+    const char *w = words[rand() % 6];
+
+    k = strlen(w);
+    if (k > DATA_SIZE - i)  k = DATA_SIZE - i;
+    memcpy(data + i, w, k);
+  }
+}
+
+static void
+codec_test(void)
+{
+  static char comp[DATA_SIZE + DATA_SIZE / 255 + 16], rnd[10000];
+  unsigned    i, n;
+  int         k;
+
+  /* Compressible, random, tiny and empty */
+
+  assert((k = hp_lz_compress(data, DATA_SIZE, comp, sizeof(comp))) > 0 && k < DATA_SIZE / 2);
+  assert(hp_lz_decompress(comp, k, back, sizeof(back)) == DATA_SIZE);
+  assert(memcmp(back, data, DATA_SIZE) == 0);
+  assert(hp_lz_decompress(comp, k, back, DATA_SIZE - 1) == -1);
+
+  for (i = 0; i < sizeof(rnd); ++i)  rnd[i] = rand();
+  assert((k = hp_lz_compress(rnd, sizeof(rnd), comp, hp_lz_bound(sizeof(rnd)))) > 0);
+  assert(hp_lz_decompress(comp, k, back, sizeof(back)) == sizeof(rnd));
+  assert(memcmp(back, rnd, sizeof(rnd)) == 0);
+  assert(hp_lz_compress(rnd, sizeof(rnd), comp, sizeof(rnd) / 2) == 0);
+
+  for (n = 0; n < 40; ++n) {
+    memset(rnd, 'x', n);
+    assert((k = hp_lz_compress(rnd, n, comp, hp_lz_bound(n))) > 0);
+    assert(hp_lz_decompress(comp, k, back, n) == n && memcmp(back, rnd, n) == 0);
+  }
+
+  /* Malformed input fails, without overrunning */
+
+  for (i = 0; i < 10000; ++i) {
+    n = 1 + rand() % 64;
+    for (k = 0; k < n; ++k)  rnd[k] = rand();
+    hp_lz_decompress(rnd, n, back, 1 + rand() % 256);
+  }
+  assert(hp_lz_decompress("\x1f" "a\x00\x00", 4, back, 100) == -1); /* Offset 0 */
+  assert(hp_lz_decompress("\x1f" "a\x05\x00", 4, back, 100) == -1); /* Before start */
+  assert(hp_lz_decompress("\xf0", 1, back, 100) == -1);		/* Truncated length */
+}
+
+/* Write through compressed stream, then read back sequentially and by seeking */
+
+static void
+stream_test(struct hp_stream *iost, unsigned block_size)
+{
+  struct hp_stream_lz stz[1];
+  char                *p;
+  unsigned            i, ofs;
+  int                 n;
+
+  assert(hp_stream_lz_writer_init(stz, iost, block_size) == stz);
+  assert(hp_stream_putc(stz->base, data[0]) == (unsigned char) data[0]);
+  assert(hp_stream_write(stz->base, data + 1, 9999) == 9999);
+  assert((n = hp_stream_get_window(stz->base, &p)) > 0);
+  memcpy(p, data + 10000, 1);
+  assert(hp_stream_commit(stz->base, 1) == 1);
+  assert(hp_stream_write(stz->base, data + 10001, DATA_SIZE - 10001) == DATA_SIZE - 10001);
+  assert(hp_stream_tell(stz->base) == DATA_SIZE);
+  assert(hp_stream_seek(stz->base, 0, SEEK_SET) == -1);
+  assert(hp_stream_getc(stz->base) == -1);
+  assert(hp_stream_lz_fini(stz) == 0);
+  assert(hp_stream_tell(iost) < DATA_SIZE / 2);
+
+  assert(hp_stream_seek(iost, 0, SEEK_SET) == 0);
+  assert(hp_stream_lz_reader_init(stz, iost) == stz);
+  assert(stz->block_size == (block_size ? block_size : HP_LZ_BLOCK_SIZE_DFLT));
+
+  assert(hp_stream_getc(stz->base) == (unsigned char) data[0]);
+
+  /* First seek loads the index; out of range, it leaves reading as it was */
+
+  assert(hp_stream_seek(stz->base, DATA_SIZE + 1, SEEK_SET) == -1);
+  assert(hp_stream_ungetc(stz->base, data[0]) == (unsigned char) data[0]);
+  assert(hp_stream_read(stz->base, back, 5000) == 5000);
+  assert((n = hp_stream_get_window(stz->base, &p)) > 0 && *p == data[5000]);
+  assert(hp_stream_commit(stz->base, 1) == 1);
+  assert(hp_stream_read(stz->base, back + 5001, DATA_SIZE) == DATA_SIZE - 5001);
+  memcpy(back + 5000, data + 5000, 1);
+  assert(memcmp(back, data, DATA_SIZE) == 0);
+  assert(hp_stream_eof(stz->base));
+  assert(hp_stream_getc(stz->base) == -1);
+  assert(hp_stream_putc(stz->base, 'x') == -1);
+
+  /* Random access, through index */
+
+  srand(2);
+  for (i = 0; i < 200; ++i) {
+    ofs = rand() % DATA_SIZE;
+    assert(hp_stream_seek(stz->base, ofs, SEEK_SET) == 0);
+    assert(hp_stream_tell(stz->base) == ofs);
+    n = DATA_SIZE - ofs < 300 ? DATA_SIZE - ofs : 300;
+    assert(hp_stream_read(stz->base, back, n) == n);
+    assert(memcmp(back, data + ofs, n) == 0);
+  }
+  assert(hp_stream_seek(stz->base, -10, SEEK_CUR) == 0);
+  assert(hp_stream_getc(stz->base) == (unsigned char) data[ofs + n - 10]);
+  assert(hp_stream_seek(stz->base, -1, SEEK_END) == 0);
+  assert(hp_stream_getc(stz->base) == (unsigned char) data[DATA_SIZE - 1]);
+  assert(hp_stream_getc(stz->base) == -1);
+  assert(hp_stream_seek(stz->base, 0, SEEK_END) == 0 && hp_stream_eof(stz->base));
+  assert(hp_stream_seek(stz->base, 1, SEEK_END) == -1);
+  assert(hp_stream_seek(stz->base, 0, SEEK_SET) == 0);
+  assert(hp_stream_getc(stz->base) == (unsigned char) data[0]);
+
+  hp_stream_lz_fini(stz);
+}
+
+int
+main(void)
+{
+  struct hp_stream_mem  stm[1];
+  struct hp_stream_fd   stf[1];
+  struct hp_stream_file stp[1];
+  struct hp_stream_buf  stb[1];
+  struct hp_stream_lz   stz[1];
+  char                  tmpname[] = "/tmp/hp_lz_testXXXXXX", buf[4096];
+  FILE                  *fp;
+  unsigned              i;
+  int                   fd;
+
+  data_fill();
+  codec_test();
+
+  /* Over memory, default and small blocks */
+
+  hp_stream_mem_init(stm, 0);
+  stream_test(stm->base, 0);
+  hp_stream_mem_fini(stm);
+
+  hp_stream_mem_init(stm, 0);
+  stream_test(stm->base, 1000);
+  hp_stream_mem_fini(stm);
+
+  /* Over a file, after a prefix */
+
+  assert((fd = mkstemp(tmpname)) >= 0);
+  unlink(tmpname);
+  assert(hp_stream_fd_init(stf, fd, buf, sizeof(buf)) == stf);
+  assert(hp_stream_puts(stf->base, "prefix") == 6);
+  assert(hp_stream_lz_writer_init(stz, stf->base, 4096) == stz);
+  assert(hp_stream_write(stz->base, data, DATA_SIZE) == DATA_SIZE);
+  assert(hp_stream_lz_fini(stz) == 0);
+  assert(hp_stream_fd_flush(stf) == 0);
+
+  assert(hp_stream_seek(stf->base, 6, SEEK_SET) == 0);
+  assert(hp_stream_lz_reader_init(stz, stf->base) == stz);
+  assert(hp_stream_seek(stz->base, 123456, SEEK_SET) == 0);
+  assert(hp_stream_read(stz->base, back, 100) == 100 && memcmp(back, data + 123456, 100) == 0);
+  hp_stream_lz_fini(stz);
+  close(fd);
+
+  /* Corrupt block is an error, not a crash */
+
+  assert((fp = tmpfile()) != 0);
+  hp_stream_file_init(stp, fp);
+  assert(hp_stream_lz_writer_init(stz, stp->base, 1000) == stz);
+  assert(hp_stream_write(stz->base, data, 5000) == 5000);
+  assert(hp_stream_lz_fini(stz) == 0);
+  fseek(fp, 12, SEEK_SET);		/* Stored length of first block */
+  fputs("\xff\xff\xff\xff", fp);
+  hp_stream_seek(stp->base, 0, SEEK_SET);
+  assert(hp_stream_lz_reader_init(stz, stp->base) == stz);
+  assert(hp_stream_read(stz->base, back, 5000) == -1);
+  hp_stream_lz_fini(stz);
+  fclose(fp);
+
+  /* Short sink: the failed block is not retried, nor is the index added to */
+
+  hp_stream_buf_init(stb, buf, 64);
+  assert(hp_stream_lz_writer_init(stz, stb->base, 256) == stz);
+  for (i = 0; i < 256 && hp_stream_putc(stz->base, data[i]) != -1; ++i);
+  assert(i == 255 && stz->index_cnt == 0);
+  for (i = 0; i < 1000; ++i)  assert(hp_stream_putc(stz->base, 'x') == -1);
+  assert(hp_stream_write(stz->base, data, 10) == -1);
+  assert(hp_stream_lz_fini(stz) == -1);
+
+  /* Past 32-bit offsets, uncompressed or compressed */
+
+  hp_stream_mem_init(stm, 0);
+  assert(hp_stream_lz_writer_init(stz, stm->base, 256) == stz);
+  assert(hp_stream_write(stz->base, data, 512) == 512);
+  stz->raw_pos = 0xffffffffULL - 100;
+  assert(hp_stream_write(stz->base, data, 256) == -1);
+  assert(hp_stream_lz_fini(stz) == -1);
+  assert(hp_stream_lz_writer_init(stz, stm->base, 256) == stz);
+  stz->comp_pos = 0xffffffffU - 100;
+  assert(hp_stream_write(stz->base, data, 256) == -1);
+  assert(stz->index_cnt == 0);
+  assert(hp_stream_lz_fini(stz) == -1);
+  hp_stream_mem_fini(stm);
+
+  /* Not a compressed stream */
+
+  hp_stream_mem_init(stm, 0);
+  hp_stream_puts(stm->base, "HPLY0000");
+  hp_stream_seek(stm->base, 0, SEEK_SET);
+  assert(hp_stream_lz_reader_init(stz, stm->base) == 0);
+  hp_stream_mem_fini(stm);
+
+  return (0);
+}
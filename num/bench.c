@@ -0,0 +1,190 @@
+/** ************************************************************************
+
+\file bench.c
+
+Throughput of hp_num_parse(), against libc
+
+Usage: bench [repeat-count]
+
+Each input set is parsed repeat-count times (default 5) by each parser; the
+fastest run is reported.  Inputs are generated from a fixed seed, so runs
+are comparable.  Output is JSON, one entry per input set and parser.
+
+***************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <assert.h>
+
+#include "hp_num.h"
+
+enum {
+  NUM_CNT  = 1000000,		/* Numbers per input set */
+  NUM_SIZE = 32			/* Max characters per number */
+};
+
+static unsigned long rand_state;
+
+static unsigned
+rand_next(void)
+{
+  rand_state = rand_state * 1103515245 + 12345;
+
+  return ((rand_state >> 16) & 0x7fffffff);
+}
+
+static char *
+rand_digits(char *p, unsigned n)
+{
+  *p++ = '1' + rand_next() % 9;
+  for ( ; n > 1; --n)  *p++ = '0' + rand_next() % 10;
+
+  return (p);
+}
+
+/* Input sets */
+
+static unsigned
+int_gen(char *p)
+{
+  return (rand_digits(p, 1 + rand_next() % 12) - p);
+}
+
+static unsigned
+float_short_gen(char *p)
+{
+  char *q = p;
+
+  q = rand_digits(q, 1 + rand_next() % 4);
+  *q++ = '.';
+  q = rand_digits(q, 1 + rand_next() % 4);
+
+  return (q - p);
+}
+
+static unsigned
+float_long_gen(char *p)
+{
+  char *q = p;
+
+  q = rand_digits(q, 1 + rand_next() % 8);
+  *q++ = '.';
+  q = rand_digits(q, 1 + rand_next() % 10);
+  q += sprintf(q, "e-%u", rand_next() % 20);
+
+  return (q - p);
+}
+
+/* Parsers; each returns a checksum, so that work is not optimized away */
+
+static double
+hp_num_run(unsigned n, char (*s)[NUM_SIZE], unsigned *len)
+{
+  struct hp_num num[1];
+  double        result = 0;
+
+  for ( ; n; --n, ++s, ++len) {
+    if (hp_num_parse(num, *len, *s) < 0)  abort();
+    result += num->type == HP_NUM_TYPE_INT ? num->u.intval : num->u.floatval;
+  }
+
+  return (result);
+}
+
+static double
+libc_run(unsigned n, char (*s)[NUM_SIZE], unsigned *len)
+{
+  double result = 0;
+  char   *q;
+
+  for ( ; n; --n, ++s, ++len) {
+    result += strtoll(*s, &q, 10);
+    if (q != *s + *len)  result += strtod(*s, 0);
+  }
+
+  return (result);
+}
+
+struct input {
+  char     *name;
+  unsigned (*gen)(char *p);
+} input_tbl[] = {
+  { "int",         int_gen },
+  { "float-short", float_short_gen },
+  { "float-long",  float_long_gen }
+};
+
+/* Where checksums go; volatile, so that the runs are kept */
+
+static volatile double sink;
+
+struct parser {
+  char   *name;
+  double (*run)(unsigned n, char (*s)[NUM_SIZE], unsigned *len);
+} parser_tbl[] = {
+  { "hp_num", hp_num_run },
+  { "libc",   libc_run }
+};
+
+static double
+now_ns(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return (ts.tv_sec * 1e9 + ts.tv_nsec);
+}
+
+int
+main(int argc, char **argv)
+{
+  unsigned           repeat = argc > 1 ? atoi(argv[1]) : 5, i, j, k, sepf = 0;
+  char               (*s)[NUM_SIZE];
+  unsigned           *len;
+  unsigned long long bytes;
+  double             t, best;
+
+  if (repeat == 0)  repeat = 1;
+
+  s   = malloc(NUM_CNT * sizeof(*s));
+  len = malloc(NUM_CNT * sizeof(*len));
+  assert(s != 0 && len != 0);
+
+  printf("[");
+
+  for (i = 0; i < sizeof(input_tbl) / sizeof(input_tbl[0]); ++i) {
+    rand_state = 12345;
+    for (bytes = k = 0; k < NUM_CNT; ++k) {
+      bytes += len[k] = (*input_tbl[i].gen)(s[k]);
+      s[k][len[k]] = 0;
+    }
+
+    for (j = 0; j < sizeof(parser_tbl) / sizeof(parser_tbl[0]); ++j) {
+      for (best = 0, k = repeat; k; --k) {
+	t = now_ns();
+	sink = (*parser_tbl[j].run)(NUM_CNT, s, len);
+	t = now_ns() - t;
+	if (best == 0 || t < best)  best = t;
+      }
+
+      printf("%s{\"input\": \"%s\", \"parser\": \"%s\", \"ns-per-num\": %g, \"mb-per-sec\": %g}",
+	     sepf ? ", " : "",
+	     input_tbl[i].name,
+	     parser_tbl[j].name,
+	     best / NUM_CNT,
+	     bytes / best * 1e3
+	     );
+      sepf = 1;
+    }
+  }
+
+  printf("]\n");
+
+  free(s);
+  free(len);
+
+  return (0);
+}
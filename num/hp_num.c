@@ -0,0 +1,234 @@
+#include <stdlib.h>
+#include <string.h>
+#include <float.h>
+
+#include "hp_num.h"
+
+/* Conversion to double is exact, with a single rounding, if the mantissa
+   fits in 53 bits and the power of 10 is at most 22 (Clinger).  Otherwise,
+   fall back to strtod().
+*/
+
+enum {
+  HP_NUM_MANT_BITS = 53,	/* Bits of mantissa in a double */
+  HP_NUM_POW10_MAX = 22		/* Largest power of 10 exact in a double */
+};
+
+static const double pow10_tbl[] = {
+  1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,
+  1e8,  1e9,  1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+  1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+static inline unsigned
+is_digit(char c)
+{
+  return ((unsigned char)(c - '0') < 10);
+}
+
+static inline unsigned
+is_hex_digit(char c)
+{
+  return (is_digit(c) || (unsigned char)((c | 0x20) - 'a') < 6);
+}
+
+/* Eight digits at a time (SWAR), for little-endian hosts only */
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+
+#define HP_NUM_SWAR
+
+static inline unsigned long long
+load8(const char *p)
+{
+  unsigned long long result;
+
+  memcpy(&result, p, sizeof(result));
+
+  return (result);
+}
+
+static inline unsigned
+is_8_digits(unsigned long long v)
+{
+  return ((((v + 0x4646464646464646ULL) | (v - 0x3030303030303030ULL)) & 0x8080808080808080ULL) == 0);
+}
+
+/* Digits pairwise, then in fours, then both fours in one multiply */
+
+static inline unsigned
+digits_8_val(unsigned long long v)
+{
+  const unsigned long long mask = 0x000000ff000000ffULL;
+  const unsigned long long mul1 = 100 + (1000000ULL << 32);
+  const unsigned long long mul2 = 1 + (10000ULL << 32);
+
+  v -= 0x3030303030303030ULL;
+  v = v * 10 + (v >> 8);
+
+  return ((unsigned)((((v & mask) * mul1) + (((v >> 16) & mask) * mul2)) >> 32));
+}
+
+#endif
+
+/* Accumulate decimal digits into *m, while it cannot overflow; any further
+   digits are skipped, and counted in *ovf.
+*/
+
+static const char *
+digits_scan(const char *q, const char *e, unsigned long long *m, unsigned *ovf)
+{
+  unsigned long long val = *m;
+  unsigned           d;
+
+#ifdef HP_NUM_SWAR
+  while (e - q >= 8 && val < 100000000000ULL && is_8_digits(load8(q))) {
+    val = val * 100000000 + digits_8_val(load8(q));
+    q += 8;
+  }
+#endif
+
+  for ( ; q < e && is_digit(*q); ++q) {
+    d = *q - '0';
+    if (val > (~0ULL - d) / 10) {
+      ++*ovf;
+      continue;
+    }
+    val = val * 10 + d;
+  }
+
+  *m = val;
+
+  return (q);
+}
+
+static int
+hex_parse(struct hp_num *num, unsigned n, const char *p)
+{
+  unsigned long long val = 0;
+  char               c;
+
+  if (n == 0)  return (-1);
+
+  for ( ; n; --n, ++p) {
+    if (!is_hex_digit(c = *p) || (val >> 60) != 0)  return (-1);
+    val = (val << 4) | (is_digit(c) ? c - '0' : (c | 0x20) - 'a' + 10);
+  }
+
+  num->type     = HP_NUM_TYPE_INT;
+  num->u.intval = (long long) val;
+
+  return (0);
+}
+
+/* Octal, only once it is known that all digits are 0-7 */
+
+static int
+oct_parse(struct hp_num *num, unsigned n, const char *p)
+{
+  unsigned long long val = 0;
+
+  for ( ; n; --n, ++p) {
+    if ((val >> 61) != 0)  return (-1);
+    val = (val << 3) | (*p - '0');
+  }
+
+  num->type     = HP_NUM_TYPE_INT;
+  num->u.intval = (long long) val;
+
+  return (0);
+}
+
+static int
+float_slow(struct hp_num *num, unsigned n, const char *p)
+{
+  char buf[n + 1];
+
+  memcpy(buf, p, n);
+  buf[n] = 0;
+
+  num->type       = HP_NUM_TYPE_FLOAT;
+  num->u.floatval = strtod(buf, 0);
+
+  return (0);
+}
+
+int
+hp_num_parse(struct hp_num *num, unsigned n, const char *p)
+{
+  const char         *q = p, *e = p + n, *d;
+  unsigned long long m = 0;
+  unsigned           negf = 0, ovf = 0, floatf = 0, k;
+  int                exp10 = 0, x;
+  double             f;
+
+  if (n >= 2 && p[0] == '0' && (p[1] | 0x20) == 'x')  return (hex_parse(num, n - 2, p + 2));
+
+  if (q < e && (*q == '-' || *q == '+')) {
+    negf = *q == '-';
+    ++q;
+  }
+
+  d = q;
+  q = digits_scan(q, e, &m, &ovf);
+  if (q == d)  return (-1);
+  exp10 = ovf;
+
+  if (q < e && *q == '.') {
+    floatf = 1;
+    d = ++q;
+    k = ovf;
+    q = digits_scan(q, e, &m, &ovf);
+    if (q == d)  return (-1);
+    exp10 -= (q - d) - (ovf - k);
+  }
+
+  if (q < e && (*q | 0x20) == 'e') {
+    floatf = 1;
+    if (++q < e && (*q == '-' || *q == '+'))  ++q;
+    for (d = q, x = 0; q < e && is_digit(*q); ++q) {
+      if (x < 100000)  x = x * 10 + (*q - '0');
+    }
+    if (q == d)  return (-1);
+    exp10 += d[-1] == '-' ? -x : x;
+  }
+
+  if (q != e)  return (-1);
+
+  if (!floatf) {
+    if (!negf && n >= 2 && p[0] == '0') {
+      for (q = p; q < e && *q <= '7'; ++q);
+      if (q == e)  return (oct_parse(num, n - 1, p + 1));
+    } else if (ovf == 0 && m <= (negf ? 1ULL << 63 : (1ULL << 63) - 1)) {
+      num->type     = HP_NUM_TYPE_INT;
+      num->u.intval = negf ? (long long)(0 - m) : (long long) m;
+
+      return (0);
+    }
+  }
+
+  if (m == 0) {
+    f = 0;
+  } else {
+#if FLT_EVAL_METHOD == 0
+    if (ovf != 0 || (m >> HP_NUM_MANT_BITS) != 0)  return (float_slow(num, n, p));
+
+    /* Shift excess exponent into the mantissa, while it stays exact */
+
+    for ( ; exp10 > HP_NUM_POW10_MAX; --exp10) {
+      if ((m *= 10) >> HP_NUM_MANT_BITS != 0)  return (float_slow(num, n, p));
+    }
+    if (exp10 < -HP_NUM_POW10_MAX)  return (float_slow(num, n, p));
+
+    f = (double) m;
+    f = exp10 < 0 ? f / pow10_tbl[-exp10] : f * pow10_tbl[exp10];
+#else
+    return (float_slow(num, n, p));
+#endif
+  }
+
+  num->type       = HP_NUM_TYPE_FLOAT;
+  num->u.floatval = negf ? -f : f;
+
+  return (0);
+}
@@ -0,0 +1,52 @@
+#ifndef __HP_NUM_H
+#define __HP_NUM_H
+
+/** ************************************************************************
+
+\file hp_num.h
+
+Number scanning
+
+Classifies and converts a numeric token in a single pass.  Accepted forms
+are
+
+  [+|-]digits                         decimal integer
+  0digits                             octal integer, digits all 0-7
+  0xhexdigits                         hexadecimal integer
+  [+|-]digits[.digits][e[+|-]digits]  float
+
+A decimal integer that does not fit in a long long, or a leading-zero token
+with a digit 8 or 9, is returned as a float.
+
+***************************************************************************/
+
+enum hp_num_type {
+  HP_NUM_TYPE_INT,
+  HP_NUM_TYPE_FLOAT
+};
+
+struct hp_num {
+  enum hp_num_type type;
+  union {
+    long long intval;
+    double    floatval;
+  } u;
+};
+
+/** ************************************************************************
+
+\brief Scan a number
+
+Scan the n characters at p, which must form exactly one number.
+
+\param num Where to store result
+\param n Length of text
+\param p Text
+
+\return 0 if successful, else -1
+
+***************************************************************************/
+
+int hp_num_parse(struct hp_num *num, unsigned n, const char *p);
+
+#endif /* !defined(__HP_NUM_H) */
@@ -0,0 +1,107 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "hp_num.h"
+
+static void
+int_check(char *s, long long val)
+{
+  struct hp_num num[1];
+
+  assert(hp_num_parse(num, strlen(s), s) == 0);
+  assert(num->type == HP_NUM_TYPE_INT);
+  assert(num->u.intval == val);
+}
+
+static void
+float_check(char *s)
+{
+  struct hp_num num[1];
+
+  assert(hp_num_parse(num, strlen(s), s) == 0);
+  assert(num->type == HP_NUM_TYPE_FLOAT);
+  assert(memcmp(&num->u.floatval, &(double){ strtod(s, 0) }, sizeof(double)) == 0);
+}
+
+static void
+bad_check(char *s)
+{
+  struct hp_num num[1];
+
+  assert(hp_num_parse(num, strlen(s), s) < 0);
+}
+
+static unsigned long rand_state = 12345;
+
+static unsigned
+rand_next(void)
+{
+  rand_state = rand_state * 1103515245 + 12345;
+
+  return ((rand_state >> 16) & 0x7fffffff);
+}
+
+static char *
+rand_digits(char *p, unsigned n)
+{
+  for ( ; n; --n)  *p++ = '0' + rand_next() % 10;
+
+  return (p);
+}
+
+int
+main(void)
+{
+  static char *ints[] = {
+    "0", "7", "-0", "12345678", "-12345678", "123456789012345678",
+    "9223372036854775807", "-9223372036854775808", "000", "9007199254740993",
+    "+1", "+0"
+  };
+  static char *floats[] = {
+    "0.0", "-0.0", "1.5", "-1.5", "1e10", "1E-10", "1e+10", "0.1", "3.14159",
+    "1.7976931348623157e308", "2.2250738585072014e-308", "4.9e-324", "1e-400", "1e400",
+    "9007199254740993.0", "0.30000000000000004", "123456789.123456789",
+    "9223372036854775808", "-9223372036854775809", "18446744073709551616",
+    "0.000000000000000000000000000001", "1234567890123456789012345678901234567890",
+    "1e23", "1e37", "8.98846567431158e307", "09", "0e999", "12345678.12345678e-3",
+    "+1.5", "+1e400"
+  };
+  static char *bads[] = {
+    "", "-", ".5", "5.", "1e", "1e+", "-e5", "0x", "0xg", "-0x1", "1.2.3", "1e5.5", "+",
+    "1 ", " 1", "0x10000000000000000", "1a", "--1", "+-1", "-+1", "++1", "+0x1"
+  };
+  unsigned i, n;
+  char     buf[64], *p;
+
+  for (i = 0; i < sizeof(ints) / sizeof(ints[0]); ++i)  int_check(ints[i], strtoll(ints[i], 0, 10));
+  for (i = 0; i < sizeof(floats) / sizeof(floats[0]); ++i)  float_check(floats[i]);
+  for (i = 0; i < sizeof(bads) / sizeof(bads[0]); ++i)  bad_check(bads[i]);
+
+  int_check("0x1F", 31);
+  int_check("0Xffffffffffffffff", -1);
+  int_check("017", 15);
+
+  /* Random decimals, against strtod */
+
+  for (i = 0; i < 1000000; ++i) {
+    p = buf;
+    if (rand_next() & 1)  *p++ = '-';
+    p = rand_digits(p, 1 + rand_next() % 12);
+    *p++ = '.';
+    p = rand_digits(p, 1 + rand_next() % 12);
+    if ((n = rand_next() % 3) != 0) {
+      *p++ = 'e';
+      if (n == 1)  *p++ = '-';
+      p += sprintf(p, "%u", rand_next() % 40);
+    }
+    *p = 0;
+
+    float_check(buf);
+  }
+
+  printf("All tests passed\n");
+
+  return (0);
+}
@@ -0,0 +1,491 @@
+/** ************************************************************************
+
+\file bench.c
+
+Micro-benchmarks for OVM
+
+Built against an OVM compiled with OVM_STATS, so that allocation counts and
+pool high-water can be reported alongside time.  Output is JSON, one entry
+per benchmark, for use in build performance gates.
+
+Usage: bench [repeat-count]
+
+Each benchmark is run repeat-count times (default 5); the fastest run is
+reported.  Inputs are generated from a fixed seed, so runs are comparable.
+
+***************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <assert.h>
+
+#include "ovm_json.h"
+#undef ARRAY_SIZE
+
+#include "ovm.h"
+
+#define _ARRAY_SIZE(a)  (sizeof(a) / sizeof((a)[0]))
+
+enum {
+  POOL_SIZE  = 1 << 21,		/* Objects */
+  STACK_SIZE = 1 << 12		/* Object pointers */
+};
+
+struct ovm vm[1];
+
+static unsigned long rand_state;
+
+static void
+rand_seed(void)
+{
+  rand_state = 12345;
+}
+
+static unsigned
+rand_next(void)
+{
+  rand_state = rand_state * 1103515245 + 12345;
+
+  return ((rand_state >> 16) & 0x7fffffff);
+}
+
+static void
+reg_clr(struct ovm *vm)
+{
+  unsigned r;
+
+  for (r = R0; r <= R7; ++r)  ovm_new(vm, r, OBJ_TYPE_NIL);
+}
+
+static void
+key_str(struct ovm *vm, unsigned r1, unsigned i)
+{
+  char buf[32];
+
+  ovm_newc(vm, r1, OBJ_TYPE_STRING, snprintf(buf, sizeof(buf), "key-%u", i), buf);
+}
+
+/* Benchmarks
+
+   Each has an optional untimed setup, and a timed body performing n
+   operations.  R5..R7 carry state from setup to body.
+*/
+
+static void
+int_add_run(struct ovm *vm, unsigned n)
+{
+  ovm_newc(vm, R0, OBJ_TYPE_INTEGER, (obj_integer_val_t) 0);
+  ovm_newc(vm, R1, OBJ_TYPE_INTEGER, (obj_integer_val_t) 1);
+  for ( ; n; --n)  ovm_call(vm, R0, OBJ_OP_ADD, R1);
+}
+
+enum {
+  DICT_SIZE = 4096		/* Buckets */
+};
+
+static void
+dict_int_setup(struct ovm *vm, unsigned n)
+{
+  ovm_newc(vm, R5, OBJ_TYPE_DICT, DICT_SIZE);
+}
+
+static void
+dict_int_insert_run(struct ovm *vm, unsigned n)
+{
+  unsigned i;
+
+  for (i = 0; i < n; ++i) {
+    ovm_newc(vm, R0, OBJ_TYPE_INTEGER, (obj_integer_val_t) i);
+    ovm_call(vm, R5, OBJ_OP_AT_PUT, R0, R0);
+  }
+}
+
+static void
+dict_int_lookup_setup(struct ovm *vm, unsigned n)
+{
+  dict_int_setup(vm, n);
+  dict_int_insert_run(vm, n);
+}
+
+static void
+dict_int_lookup_run(struct ovm *vm, unsigned n)
+{
+  unsigned i;
+
+  for (i = 0; i < n; ++i) {
+    ovm_newc(vm, R0, OBJ_TYPE_INTEGER, (obj_integer_val_t) i);
+    ovm_move(vm, R1, R5);
+    ovm_call(vm, R1, OBJ_OP_AT, R0);
+  }
+}
+
+/* String keys are made in setup, so that only the dictionary is timed */
+
+static void
+dict_str_setup(struct ovm *vm, unsigned n)
+{
+  unsigned i;
+
+  ovm_newc(vm, R5, OBJ_TYPE_DICT, DICT_SIZE);
+  ovm_newc(vm, R6, OBJ_TYPE_ARRAY, n);
+  for (i = 0; i < n; ++i) {
+    key_str(vm, R0, i);
+    ovm_newc(vm, R1, OBJ_TYPE_INTEGER, (obj_integer_val_t) i);
+    ovm_call(vm, R6, OBJ_OP_AT_PUT, R1, R0);
+  }
+}
+
+static void
+dict_str_insert_run(struct ovm *vm, unsigned n)
+{
+  unsigned i;
+
+  for (i = 0; i < n; ++i) {
+    ovm_newc(vm, R1, OBJ_TYPE_INTEGER, (obj_integer_val_t) i);
+    ovm_move(vm, R0, R6);
+    ovm_call(vm, R0, OBJ_OP_AT, R1);
+    ovm_call(vm, R5, OBJ_OP_AT_PUT, R0, R1);
+  }
+}
+
+static void
+dict_str_lookup_setup(struct ovm *vm, unsigned n)
+{
+  dict_str_setup(vm, n);
+  dict_str_insert_run(vm, n);
+}
+
+static void
+dict_str_lookup_run(struct ovm *vm, unsigned n)
+{
+  unsigned i;
+
+  for (i = 0; i < n; ++i) {
+    ovm_newc(vm, R1, OBJ_TYPE_INTEGER, (obj_integer_val_t) i);
+    ovm_move(vm, R0, R6);
+    ovm_call(vm, R0, OBJ_OP_AT, R1);
+    ovm_move(vm, R1, R5);
+    ovm_call(vm, R1, OBJ_OP_AT, R0);
+  }
+}
+
+static void
+array_sort_setup(struct ovm *vm, unsigned n)
+{
+  unsigned i;
+
+  rand_seed();
+
+  ovm_newc(vm, R5, OBJ_TYPE_ARRAY, n);
+  for (i = 0; i < n; ++i) {
+    ovm_newc(vm, R0, OBJ_TYPE_INTEGER, (obj_integer_val_t) i);
+    ovm_newc(vm, R1, OBJ_TYPE_INTEGER, (obj_integer_val_t) rand_next());
+    ovm_call(vm, R5, OBJ_OP_AT_PUT, R0, R1);
+  }
+}
+
+static void
+array_sort_run(struct ovm *vm, unsigned n)
+{
+  ovm_call(vm, R5, OBJ_OP_SORT);
+}
+
+/* Round trip of an array of n integers, through string and back */
+
+static void
+tostring_parse_setup(struct ovm *vm, unsigned n)
+{
+  array_sort_setup(vm, n);
+}
+
+static void
+tostring_parse_run(struct ovm *vm, unsigned n)
+{
+  ovm_new(vm, R0, OBJ_TYPE_STRING, R5);
+  ovm_new(vm, R1, OBJ_TYPE_ARRAY, R0);
+}
+
+static void
+tostring_parse_float_setup(struct ovm *vm, unsigned n)
+{
+  unsigned i;
+
+  rand_seed();
+
+  ovm_newc(vm, R5, OBJ_TYPE_ARRAY, n);
+  for (i = 0; i < n; ++i) {
+    ovm_newc(vm, R0, OBJ_TYPE_INTEGER, (obj_integer_val_t) i);
+    ovm_newc(vm, R1, OBJ_TYPE_FLOAT, (obj_float_val_t) rand_next() / 1024);
+    ovm_call(vm, R5, OBJ_OP_AT_PUT, R0, R1);
+  }
+}
+
+/* Deep comparison of two distinct, equal arrays */
+
+enum {
+  EQ_SIZE = 1000
+};
+
+static void
+array_eq_setup(struct ovm *vm, unsigned n)
+{
+  array_sort_setup(vm, EQ_SIZE);
+  ovm_new(vm, R6, OBJ_TYPE_STRING, R5);
+  ovm_new(vm, R6, OBJ_TYPE_ARRAY, R6);
+}
+
+static void
+array_eq_run(struct ovm *vm, unsigned n)
+{
+  for ( ; n; --n) {
+    ovm_move(vm, R0, R5);
+    ovm_call(vm, R0, OBJ_OP_EQ, R6);
+  }
+}
+
+enum {
+  LIST_SIZE = 1000
+};
+
+static void
+list_setup(struct ovm *vm, unsigned n)
+{
+  array_sort_setup(vm, LIST_SIZE);
+  ovm_new(vm, R5, OBJ_TYPE_LIST, 1, R5);
+  ovm_newc(vm, R6, OBJ_TYPE_INTEGER, (obj_integer_val_t) (LIST_SIZE / 4));
+  ovm_newc(vm, R7, OBJ_TYPE_INTEGER, (obj_integer_val_t) (LIST_SIZE / 2));
+}
+
+static void
+list_append_run(struct ovm *vm, unsigned n)
+{
+  for ( ; n; --n) {
+    ovm_move(vm, R0, R5);
+    ovm_call(vm, R0, OBJ_OP_APPEND, R5);
+  }
+}
+
+static void
+list_slice_run(struct ovm *vm, unsigned n)
+{
+  for ( ; n; --n) {
+    ovm_move(vm, R0, R5);
+    ovm_call(vm, R0, OBJ_OP_SLICE, R6, R7);
+  }
+}
+
+/* Hash of a list; memoized after the first */
+
+static void
+list_hash_run(struct ovm *vm, unsigned n)
+{
+  for ( ; n; --n) {
+    ovm_move(vm, R0, R5);
+    ovm_call(vm, R0, OBJ_OP_HASH);
+  }
+}
+
+/* Array of n records, converted directly between JSON and objects, versus
+   through OVM text
+*/
+
+static char     *json_text;
+static unsigned json_len, json_size;
+
+static void
+json_setup(struct ovm *vm, unsigned n)
+{
+  struct hp_stream_buf  sb[1];
+  struct hp_json_stream jst[1];
+  unsigned              i, k;
+
+  rand_seed();
+
+  free(json_text);
+  json_size = 128 * n + 2;
+  assert((json_text = malloc(json_size)) != 0);
+
+  json_len = 0;
+  json_text[json_len++] = '[';
+  for (i = 0; i < n; ++i) {
+    k = rand_next();
+    json_len += snprintf(json_text + json_len, json_size - json_len,
+			 "%s{\"id\": %u, \"name\": \"key-%u\", \"score\": %.3f, \"tags\": [%u, %u, %u]}",
+			 i ? ", " : "", i, k, (double) k / 1024, k & 7, k >> 28, i & 15
+			 );
+  }
+  json_text[json_len++] = ']';
+
+  hp_json_stream_parse_init(jst, hp_stream_buf_init(sb, json_text, json_len)->base);
+  assert(ovm_json_parse(vm, R5, jst) == 0);
+  ovm_new(vm, R6, OBJ_TYPE_STRING, R5);
+}
+
+static void
+json_parse_run(struct ovm *vm, unsigned n)
+{
+  struct hp_stream_buf  sb[1];
+  struct hp_json_stream jst[1];
+
+  hp_json_stream_parse_init(jst, hp_stream_buf_init(sb, json_text, json_len)->base);
+  ovm_json_parse(vm, R0, jst);
+}
+
+static void
+text_parse_run(struct ovm *vm, unsigned n)
+{
+  ovm_new(vm, R0, OBJ_TYPE_ARRAY, R6);
+}
+
+static void
+json_tostring_run(struct ovm *vm, unsigned n)
+{
+  struct hp_stream_buf  sb[1];
+  struct hp_json_stream jst[1];
+
+  hp_json_stream_tostring_init(jst, hp_stream_buf_init(sb, json_text, json_size)->base);
+  ovm_json_tostring(vm, R5, jst);
+}
+
+static void
+text_tostring_run(struct ovm *vm, unsigned n)
+{
+  ovm_new(vm, R0, OBJ_TYPE_STRING, R5);
+}
+
+struct bench {
+  char     *name;
+  void     (*setup)(struct ovm *vm, unsigned n);
+  void     (*run)(struct ovm *vm, unsigned n);
+  unsigned n;			/* Operations per run */
+} bench_tbl[] = {
+  { "integer-add",          0,                          int_add_run,         10000000 },
+  { "dict-insert-int",      dict_int_setup,             dict_int_insert_run, 100000 },
+  { "dict-lookup-int",      dict_int_lookup_setup,      dict_int_lookup_run, 100000 },
+  { "dict-insert-str",      dict_str_setup,             dict_str_insert_run, 100000 },
+  { "dict-lookup-str",      dict_str_lookup_setup,      dict_str_lookup_run, 100000 },
+  { "array-sort",           array_sort_setup,           array_sort_run,      1000000 },
+  { "tostring-parse",       tostring_parse_setup,       tostring_parse_run,  100000 },
+  { "tostring-parse-float", tostring_parse_float_setup, tostring_parse_run,  100000 },
+  { "array-eq",             array_eq_setup,             array_eq_run,        10000 },
+  { "list-append",          list_setup,                 list_append_run,     10000 },
+  { "list-slice",           list_setup,                 list_slice_run,      100000 },
+  { "list-hash",            list_setup,                 list_hash_run,       100000 },
+  { "json-parse",           json_setup,                 json_parse_run,      10000 },
+  { "text-parse",           json_setup,                 text_parse_run,      10000 },
+  { "json-tostring",        json_setup,                 json_tostring_run,   10000 },
+  { "text-tostring",        json_setup,                 text_tostring_run,   10000 }
+};
+
+struct bench_result {
+  double             ns_per_op;
+  double             allocs_per_op;
+  unsigned           pool_peak;
+};
+
+static double
+now_ns(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return (ts.tv_sec * 1e9 + ts.tv_nsec);
+}
+
+static unsigned long long
+allocs_total(struct ovm_stats *st)
+{
+  unsigned long long result = 0;
+  unsigned           i;
+
+  for (i = 0; i < _ARRAY_SIZE(st->type); ++i)  result += st->type[i].allocs;
+
+  return (result);
+}
+
+static int
+bench_run(struct bench *b, unsigned repeat, struct bench_result *r)
+{
+  static struct ovm_stats st[1];
+  double                  t;
+
+  for ( ; repeat; --repeat) {
+    reg_clr(vm);
+    if (b->setup)  (*b->setup)(vm, b->n);
+
+    ovm_stats_clr(vm);
+
+    t = now_ns();
+    (*b->run)(vm, b->n);
+    t = now_ns() - t;
+
+    if (ovm_errno(vm) != OBJ_ERRNO_NONE || ovm_stats_get(vm, st) < 0)  return (-1);
+
+    t /= b->n;
+    if (r->ns_per_op == 0 || t < r->ns_per_op)  r->ns_per_op = t;
+    r->allocs_per_op = (double) allocs_total(st) / b->n;
+    r->pool_peak     = st->pool_peak;
+  }
+
+  reg_clr(vm);
+
+  return (0);
+}
+
+int
+main(int argc, char **argv)
+{
+  unsigned              repeat = argc > 1 ? atoi(argv[1]) : 5, i;
+  void                  *pool, *stack;
+  obj_var               work[1];
+  struct hp_stream_file fst[1];
+  struct hp_json_stream jst[1], ast[1], dst[1];
+  struct bench          *b;
+  struct bench_result   r[1];
+
+  if (repeat == 0)  repeat = 1;
+
+  pool  = malloc(POOL_SIZE * sizeof(struct obj));
+  stack = malloc(STACK_SIZE * sizeof(obj_t));
+  assert(pool != 0 && stack != 0);
+
+  ovm_init(vm, POOL_SIZE * sizeof(struct obj), pool, sizeof(work), work, STACK_SIZE * sizeof(obj_t), stack);
+  if (ovm_errno(vm) != OBJ_ERRNO_NONE) {
+    fprintf(stderr, "VM init failed\n");
+    return (1);
+  }
+
+  hp_json_stream_tostring_init(jst, hp_stream_file_init(fst, stdout)->base);
+  hp_json_arr_begin_tostring(jst, ast);
+
+  for (b = bench_tbl, i = _ARRAY_SIZE(bench_tbl); i; --i, ++b) {
+    memset(r, 0, sizeof(*r));
+    if (bench_run(b, repeat, r) < 0) {
+      fprintf(stderr, "%s: failed, errno %d\n", b->name, ovm_errno(vm));
+      return (1);
+    }
+
+    hp_json_dict_begin_tostring(ast, dst);
+    hp_json_string_tostring(dst, "name");
+    hp_json_string_tostring(dst, b->name);
+    hp_json_string_tostring(dst, "ops");
+    hp_json_int_tostring(dst, b->n);
+    hp_json_string_tostring(dst, "ns-per-op");
+    hp_json_float_tostring(dst, r->ns_per_op);
+    hp_json_string_tostring(dst, "allocs-per-op");
+    hp_json_float_tostring(dst, r->allocs_per_op);
+    hp_json_string_tostring(dst, "pool-peak");
+    hp_json_int_tostring(dst, r->pool_peak);
+    hp_json_dict_end_tostring(dst);
+  }
+
+  hp_json_arr_end_tostring(ast);
+  putchar('\n');
+
+  ovm_fini(vm);
+
+  return (0);
+}
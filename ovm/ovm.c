@@ -14,87 +14,104 @@ OVM, an Object Virtual Machine for C
 
 ***************************************************************************/
 
+#include <stddef.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdarg.h>
 #include <assert.h>
 #include <stdio.h>
+#include <stdatomic.h>
+
+#if defined(__SSE2__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#include "num/hp_num.h"
 
 #include "ovm.h"
 
 #define _ARRAY_SIZE(a)  (sizeof(a) / sizeof((a)[0]))
 
-#define FIELD_OFS(s, f)                   ((int) &((s *) 0)->f)
-#define FIELD_PTR_TO_STRUCT_PTR(p, s, f)  ((s *)((char *)(p) - FIELD_OFS(s, f)))
+#define BITS_PER_WORD  (8 * sizeof(unsigned))
 
+/* Instrumentation, compiled in only if OVM_STATS is defined */
 
-static struct _list *
-list_init(struct _list *li)
-{
-  return (li->prev = li->next = li);
-}
+#ifdef OVM_STATS
 
-static unsigned
-list_empty(struct _list *li)
-{
-  return (li->next == li);
-}
+#if defined(__i386__) || defined(__x86_64__)
 
-static struct _list *
-list_end(struct _list *li)
-{
-  return (li);
-}
+#include <x86intrin.h>
 
-static struct _list *
-list_first(struct _list *li)
-{
-  return (li->next);
-}
+#define OVM_STATS_CLOCK()  (__rdtsc())
+
+#else
 
-static struct _list *
-list_last(struct _list *li)
+#include <time.h>
+
+static inline unsigned long long
+ovm_stats_clock(void)
 {
-  return (li->prev);
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return (ts.tv_sec * 1000000000ULL + ts.tv_nsec);
 }
 
-static struct _list *
-list_prev(struct _list *nd)
+#define OVM_STATS_CLOCK()  (ovm_stats_clock())
+
+#endif
+
+static inline void
+ovm_stats_alloc(struct ovm *vm, unsigned type)
 {
-  return (nd->prev);
+  struct ovm_stats *st = vm->stats;
+
+  ++st->type[type - OBJ_TYPE_BASE].allocs;
+  if (++st->pool_used > st->pool_peak)  st->pool_peak = st->pool_used;
 }
 
-static struct _list *
-list_next(struct _list *nd)
+static inline void
+ovm_stats_free(struct ovm *vm, unsigned type)
 {
-  return (nd->next);
+  struct ovm_stats *st = vm->stats;
+
+  ++st->type[type - OBJ_TYPE_BASE].frees;
+  --st->pool_used;
 }
 
-static struct _list *
-list_insert(struct _list *nd, struct _list *before)
-{
-  struct _list *p = before->prev;
+#define OVM_STATS_ALLOC(vm, type)    (ovm_stats_alloc((vm), (type)))
+#define OVM_STATS_FREE(vm, type)     (ovm_stats_free((vm), (type)))
+#define OVM_STATS_PAYLOAD(vm, size)  ((vm)->stats->payload_bytes += (size))
 
-  nd->prev = p;
-  nd->next = before;
+#else
 
-  return (p->next = before->prev = nd);
-}
+#define OVM_STATS_ALLOC(vm, type)
+#define OVM_STATS_FREE(vm, type)
+#define OVM_STATS_PAYLOAD(vm, size)
 
-static struct _list *
-list_erase(struct _list *nd)
-{
-  struct _list *p = nd->prev, *q = nd->next;
+#endif
+
+
+#define R(x)  (vm->reg[x])
 
-  p->next = q;
-  q->prev = p;
+/* Pool occupancy bitmap, so that live objects can be enumerated */
 
-  nd->prev = nd->next = 0;
+static inline void
+obj_live_set(struct ovm *vm, struct obj *obj)
+{
+  unsigned i = obj - vm->obj_pool;
 
-  return (nd);
+  vm->obj_live[i / BITS_PER_WORD] |= 1U << (i % BITS_PER_WORD);
 }
 
-#define R(x)  (vm->reg[x])
+static inline void
+obj_live_clr(struct ovm *vm, struct obj *obj)
+{
+  unsigned i = obj - vm->obj_pool;
+
+  vm->obj_live[i / BITS_PER_WORD] &= ~(1U << (i % BITS_PER_WORD));
+}
 
 static unsigned
 obj_type(struct obj *obj)
@@ -108,6 +125,7 @@ is_list(struct obj *p)
   switch (obj_type(p)) {
   case OBJ_TYPE_NIL:
   case OBJ_TYPE_LIST:
+  case OBJ_TYPE_VLIST:
     return (1);
   default:
     ;
@@ -116,6 +134,51 @@ is_list(struct obj *p)
   return (0);
 }
 
+/* Traversal of lists, in either representation.  A list is a chain of
+   cons cells, optionally terminated by a vector list sharing its tail. */
+
+struct list_iter {
+  struct obj *li;		/* Current cons cell or vector list */
+  unsigned   idx;		/* Current index, if vector list */
+};
+
+static void
+list_iter_init(struct list_iter *it, struct obj *li)
+{
+  it->li  = li;
+  it->idx = 0;
+}
+
+static struct obj *
+list_iter_car(struct list_iter *it)
+{
+  struct obj *li = it->li;
+
+  return (obj_type(li) == OBJ_TYPE_VLIST ? VLIST_DATA(li)[it->idx] : CAR(li));
+}
+
+static void
+list_iter_skip(struct list_iter *it, unsigned n)
+{
+  struct obj *li;
+
+  for ( ; n && (li = it->li); --n) {
+    if (obj_type(li) == OBJ_TYPE_VLIST) {
+      if ((it->idx += n) >= VLIST_SIZE(li))  it->li = 0;
+
+      return;
+    }
+
+    it->li = CDR(li);
+  }
+}
+
+static void
+list_iter_next(struct list_iter *it)
+{
+  list_iter_skip(it, 1);
+}
+
 static void obj_nil_newc(struct ovm *vm, struct obj **pp);
 static void obj_bool_newc(struct ovm *vm, struct obj **pp, unsigned val);
 static void obj_integer_newc(struct ovm *vm, struct obj **pp, obj_integer_val_t val);
@@ -124,10 +187,20 @@ static void obj_string_newc(struct ovm *vm, struct obj **pp, unsigned n, ...);
 static void obj_string_newv(struct ovm *vm, struct obj **pp, struct obj *arr);
 static void obj_pair_newc(struct ovm *vm, struct obj **pp, struct obj *car, struct obj *cdr);
 static void obj_list_newc(struct ovm *vm, struct obj **pp, struct obj *car, struct obj *cdr);
+static void obj_vlist_newc(struct ovm *vm, struct obj **pp, struct obj *arr, unsigned ofs, unsigned size);
 static void obj_array_newc(struct ovm *vm, struct obj **pp, unsigned size);
+static void obj_array_copy(struct ovm *vm, struct obj **pp, struct obj *a);
 static void obj_dict_newc(struct ovm *vm, struct obj **pp, unsigned size);
+static unsigned obj_iter_step(struct ovm *vm, struct obj *it, struct obj **pp);
+static void obj_iter_drain(struct ovm *vm, struct obj **pp, struct obj *it);
+static void obj_iter_newc(struct ovm *vm, struct obj **pp, struct obj *q);
+static void obj_pdict_pairs(struct ovm *vm, struct obj **pp, struct obj *q);
+static void obj_set_members(struct ovm *vm, struct obj **pp, struct obj *q);
 
 static void obj_free(struct ovm *vm, struct obj *obj);
+static int obj_equal(struct ovm *vm, struct obj *p, struct obj *q);
+static int _obj_hash(struct obj *p, unsigned *h);
+static struct objval_hash_memo *obj_hash_memo(struct obj *p);
 
 static void
 ovm_error(struct ovm *vm, int errno)
@@ -136,10 +209,32 @@ ovm_error(struct ovm *vm, int errno)
   if (vm->err_hook)  (*vm->err_hook)(vm);
 }
 
+/* Reference count of frozen objects, which are never counted */
+
+enum {
+  OBJ_REF_CNT_FROZEN = ~0U
+};
+
+static inline unsigned
+obj_is_frozen(struct obj *obj)
+{
+  return (obj->ref_cnt == OBJ_REF_CNT_FROZEN);
+}
+
+static unsigned
+obj_frozen_chk(struct ovm *vm, struct obj *obj)
+{
+  if (obj == 0 || !obj_is_frozen(obj))  return (0);
+
+  ovm_error(vm, OBJ_ERRNO_FROZEN);
+
+  return (1);
+}
+
 static struct obj *
 obj_retain(struct obj *obj)
 {
-  if (obj)  ++obj->ref_cnt;
+  if (obj && !obj_is_frozen(obj))  ++obj->ref_cnt;
 
   return (obj);
 }
@@ -158,13 +253,44 @@ obj_free_block(struct ovm *vm, struct obj *obj)
 static void
 obj_free_dptr(struct ovm *vm, struct obj *obj)
 {
+  struct obj *p = CDR(obj), *q;
+
   obj_release(vm, CAR(obj));
-  obj_release(vm, CDR(obj));
 
   CAR(obj) = 0;
   CDR(obj) = 0;
+
+  /* Free the tail of a list here, cell by cell, rather than recursing down
+     it; each cell is cut off from the rest before it is released
+  */
+
+  while (p != 0
+	 && p->ref_cnt == 1
+	 && (p->type == OBJ_TYPE_LIST || p->type == OBJ_TYPE_PAIR)
+	 ) {
+    q = CDR(p);
+    CDR(p) = 0;
+    obj_release(vm, p);
+    p = q;
+  }
+  obj_release(vm, p);
+}
+
+static void
+obj_free_vlist(struct ovm *vm, struct obj *obj)
+{
+  obj_release(vm, VLIST_ARR(obj));
+
+  /* Cleared, so that the DPTR cleanup for the parent type is a no-op */
+
+  VLIST_ARR(obj)  = 0;
+  VLIST_OFS(obj)  = 0;
+  VLIST_SIZE(obj) = 0;
 }
 
+static void obj_free_iter(struct ovm *vm, struct obj *obj);
+static void obj_free_pdict(struct ovm *vm, struct obj *obj);
+
 static void
 obj_free_array(struct ovm *vm, struct obj *obj)
 {
@@ -181,6 +307,8 @@ obj_free(struct ovm *vm, struct obj *obj)
 {
   unsigned type;
 
+  OVM_STATS_FREE(vm, obj_type(obj));
+
   for (type = obj_type(obj); type != OBJ_TYPE_OBJECT; type = obj_type_parent(type)) {
     switch (type) {
     case OBJ_TYPE_BOOLEAN:
@@ -196,6 +324,15 @@ obj_free(struct ovm *vm, struct obj *obj)
     case OBJ_TYPE_DPTR:
       obj_free_dptr(vm, obj);
       break;
+    case OBJ_TYPE_VLIST:
+      obj_free_vlist(vm, obj);
+      break;
+    case OBJ_TYPE_ITERATOR:
+      obj_free_iter(vm, obj);
+      break;
+    case OBJ_TYPE_PDICT:
+      obj_free_pdict(vm, obj);
+      break;
     case OBJ_TYPE_ARRAY:
       obj_free_array(vm, obj);
       break;
@@ -204,15 +341,16 @@ obj_free(struct ovm *vm, struct obj *obj)
     }
   }
 
-  list_erase(obj->_list_node);
+  obj_live_clr(vm, obj);
 
-  list_insert(obj->_list_node, &vm->obj_list._list[vm->obj_list.idx_free]);
+  obj->val.ptrval = vm->obj_free;
+  vm->obj_free    = obj;
 }
 
 static void
 obj_release(struct ovm *vm, struct obj *obj)
 {
-  if (obj == 0)  return;
+  if (obj == 0 || obj_is_frozen(obj))  return;
 
   assert(obj->ref_cnt != 0);
 
@@ -254,7 +392,7 @@ obj_alloc(struct ovm *vm, struct obj **pp, unsigned type)
 {
   struct obj *q;
 
-  assert(type >= OBJ_TYPE_BASE && type < OBJ_TYPE_LAST);
+  assert(type >= OBJ_TYPE_BASE && type < OBJ_TYPE_INTERNAL_LAST);
 
   switch (type) {
   case OBJ_TYPE_OBJECT:
@@ -263,24 +401,16 @@ obj_alloc(struct ovm *vm, struct obj **pp, unsigned type)
     q = 0;
     break;
   default:
-    {
-      struct _list *li;
-      struct _list *nd;
-    
-      li = &vm->obj_list._list[vm->obj_list.idx_free];
-      if (list_first(li) == list_end(li)) {
-	assert(0);
-      }
-      
-      nd = list_first(li);
-      list_erase(nd);
+    q = vm->obj_free;
+    assert(q != 0);
 
-      q = FIELD_PTR_TO_STRUCT_PTR(nd, struct obj, _list_node);
-      memset(q, 0, sizeof(*q));
-      q->type = type;
-      
-      list_insert(nd, list_end(&vm->obj_list._list[vm->obj_list.idx_alloced]));
-    }
+    vm->obj_free = q->val.ptrval;
+
+    memset(q, 0, sizeof(*q));
+    q->type = type;
+    obj_live_set(vm, q);
+
+    OVM_STATS_ALLOC(vm, type);
   }
 
   obj_assign(vm, pp, q);
@@ -416,11 +546,14 @@ static int obj_nil_parse(struct ovm *vm, struct obj **pp, unsigned n, char *p);
 static int obj_bool_parse(struct ovm *vm, struct obj **pp, unsigned n, char *p);
 static int obj_int_parse(struct ovm *vm, struct obj **pp, unsigned n, char *p);
 static int obj_float_parse(struct ovm *vm, struct obj **pp, unsigned n, char *p);
+static int obj_num_parse(struct ovm *vm, struct obj **pp, unsigned n, char *p);
 static int obj_pair_parse(struct ovm *vm, struct obj **pp, unsigned n, char *p);
 static int obj_list_parse(struct ovm *vm, struct obj **pp, unsigned n, char *p);
 static int obj_array_parse(struct ovm *vm, struct obj **pp, unsigned n, char *p);
 static int obj_dict_parse(struct ovm *vm, struct obj **pp, unsigned n, char *p);
+static int obj_set_parse(struct ovm *vm, struct obj **pp, unsigned n, char *p);
 static int obj_str_parse(struct ovm *vm, struct obj **pp, unsigned n, char *p);
+static int obj_seq_parse(struct ovm *vm, struct obj **pp, unsigned n, char *p);
 
 static void obj_nil_tostring(struct ovm *vm, struct obj **pp, struct obj *q);
 static void obj_bool_tostring(struct ovm *vm, struct obj **pp, struct obj *q);
@@ -431,19 +564,120 @@ static void obj_pair_tostring(struct ovm *vm, struct obj **pp, struct obj *q);
 static void obj_list_tostring(struct ovm *vm, struct obj **pp, struct obj *q);
 static void obj_array_tostring(struct ovm *vm, struct obj **pp, struct obj *q);
 static void obj_dict_tostring(struct ovm *vm, struct obj **pp, struct obj *q);
+static void obj_iter_tostring(struct ovm *vm, struct obj **pp, struct obj *q);
+static void obj_pdict_tostring(struct ovm *vm, struct obj **pp, struct obj *q);
+static void obj_set_tostring(struct ovm *vm, struct obj **pp, struct obj *q);
 
 static struct obj *_obj_dict_at(struct ovm *vm, struct obj *dict, struct obj *key);
 static void _obj_dict_at_put(struct ovm *vm, struct obj *dict, struct obj *key, struct obj *val);
 static void _obj_dict_del(struct ovm *vm, struct obj *dict, struct obj *key);
 
 
+/* Byte scanning
+
+   Substring search finds candidate positions, where both the first and
+   last bytes of the substring match, a vector at a time, and compares
+   only those in full.  Vectors are AVX2 if the build enables it (e.g.
+   -mavx2), else SSE2, which every x86-64 has; elsewhere, bytes are
+   compared one at a time.
+*/
+
+static char *
+mem_find(char *s, unsigned n, char *d, unsigned m)
+{
+  unsigned i, k, bits;
+
+  if (m == 0)  return (s);
+  if (m > n)   return (0);
+  if (m == 1)  return (memchr(s, d[0], n));
+
+  i = 0;
+
+#ifdef __AVX2__
+  {
+    __m256i f = _mm256_set1_epi8(d[0]), l = _mm256_set1_epi8(d[m - 1]);
+
+    for ( ; i + 32 <= n - m + 1; i += 32) {
+      bits = _mm256_movemask_epi8(
+               _mm256_and_si256(_mm256_cmpeq_epi8(f, _mm256_loadu_si256((__m256i *)(s + i))),
+				_mm256_cmpeq_epi8(l, _mm256_loadu_si256((__m256i *)(s + i + m - 1)))
+				)
+				  );
+      for ( ; bits; bits &= bits - 1) {
+	k = i + __builtin_ctz(bits);
+	if (memcmp(s + k + 1, d + 1, m - 2) == 0)  return (s + k);
+      }
+    }
+  }
+#endif
+
+#ifdef __SSE2__
+  {
+    __m128i f = _mm_set1_epi8(d[0]), l = _mm_set1_epi8(d[m - 1]);
+
+    for ( ; i + 16 <= n - m + 1; i += 16) {
+      bits = _mm_movemask_epi8(
+               _mm_and_si128(_mm_cmpeq_epi8(f, _mm_loadu_si128((__m128i *)(s + i))),
+			     _mm_cmpeq_epi8(l, _mm_loadu_si128((__m128i *)(s + i + m - 1)))
+			     )
+			       );
+      for ( ; bits; bits &= bits - 1) {
+	k = i + __builtin_ctz(bits);
+	if (memcmp(s + k + 1, d + 1, m - 2) == 0)  return (s + k);
+      }
+    }
+  }
+#endif
+
+  for ( ; i <= n - m; ++i) {
+    if (s[i] == d[0] && s[i + m - 1] == d[m - 1] && memcmp(s + i + 1, d + 1, m - 2) == 0) {
+      return (s + i);
+    }
+  }
+
+  return (0);
+}
+
+/* Number of leading bytes which delim_find() can pass over: not the
+   delimiter, nor any character it tracks
+*/
+
+static unsigned
+delim_skip(char *p, unsigned n, char d)
+{
+  unsigned result = 0;
+
+#ifdef __SSE2__
+  static const char tracked[] = "\\<([{>)]}\"";
+
+  __m128i  v, m;
+  unsigned i, bits;
+
+  for ( ; result + 16 <= n; result += 16) {
+    v = _mm_loadu_si128((__m128i *)(p + result));
+    m = _mm_cmpeq_epi8(v, _mm_set1_epi8(d));
+    for (i = 0; i < sizeof(tracked) - 1; ++i) {
+      m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8(tracked[i])));
+    }
+    if (bits = _mm_movemask_epi8(m))  return (result + __builtin_ctz(bits));
+  }
+#endif
+
+  return (result);
+}
+
 static unsigned
 delim_find(unsigned *pn, char **pp, char d)
 {
-  unsigned n = *pn, lvl, qlvl;
+  unsigned n = *pn, lvl, qlvl, k;
   char     *p = *pp, c, dc, *dd;
 
   for (qlvl = lvl = 0; n; --n, ++p) {
+    k = delim_skip(p, n, d);
+    if (k == n)  break;
+    p += k;
+    n -= k;
+
     c = *p;
 
     if (c == d && qlvl == 0 && lvl == 0) {
@@ -513,6 +747,7 @@ obj_str_parse(struct ovm *vm, struct obj **pp, unsigned n, char *p)
   case '#':
     return (obj_nil_parse(vm, pp, n, p) == 0
 	    || obj_bool_parse(vm, pp, n, p) == 0
+	    || obj_set_parse(vm, pp, n, p) == 0
 	    ? 0 : -1
 	    );
   case '"':
@@ -521,11 +756,7 @@ obj_str_parse(struct ovm *vm, struct obj **pp, unsigned n, char *p)
     return (0);
 
   default:
-    if (obj_int_parse(vm, pp, n, p) == 0
-	|| obj_float_parse(vm, pp, n, p) == 0
-	) {
-      return (0);
-    }
+    return (obj_num_parse(vm, pp, n, p));
   }
 
   return (-1);
@@ -554,6 +785,7 @@ obj_tostring(struct ovm *vm, struct obj **pp, struct obj *q)
     obj_pair_tostring(vm, pp, q);
     return;
   case OBJ_TYPE_LIST:
+  case OBJ_TYPE_VLIST:
     obj_list_tostring(vm, pp, q);
     return;
   case OBJ_TYPE_ARRAY:
@@ -562,6 +794,15 @@ obj_tostring(struct ovm *vm, struct obj **pp, struct obj *q)
   case OBJ_TYPE_DICT:
     obj_dict_tostring(vm, pp, q);
     return;
+  case OBJ_TYPE_ITERATOR:
+    obj_iter_tostring(vm, pp, q);
+    return;
+  case OBJ_TYPE_PDICT:
+    obj_pdict_tostring(vm, pp, q);
+    return;
+  case OBJ_TYPE_SET:
+    obj_set_tostring(vm, pp, q);
+    return;
   default:
     ;
   }
@@ -607,11 +848,7 @@ obj_nil_append(struct ovm *vm, struct obj **pp, va_list ap)
 {
   struct obj *q = *_ovm_reg(vm, va_arg(ap, unsigned));
 
-  switch (obj_type(q)) {
-  case OBJ_TYPE_NIL:
-  case OBJ_TYPE_LIST:
-    break;
-  default:
+  if (!is_list(q)) {
     ovm_error(vm, OBJ_ERRNO_BAD_TYPE);
     return;
   }
@@ -629,24 +866,12 @@ obj_nil_at(struct ovm *vm, struct obj **pp, va_list ap)
     ;
 }
 
-static void
-obj_nil_eq(struct ovm *vm, struct obj **pp, va_list ap)
-{
-  obj_bool_newc(vm, pp, *_ovm_reg(vm, va_arg(ap, unsigned)) == 0);
-}
-
 static void
 obj_nil_filter(struct ovm *vm, struct obj **pp, va_list ap)
 {
   obj_assign(vm, pp, 0);
 }
 
-static void
-obj_nil_hash(struct ovm *vm, struct obj **pp, va_list ap)
-{
-  obj_integer_newc(vm, pp, 0);
-}
-
 static void
 obj_nil_reverse(struct ovm *vm, struct obj **pp, va_list ap)
 {
@@ -687,14 +912,21 @@ obj_ptr_newc(struct ovm *vm, struct obj **pp, void *val)
 
 /***************************************************************************/
 
+/* Booleans are immutable, so there is one of each, shared by all VMs and,
+   like a frozen object, not reference counted; making one allocates nothing
+*/
+
+static struct obj obj_bool_false[1] = {
+  { .ref_cnt = OBJ_REF_CNT_FROZEN, .type = OBJ_TYPE_BOOLEAN, .val.boolval = 0 }
+};
+static struct obj obj_bool_true[1] = {
+  { .ref_cnt = OBJ_REF_CNT_FROZEN, .type = OBJ_TYPE_BOOLEAN, .val.boolval = 1 }
+};
+
 static void
 obj_bool_newc(struct ovm *vm, struct obj **pp, unsigned val)
 {
-  obj_alloc(vm, pp, OBJ_TYPE_BOOLEAN);
-
-  if (vm->errno != OBJ_ERRNO_NONE)  return;
-
-  BOOLVAL(*pp) = (val != 0);
+  obj_assign(vm, pp, val ? obj_bool_true : obj_bool_false);
 }
 
 static int
@@ -764,19 +996,6 @@ obj_bool_new(struct ovm *vm, struct obj **pp, va_list ap)
 
 METHOD_2(obj_bool_and, OBJ_TYPE_BOOLEAN, obj_bool_newc, boolval, &&)
 
-static void
-obj_bool_eq(struct ovm *vm, struct obj **pp, va_list ap)
-{
-  struct obj *q = *_ovm_reg(vm, va_arg(ap, unsigned));
-
-  obj_bool_newc(vm,
-		pp,
-		obj_type(q) == OBJ_TYPE_BOOLEAN && (BOOLVAL(*pp) != 0) == (BOOLVAL(q) != 0)
-		);
-}
-
-METHOD_1(obj_bool_hash, obj_integer_newc, BOOLVAL(*pp) != 0);
-
 METHOD_1(obj_bool_not, obj_bool_newc, BOOLVAL(*pp) == 0);
 
 METHOD_2(obj_bool_or, OBJ_TYPE_BOOLEAN, obj_bool_newc, boolval, ||);
@@ -798,51 +1017,12 @@ obj_integer_newc(struct ovm *vm, struct obj **pp, obj_integer_val_t val)
 static int
 obj_int_parse(struct ovm *vm, struct obj **pp, unsigned n, char *p)
 {
-  char     c, buf[n + 1], *fmt, *q;
-  unsigned k;
-  obj_integer_val_t val;
+  struct hp_num num[1];
 
   trim(&n, &p);
+  if (hp_num_parse(num, n, p) < 0 || num->type != HP_NUM_TYPE_INT)  return (-1);
 
-  if (n >= 2 && p[0] == '0') {
-    if (n >= 3 && (p[1] | 0x20) == 'x') {
-      p += 2;  n -= 2;
-      
-      for (q = p, k = n; k; --k, ++q) {
-	if (!((c = *q) >= '0' && c <= '9' || (c |= 0x20) >= 'a' && c <= 'f'))  return (-1);
-      }
-
-      fmt = "%llx";
-    } else {
-      ++p;  --n;
-
-      for (q = p, k = n; k; --k, ++q) {
-	if (!((c = *q) >= '0' && c <= '7'))  return (-1);
-      }
-
-      fmt = "%llo";
-    }
-  } else if (n >= 1 && (c = p[0]) >= '0' && c <= '9'
-	     || n >= 2 && p[0] == '-' && (c = p[1]) >= '0' && c <= '9'
-      ) {
-    q = p;  k = n;
-    if (*q == '-') {
-      ++q;  --k;
-    }
-    for ( ; k; --k, ++q) {
-      if (!((c = *q) >= '0' && c <= '9'))  return (-1);
-    }
-
-    fmt = "%lld";
-  } else {
-    return (-1);
-  }
-
-  memcpy(buf, p, n);
-  buf[n] = 0;
-  if (sscanf(buf, fmt, &val) != 1)  return (-1);
-
-  obj_integer_newc(vm, pp, val);
+  obj_integer_newc(vm, pp, num->u.intval);
 
   return (vm->errno != OBJ_ERRNO_NONE ? -1 : 0);
 }
@@ -917,32 +1097,8 @@ METHOD_2(obj_integer_and, OBJ_TYPE_INTEGER, obj_integer_newc, intval, &);
 
 METHOD_2(obj_integer_div, OBJ_TYPE_INTEGER, obj_integer_newc, intval, /);
 
-static void
-obj_integer_eq(struct ovm *vm, struct obj **pp, va_list ap)
-{
-  struct obj *q = *_ovm_reg(vm, va_arg(ap, unsigned));
-  
-  obj_bool_newc(vm, pp, obj_type(q) == OBJ_TYPE_INTEGER && INTVAL(*pp) == INTVAL(q));
-}
-
 METHOD_2(obj_integer_gt, OBJ_TYPE_INTEGER, obj_bool_newc, intval, >);
 
-static void
-obj_integer_hash(struct ovm *vm, struct obj **pp, va_list ap)
-{
-  struct obj *p = *pp;
-  unsigned   r[1];
-
-  crc_init(r);
-  obj_integer_newc(vm,
-		   pp,
-		   (obj_integer_val_t) crc32(r,
-					     sizeof(INTVAL(p)),
-					     (unsigned char *) &INTVAL(p)
-					     )
-		   );
-}
-
 METHOD_2(obj_integer_lt, OBJ_TYPE_INTEGER, obj_bool_newc, intval, <);
 
 METHOD_1(obj_integer_minus, obj_integer_newc, -INTVAL(*pp));
@@ -969,59 +1125,59 @@ obj_float_newc(struct ovm *vm, struct obj **pp, obj_float_val_t val)
   FLOATVAL(*pp) = val;
 }
 
-static int
-obj_float_parse(struct ovm *vm, struct obj **pp, unsigned n, char *p)
+/* The scanner converts to double; for a wider FLOAT, convert again.  The
+   text is not terminated, so it is copied; long text goes to the heap.
+*/
+
+static obj_float_val_t
+obj_float_num_val(struct hp_num *num, unsigned n, char *p)
 {
-  char            c, buf[n + 1], *q;
-  unsigned        k, i, dpcnt;
+#ifdef OVM_FLOAT_LONG_DOUBLE
+  char            sbuf[64], *buf = sbuf, *e;
   obj_float_val_t val;
+  int             ok;
 
-  trim(&n, &p);
+  if (n >= sizeof(sbuf) && (buf = malloc(n + 1)) == 0)  goto dflt;
+  memcpy(buf, p, n);
+  buf[n] = 0;
+  val = OVM_STRTO_FLOAT(buf, &e);
+  ok  = (e == buf + n);
+  if (buf != sbuf)  free(buf);
+  if (ok)  return (val);
 
-  q = p;  k = n;
+ dflt:
+#endif
 
-  if (k < 1)  return (-1);
-  if (*q == '-') {
-    ++q;  --k;
-    if (k < 1)  return (-1);
-  }
-  for (dpcnt = i = 0; k; --k, ++q) {
-    if ((c = *q) >= '0' && c <= '9') {
-      ++i;
-      continue;
-    }
+  return (num->type == HP_NUM_TYPE_INT ? (obj_float_val_t) num->u.intval : num->u.floatval);
+}
 
-    if (c == '.') {
-      if (i < 1 || ++dpcnt > 1)  return (-1);
-      i = 0;
-      continue;
-    }
+static int
+obj_float_parse(struct ovm *vm, struct obj **pp, unsigned n, char *p)
+{
+  struct hp_num num[1];
 
-    if ((c | 0x20) == 'e')  break;
+  trim(&n, &p);
+  if (hp_num_parse(num, n, p) < 0)  return (-1);
 
-    return (-1);
-  }
+  obj_float_newc(vm, pp, obj_float_num_val(num, n, p));
 
-  if (dpcnt != 0 && i == 0)  return (-1);
+  return (vm->errno != OBJ_ERRNO_NONE ? -1 : 0);
+}
 
-  if (k > 0) {
-    ++q;  --k;
+/* Integer or float, classified in one scan */
 
-    if (k < 1)  return (-1);
-    if (*q == '-') {
-      ++q;  --k;
-      if (k < 1)  return (-1);
-    }
-    for ( ; k; --k, ++q) {
-      if (!((c = *q) >= '0' && c <= '9'))  return (-1);
-    }
-  }
+static int
+obj_num_parse(struct ovm *vm, struct obj **pp, unsigned n, char *p)
+{
+  struct hp_num num[1];
 
-  memcpy(buf, p, n);
-  buf[n] = 0;
-  if (sscanf(buf, "%Lg", &val) != 1)  return (-1);
+  if (hp_num_parse(num, n, p) < 0)  return (-1);
 
-  obj_float_newc(vm, pp, val);
+  if (num->type == HP_NUM_TYPE_INT) {
+    obj_integer_newc(vm, pp, num->u.intval);
+  } else {
+    obj_float_newc(vm, pp, obj_float_num_val(num, n, p));
+  }
 
   return (vm->errno != OBJ_ERRNO_NONE ? -1 : 0);
 }
@@ -1029,7 +1185,7 @@ obj_float_parse(struct ovm *vm, struct obj **pp, unsigned n, char *p)
 static char *
 obj_float_tostring_fmt(struct ovm *vm)
 {
-  static const char s[] = "tostring-format", dflt[] = "%Lg";
+  static const char s[] = "tostring-format", dflt[] = OVM_FMT_FLOAT;
 
   char *result = (char *) dflt;
   struct obj **fp, *p, *q;
@@ -1088,38 +1244,14 @@ obj_float_new(struct ovm *vm, struct obj **pp, va_list ap)
   obj_float_newc(vm, pp, val);
 }
 
-METHOD_1(obj_float_abs, obj_float_newc, abs(FLOATVAL(*pp)));
+METHOD_1(obj_float_abs, obj_float_newc, OVM_FLOAT_ABS(FLOATVAL(*pp)));
 
 METHOD_2(obj_float_add, OBJ_TYPE_FLOAT, obj_float_newc, floatval, +);
 
 METHOD_2(obj_float_div, OBJ_TYPE_FLOAT, obj_float_newc, floatval, /);
 
-static void
-obj_float_eq(struct ovm *vm, struct obj **pp, va_list ap)
-{
-  struct obj *q = *_ovm_reg(vm, va_arg(ap, unsigned));
-
-  obj_bool_newc(vm, pp, obj_type(q) == OBJ_TYPE_FLOAT && FLOATVAL(*pp) == FLOATVAL(q));
-}
-
 METHOD_2(obj_float_gt, OBJ_TYPE_FLOAT, obj_bool_newc, floatval, >);
 
-static void
-obj_float_hash(struct ovm *vm, struct obj **pp, va_list ap)
-{
-  struct obj *p = *pp;
-  unsigned   r[1];
-
-  crc_init(r);
-  obj_integer_newc(vm,
-		   pp,
-		   (obj_integer_val_t) crc32(r,
-					     sizeof(FLOATVAL(p)),
-					     (unsigned char *) &FLOATVAL(p)
-					     )
-		   );
-}
-
 METHOD_2(obj_float_lt, OBJ_TYPE_FLOAT, obj_bool_newc, floatval, <);
 
 METHOD_1(obj_float_minus, obj_float_newc, -FLOATVAL(*pp));
@@ -1167,6 +1299,7 @@ obj_string_newc(struct ovm *vm, struct obj **pp, unsigned n, ...)
 
     return;
   }
+  OVM_STATS_PAYLOAD(vm, size);
 
   STR_DATA(*pp) = p;
 
@@ -1206,6 +1339,7 @@ obj_string_newv(struct ovm *vm, struct obj **pp, struct obj *a)
 
     return;
   }
+  OVM_STATS_PAYLOAD(vm, size);
 
   STR_DATA(*pp) = p;
 
@@ -1292,44 +1426,69 @@ obj_string_copy(struct ovm *vm, struct obj **pp, struct obj *s)
 }
 
 static void
-obj_string_eq(struct ovm *vm, struct obj **pp, va_list ap)
+obj_string_count(struct ovm *vm, struct obj **pp, va_list ap)
 {
-  struct obj *q = *_ovm_reg(vm, va_arg(ap, unsigned));
+  struct obj *p = *pp, *q = *_ovm_reg(vm, va_arg(ap, unsigned));
+  char       *r, *e;
+  unsigned   m, n;
+
+  if (obj_type(q) != OBJ_TYPE_STRING) {
+    ovm_error(vm, OBJ_ERRNO_BAD_TYPE);
+    return;
+  }
+  if ((m = STR_SIZE(q) - 1) == 0) {
+    ovm_error(vm, OBJ_ERRNO_BAD_VALUE);
+    return;
+  }
+
+  /* Occurrences do not overlap */
+
+  for (n = 0, r = STR_DATA(p), e = r + STR_SIZE(p) - 1; r = mem_find(r, e - r, STR_DATA(q), m); r += m) {
+    ++n;
+  }
 
-  obj_bool_newc(vm,
-		pp,
-		obj_type(q) == OBJ_TYPE_STRING && strcmp(STR_DATA(*pp), STR_DATA(q)) == 0
-		);
+  obj_integer_newc(vm, pp, n);
 }
 
+/* Offset of first occurrence of substring, or nil if none */
+
 static void
-obj_string_gt(struct ovm *vm, struct obj **pp, va_list ap)
+obj_string_find(struct ovm *vm, struct obj **pp, va_list ap)
 {
-  struct obj *q = *_ovm_reg(vm, va_arg(ap, unsigned));
+  struct obj *p = *pp, *q = *_ovm_reg(vm, va_arg(ap, unsigned));
+  char       *r;
 
   if (obj_type(q) != OBJ_TYPE_STRING) {
     ovm_error(vm, OBJ_ERRNO_BAD_TYPE);
     return;
   }
-  
-  obj_bool_newc(vm, pp, strcmp(STR_DATA(*pp), STR_DATA(q)) > 0);
+
+  if (r = mem_find(STR_DATA(p), STR_SIZE(p) - 1, STR_DATA(q), STR_SIZE(q) - 1)) {
+    obj_integer_newc(vm, pp, r - STR_DATA(p));
+  } else {
+    obj_nil_newc(vm, pp);
+  }
 }
 
 static void
-obj_string_hash(struct ovm *vm, struct obj **pp, va_list ap)
+obj_string_gt(struct ovm *vm, struct obj **pp, va_list ap)
 {
-  struct obj *p = *pp;
-  unsigned r[1];
+  struct obj *q = *_ovm_reg(vm, va_arg(ap, unsigned));
 
-  crc_init(r);
-  obj_integer_newc(vm, pp, crc32(r, STR_SIZE(p) - 1, (unsigned char *) STR_DATA(p)));
+  if (obj_type(q) != OBJ_TYPE_STRING) {
+    ovm_error(vm, OBJ_ERRNO_BAD_TYPE);
+    return;
+  }
+  
+  obj_bool_newc(vm, pp, strcmp(STR_DATA(*pp), STR_DATA(q)) > 0);
 }
 
 static void
 obj_string_join(struct ovm *vm, struct obj **pp, va_list ap)
 {
-  struct obj *p = *pp, *q = *_ovm_reg(vm, va_arg(ap, unsigned)), **fp, **rr;
-  unsigned i, n;
+  struct obj       *p = *pp, *q = *_ovm_reg(vm, va_arg(ap, unsigned)), **fp, **rr;
+  struct list_iter it[1];
+  unsigned         i, n;
 
   if (!is_list(q)) {
     ovm_error(vm, OBJ_ERRNO_BAD_TYPE);
@@ -1340,12 +1499,12 @@ obj_string_join(struct ovm *vm, struct obj **pp, va_list ap)
 
   n = list_len(q);
   obj_array_newc(vm, &fp[-1], n <= 1 ? n : 2 * n - 1);
-  for (i = 0, rr = ARRAY_DATA(fp[-1]); q; q = CDR(q), ++i) {
+  for (i = 0, rr = ARRAY_DATA(fp[-1]), list_iter_init(it, q); it->li; list_iter_next(it), ++i) {
     if (i > 0) {
       obj_assign(vm, rr, p);
       ++rr;
     }
-    obj_tostring(vm, rr, CAR(q));
+    obj_tostring(vm, rr, list_iter_car(it));
     ++rr;
   }
 
@@ -1422,20 +1581,26 @@ obj_string_split(struct ovm *vm, struct obj **pp, va_list ap)
   struct obj *p = *pp;
   struct obj *q = *_ovm_reg(vm, va_arg(ap, unsigned));
   struct obj **fp, **qq;
-  char *r, *s;
+  char       *r, *s, *e;
+  unsigned   m;
 
   if (obj_type(q) != OBJ_TYPE_STRING) {
     ovm_error(vm, OBJ_ERRNO_BAD_TYPE);
     return;
   }
+  if ((m = STR_SIZE(q) - 1) == 0) {
+    ovm_error(vm, OBJ_ERRNO_BAD_VALUE);
+    return;
+  }
 
   fp = ovm_falloc(vm, 2);
 
-  for (qq = &fp[-1], r = STR_DATA(p); ; r = s + STR_SIZE(q) - 1) {
-    s = strstr(r, STR_DATA(q));
+  for (qq = &fp[-1], r = STR_DATA(p), e = r + STR_SIZE(p) - 1; ; r = s + m) {
+    s = mem_find(r, e - r, STR_DATA(q), m);
 
-    obj_string_newc(vm, &fp[-2], 1, s ? s - r : strlen(r), r);
+    obj_string_newc(vm, &fp[-2], 1, (s ? s : e) - r, r);
     obj_list_newc(vm, qq, fp[-2], 0);
+    if (vm->errno != OBJ_ERRNO_NONE)  break;
     qq = &CDR(*qq);
 
     if (s == 0)  break;
@@ -1570,141 +1735,108 @@ obj_pair_new(struct ovm *vm, struct obj **pp, va_list ap)
 }
 
 static void
-obj_pair_eq(struct ovm *vm, struct obj **pp, va_list ap)
+obj_pair_reverse(struct ovm *vm, struct obj **pp, va_list ap)
 {
-  struct obj *p = *pp;
-  struct obj *q = *_ovm_reg(vm, va_arg(ap, unsigned));
-  struct obj **fp;
+  struct obj *p = *pp, **fp;
 
   fp = ovm_falloc(vm, 1);
 
-  obj_bool_newc(vm, &fp[-1], 0);
-  if (vm->errno != OBJ_ERRNO_NONE)  goto done1;
-
-  if (obj_type(q) == OBJ_TYPE_PAIR) {
-    ovm_pushm(vm, 1, 2);
-
-    obj_assign(vm, &R(1), CAR(p));
-    obj_assign(vm, &R(2), CAR(q));
-    ovm_call(vm, 1, OBJ_OP_EQ, 2);
-    if (vm->errno != OBJ_ERRNO_NONE)  goto done2;
-    if (BOOLVAL(R(1))) {
-      obj_assign(vm, &R(1), CDR(p));
-      obj_assign(vm, &R(2), CDR(q));
-      ovm_call(vm, 1, OBJ_OP_EQ, 2);
-      if (vm->errno != OBJ_ERRNO_NONE)  goto done2;
-      if (BOOLVAL(R(1))) {
-	BOOLVAL(fp[-1]) = 1;
-      }
-    }
-    
-  done2:
-    ovm_popm(vm, 1, 2);
-  }
+  obj_pair_newc(vm, &fp[-1], CDR(p), CAR(p));
 
- done1:
-  if (vm->errno == OBJ_ERRNO_NONE)  obj_assign(vm, pp, fp[-1]);
+  obj_assign(vm, pp, fp[-1]);
 
   ovm_ffree(vm, fp);
 }
 
-static void
-obj_pair_hash(struct ovm *vm, struct obj **pp, va_list ap)
-{
-  struct obj *p = *pp;
-  struct obj **fp;
-
-  fp = ovm_falloc(vm, 1);
-
-  obj_integer_newc(vm, &fp[-1], 0);
-  if (vm->errno != OBJ_ERRNO_NONE)  goto done1;
+/***************************************************************************/
 
-  ovm_push(vm, 1);
+static unsigned
+list_len(struct obj *p)
+{
+  unsigned result;
 
-  obj_assign(vm, &R(1), CAR(p));
-  ovm_call(vm, 1, OBJ_OP_HASH);
-  if (vm->errno != OBJ_ERRNO_NONE)  goto done2;
-  INTVAL(fp[-1]) += INTVAL(R(1));
-  obj_assign(vm, &R(1), CDR(p));
-  ovm_call(vm, 1, OBJ_OP_HASH);
-  if (vm->errno != OBJ_ERRNO_NONE)  goto done2;
-  INTVAL(fp[-1]) += INTVAL(R(1));
+  for (result = 0; p; p = CDR(p)) {
+    if (obj_type(p) == OBJ_TYPE_VLIST)  return (result + VLIST_SIZE(p));
 
- done2:
-  ovm_pop(vm, 1);
+    ++result;
+  }
 
-  if (vm->errno == OBJ_ERRNO_NONE)  obj_assign(vm, pp, fp[-1]);
+  return (result);
+}
 
- done1:
-  ovm_ffree(vm, fp);
+static void
+obj_list_newc(struct ovm *vm, struct obj **pp, struct obj *car, struct obj *cdr)
+{
+  obj_dptr_newc(vm, pp, OBJ_TYPE_LIST, car, cdr);
 }
 
 static void
-obj_pair_reverse(struct ovm *vm, struct obj **pp, va_list ap)
+obj_vlist_newc(struct ovm *vm, struct obj **pp, struct obj *arr, unsigned ofs, unsigned size)
 {
-  struct obj *p = *pp, **fp;
+  struct obj **fp;
+
+  if (size == 0) {
+    obj_nil_newc(vm, pp);
+    return;
+  }
+
+  /* Built in frame, since arr may be reachable only through *pp */
 
   fp = ovm_falloc(vm, 1);
 
-  obj_pair_newc(vm, &fp[-1], CDR(p), CAR(p));
+  obj_alloc(vm, &fp[-1], OBJ_TYPE_VLIST);
+  if (vm->errno != OBJ_ERRNO_NONE)  goto done;
+
+  obj_assign(vm, &VLIST_ARR(fp[-1]), arr);
+  VLIST_OFS(fp[-1])  = ofs;
+  VLIST_SIZE(fp[-1]) = size;
 
   obj_assign(vm, pp, fp[-1]);
 
+ done:
   ovm_ffree(vm, fp);
 }
 
-/***************************************************************************/
-
-static unsigned
-list_len(struct obj *p)
+static void
+obj_vlist_copy(struct ovm *vm, struct obj **pp, struct obj *li)
 {
-  unsigned result;
+  struct list_iter it[1];
+  struct obj       **fp, **qq;
+  unsigned         n;
 
-  for (result = 0; p; p = CDR(p))  ++result;
+  fp = ovm_falloc(vm, 1);
 
-  return (result);
-}
+  obj_array_newc(vm, &fp[-1], n = list_len(li));
+  if (vm->errno != OBJ_ERRNO_NONE)  goto done;
+  for (qq = ARRAY_DATA(fp[-1]), list_iter_init(it, li); it->li; list_iter_next(it), ++qq) {
+    obj_assign(vm, qq, list_iter_car(it));
+  }
 
-static void
-obj_list_newc(struct ovm *vm, struct obj **pp, struct obj *car, struct obj *cdr)
-{
-  obj_dptr_newc(vm, pp, OBJ_TYPE_LIST, car, cdr);
+  obj_vlist_newc(vm, pp, fp[-1], 0, n);
+
+ done:
+  ovm_ffree(vm, fp);
 }
 
 static int
 obj_list_parse(struct ovm *vm, struct obj **pp, unsigned n, char *p)
 {
   int        result = -1;
-  struct obj **fp, **qq;
-  char       *st;
-  unsigned   f;
+  struct obj **fp;
   
   trim(&n, &p);
 
   if (!(n >= 2 && p[0] == '(' &&  p[n - 1] == ')'))  return (-1);
   ++p;
   n -= 2;
-  trim(&n, &p);
-
-  fp = ovm_falloc(vm, 2);
 
-  for (qq = &fp[-1]; n > 0; ) {
-    st = p;
-    f = delim_find(&n, &p, ',');
-    if (obj_str_parse(vm, &fp[-2], f ? p - st : n, st) < 0)  goto done;
+  fp = ovm_falloc(vm, 1);
 
-    obj_list_newc(vm, qq, fp[-2], 0);
-    if (vm->errno != OBJ_ERRNO_NONE)  goto done;
+  if (obj_seq_parse(vm, &fp[-1], n, p) < 0)  goto done;
 
-    qq = &CDR(*qq);
-    
-    if (!f)  break;
-    
-    ++p;
-    --n;
-  }
+  obj_vlist_newc(vm, pp, fp[-1], 0, ARRAY_SIZE(fp[-1]));
+  if (vm->errno != OBJ_ERRNO_NONE)  goto done;
 
-  obj_assign(vm, pp, fp[-1]);
   result = 0;
 
  done:
@@ -1716,8 +1848,9 @@ obj_list_parse(struct ovm *vm, struct obj **pp, unsigned n, char *p)
 static void
 obj_list_tostring(struct ovm *vm, struct obj **pp, struct obj *q)
 {
-  struct obj **fp, **qq;
-  unsigned   n, i;
+  struct list_iter it[1];
+  struct obj       **fp, **qq;
+  unsigned         n, i;
   
   fp = ovm_falloc(vm, 1);
 
@@ -1733,13 +1866,13 @@ obj_list_tostring(struct ovm *vm, struct obj **pp, struct obj *q)
   obj_string_newc(vm, qq, 1, 1, "(");
   if (vm->errno != OBJ_ERRNO_NONE)  goto done;
   ++qq;
-  for (i = 0; q; ++i, q = CDR(q)) {
+  for (i = 0, list_iter_init(it, q); it->li; ++i, list_iter_next(it)) {
     if (i > 0) {
       obj_string_newc(vm, qq, 1, 2, ", ");
       if (vm->errno != OBJ_ERRNO_NONE)  goto done;
       ++qq;
     }
-    obj_tostring(vm, qq, CAR(q));
+    obj_tostring(vm, qq, list_iter_car(it));
     if (vm->errno != OBJ_ERRNO_NONE)  goto done;
     ++qq;
   }
@@ -1768,26 +1901,42 @@ obj_list_new(struct ovm *vm, struct obj **pp, va_list ap)
 
     case OBJ_TYPE_ARRAY:
       {
-	struct obj **fp, **qq, **rr;
-	char *r;
-	unsigned n;
+	struct obj **fp;
 
 	fp = ovm_falloc(vm, 1);
 
-	for (qq = &fp[-1], rr = ARRAY_DATA(q), n = ARRAY_SIZE(q); n; --n, ++rr) {
-	  obj_list_newc(vm, qq, *rr, 0);
-	  qq = &CDR(*qq);
+	obj_array_copy(vm, &fp[-1], q);
+	if (vm->errno == OBJ_ERRNO_NONE) {
+	  obj_vlist_newc(vm, pp, fp[-1], 0, ARRAY_SIZE(fp[-1]));
 	}
 
-	obj_assign(vm, pp, fp[-1]);
+	ovm_ffree(vm, fp);
+      }
+      return;
+
+    case OBJ_TYPE_ITERATOR:
+      {
+	struct obj **fp;
+
+	fp = ovm_falloc(vm, 1);
+
+	obj_iter_drain(vm, &fp[-1], q);
+	if (vm->errno == OBJ_ERRNO_NONE) {
+	  obj_vlist_newc(vm, pp, fp[-1], 0, ARRAY_SIZE(fp[-1]));
+	}
 
 	ovm_ffree(vm, fp);
       }
       return;
 
     case OBJ_TYPE_DICT:
+      break;
+
     default:
-      ;
+      if (is_list(q)) {
+	obj_vlist_copy(vm, pp, q);
+	return;
+      }
     }
 
     ovm_error(vm, OBJ_ERRNO_BAD_TYPE);
@@ -1815,8 +1964,10 @@ obj_list_new(struct ovm *vm, struct obj **pp, va_list ap)
 static void
 obj_list_append(struct ovm *vm, struct obj **pp, va_list ap)
 {
-  struct obj *p = *pp, *q = *_ovm_reg(vm, va_arg(ap, unsigned)), **qq;
-  struct obj **fp;
+  struct obj       *p = *pp, *q = *_ovm_reg(vm, va_arg(ap, unsigned)), **qq;
+  struct obj       **fp;
+  struct list_iter it[1];
+  unsigned         n;
 
   if (!is_list(q)) {
     ovm_error(vm, OBJ_ERRNO_BAD_TYPE);
@@ -1825,14 +1976,17 @@ obj_list_append(struct ovm *vm, struct obj **pp, va_list ap)
 
   fp = ovm_falloc(vm, 1);
   
-  for (qq = &fp[-1]; p; p = CDR(p)) {
-    obj_list_newc(vm, qq, CAR(p), 0);
-    if (vm->errno != OBJ_ERRNO_NONE)  goto done;
-    qq = &CDR(*qq);
+  obj_array_newc(vm, &fp[-1], n = list_len(p) + list_len(q));
+  if (vm->errno != OBJ_ERRNO_NONE)  goto done;
+  qq = ARRAY_DATA(fp[-1]);
+  for (list_iter_init(it, p); it->li; list_iter_next(it), ++qq) {
+    obj_assign(vm, qq, list_iter_car(it));
+  }
+  for (list_iter_init(it, q); it->li; list_iter_next(it), ++qq) {
+    obj_assign(vm, qq, list_iter_car(it));
   }
-  obj_assign(vm, qq, q);
 
-  obj_assign(vm, pp, fp[-1]);
+  obj_vlist_newc(vm, pp, fp[-1], 0, n);
 
  done:  
   ovm_ffree(vm, fp);
@@ -1841,8 +1995,9 @@ obj_list_append(struct ovm *vm, struct obj **pp, va_list ap)
 static void
 obj_list_at(struct ovm *vm, struct obj **pp, va_list ap)
 {
-  struct obj *p = *pp, *q = *_ovm_reg(vm, va_arg(ap, unsigned));
-  int        i, n;
+  struct obj       *p = *pp, *q = *_ovm_reg(vm, va_arg(ap, unsigned));
+  struct list_iter it[1];
+  int              i, n;
 
   if (obj_type(q) != OBJ_TYPE_INTEGER) {
     ovm_error(vm, OBJ_ERRNO_BAD_TYPE);
@@ -1857,117 +2012,73 @@ obj_list_at(struct ovm *vm, struct obj **pp, va_list ap)
     return;
   }
 
-  for ( ; i; --i, p = CDR(p));
-  obj_assign(vm, pp, CAR(p));
-}
-
-static void
-obj_list_eq(struct ovm *vm, struct obj **pp, va_list ap)
-{
-  struct obj *p = *pp, *q = *_ovm_reg(vm, va_arg(ap, unsigned));
-  struct obj **fp;
-
-  fp = ovm_falloc(vm, 1);
-
-  obj_bool_newc(vm, &fp[-1], 0);
-  if (vm->errno != OBJ_ERRNO_NONE)  goto done1;
-
-  if (obj_type(q) == OBJ_TYPE_LIST) {
-    ovm_pushm(vm, 1, 2);
-
-    for ( ; p && q; p = CDR(p), q = CDR(q)) {
-      obj_assign(vm, &R(1), CAR(p));
-      obj_assign(vm, &R(2), CAR(q));
-      ovm_call(vm, 1, OBJ_OP_EQ, 2);
-      if (vm->errno != OBJ_ERRNO_NONE)  goto done2;
-      if (!BOOLVAL(R(1)))  break;
-    }
-    if (p == 0 && q == 0)  BOOLVAL(fp[-1]) = 1;
-
-  done2:
-    ovm_popm(vm, 1, 2);
-  }
-
- done1:
-  if (vm->errno == OBJ_ERRNO_NONE)  obj_assign(vm, pp, fp[-1]);
-
-  ovm_ffree(vm, fp);
+  list_iter_init(it, p);
+  list_iter_skip(it, i);
+  obj_assign(vm, pp, list_iter_car(it));
 }
 
 static void
 obj_list_filter(struct ovm *vm, struct obj **pp, va_list ap)
 {
-  struct obj *p = *pp;
-  struct obj *q = *_ovm_reg(vm, va_arg(ap, unsigned)), **qq, *r;
-  
-  struct obj **fp;
+  struct obj       *q = *_ovm_reg(vm, va_arg(ap, unsigned)), **qq, *r;
+  struct obj       **fp;
+  struct list_iter it1[1], it2[1];
+  unsigned         n;
 
   if (!is_list(q)) {
     ovm_error(vm, OBJ_ERRNO_BAD_TYPE);
     return;
   }
 
-  fp = ovm_falloc(vm, 1);
-
-  for (qq = &fp[-1]; p && q; p = CDR(p), q = CDR(q)) {
-    r = CAR(q);
-    if (obj_type(r) != OBJ_TYPE_BOOLEAN) {
+  for (n = 0, list_iter_init(it1, *pp), list_iter_init(it2, q);
+       it1->li && it2->li;
+       list_iter_next(it1), list_iter_next(it2)
+       ) {
+    if (obj_type(r = list_iter_car(it2)) != OBJ_TYPE_BOOLEAN) {
       ovm_error(vm, OBJ_ERRNO_BAD_VALUE);
-      goto done;
-    }
-    if (BOOLVAL(r)) {
-      obj_list_newc(vm, qq, CAR(p), 0);
-      qq = &CDR(*qq);
+      return;
     }
+    if (BOOLVAL(r))  ++n;
   }
 
-  obj_assign(vm, pp, fp[-1]);
-
- done:
-  ovm_ffree(vm, fp);
-}
-
-static void
-obj_list_hash(struct ovm *vm, struct obj **pp, va_list ap)
-{
-  struct obj *p = *pp, **qq;
-  struct obj **fp;
-
   fp = ovm_falloc(vm, 1);
 
-  obj_integer_newc(vm, &fp[-1], 0);
-  if (vm->errno != OBJ_ERRNO_NONE)  goto done1;
-
-  ovm_push(vm, 1);
-  for ( ; p; p = CDR(p)) {
-    obj_assign(vm, &R(1), CAR(p));
-    ovm_call(vm, 1, OBJ_OP_HASH);
-    if (vm->errno != OBJ_ERRNO_NONE)  goto done2;
-    INTVAL(fp[-1]) += INTVAL(R(1));
+  obj_array_newc(vm, &fp[-1], n);
+  if (vm->errno != OBJ_ERRNO_NONE)  goto done;
+  for (qq = ARRAY_DATA(fp[-1]), list_iter_init(it1, *pp), list_iter_init(it2, q);
+       it1->li && it2->li;
+       list_iter_next(it1), list_iter_next(it2)
+       ) {
+    if (BOOLVAL(list_iter_car(it2))) {
+      obj_assign(vm, qq, list_iter_car(it1));
+      ++qq;
+    }
   }
- done2:
-  ovm_pop(vm, 1);
 
- done1:
-  if (vm->errno == OBJ_ERRNO_NONE)  obj_assign(vm, pp, fp[-1]);
+  obj_vlist_newc(vm, pp, fp[-1], 0, n);
 
+ done:
   ovm_ffree(vm, fp);
 }
 
 static void
 obj_list_reverse(struct ovm *vm, struct obj **pp, va_list ap)
 {
-  struct obj **fp, *p;
+  struct obj       **fp, **qq;
+  struct list_iter it[1];
+  unsigned         n;
 
-  fp = ovm_falloc(vm, 2);
+  fp = ovm_falloc(vm, 1);
 
-  for (p = *pp; p; p = CDR(p)) {
-    obj_list_newc(vm, &fp[-2], CAR(p), fp[-1]);
-    obj_assign(vm, &fp[-1], fp[-2]);
+  obj_array_newc(vm, &fp[-1], n = list_len(*pp));
+  if (vm->errno != OBJ_ERRNO_NONE)  goto done;
+  for (qq = ARRAY_DATA(fp[-1]) + n - 1, list_iter_init(it, *pp); it->li; list_iter_next(it), --qq) {
+    obj_assign(vm, qq, list_iter_car(it));
   }
 
-  obj_assign(vm, pp, fp[-1]);
+  obj_vlist_newc(vm, pp, fp[-1], 0, n);
 
+ done:
   ovm_ffree(vm, fp);
 }
 
@@ -1980,11 +2091,13 @@ obj_list_size(struct ovm *vm, struct obj **pp, va_list ap)
 static void
 obj_list_slice(struct ovm *vm, struct obj **pp, va_list ap)
 {
-  struct obj *p = *pp;
-  struct obj *q = *_ovm_reg(vm, va_arg(ap, unsigned));
-  struct obj *r = *_ovm_reg(vm, va_arg(ap, unsigned));
-  int        i, n;
-  struct obj **fp, **qq;
+  struct obj       *p = *pp;
+  struct obj       *q = *_ovm_reg(vm, va_arg(ap, unsigned));
+  struct obj       *r = *_ovm_reg(vm, va_arg(ap, unsigned));
+  struct list_iter it[1];
+  int              i, n;
+  unsigned         k;
+  struct obj       **fp, **qq;
 
   if (obj_type(q) != OBJ_TYPE_INTEGER || obj_type(r) != OBJ_TYPE_INTEGER) {
     ovm_error(vm, OBJ_ERRNO_BAD_TYPE);
@@ -1995,16 +2108,26 @@ obj_list_slice(struct ovm *vm, struct obj **pp, va_list ap)
   n = INTVAL(r);
   slice_idxs((int) list_len(p), &i, &n);
 
+  list_iter_init(it, p);
+  list_iter_skip(it, i);
+
+  if (obj_type(it->li) == OBJ_TYPE_VLIST) {
+    /* Slice lies entirely within vector part => share storage */
+
+    obj_vlist_newc(vm, pp, VLIST_ARR(it->li), VLIST_OFS(it->li) + it->idx, n);
+
+    return;
+  }
+
   fp = ovm_falloc(vm, 1);
 
-  for ( ; i; --i)  p = CDR(p);
-  for (qq = &fp[-1]; n; --n) {
-    obj_list_newc(vm, qq, CAR(p), 0);
-    if (vm->errno != OBJ_ERRNO_NONE)  goto done;
-    qq = &CDR(*qq);
+  obj_array_newc(vm, &fp[-1], n);
+  if (vm->errno != OBJ_ERRNO_NONE)  goto done;
+  for (qq = ARRAY_DATA(fp[-1]), k = n; k; --k, ++qq, list_iter_next(it)) {
+    obj_assign(vm, qq, list_iter_car(it));
   }
 
-  obj_assign(vm, pp, fp[-1]);
+  obj_vlist_newc(vm, pp, fp[-1], 0, n);
 
  done:
   ovm_ffree(vm, fp);
@@ -2012,6 +2135,50 @@ obj_list_slice(struct ovm *vm, struct obj **pp, va_list ap)
 
 /***************************************************************************/
 
+static void
+obj_vlist_car(struct ovm *vm, struct obj **pp, va_list ap)
+{
+  obj_assign(vm, pp, VLIST_DATA(*pp)[0]);
+}
+
+static void
+obj_vlist_cdr(struct ovm *vm, struct obj **pp, va_list ap)
+{
+  struct obj *p = *pp;
+
+  obj_vlist_newc(vm, pp, VLIST_ARR(p), VLIST_OFS(p) + 1, VLIST_SIZE(p) - 1);
+}
+
+static void
+obj_vlist_at(struct ovm *vm, struct obj **pp, va_list ap)
+{
+  struct obj *p = *pp, *q = *_ovm_reg(vm, va_arg(ap, unsigned));
+  int        i, n;
+
+  if (obj_type(q) != OBJ_TYPE_INTEGER) {
+    ovm_error(vm, OBJ_ERRNO_BAD_TYPE);
+    return;
+  }
+
+  i = INTVAL(q);
+  n = 1;
+  slice_idxs((int) VLIST_SIZE(p), &i, &n);
+  if (n != 1) {
+    ovm_error(vm, OBJ_ERRNO_RANGE);
+    return;
+  }
+
+  obj_assign(vm, pp, VLIST_DATA(p)[i]);
+}
+
+static void
+obj_vlist_size(struct ovm *vm, struct obj **pp, va_list ap)
+{
+  obj_integer_newc(vm, pp, VLIST_SIZE(*pp));
+}
+
+/***************************************************************************/
+
 static void
 _obj_array_newc(struct ovm *vm, struct obj **pp, unsigned type, unsigned size)
 {
@@ -2021,6 +2188,7 @@ _obj_array_newc(struct ovm *vm, struct obj **pp, unsigned type, unsigned size)
 
   ARRAY_SIZE(*pp) = size;
   ARRAY_DATA(*pp) = size ? calloc(size, sizeof(ARRAY_DATA(*pp)[0])) : 0;
+  OVM_STATS_PAYLOAD(vm, size * sizeof(ARRAY_DATA(*pp)[0]));
 }
 
 static void
@@ -2030,7 +2198,7 @@ obj_array_newc(struct ovm *vm, struct obj **pp, unsigned size)
 }
 
 static int
-obj_array_parse(struct ovm *vm, struct obj **pp, unsigned n, char *p)
+obj_seq_parse(struct ovm *vm, struct obj **pp, unsigned n, char *p)
 {
   int        result = -1;
   struct obj **fp;
@@ -2040,11 +2208,6 @@ obj_array_parse(struct ovm *vm, struct obj **pp, unsigned n, char *p)
 
   trim(&n, &p);
   
-  if (!(n >= 2 && p[0] == '[' && p[n - 1] == ']'))  return (-1);
-  ++p;
-  n -= 2;
-  trim(&n, &p);
-  
   if (n == 0) {
     sz = 0;
   } else {
@@ -2078,6 +2241,16 @@ obj_array_parse(struct ovm *vm, struct obj **pp, unsigned n, char *p)
   return (result);
 }
 
+static int
+obj_array_parse(struct ovm *vm, struct obj **pp, unsigned n, char *p)
+{
+  trim(&n, &p);
+  
+  if (!(n >= 2 && p[0] == '[' && p[n - 1] == ']'))  return (-1);
+
+  return (obj_seq_parse(vm, pp, n - 2, p + 1));
+}
+
 static void
 obj_array_tostring(struct ovm *vm, struct obj **pp, struct obj *q)
 {
@@ -2150,6 +2323,12 @@ obj_array_new(struct ovm *vm, struct obj **pp, va_list ap)
   case OBJ_TYPE_ARRAY:
     obj_array_copy(vm, pp, q);
     return;
+  case OBJ_TYPE_ITERATOR:
+    obj_iter_drain(vm, pp, q);
+    return;
+  case OBJ_TYPE_SET:
+    obj_set_members(vm, pp, q);
+    return;
   case OBJ_TYPE_DICT:
     {
       unsigned   n;
@@ -2172,15 +2351,15 @@ obj_array_new(struct ovm *vm, struct obj **pp, va_list ap)
     return;
   default:
     if (is_list(q)) {
-      unsigned   n;
-      struct obj **fp;
-      struct obj **qq;
+      struct obj       **fp;
+      struct obj       **qq;
+      struct list_iter it[1];
 
       fp = ovm_falloc(vm, 1);
       
-      obj_array_newc(vm, &fp[-1], n = list_len(q));
-      for (qq = ARRAY_DATA(fp[-1]); n; --n, ++qq, q = CDR(q)) {
-	obj_assign(vm, qq, CAR(q));
+      obj_array_newc(vm, &fp[-1], list_len(q));
+      for (qq = ARRAY_DATA(fp[-1]), list_iter_init(it, q); it->li; ++qq, list_iter_next(it)) {
+	obj_assign(vm, qq, list_iter_car(it));
       }
       
       obj_assign(vm, pp, fp[-1]);
@@ -2252,6 +2431,8 @@ obj_array_at_put(struct ovm *vm, struct obj **pp, va_list ap)
   struct obj *r = *_ovm_reg(vm, va_arg(ap, unsigned));
   int        i, n;
 
+  if (obj_frozen_chk(vm, p))  return;
+
   if (obj_type(q) != OBJ_TYPE_INTEGER) {
     ovm_error(vm, OBJ_ERRNO_BAD_TYPE);
     return;
@@ -2269,57 +2450,21 @@ obj_array_at_put(struct ovm *vm, struct obj **pp, va_list ap)
 }
 
 static void
-obj_array_eq(struct ovm *vm, struct obj **pp, va_list ap)
+obj_array_filter(struct ovm *vm, struct obj **pp, va_list ap)
 {
-  struct obj *p = *pp, *q = *_ovm_reg(vm, va_arg(ap, unsigned));
-  struct obj **qq, **rr, **fp;
-  unsigned n;
-
-  fp = ovm_falloc(vm, 1);
+  struct obj       *p = *pp;
+  struct obj       *q = *_ovm_reg(vm, va_arg(ap, unsigned)), **qq, **rr, *s;
+  struct obj       **fp;
+  struct list_iter it[1];
+  unsigned         n, k;
 
-  obj_bool_newc(vm, &fp[-1], 0);
+  if (!is_list(q)) {
+    ovm_error(vm, OBJ_ERRNO_BAD_TYPE);
+    return;
+  }
 
-  if (obj_type(q) != OBJ_TYPE_ARRAY
-      || (n = ARRAY_SIZE(p) != ARRAY_SIZE(q))
-      ) {
-    goto done1;
-  }
-
-  ovm_pushm(vm, 1, 2);
-
-  for (qq = ARRAY_DATA(p), rr = ARRAY_DATA(q); n; --n, ++qq, ++rr) {
-    obj_assign(vm, &R(1), *qq);
-    obj_assign(vm, &R(2), *rr);
-    ovm_call(vm, 1, OBJ_OP_EQ, 2);
-    if (vm->errno != OBJ_ERRNO_NONE)  goto done2;
-    if (!BOOLVAL(R(1)))  break;
-  }
-  if (n == 0)  BOOLVAL(fp[-1]) = 1;
-
- done2:
-  ovm_popm(vm, 1, 2);
-
- done1:
-  if (vm->errno == OBJ_ERRNO_NONE)  obj_assign(vm, pp, fp[-1]);
-
-  ovm_ffree(vm, fp);
-}
-
-static void
-obj_array_filter(struct ovm *vm, struct obj **pp, va_list ap)
-{
-  struct obj *p = *pp;
-  struct obj *q = *_ovm_reg(vm, va_arg(ap, unsigned)), **qq, **rr, *r, *s;
-  struct obj **fp;
-  unsigned n;
-
-  if (!is_list(q)) {
-    ovm_error(vm, OBJ_ERRNO_BAD_TYPE);
-    return;
-  }
-
-  for (n = 0, r = q; r; r = CDR(r)) {
-    if (obj_type(s = CAR(r)) != OBJ_TYPE_BOOLEAN) {
+  for (n = 0, k = ARRAY_SIZE(p), list_iter_init(it, q); k && it->li; --k, list_iter_next(it)) {
+    if (obj_type(s = list_iter_car(it)) != OBJ_TYPE_BOOLEAN) {
       ovm_error(vm, OBJ_ERRNO_BAD_TYPE);
       return;
     }
@@ -2328,11 +2473,10 @@ obj_array_filter(struct ovm *vm, struct obj **pp, va_list ap)
 
   fp = ovm_falloc(vm, 1);
 
-  if (n > ARRAY_SIZE(p))  n = ARRAY_SIZE(p);
   obj_array_newc(vm, &fp[-1], n);
 
-  for (qq = ARRAY_DATA(fp[-1]), rr = ARRAY_DATA(p); n; ++rr, q = CDR(q)) {
-    if (BOOLVAL(CAR(q))) {
+  for (qq = ARRAY_DATA(fp[-1]), rr = ARRAY_DATA(p), list_iter_init(it, q); n; ++rr, list_iter_next(it)) {
+    if (BOOLVAL(list_iter_car(it))) {
       obj_assign(vm, qq, *rr);
       ++qq;
       --n;
@@ -2505,6 +2649,8 @@ obj_array_sort_merge(struct ovm *vm, struct obj **pp)
 static void
 obj_array_sort(struct ovm *vm, struct obj **pp, va_list ap)
 {
+  if (obj_frozen_chk(vm, *pp))  return;
+
   obj_array_sort_merge(vm, pp);
 }
 
@@ -2514,26 +2660,23 @@ static void
 _obj_dict_find(struct ovm *vm, struct obj *dict, struct obj *key, struct obj ***pbucket, struct obj ***pprev)
 {
   struct obj **bucket, **rr, *r;
+  unsigned   h;
 
-  ovm_pushm(vm, 1, 2);
+  *pprev = 0;
 
-  obj_assign(vm, &R(1), key);
-  ovm_call(vm, 1, OBJ_OP_HASH);
-  bucket = &DICT_DATA(dict)[INTVAL(R(1)) % DICT_SIZE(dict)];
+  if (_obj_hash(key, &h) < 0) {
+    ovm_error(vm, OBJ_ERRNO_BAD_METHOD);
+    return;
+  }
+  bucket = &DICT_DATA(dict)[h % DICT_SIZE(dict)];
   if (pbucket)  *pbucket = bucket;
 
-  *pprev = 0;
   for (rr = bucket; r = *rr; rr = &CDR(r)) {
-    obj_assign(vm, &R(1), CAR(CAR(r)));
-    obj_assign(vm, &R(2), key);
-    ovm_call(vm, 1, OBJ_OP_EQ, 2);
-    if (BOOLVAL(R(1))) {
+    if (obj_equal(vm, CAR(CAR(r)), key) == 1) {
       *pprev = rr;
       break;
     }
   }
-
-  ovm_popm(vm, 1, 2);
 }
 
 static struct obj *
@@ -2551,8 +2694,25 @@ _obj_dict_at_put(struct ovm *vm, struct obj *dict, struct obj *key, struct obj *
   struct obj **bucket, **pp, **qq, *p, **fp;
 
   _obj_dict_find(vm, dict, key, &bucket, &pp);
+  if (vm->errno != OBJ_ERRNO_NONE)  return;
   if (pp) {
-    obj_assign(vm, &CDR(CAR(*pp)), val);
+    /* Update entry in place only if unshared, since pairs are otherwise
+       immutable, and may have memoized their hash
+    */
+
+    if ((p = CAR(*pp))->ref_cnt == 1) {
+      obj_assign(vm, &CDR(p), val);
+      obj_hash_memo(p)->valid = 0;
+
+      return;
+    }
+
+    fp = ovm_falloc(vm, 1);
+
+    obj_pair_newc(vm, &fp[-1], CAR(p), val);
+    if (vm->errno == OBJ_ERRNO_NONE)  obj_assign(vm, &CAR(*pp), fp[-1]);
+
+    ovm_ffree(vm, fp);
 
     return;
   }
@@ -2714,7 +2874,7 @@ obj_dict_new(struct ovm *vm, struct obj **pp, va_list ap)
     obj_dict_newc(vm, pp, INTVAL(q));
     return;
   case OBJ_TYPE_ARRAY:
-    for (qq = ARRAY_DATA(q), n = ARRAY_SIZE(q); n; --n, ++q) {
+    for (qq = ARRAY_DATA(q), n = ARRAY_SIZE(q); n; --n, ++qq) {
       if (obj_type(*qq) != OBJ_TYPE_PAIR) {
 	ovm_error(vm, OBJ_ERRNO_BAD_VALUE);
 	return;
@@ -2724,7 +2884,7 @@ obj_dict_new(struct ovm *vm, struct obj **pp, va_list ap)
     fp = ovm_falloc(vm, 1);
 
     obj_dict_newc(vm, &fp[-1], 0);
-    for (qq = ARRAY_DATA(q), n = ARRAY_SIZE(q); n; --n, ++q) {
+    for (qq = ARRAY_DATA(q), n = ARRAY_SIZE(q); n; --n, ++qq) {
       r = *qq;
       _obj_dict_at_put(vm, fp[-1], CAR(r), CDR(r));
     }
@@ -2739,7 +2899,7 @@ obj_dict_new(struct ovm *vm, struct obj **pp, va_list ap)
     fp = ovm_falloc(vm, 1);
 
     obj_dict_newc(vm, &fp[-1], 0);
-    for (qq = ARRAY_DATA(q), n = ARRAY_SIZE(q); n; --n, ++q) {
+    for (qq = ARRAY_DATA(q), n = ARRAY_SIZE(q); n; --n, ++qq) {
       for (r = *qq; r; r = CDR(r)) {
 	s = CAR(r);
 	_obj_dict_at_put(vm, fp[-1], CAR(s), CDR(s));
@@ -2752,10 +2912,32 @@ obj_dict_new(struct ovm *vm, struct obj **pp, va_list ap)
 
     return;
 
+  case OBJ_TYPE_ITERATOR:
+  case OBJ_TYPE_PDICT:
+    fp = ovm_falloc(vm, 3);
+
+    obj_iter_newc(vm, &fp[-3], q);
+    obj_dict_newc(vm, &fp[-1], 0);
+    while (obj_iter_step(vm, fp[-3], &fp[-2])) {
+      if (obj_type(fp[-2]) != OBJ_TYPE_PAIR) {
+	ovm_error(vm, OBJ_ERRNO_BAD_VALUE);
+	break;
+      }
+      _obj_dict_at_put(vm, fp[-1], CAR(fp[-2]), CDR(fp[-2]));
+    }
+
+    if (vm->errno == OBJ_ERRNO_NONE)  obj_assign(vm, pp, fp[-1]);
+
+    ovm_ffree(vm, fp);
+
+    return;
+
   default:
     if (is_list(q)) {
-      for (qq = ARRAY_DATA(q), n = ARRAY_SIZE(q); n; --n, ++q) {
-	if (obj_type(*qq) != OBJ_TYPE_PAIR) {
+      struct list_iter it[1];
+
+      for (list_iter_init(it, q); it->li; list_iter_next(it)) {
+	if (obj_type(list_iter_car(it)) != OBJ_TYPE_PAIR) {
 	  ovm_error(vm, OBJ_ERRNO_BAD_VALUE);
 	  return;
 	}
@@ -2764,8 +2946,8 @@ obj_dict_new(struct ovm *vm, struct obj **pp, va_list ap)
       fp = ovm_falloc(vm, 1);
       
       obj_dict_newc(vm, &fp[-1], 0);
-      for (qq = ARRAY_DATA(q), n = ARRAY_SIZE(q); n; --n, ++q) {
-	r = *qq;
+      for (list_iter_init(it, q); it->li; list_iter_next(it)) {
+	r = list_iter_car(it);
 	_obj_dict_at_put(vm, fp[-1], CAR(r), CDR(r));
       }
       
@@ -2787,6 +2969,8 @@ obj_dict_append(struct ovm *vm, struct obj **pp, va_list ap)
   struct obj **qq, *r;
   unsigned   n;
 
+  if (obj_frozen_chk(vm, p))  return;
+
   switch (obj_type(q)) {
   case OBJ_TYPE_DICT:
     for (qq = DICT_DATA(q), n = DICT_SIZE(q); n; --n, ++q) {
@@ -2813,6 +2997,8 @@ obj_dict_at_put(struct ovm *vm, struct obj **pp, va_list ap)
 {
   struct obj *q = *_ovm_reg(vm, va_arg(ap, unsigned));
   struct obj *r = *_ovm_reg(vm, va_arg(ap, unsigned));
+
+  if (obj_frozen_chk(vm, *pp))  return;
   
   _obj_dict_at_put(vm, *pp, q, r);
 }
@@ -2826,6 +3012,8 @@ obj_dict_count(struct ovm *vm, struct obj **pp, va_list ap)
 static void
 obj_dict_del(struct ovm *vm, struct obj **pp, va_list ap)
 {
+  if (obj_frozen_chk(vm, *pp))  return;
+
   _obj_dict_del(vm, *pp, *_ovm_reg(vm, va_arg(ap, unsigned)));
 }
 
@@ -2837,228 +3025,2043 @@ obj_dict_keys(struct ovm *vm, struct obj **pp, va_list ap)
 
   fp = ovm_falloc(vm, 1);
 
-  rr = &fp[-1];
-  for (ss = ARRAY_DATA(p), n = ARRAY_SIZE(p); n; --n, ++ss) {
-    for (s = *ss; s; s = CDR(s)) {
-      obj_list_newc(vm, rr, CAR(CAR(s)), 0);
-      rr = &CDR(*rr);
+  obj_array_newc(vm, &fp[-1], DICT_CNT(p));
+  if (vm->errno != OBJ_ERRNO_NONE)  goto done;
+  rr = ARRAY_DATA(fp[-1]);
+  for (ss = DICT_DATA(p), n = DICT_SIZE(p); n; --n, ++ss) {
+    for (s = *ss; s; s = CDR(s), ++rr) {
+      obj_assign(vm, rr, CAR(CAR(s)));
     }
   }
 
-  obj_assign(vm, pp, fp[-1]);
+  obj_vlist_newc(vm, pp, fp[-1], 0, DICT_CNT(p));
 
+ done:
   ovm_ffree(vm, fp);
 }
 
 /***************************************************************************/
 
-void (*op_func_tbl[OBJ_NUM_TYPES][OBJ_NUM_OPS])(struct ovm *, struct obj **, va_list) = {
-  /* OBJ_TYPE_OBJECT */
-  { 0 },
-  
-  /* OBJ_TYPE_NIL */
-  { 0,				/* OBJ_OP_ABS */
-    0,				/* OBJ_OP_ADD */
-    0,				/* OBJ_OP_AND */
-    obj_nil_append,		/* OBJ_OP_APPEND */
-    obj_nil_at,			/* OBJ_OP_AT */
-    0,				/* OBJ_OP_AT_PUT */
-    0,				/* OBJ_OP_CAR */
-    0,				/* OBJ_OP_CDR */
-    0,				/* OBJ_OP_COUNT */
-    0,				/* OBJ_OP_DEL */
-    0,				/* OBJ_OP_DIV */
-    obj_nil_eq,			/* OBJ_OP_EQ */
-    obj_nil_filter,		/* OBJ_OP_FILTER */
-    0,				/* OBJ_OP_GT */
-    obj_nil_hash,		/* OBJ_OP_HASH */
-    0,				/* OBJ_OP_JOIN */
-    0,				/* OBJ_OP_KEYS */
-    0,				/* OBJ_OP_LT */
-    0,				/* OBJ_OP_MINUS */
-    0,				/* OBJ_OP_MOD */
-    0,				/* OBJ_OP_MULT */
-    0,				/* OBJ_OP_NOT */
-    0,				/* OBJ_OP_OR */
-    obj_nil_reverse,		/* OBJ_OP_REVERSE */
-    obj_nil_size,		/* OBJ_OP_SIZE */
-    obj_nil_slice,		/* OBJ_OP_SLICE */
-    0,				/* OBJ_OP_SORT */
-    0,				/* OBJ_OP_SPLIT */
-    0,				/* OBJ_OP_SUB */
-    0				/* OBJ_OP_XOR */
-  },
+/* Iterators
 
-  /* OBJ_TYPE_POINTER */
-  { 0 },
-  
-  /* OBJ_TYPE_BOOLEAN */
-  { 0,				/* OBJ_OP_ABS */
-    0,				/* OBJ_OP_ADD */
-    obj_bool_and,		/* OBJ_OP_AND */
-    0,				/* OBJ_OP_APPEND */
-    0,				/* OBJ_OP_AT */
-    0,				/* OBJ_OP_AT_PUT */
-    0,				/* OBJ_OP_CAR */
-    0,				/* OBJ_OP_CDR */
-    0,				/* OBJ_OP_COUNT */
-    0,				/* OBJ_OP_DEL */
-    0,				/* OBJ_OP_DIV */
-    obj_bool_eq,		/* OBJ_OP_EQ */
-    0,				/* OBJ_OP_FILTER */
-    0,				/* OBJ_OP_GT */
-    obj_bool_hash,		/* OBJ_OP_HASH */
-    0,				/* OBJ_OP_JOIN */
-    0,				/* OBJ_OP_KEYS */
-    0,				/* OBJ_OP_LT */
-    0,				/* OBJ_OP_MINUS */
-    0,				/* OBJ_OP_MOD */
-    0,				/* OBJ_OP_MULT */
-    obj_bool_not,		/* OBJ_OP_NOT */
-    obj_bool_or,		/* OBJ_OP_OR */
-    0,				/* OBJ_OP_REVERSE */
-    0,				/* OBJ_OP_SIZE */
-    0,				/* OBJ_OP_SLICE */
-    0,				/* OBJ_OP_SORT */
-    0,				/* OBJ_OP_SPLIT */
-    0,				/* OBJ_OP_SUB */
-    obj_bool_xor		/* OBJ_OP_XOR */
-  },
+   An iterator produces the elements of a collection one at a time, without
+   materializing them.  Filtering, key extraction, slicing and reversal of
+   an iterator yield new iterators, stacked on (or, where the position can
+   be computed directly, fused into) the original one, so that chained
+   operations allocate only for the elements finally produced.
+*/
 
-  /* OBJ_TYPE_NUMBER */
-  { 0 },
+enum {
+  OBJ_ITER_KIND_ARRAY,		/* Elements of array, in either direction */
+  OBJ_ITER_KIND_LIST,		/* Elements of list */
+  OBJ_ITER_KIND_DICT,		/* Entries (pairs) of dictionary */
+  OBJ_ITER_KIND_FILTER,		/* Elements of upstream iterator, selected */
+  OBJ_ITER_KIND_KEYS		/* Keys of pairs from upstream iterator */
+};
 
-  /* OBJ_TYPE_INTEGER */
-  { 0,				/* OBJ_OP_ABS */
-    obj_integer_add,		/* OBJ_OP_ADD */
-    obj_integer_and,		/* OBJ_OP_AND */
-    0,				/* OBJ_OP_APPEND */
-    0,				/* OBJ_OP_AT */
-    0,				/* OBJ_OP_AT_PUT */
-    0,				/* OBJ_OP_CAR */
-    0,				/* OBJ_OP_CDR */
-    0,				/* OBJ_OP_COUNT */
-    0,				/* OBJ_OP_DEL */
-    obj_integer_div,		/* OBJ_OP_DIV */
-    obj_integer_eq,		/* OBJ_OP_EQ */
-    0,				/* OBJ_OP_FILTER */
-    obj_integer_gt,		/* OBJ_OP_GT */
-    obj_integer_hash,		/* OBJ_OP_HASH */
-    0,				/* OBJ_OP_JOIN */
-    0,				/* OBJ_OP_KEYS */
-    obj_integer_lt,		/* OBJ_OP_LT */
-    obj_integer_minus,		/* OBJ_OP_MINUS */
-    obj_integer_mod,		/* OBJ_OP_MOD */
-    obj_integer_mult,		/* OBJ_OP_MULT */
-    0,				/* OBJ_OP_NOT */
-    obj_integer_or,		/* OBJ_OP_OR */
-    0,				/* OBJ_OP_REVERSE */
-    0,				/* OBJ_OP_SIZE */
-    0,				/* OBJ_OP_SLICE */
-    0,				/* OBJ_OP_SORT */
-    0,				/* OBJ_OP_SPLIT */
-    obj_integer_sub,		/* OBJ_OP_SUB */
-    obj_integer_xor		/* OBJ_OP_XOR */
-  },
+enum {
+  OBJ_ITER_UNBOUNDED = ~0U
+};
 
-  /* OBJ_TYPE_FLOAT */
-  { 0,				/* OBJ_OP_ABS */
-    obj_float_add,		/* OBJ_OP_ADD */
-    0,				/* OBJ_OP_AND */
-    0,				/* OBJ_OP_APPEND */
-    0,				/* OBJ_OP_AT */
-    0,				/* OBJ_OP_AT_PUT */
-    0,				/* OBJ_OP_CAR */
-    0,				/* OBJ_OP_CDR */
-    0,				/* OBJ_OP_COUNT */
-    0,				/* OBJ_OP_DEL */
-    obj_float_div,		/* OBJ_OP_DIV */
-    obj_float_eq,		/* OBJ_OP_EQ */
-    0,				/* OBJ_OP_FILTER */
-    obj_float_gt,		/* OBJ_OP_GT */
-    obj_float_hash,		/* OBJ_OP_HASH */
-    0,				/* OBJ_OP_JOIN */
-    0,				/* OBJ_OP_KEYS */
-    obj_float_lt,		/* OBJ_OP_LT */
-    obj_float_minus,		/* OBJ_OP_MINUS */
-    0,				/* OBJ_OP_MOD */
-    obj_float_mult,		/* OBJ_OP_MULT */
-    0,				/* OBJ_OP_NOT */
-    0,				/* OBJ_OP_OR */
-    0,				/* OBJ_OP_REVERSE */
-    0,				/* OBJ_OP_SIZE */
-    0,				/* OBJ_OP_SLICE */
-    0,				/* OBJ_OP_SORT */
-    0,				/* OBJ_OP_SPLIT */
-    obj_float_sub,		/* OBJ_OP_SUB */
-    0				/* OBJ_OP_XOR */
-  },
+struct obj_iter {
+  unsigned         kind;
+  struct obj       *src;	/* Source collection, or upstream iterator */
+  struct obj       *sel;	/* Selector iterator or predicate, for filter */
+  struct obj       *cell;	/* Current dictionary bucket entry */
+  struct list_iter li[1];	/* Current position, for list */
+  unsigned         idx;		/* Current index, for array or dictionary */
+  int              step;	/* Direction, for array */
+  unsigned         skip;	/* Number of elements to skip */
+  unsigned         cnt;		/* Number of elements remaining */
+};
 
-  /* OBJ_TYPE_BLOCK */
-  { 0 },
+#define ITER(x)  ((struct obj_iter *)(x)->val.blockval.ptr)
 
-  /* OBJ_TYPE_STRING */
-  { 0,				/* OBJ_OP_ABS */
-    0,				/* OBJ_OP_ADD */
-    0,				/* OBJ_OP_AND */
-    obj_string_append,		/* OBJ_OP_APPEND */
-    obj_string_at,		/* OBJ_OP_AT */
-    0,				/* OBJ_OP_AT_PUT */
-    0,				/* OBJ_OP_CAR */
-    0,				/* OBJ_OP_CDR */
-    0,				/* OBJ_OP_COUNT */
-    0,				/* OBJ_OP_DEL */
-    0,				/* OBJ_OP_DIV */
-    obj_string_eq,		/* OBJ_OP_EQ */
-    0,				/* OBJ_OP_FILTER */
-    obj_string_gt,		/* OBJ_OP_GT */
-    obj_string_hash,		/* OBJ_OP_HASH */
-    obj_string_join,		/* OBJ_OP_JOIN */
-    0,				/* OBJ_OP_KEYS */
-    obj_string_lt,		/* OBJ_OP_LT */
-    0,				/* OBJ_OP_MINUS */
-    0,				/* OBJ_OP_MOD */
-    0,				/* OBJ_OP_MULT */
-    0,				/* OBJ_OP_NOT */
-    0,				/* OBJ_OP_OR */
-    obj_string_reverse,		/* OBJ_OP_REVERSE */
-    _obj_string_size,		/* OBJ_OP_SIZE */
-    obj_string_slice,		/* OBJ_OP_SLICE */
-    0,				/* OBJ_OP_SORT */
-    obj_string_split,		/* OBJ_OP_SPLIT */
-    0,				/* OBJ_OP_SUB */
-    0				/* OBJ_OP_XOR */
-  },
+static void
+obj_free_iter(struct ovm *vm, struct obj *obj)
+{
+  struct obj_iter *s = ITER(obj);
 
-  /* OBJ_TYPE_BYTES */
-  { 0 },
+  obj_release(vm, s->src);
+  obj_release(vm, s->sel);
+  obj_release(vm, s->cell);
+}
 
-  /* OBJ_TYPE_WORDS */
-  { 0 },
+static void
+_obj_iter_newc(struct ovm *vm, struct obj **pp, unsigned kind, struct obj *src)
+{
+  struct obj      **fp;
+  struct obj_iter *s;
 
-  /* OBJ_TYPE_DWORDS */
-  { 0 },
+  fp = ovm_falloc(vm, 1);
 
-  /* OBJ_TYPE_QWORDS */
-  { 0 },
+  obj_alloc(vm, &fp[-1], OBJ_TYPE_ITERATOR);
+  if (vm->errno != OBJ_ERRNO_NONE)  goto done;
 
-  /* OBJ_TYPE_BITS */
-  { 0 },
+  if ((s = calloc(1, sizeof(*s))) == 0) {
+    ovm_error(vm, OBJ_ERRNO_MEM);
+    goto done;
+  }
+  OVM_STATS_PAYLOAD(vm, sizeof(*s));
+  fp[-1]->val.blockval.size = sizeof(*s);
+  fp[-1]->val.blockval.ptr  = s;
 
-  /* OBJ_TYPE_DPTR */
-  { 0,				/* OBJ_OP_ABS */
-    0,				/* OBJ_OP_ADD */
-    0,				/* OBJ_OP_AND */
-    0,				/* OBJ_OP_APPEND */
-    0,				/* OBJ_OP_AT */
-    0,				/* OBJ_OP_AT_PUT */
-    obj_dptr_car,		/* OBJ_OP_CAR */
+  s->kind = kind;
+  obj_assign(vm, &s->src, src);
+  s->step = 1;
+  s->cnt  = OBJ_ITER_UNBOUNDED;
+
+  obj_assign(vm, pp, fp[-1]);
+
+ done:
+  ovm_ffree(vm, fp);
+}
+
+static void
+obj_iter_array_newc(struct ovm *vm, struct obj **pp, struct obj *arr, unsigned idx, unsigned cnt, int step)
+{
+  struct obj_iter *s;
+
+  _obj_iter_newc(vm, pp, OBJ_ITER_KIND_ARRAY, arr);
+  if (vm->errno != OBJ_ERRNO_NONE)  return;
+
+  s = ITER(*pp);
+  s->idx  = idx;
+  s->cnt  = cnt;
+  s->step = step;
+}
+
+static void
+obj_iter_newc(struct ovm *vm, struct obj **pp, struct obj *q)
+{
+  switch (obj_type(q)) {
+  case OBJ_TYPE_ITERATOR:
+    obj_assign(vm, pp, q);
+    return;
+
+  case OBJ_TYPE_ARRAY:
+    obj_iter_array_newc(vm, pp, q, 0, ARRAY_SIZE(q), 1);
+    return;
+
+  case OBJ_TYPE_VLIST:
+    obj_iter_array_newc(vm, pp, VLIST_ARR(q), VLIST_OFS(q), VLIST_SIZE(q), 1);
+    return;
+
+  case OBJ_TYPE_NIL:
+  case OBJ_TYPE_LIST:
+    _obj_iter_newc(vm, pp, OBJ_ITER_KIND_LIST, q);
+    if (vm->errno == OBJ_ERRNO_NONE)  list_iter_init(ITER(*pp)->li, q);
+    return;
+
+  case OBJ_TYPE_DICT:
+    _obj_iter_newc(vm, pp, OBJ_ITER_KIND_DICT, q);
+    return;
+
+  case OBJ_TYPE_PDICT:
+    {
+      struct obj **fp;
+
+      fp = ovm_falloc(vm, 1);
+
+      obj_pdict_pairs(vm, &fp[-1], q);
+      if (vm->errno == OBJ_ERRNO_NONE) {
+	obj_iter_array_newc(vm, pp, fp[-1], 0, ARRAY_SIZE(fp[-1]), 1);
+      }
+
+      ovm_ffree(vm, fp);
+    }
+    return;
+
+  case OBJ_TYPE_SET:
+    {
+      struct obj **fp;
+
+      fp = ovm_falloc(vm, 1);
+
+      obj_set_members(vm, &fp[-1], q);
+      if (vm->errno == OBJ_ERRNO_NONE) {
+	obj_iter_array_newc(vm, pp, fp[-1], 0, ARRAY_SIZE(fp[-1]), 1);
+      }
+
+      ovm_ffree(vm, fp);
+    }
+    return;
+
+  default:
+    ;
+  }
+
+  ovm_error(vm, OBJ_ERRNO_BAD_TYPE);
+}
+
+static unsigned
+obj_iter_select(struct ovm *vm, struct obj *sel, struct obj *q)
+{
+  unsigned   result = 0;
+  struct obj **fp;
+
+  fp = ovm_falloc(vm, 2);
+
+  if (obj_type(sel) == OBJ_TYPE_POINTER) {
+    /* Predicate, called like a command function: argument in R0, result
+       in R0; caller's R0 is preserved
+    */
+
+    obj_assign(vm, &fp[-2], R(0));
+    obj_assign(vm, &R(0), q);
+
+    (* (void (*)(struct ovm *)) PTRVAL(sel))(vm);
+
+    obj_assign(vm, &fp[-1], R(0));
+    obj_assign(vm, &R(0), fp[-2]);
+  } else if (!obj_iter_step(vm, sel, &fp[-1])) {
+    goto done;
+  }
+
+  if (vm->errno != OBJ_ERRNO_NONE)  goto done;
+
+  if (obj_type(fp[-1]) != OBJ_TYPE_BOOLEAN) {
+    ovm_error(vm, OBJ_ERRNO_BAD_VALUE);
+    goto done;
+  }
+
+  result = (BOOLVAL(fp[-1]) ? 1 : 2);
+
+ done:
+  ovm_ffree(vm, fp);
+
+  return (result);
+}
+
+static unsigned
+_obj_iter_step(struct ovm *vm, struct obj_iter *s, struct obj **pp)
+{
+  struct obj *p;
+
+  switch (s->kind) {
+  case OBJ_ITER_KIND_ARRAY:
+    /* Bound by current size, not by that when iterator was created */
+
+    if (s->idx >= ARRAY_SIZE(s->src))  return (0);
+    obj_assign(vm, pp, ARRAY_DATA(s->src)[s->idx]);
+    s->idx += s->step;
+    return (1);
+
+  case OBJ_ITER_KIND_LIST:
+    if (s->li->li == 0)  return (0);
+    obj_assign(vm, pp, list_iter_car(s->li));
+    list_iter_next(s->li);
+    return (1);
+
+  case OBJ_ITER_KIND_DICT:
+    while ((p = s->cell) == 0) {
+      if (s->idx >= DICT_SIZE(s->src))  return (0);
+      obj_assign(vm, &s->cell, DICT_DATA(s->src)[s->idx++]);
+    }
+    obj_assign(vm, pp, CAR(p));
+    obj_assign(vm, &s->cell, CDR(p));
+    return (1);
+
+  case OBJ_ITER_KIND_FILTER:
+    for (;;) {
+      if (!obj_iter_step(vm, s->src, pp))  return (0);
+
+      switch (obj_iter_select(vm, s->sel, *pp)) {
+      case 0:
+	return (0);
+      case 1:
+	return (1);
+      default:
+	;
+      }
+    }
+
+  case OBJ_ITER_KIND_KEYS:
+    if (!obj_iter_step(vm, s->src, pp))  return (0);
+    if (obj_type(*pp) != OBJ_TYPE_PAIR) {
+      ovm_error(vm, OBJ_ERRNO_BAD_VALUE);
+      return (0);
+    }
+    obj_assign(vm, pp, CAR(*pp));
+    return (1);
+
+  default:
+    assert(0);
+  }
+
+  return (0);
+}
+
+static unsigned
+obj_iter_step(struct ovm *vm, struct obj *it, struct obj **pp)
+{
+  struct obj_iter *s = ITER(it);
+
+  for (;;) {
+    if (s->cnt == 0 || vm->errno != OBJ_ERRNO_NONE)  return (0);
+
+    if (!_obj_iter_step(vm, s, pp)) {
+      s->cnt = 0;
+
+      return (0);
+    }
+
+    if (s->skip > 0) {
+      --s->skip;
+
+      continue;
+    }
+
+    if (s->cnt != OBJ_ITER_UNBOUNDED)  --s->cnt;
+
+    return (1);
+  }
+}
+
+static void
+obj_iter_drain(struct ovm *vm, struct obj **pp, struct obj *it)
+{
+  struct obj **fp, **data = 0, **rr;
+  unsigned   n = 0, size = 0;
+
+  fp = ovm_falloc(vm, 2);
+
+  while (obj_iter_step(vm, it, &fp[-1])) {
+    if (n >= size) {
+      size = size == 0 ? 16 : 2 * size;
+      if ((rr = realloc(data, size * sizeof(*data))) == 0) {
+	ovm_error(vm, OBJ_ERRNO_MEM);
+	break;
+      }
+      OVM_STATS_PAYLOAD(vm, size * sizeof(*data));
+      data = rr;
+    }
+
+    data[n++] = obj_retain(fp[-1]);
+  }
+
+  if (vm->errno == OBJ_ERRNO_NONE) {
+    obj_array_newc(vm, &fp[-2], 0);
+  }
+  if (vm->errno != OBJ_ERRNO_NONE) {
+    for (rr = data; n; --n, ++rr)  obj_release(vm, *rr);
+    free(data);
+
+    goto done;
+  }
+
+  /* Trim to size; on failure, the larger block is kept */
+
+  if (n < size && (rr = realloc(data, n * sizeof(*data))) != 0)  data = rr;
+  ARRAY_SIZE(fp[-2]) = n;
+  ARRAY_DATA(fp[-2]) = data;
+
+  obj_assign(vm, pp, fp[-2]);
+
+ done:
+  ovm_ffree(vm, fp);
+}
+
+static void
+obj_iter_new(struct ovm *vm, struct obj **pp, va_list ap)
+{
+  obj_iter_newc(vm, pp, *_ovm_reg(vm, va_arg(ap, unsigned)));
+}
+
+static void
+obj_iter_tostring(struct ovm *vm, struct obj **pp, struct obj *q)
+{
+  obj_string_newc(vm, pp, 1, 9, "#iterator");
+}
+
+static void
+obj_iter_clone(struct ovm *vm, struct obj **pp, struct obj *it)
+{
+  struct obj_iter *s = ITER(it), *t;
+
+  _obj_iter_newc(vm, pp, s->kind, s->src);
+  if (vm->errno != OBJ_ERRNO_NONE)  return;
+
+  t = ITER(*pp);
+  obj_assign(vm, &t->sel, s->sel);
+  obj_assign(vm, &t->cell, s->cell);
+  *t->li  = *s->li;
+  t->idx  = s->idx;
+  t->step = s->step;
+  t->skip = s->skip;
+  t->cnt  = s->cnt;
+}
+
+/* Convert to a random-access iterator, draining if necessary */
+
+static void
+obj_iter_seekable(struct ovm *vm, struct obj **pp)
+{
+  struct obj **fp;
+
+  if (ITER(*pp)->kind == OBJ_ITER_KIND_ARRAY)  return;
+
+  fp = ovm_falloc(vm, 1);
+
+  obj_iter_drain(vm, &fp[-1], *pp);
+  if (vm->errno == OBJ_ERRNO_NONE) {
+    obj_iter_array_newc(vm, pp, fp[-1], 0, ARRAY_SIZE(fp[-1]), 1);
+  }
+
+  ovm_ffree(vm, fp);
+}
+
+static void
+obj_iter_next(struct ovm *vm, struct obj **pp, va_list ap)
+{
+  struct obj **qq = _ovm_reg(vm, va_arg(ap, unsigned));
+  struct obj **fp;
+
+  fp = ovm_falloc(vm, 1);
+
+  if (!obj_iter_step(vm, *pp, &fp[-1]) && vm->errno == OBJ_ERRNO_NONE) {
+    /* Exhausted => iterator replaced by nil */
+
+    obj_assign(vm, pp, 0);
+  }
+
+  obj_assign(vm, qq, fp[-1]);
+
+  ovm_ffree(vm, fp);
+}
+
+static void
+obj_iter_filter(struct ovm *vm, struct obj **pp, va_list ap)
+{
+  struct obj **fp, *q = *_ovm_reg(vm, va_arg(ap, unsigned));
+
+  fp = ovm_falloc(vm, 2);
+
+  switch (obj_type(q)) {
+  case OBJ_TYPE_POINTER:
+    obj_assign(vm, &fp[-2], q);
+    break;
+  case OBJ_TYPE_ARRAY:
+  case OBJ_TYPE_ITERATOR:
+    obj_iter_newc(vm, &fp[-2], q);
+    break;
+  default:
+    if (is_list(q)) {
+      obj_iter_newc(vm, &fp[-2], q);
+      break;
+    }
+    ovm_error(vm, OBJ_ERRNO_BAD_TYPE);
+  }
+  if (vm->errno != OBJ_ERRNO_NONE)  goto done;
+
+  _obj_iter_newc(vm, &fp[-1], OBJ_ITER_KIND_FILTER, *pp);
+  if (vm->errno != OBJ_ERRNO_NONE)  goto done;
+  obj_assign(vm, &ITER(fp[-1])->sel, fp[-2]);
+
+  obj_assign(vm, pp, fp[-1]);
+
+ done:
+  ovm_ffree(vm, fp);
+}
+
+static void
+obj_iter_keys(struct ovm *vm, struct obj **pp, va_list ap)
+{
+  _obj_iter_newc(vm, pp, OBJ_ITER_KIND_KEYS, *pp);
+}
+
+static void
+obj_iter_reverse(struct ovm *vm, struct obj **pp, va_list ap)
+{
+  struct obj      **fp;
+  struct obj_iter *s;
+
+  fp = ovm_falloc(vm, 1);
+
+  obj_assign(vm, &fp[-1], *pp);
+  obj_iter_seekable(vm, &fp[-1]);
+  if (vm->errno != OBJ_ERRNO_NONE)  goto done;
+
+  s = ITER(fp[-1]);
+  obj_iter_array_newc(vm,
+		      pp,
+		      s->src,
+		      s->cnt == 0 ? s->idx : s->idx + s->step * (int) (s->cnt - 1),
+		      s->cnt,
+		      -s->step
+		      );
+
+ done:
+  ovm_ffree(vm, fp);
+}
+
+static void
+obj_iter_slice(struct ovm *vm, struct obj **pp, va_list ap)
+{
+  struct obj      *q = *_ovm_reg(vm, va_arg(ap, unsigned));
+  struct obj      *r = *_ovm_reg(vm, va_arg(ap, unsigned));
+  struct obj      **fp;
+  struct obj_iter *s;
+  int             i, n;
+
+  if (obj_type(q) != OBJ_TYPE_INTEGER || obj_type(r) != OBJ_TYPE_INTEGER) {
+    ovm_error(vm, OBJ_ERRNO_BAD_TYPE);
+    return;
+  }
+
+  i = INTVAL(q);
+  n = INTVAL(r);
+
+  fp = ovm_falloc(vm, 1);
+
+  if (i < 0 || n < 0) {
+    /* Relative to end => need size of remainder */
+
+    obj_assign(vm, &fp[-1], *pp);
+    obj_iter_seekable(vm, &fp[-1]);
+    if (vm->errno != OBJ_ERRNO_NONE)  goto done;
+
+    s = ITER(fp[-1]);
+    slice_idxs((int) s->cnt, &i, &n);
+  } else {
+    obj_iter_clone(vm, &fp[-1], *pp);
+    if (vm->errno != OBJ_ERRNO_NONE)  goto done;
+
+    s = ITER(fp[-1]);
+  }
+
+  if (s->kind == OBJ_ITER_KIND_ARRAY) {
+    if (i > s->cnt)  i = s->cnt;
+    s->idx += s->step * i;
+    s->cnt -= i;
+    if (n < s->cnt)  s->cnt = n;
+
+    obj_iter_array_newc(vm, pp, s->src, s->idx, s->cnt, s->step);
+  } else {
+    if (s->cnt != OBJ_ITER_UNBOUNDED) {
+      s->cnt = i >= s->cnt ? 0 : s->cnt - i;
+    }
+    s->skip += i;
+    if (n < s->cnt)  s->cnt = n;
+
+    obj_assign(vm, pp, fp[-1]);
+  }
+
+ done:
+  ovm_ffree(vm, fp);
+}
+
+/***************************************************************************/
+
+/* Persistent dictionaries
+
+   A persistent dictionary is a hash array mapped trie.  Each node holds a
+   32-bit occupancy bitmap, indexed by 5 bits of the key hash, and a compact
+   array of the occupied slots; a slot is a pair (single entry), a node
+   (subtrie), or a list of pairs (keys with identical hashes).
+
+   Nodes are never modified once built.  An update copies only the nodes on
+   the path from the root to the changed slot, and produces a new
+   dictionary, sharing all other nodes with the original; a copy is just
+   another reference.
+*/
+
+enum {
+  HAMT_BITS = 5,
+  HAMT_MASK = (1 << HAMT_BITS) - 1
+};
+
+static unsigned
+obj_key_hash(struct ovm *vm, struct obj *key)
+{
+  unsigned result = 0;
+
+  if (_obj_hash(key, &result) < 0)  ovm_error(vm, OBJ_ERRNO_BAD_METHOD);
+
+  return (result);
+}
+
+static unsigned
+obj_key_eq(struct ovm *vm, struct obj *key1, struct obj *key2)
+{
+  return (obj_equal(vm, key1, key2) == 1);
+}
+
+static inline unsigned
+hamt_idx(struct obj *node, unsigned bit)
+{
+  return (__builtin_popcount(HAMT_BITMAP(node) & (bit - 1)));
+}
+
+/* Hash of a slot which is a pair or collision list */
+
+static unsigned
+hamt_slot_hash(struct ovm *vm, struct obj *e)
+{
+  return (obj_key_hash(vm, CAR(obj_type(e) == OBJ_TYPE_PAIR ? e : CAR(e))));
+}
+
+static void
+hamt_newc(struct ovm *vm, struct obj **pp, unsigned bitmap)
+{
+  _obj_array_newc(vm, pp, OBJ_TYPE_HAMT, __builtin_popcount(bitmap));
+  if (vm->errno != OBJ_ERRNO_NONE)  return;
+
+  HAMT_BITMAP(*pp) = bitmap;
+}
+
+/* Copy of node, with given slot replaced (e != 0), inserted (bit not in
+   node's bitmap), or removed (e == 0)
+*/
+
+static void
+hamt_copy(struct ovm *vm, struct obj **pp, struct obj *node, unsigned bit, struct obj *e)
+{
+  struct obj **fp, **rr, **ss;
+  unsigned   bitmap = HAMT_BITMAP(node), i = hamt_idx(node, bit), n;
+
+  bitmap = e == 0 ? bitmap & ~bit : bitmap | bit;
+  if (bitmap == 0) {
+    obj_assign(vm, pp, 0);
+
+    return;
+  }
+
+  fp = ovm_falloc(vm, 1);
+
+  hamt_newc(vm, &fp[-1], bitmap);
+  if (vm->errno != OBJ_ERRNO_NONE)  goto done;
+
+  for (rr = ARRAY_DATA(fp[-1]), ss = ARRAY_DATA(node), n = 0; n < i; ++n) {
+    obj_assign(vm, rr++, *ss++);
+  }
+  if (e)  obj_assign(vm, rr++, e);
+  if (HAMT_BITMAP(node) & bit)  ++ss;
+  for (n = ARRAY_DATA(node) + ARRAY_SIZE(node) - ss; n; --n) {
+    obj_assign(vm, rr++, *ss++);
+  }
+
+  obj_assign(vm, pp, fp[-1]);
+
+ done:
+  ovm_ffree(vm, fp);
+}
+
+/* Subtrie holding two slots, with different hashes */
+
+static void
+hamt_merge(struct ovm *vm, struct obj **pp, struct obj *e1, unsigned h1, struct obj *e2, unsigned h2, unsigned shift)
+{
+  struct obj **fp;
+  unsigned   i1 = (h1 >> shift) & HAMT_MASK, i2 = (h2 >> shift) & HAMT_MASK;
+
+  fp = ovm_falloc(vm, 1);
+
+  if (i1 == i2) {
+    hamt_merge(vm, &fp[-1], e1, h1, e2, h2, shift + HAMT_BITS);
+    if (vm->errno != OBJ_ERRNO_NONE)  goto done;
+
+    hamt_newc(vm, pp, 1U << i1);
+    if (vm->errno != OBJ_ERRNO_NONE)  goto done;
+    obj_assign(vm, &ARRAY_DATA(*pp)[0], fp[-1]);
+
+    goto done;
+  }
+
+  hamt_newc(vm, &fp[-1], (1U << i1) | (1U << i2));
+  if (vm->errno != OBJ_ERRNO_NONE)  goto done;
+  obj_assign(vm, &ARRAY_DATA(fp[-1])[i1 > i2], e1);
+  obj_assign(vm, &ARRAY_DATA(fp[-1])[i1 < i2], e2);
+
+  obj_assign(vm, pp, fp[-1]);
+
+ done:
+  ovm_ffree(vm, fp);
+}
+
+static struct obj *
+hamt_at(struct ovm *vm, struct obj *node, unsigned hash, struct obj *key)
+{
+  unsigned         shift, bit;
+  struct obj       *e;
+  struct list_iter li[1];
+
+  for (shift = 0; node; shift += HAMT_BITS) {
+    bit = 1U << ((hash >> shift) & HAMT_MASK);
+    if ((HAMT_BITMAP(node) & bit) == 0)  return (0);
+
+    e = ARRAY_DATA(node)[hamt_idx(node, bit)];
+    switch (obj_type(e)) {
+    case OBJ_TYPE_HAMT:
+      node = e;
+      continue;
+
+    case OBJ_TYPE_PAIR:
+      return (obj_key_eq(vm, CAR(e), key) ? e : 0);
+
+    default:
+      for (list_iter_init(li, e); li->li; list_iter_next(li)) {
+	e = list_iter_car(li);
+	if (obj_key_eq(vm, CAR(e), key))  return (e);
+      }
+      return (0);
+    }
+  }
+
+  return (0);
+}
+
+/* Collision list, with pair for key replaced or removed (pair == 0) */
+
+static void
+hamt_list_put(struct ovm *vm, struct obj **pp, struct obj *li, struct obj *key, struct obj *pair, unsigned *found)
+{
+  struct obj **fp;
+
+  if (li == 0) {
+    *found = 0;
+    if (pair)  obj_list_newc(vm, pp, pair, 0);
+    else       obj_assign(vm, pp, 0);
+
+    return;
+  }
+
+  if (obj_key_eq(vm, CAR(CAR(li)), key)) {
+    *found = 1;
+    if (pair)  obj_list_newc(vm, pp, pair, CDR(li));
+    else       obj_assign(vm, pp, CDR(li));
+
+    return;
+  }
+
+  fp = ovm_falloc(vm, 1);
+
+  hamt_list_put(vm, &fp[-1], CDR(li), key, pair, found);
+  if (vm->errno == OBJ_ERRNO_NONE)  obj_list_newc(vm, pp, CAR(li), fp[-1]);
+
+  ovm_ffree(vm, fp);
+}
+
+static void
+hamt_put(struct ovm *vm, struct obj **pp, struct obj *node, unsigned hash, unsigned shift, struct obj *pair, unsigned *added)
+{
+  struct obj **fp, *e;
+  unsigned   bit = 1U << ((hash >> shift) & HAMT_MASK), h, found;
+
+  if (node == 0) {
+    hamt_newc(vm, pp, bit);
+    if (vm->errno == OBJ_ERRNO_NONE)  obj_assign(vm, &ARRAY_DATA(*pp)[0], pair);
+    *added = 1;
+
+    return;
+  }
+
+  if ((HAMT_BITMAP(node) & bit) == 0) {
+    hamt_copy(vm, pp, node, bit, pair);
+    *added = 1;
+
+    return;
+  }
+
+  fp = ovm_falloc(vm, 2);
+
+  e = ARRAY_DATA(node)[hamt_idx(node, bit)];
+  *added = 0;
+
+  switch (obj_type(e)) {
+  case OBJ_TYPE_HAMT:
+    hamt_put(vm, &fp[-1], e, hash, shift + HAMT_BITS, pair, added);
+    break;
+
+  case OBJ_TYPE_PAIR:
+    if (obj_key_eq(vm, CAR(e), CAR(pair))) {
+      obj_assign(vm, &fp[-1], pair);
+      break;
+    }
+    *added = 1;
+    h = obj_key_hash(vm, CAR(e));
+    if (vm->errno != OBJ_ERRNO_NONE)  break;
+    if (h == hash) {
+      /* Full hash collision => list */
+
+      obj_list_newc(vm, &fp[-2], e, 0);
+      obj_list_newc(vm, &fp[-1], pair, fp[-2]);
+      break;
+    }
+    hamt_merge(vm, &fp[-1], e, h, pair, hash, shift + HAMT_BITS);
+    break;
+
+  default:
+    h = hamt_slot_hash(vm, e);
+    if (vm->errno != OBJ_ERRNO_NONE)  break;
+    if (h == hash) {
+      /* Replaced in, or appended to, list */
+
+      hamt_list_put(vm, &fp[-1], e, CAR(pair), pair, &found);
+      *added = !found;
+      break;
+    }
+    *added = 1;
+    hamt_merge(vm, &fp[-1], e, h, pair, hash, shift + HAMT_BITS);
+  }
+
+  if (vm->errno == OBJ_ERRNO_NONE)  hamt_copy(vm, pp, node, bit, fp[-1]);
+
+  ovm_ffree(vm, fp);
+}
+
+static void
+hamt_del(struct ovm *vm, struct obj **pp, struct obj *node, unsigned hash, unsigned shift, struct obj *key, unsigned *removed)
+{
+  struct obj **fp, *e;
+  unsigned   bit = 1U << ((hash >> shift) & HAMT_MASK);
+
+  *removed = 0;
+
+  if (node == 0 || (HAMT_BITMAP(node) & bit) == 0) {
+    obj_assign(vm, pp, node);
+
+    return;
+  }
+
+  fp = ovm_falloc(vm, 1);
+
+  e = ARRAY_DATA(node)[hamt_idx(node, bit)];
+
+  switch (obj_type(e)) {
+  case OBJ_TYPE_HAMT:
+    hamt_del(vm, &fp[-1], e, hash, shift + HAMT_BITS, key, removed);
+    e = fp[-1];
+    if (e && ARRAY_SIZE(e) == 1 && obj_type(ARRAY_DATA(e)[0]) != OBJ_TYPE_HAMT) {
+      /* Single entry left in subtrie => pull up */
+
+      obj_assign(vm, &fp[-1], ARRAY_DATA(e)[0]);
+    }
+    break;
+
+  case OBJ_TYPE_PAIR:
+    if (obj_key_eq(vm, CAR(e), key))  *removed = 1;
+    else                              obj_assign(vm, &fp[-1], e);
+    break;
+
+  default:
+    hamt_list_put(vm, &fp[-1], e, key, 0, removed);
+    if (CDR(fp[-1]) == 0)  obj_assign(vm, &fp[-1], CAR(fp[-1]));
+  }
+
+  if (vm->errno != OBJ_ERRNO_NONE)  goto done;
+
+  if (*removed)  hamt_copy(vm, pp, node, bit, fp[-1]);
+  else           obj_assign(vm, pp, node);
+
+ done:
+  ovm_ffree(vm, fp);
+}
+
+/* Store all pairs in trie into array, starting at *prr */
+
+static void
+hamt_pairs(struct ovm *vm, struct obj *node, struct obj ***prr)
+{
+  struct obj       **ss, *e;
+  unsigned         n;
+  struct list_iter li[1];
+
+  if (node == 0)  return;
+
+  for (ss = ARRAY_DATA(node), n = ARRAY_SIZE(node); n; --n, ++ss) {
+    switch (obj_type(e = *ss)) {
+    case OBJ_TYPE_HAMT:
+      hamt_pairs(vm, e, prr);
+      break;
+    case OBJ_TYPE_PAIR:
+      obj_assign(vm, (*prr)++, e);
+      break;
+    default:
+      for (list_iter_init(li, e); li->li; list_iter_next(li)) {
+	obj_assign(vm, (*prr)++, list_iter_car(li));
+      }
+    }
+  }
+}
+
+static void
+obj_pdict_newc(struct ovm *vm, struct obj **pp, struct obj *root, unsigned cnt)
+{
+  struct obj **fp;
+
+  fp = ovm_falloc(vm, 1);
+
+  obj_alloc(vm, &fp[-1], OBJ_TYPE_PDICT);
+  if (vm->errno != OBJ_ERRNO_NONE)  goto done;
+
+  obj_assign(vm, &PDICT_ROOT(fp[-1]), root);
+  PDICT_CNT(fp[-1]) = cnt;
+
+  obj_assign(vm, pp, fp[-1]);
+
+ done:
+  ovm_ffree(vm, fp);
+}
+
+static void
+obj_free_pdict(struct ovm *vm, struct obj *obj)
+{
+  obj_release(vm, PDICT_ROOT(obj));
+  PDICT_ROOT(obj) = 0;
+}
+
+/* Array of all pairs in dictionary */
+
+static void
+obj_pdict_pairs(struct ovm *vm, struct obj **pp, struct obj *q)
+{
+  struct obj **fp, **rr;
+
+  fp = ovm_falloc(vm, 1);
+
+  obj_array_newc(vm, &fp[-1], PDICT_CNT(q));
+  if (vm->errno != OBJ_ERRNO_NONE)  goto done;
+
+  rr = ARRAY_DATA(fp[-1]);
+  hamt_pairs(vm, PDICT_ROOT(q), &rr);
+  assert(rr == ARRAY_DATA(fp[-1]) + PDICT_CNT(q));
+
+  obj_assign(vm, pp, fp[-1]);
+
+ done:
+  ovm_ffree(vm, fp);
+}
+
+/* New version of dictionary, with entry for key set to val */
+
+static void
+_obj_pdict_at_put(struct ovm *vm, struct obj **pp, struct obj *key, struct obj *val)
+{
+  struct obj **fp;
+  unsigned   hash, added, cnt = PDICT_CNT(*pp);
+
+  hash = obj_key_hash(vm, key);
+  if (vm->errno != OBJ_ERRNO_NONE)  return;
+
+  fp = ovm_falloc(vm, 2);
+
+  obj_pair_newc(vm, &fp[-2], key, val);
+  if (vm->errno != OBJ_ERRNO_NONE)  goto done;
+  hamt_put(vm, &fp[-1], PDICT_ROOT(*pp), hash, 0, fp[-2], &added);
+  if (vm->errno != OBJ_ERRNO_NONE)  goto done;
+
+  obj_pdict_newc(vm, pp, fp[-1], cnt + added);
+
+ done:
+  ovm_ffree(vm, fp);
+}
+
+static void
+obj_pdict_tostring(struct ovm *vm, struct obj **pp, struct obj *q)
+{
+  struct obj **fp, **rr, **ss;
+  unsigned   n, i;
+
+  fp = ovm_falloc(vm, 2);
+
+  obj_pdict_pairs(vm, &fp[-2], q);
+  if (vm->errno != OBJ_ERRNO_NONE)  goto done;
+
+  n = 2 + 3 * PDICT_CNT(q);
+  if (PDICT_CNT(q) > 1)  n += PDICT_CNT(q) - 1;
+
+  obj_array_newc(vm, &fp[-1], n);
+  if (vm->errno != OBJ_ERRNO_NONE)  goto done;
+  rr = ARRAY_DATA(fp[-1]);
+
+  obj_string_newc(vm, rr++, 1, 1, "{");
+  for (ss = ARRAY_DATA(fp[-2]), i = 0; i < PDICT_CNT(q); ++i, ++ss) {
+    if (i > 0)  obj_string_newc(vm, rr++, 1, 2, ", ");
+    obj_tostring(vm, rr++, CAR(*ss));
+    obj_string_newc(vm, rr++, 1, 2, ": ");
+    obj_tostring(vm, rr++, CDR(*ss));
+  }
+  obj_string_newc(vm, rr, 1, 1, "}");
+
+  obj_string_newv(vm, pp, fp[-1]);
+
+ done:
+  ovm_ffree(vm, fp);
+}
+
+static void
+obj_pdict_new(struct ovm *vm, struct obj **pp, va_list ap)
+{
+  struct obj *q = *_ovm_reg(vm, va_arg(ap, unsigned)), **fp;
+
+  if (obj_type(q) == OBJ_TYPE_PDICT) {
+    /* Immutable => copy is the same object */
+
+    obj_assign(vm, pp, q);
+
+    return;
+  }
+
+  fp = ovm_falloc(vm, 3);
+
+  obj_iter_newc(vm, &fp[-3], q);
+  if (vm->errno != OBJ_ERRNO_NONE)  goto done;
+
+  obj_pdict_newc(vm, &fp[-1], 0, 0);
+  while (obj_iter_step(vm, fp[-3], &fp[-2])) {
+    if (obj_type(fp[-2]) != OBJ_TYPE_PAIR) {
+      ovm_error(vm, OBJ_ERRNO_BAD_VALUE);
+      break;
+    }
+    _obj_pdict_at_put(vm, &fp[-1], CAR(fp[-2]), CDR(fp[-2]));
+  }
+
+  if (vm->errno == OBJ_ERRNO_NONE)  obj_assign(vm, pp, fp[-1]);
+
+ done:
+  ovm_ffree(vm, fp);
+}
+
+static void
+obj_pdict_at(struct ovm *vm, struct obj **pp, va_list ap)
+{
+  struct obj *q = *_ovm_reg(vm, va_arg(ap, unsigned));
+  unsigned   hash;
+
+  hash = obj_key_hash(vm, q);
+  if (vm->errno != OBJ_ERRNO_NONE)  return;
+
+  obj_assign(vm, pp, hamt_at(vm, PDICT_ROOT(*pp), hash, q));
+}
+
+static void
+obj_pdict_at_put(struct ovm *vm, struct obj **pp, va_list ap)
+{
+  struct obj *q = *_ovm_reg(vm, va_arg(ap, unsigned));
+  struct obj *r = *_ovm_reg(vm, va_arg(ap, unsigned));
+
+  _obj_pdict_at_put(vm, pp, q, r);
+}
+
+static void
+obj_pdict_count(struct ovm *vm, struct obj **pp, va_list ap)
+{
+  obj_integer_newc(vm, pp, PDICT_CNT(*pp));
+}
+
+static void
+obj_pdict_del(struct ovm *vm, struct obj **pp, va_list ap)
+{
+  struct obj *q = *_ovm_reg(vm, va_arg(ap, unsigned)), **fp;
+  unsigned   hash, removed, cnt = PDICT_CNT(*pp);
+
+  hash = obj_key_hash(vm, q);
+  if (vm->errno != OBJ_ERRNO_NONE)  return;
+
+  fp = ovm_falloc(vm, 1);
+
+  hamt_del(vm, &fp[-1], PDICT_ROOT(*pp), hash, 0, q, &removed);
+  if (vm->errno == OBJ_ERRNO_NONE && removed) {
+    obj_pdict_newc(vm, pp, fp[-1], cnt - 1);
+  }
+
+  ovm_ffree(vm, fp);
+}
+
+static void
+obj_pdict_keys(struct ovm *vm, struct obj **pp, va_list ap)
+{
+  struct obj **fp, **rr;
+  unsigned   n;
+
+  fp = ovm_falloc(vm, 1);
+
+  obj_pdict_pairs(vm, &fp[-1], *pp);
+  if (vm->errno != OBJ_ERRNO_NONE)  goto done;
+
+  for (rr = ARRAY_DATA(fp[-1]), n = ARRAY_SIZE(fp[-1]); n; --n, ++rr) {
+    obj_assign(vm, rr, CAR(*rr));
+  }
+
+  obj_vlist_newc(vm, pp, fp[-1], 0, ARRAY_SIZE(fp[-1]));
+
+ done:
+  ovm_ffree(vm, fp);
+}
+
+/***************************************************************************/
+
+/* Sets
+
+   A set is a hash table, with open addressing and linear probing, holding
+   only its members: no values, and no pair or list per member.  Its block
+   is SET_SIZE() member pointers, followed by the hash of each member, so
+   that probing and resizing compare and move hashes rather than calling
+   methods.  The size is a power of 2, and the table is kept at most half
+   full.  Deletion moves later members of the probe sequence back, so that
+   no tombstones are needed.
+
+   An empty slot is NIL (a null pointer), so NIL cannot be a member.
+*/
+
+enum {
+  SET_SIZE_MIN = 8
+};
+
+#define SET_HASH(x)  ((unsigned *)(SET_DATA(x) + SET_SIZE(x)))
+
+/* Size of an array's block, in bytes */
+
+static unsigned
+obj_array_bytes(struct obj *p)
+{
+  return (ARRAY_SIZE(p) * (obj_type(p) == OBJ_TYPE_SET
+			   ? sizeof(ARRAY_DATA(p)[0]) + sizeof(unsigned)
+			   : sizeof(ARRAY_DATA(p)[0])
+			   )
+	  );
+}
+
+static unsigned
+set_size(unsigned cnt)
+{
+  unsigned result;
+
+  for (result = SET_SIZE_MIN; result < 2 * cnt; result <<= 1);
+
+  return (result);
+}
+
+static void
+obj_set_newc(struct ovm *vm, struct obj **pp, unsigned cnt)
+{
+  unsigned size = set_size(cnt), n = size * (sizeof(SET_DATA(*pp)[0]) + sizeof(unsigned));
+
+  obj_alloc(vm, pp, OBJ_TYPE_SET);
+
+  if (vm->errno != OBJ_ERRNO_NONE)  return;
+
+  if ((SET_DATA(*pp) = calloc(1, n)) == 0) {
+    obj_assign(vm, pp, 0);
+
+    ovm_error(vm, OBJ_ERRNO_MEM);
+
+    return;
+  }
+  SET_SIZE(*pp) = size;
+  OVM_STATS_PAYLOAD(vm, n);
+}
+
+/* Slot holding given member, or empty slot where it would go */
+
+static unsigned
+_obj_set_find(struct ovm *vm, struct obj *set, struct obj *key, unsigned hash)
+{
+  unsigned   mask = SET_SIZE(set) - 1, i;
+  struct obj *r;
+
+  for (i = hash & mask; r = SET_DATA(set)[i]; i = (i + 1) & mask) {
+    if (SET_HASH(set)[i] == hash
+	&& (r == key || obj_key_eq(vm, r, key) || vm->errno != OBJ_ERRNO_NONE)
+	) {
+      break;
+    }
+  }
+
+  return (i);
+}
+
+static unsigned
+_obj_set_has(struct ovm *vm, struct obj *set, struct obj *key, unsigned hash)
+{
+  return (key != 0 && SET_DATA(set)[_obj_set_find(vm, set, key, hash)] != 0);
+}
+
+static void
+obj_set_resize(struct ovm *vm, struct obj *set, unsigned size)
+{
+  struct obj **data, **rr;
+  unsigned   *hh, *h, mask = size - 1, i, n;
+
+  if ((data = calloc(1, size * (sizeof(data[0]) + sizeof(hh[0])))) == 0) {
+    ovm_error(vm, OBJ_ERRNO_MEM);
+
+    return;
+  }
+  OVM_STATS_PAYLOAD(vm, size * (sizeof(data[0]) + sizeof(hh[0])));
+  hh = (unsigned *)(data + size);
+
+  for (rr = SET_DATA(set), h = SET_HASH(set), n = SET_SIZE(set); n; --n, ++rr, ++h) {
+    if (*rr == 0)  continue;
+
+    for (i = *h & mask; data[i]; i = (i + 1) & mask);
+    data[i] = *rr;
+    hh[i]   = *h;
+  }
+
+  free(SET_DATA(set));
+  SET_DATA(set) = data;
+  SET_SIZE(set) = size;
+}
+
+static void
+_obj_set_put(struct ovm *vm, struct obj *set, struct obj *key, unsigned hash)
+{
+  unsigned i;
+
+  if (key == 0) {
+    ovm_error(vm, OBJ_ERRNO_BAD_VALUE);
+
+    return;
+  }
+
+  i = _obj_set_find(vm, set, key, hash);
+  if (vm->errno != OBJ_ERRNO_NONE || SET_DATA(set)[i] != 0)  return;
+
+  if (2 * (SET_CNT(set) + 1) > SET_SIZE(set)) {
+    obj_set_resize(vm, set, 2 * SET_SIZE(set));
+    if (vm->errno != OBJ_ERRNO_NONE)  return;
+
+    for (i = hash & (SET_SIZE(set) - 1); SET_DATA(set)[i]; i = (i + 1) & (SET_SIZE(set) - 1));
+  }
+
+  obj_assign(vm, &SET_DATA(set)[i], key);
+  SET_HASH(set)[i] = hash;
+  ++SET_CNT(set);
+}
+
+static void
+_obj_set_del(struct ovm *vm, struct obj *set, struct obj *key, unsigned hash)
+{
+  unsigned   mask = SET_SIZE(set) - 1, i, j, k;
+  struct obj **data = SET_DATA(set), *r;
+
+  if (key == 0)  return;
+
+  i = _obj_set_find(vm, set, key, hash);
+  if (vm->errno != OBJ_ERRNO_NONE || (r = data[i]) == 0)  return;
+
+  data[i] = 0;
+  --SET_CNT(set);
+
+  /* Move back each following member whose home slot is not between the
+     vacated slot and its own
+  */
+
+  for (j = (i + 1) & mask; data[j]; j = (j + 1) & mask) {
+    k = SET_HASH(set)[j] & mask;
+    if (i <= j ? (k <= i || k > j) : (k <= i && k > j)) {
+      data[i] = data[j];
+      SET_HASH(set)[i] = SET_HASH(set)[j];
+      data[j] = 0;
+      i = j;
+    }
+  }
+
+  obj_release(vm, r);
+}
+
+/* Add members of src to dst; if other is given, only those whose
+   membership in other is as given
+*/
+
+static void
+obj_set_merge(struct ovm *vm, struct obj *dst, struct obj *src, struct obj *other, unsigned member)
+{
+  struct obj **rr;
+  unsigned   *h, n;
+
+  for (rr = SET_DATA(src), h = SET_HASH(src), n = SET_SIZE(src); n; --n, ++rr, ++h) {
+    if (*rr == 0 || (other != 0 && _obj_set_has(vm, other, *rr, *h) != member))  continue;
+
+    _obj_set_put(vm, dst, *rr, *h);
+    if (vm->errno != OBJ_ERRNO_NONE)  return;
+  }
+}
+
+/* Add each element produced by iterating over given object */
+
+static void
+obj_set_add_all(struct ovm *vm, struct obj *set, struct obj *q)
+{
+  struct obj **fp;
+  unsigned   hash;
+
+  fp = ovm_falloc(vm, 2);
+
+  obj_iter_newc(vm, &fp[-1], q);
+  while (vm->errno == OBJ_ERRNO_NONE && obj_iter_step(vm, fp[-1], &fp[-2])) {
+    hash = obj_key_hash(vm, fp[-2]);
+    if (vm->errno != OBJ_ERRNO_NONE)  break;
+
+    _obj_set_put(vm, set, fp[-2], hash);
+  }
+
+  ovm_ffree(vm, fp);
+}
+
+static int
+obj_set_parse(struct ovm *vm, struct obj **pp, unsigned n, char *p)
+{
+  int        result = -1;
+  struct obj **fp;
+
+  trim(&n, &p);
+
+  if (!(n >= 3 && p[0] == '#' && p[1] == '{' && p[n - 1] == '}'))  return (-1);
+
+  fp = ovm_falloc(vm, 2);
+
+  if (obj_seq_parse(vm, &fp[-2], n - 3, p + 2) < 0)  goto done;
+  obj_set_newc(vm, &fp[-1], ARRAY_SIZE(fp[-2]));
+  if (vm->errno != OBJ_ERRNO_NONE)  goto done;
+  obj_set_add_all(vm, fp[-1], fp[-2]);
+  if (vm->errno != OBJ_ERRNO_NONE)  goto done;
+
+  obj_assign(vm, pp, fp[-1]);
+
+  result = 0;
+
+ done:
+  ovm_ffree(vm, fp);
+
+  return (result);
+}
+
+static void
+obj_set_tostring(struct ovm *vm, struct obj **pp, struct obj *q)
+{
+  struct obj **fp, **rr, **ss;
+  unsigned   i, n;
+
+  n = 2 + SET_CNT(q);
+  if (SET_CNT(q) > 1)  n += SET_CNT(q) - 1;
+
+  fp = ovm_falloc(vm, 1);
+
+  obj_array_newc(vm, &fp[-1], n);
+  if (vm->errno != OBJ_ERRNO_NONE)  goto done;
+  rr = ARRAY_DATA(fp[-1]);
+
+  obj_string_newc(vm, rr++, 1, 2, "#{");
+  for (i = 0, ss = SET_DATA(q), n = SET_SIZE(q); n; --n, ++ss) {
+    if (*ss == 0)  continue;
+
+    if (i++ > 0)  obj_string_newc(vm, rr++, 1, 2, ", ");
+    obj_tostring(vm, rr++, *ss);
+  }
+  obj_string_newc(vm, rr, 1, 1, "}");
+
+  obj_string_newv(vm, pp, fp[-1]);
+
+ done:
+  ovm_ffree(vm, fp);
+}
+
+/* Members, as an array */
+
+static void
+obj_set_members(struct ovm *vm, struct obj **pp, struct obj *q)
+{
+  struct obj **fp, **rr, **ss;
+  unsigned   n;
+
+  fp = ovm_falloc(vm, 1);
+
+  obj_array_newc(vm, &fp[-1], SET_CNT(q));
+  if (vm->errno != OBJ_ERRNO_NONE)  goto done;
+  rr = ARRAY_DATA(fp[-1]);
+  for (ss = SET_DATA(q), n = SET_SIZE(q); n; --n, ++ss) {
+    if (*ss)  obj_assign(vm, rr++, *ss);
+  }
+
+  obj_assign(vm, pp, fp[-1]);
+
+ done:
+  ovm_ffree(vm, fp);
+}
+
+static void
+obj_set_new(struct ovm *vm, struct obj **pp, va_list ap)
+{
+  struct obj *q = *_ovm_reg(vm, va_arg(ap, unsigned)), **fp;
+
+  switch (obj_type(q)) {
+  case OBJ_TYPE_INTEGER:
+    if (INTVAL(q) < 0) {
+      ovm_error(vm, OBJ_ERRNO_BAD_VALUE);
+      return;
+    }
+
+    obj_set_newc(vm, pp, INTVAL(q));
+    return;
+
+  case OBJ_TYPE_STRING:
+    if (obj_set_parse(vm, pp, STR_SIZE(q) - 1, STR_DATA(q)) < 0) {
+      ovm_error(vm, OBJ_ERRNO_BAD_VALUE);
+    }
+    return;
+
+  case OBJ_TYPE_SET:
+    fp = ovm_falloc(vm, 1);
+
+    obj_set_newc(vm, &fp[-1], SET_CNT(q));
+    obj_set_merge(vm, fp[-1], q, 0, 0);
+    if (vm->errno == OBJ_ERRNO_NONE)  obj_assign(vm, pp, fp[-1]);
+
+    ovm_ffree(vm, fp);
+    return;
+
+  default:
+    ;
+  }
+
+  fp = ovm_falloc(vm, 1);
+
+  obj_set_newc(vm, &fp[-1], 0);
+  obj_set_add_all(vm, fp[-1], q);
+  if (vm->errno == OBJ_ERRNO_NONE)  obj_assign(vm, pp, fp[-1]);
+
+  ovm_ffree(vm, fp);
+}
+
+static void
+obj_set_append(struct ovm *vm, struct obj **pp, va_list ap)
+{
+  struct obj *q = *_ovm_reg(vm, va_arg(ap, unsigned));
+
+  if (obj_frozen_chk(vm, *pp))  return;
+
+  if (obj_type(q) != OBJ_TYPE_SET) {
+    ovm_error(vm, OBJ_ERRNO_BAD_TYPE);
+    return;
+  }
+
+  obj_set_merge(vm, *pp, q, 0, 0);
+}
+
+static void
+obj_set_at(struct ovm *vm, struct obj **pp, va_list ap)
+{
+  struct obj *q = *_ovm_reg(vm, va_arg(ap, unsigned));
+  unsigned   hash;
+
+  hash = obj_key_hash(vm, q);
+  if (vm->errno != OBJ_ERRNO_NONE)  return;
+
+  obj_bool_newc(vm, pp, _obj_set_has(vm, *pp, q, hash));
+}
+
+/* Set or clear membership, as given by boolean */
+
+static void
+obj_set_at_put(struct ovm *vm, struct obj **pp, va_list ap)
+{
+  struct obj *q = *_ovm_reg(vm, va_arg(ap, unsigned));
+  struct obj *r = *_ovm_reg(vm, va_arg(ap, unsigned));
+  unsigned   hash;
+
+  if (obj_frozen_chk(vm, *pp))  return;
+
+  if (obj_type(r) != OBJ_TYPE_BOOLEAN) {
+    ovm_error(vm, OBJ_ERRNO_BAD_TYPE);
+    return;
+  }
+
+  hash = obj_key_hash(vm, q);
+  if (vm->errno != OBJ_ERRNO_NONE)  return;
+
+  if (BOOLVAL(r)) {
+    _obj_set_put(vm, *pp, q, hash);
+  } else {
+    _obj_set_del(vm, *pp, q, hash);
+  }
+}
+
+static void
+obj_set_count(struct ovm *vm, struct obj **pp, va_list ap)
+{
+  obj_integer_newc(vm, pp, SET_CNT(*pp));
+}
+
+static void
+obj_set_del(struct ovm *vm, struct obj **pp, va_list ap)
+{
+  struct obj *q = *_ovm_reg(vm, va_arg(ap, unsigned));
+  unsigned   hash;
+
+  if (obj_frozen_chk(vm, *pp))  return;
+
+  hash = obj_key_hash(vm, q);
+  if (vm->errno != OBJ_ERRNO_NONE)  return;
+
+  _obj_set_del(vm, *pp, q, hash);
+}
+
+static void
+obj_set_keys(struct ovm *vm, struct obj **pp, va_list ap)
+{
+  struct obj *p = *pp, **fp;
+
+  fp = ovm_falloc(vm, 1);
+
+  obj_set_members(vm, &fp[-1], p);
+  if (vm->errno == OBJ_ERRNO_NONE)  obj_vlist_newc(vm, pp, fp[-1], 0, SET_CNT(p));
+
+  ovm_ffree(vm, fp);
+}
+
+/* Bulk operations, making a new set; each walks each operand's table once */
+
+enum {
+  OBJ_SET_OP_OR,
+  OBJ_SET_OP_AND,
+  OBJ_SET_OP_SUB,
+  OBJ_SET_OP_XOR
+};
+
+static void
+obj_set_op(struct ovm *vm, struct obj **pp, unsigned op, struct obj *q)
+{
+  struct obj *p = *pp, **fp, *t;
+
+  if (obj_type(q) != OBJ_TYPE_SET) {
+    ovm_error(vm, OBJ_ERRNO_BAD_TYPE);
+    return;
+  }
+
+  fp = ovm_falloc(vm, 1);
+
+  switch (op) {
+  case OBJ_SET_OP_OR:
+    obj_set_newc(vm, &fp[-1], SET_CNT(p) + SET_CNT(q));
+    if (vm->errno != OBJ_ERRNO_NONE)  break;
+    obj_set_merge(vm, fp[-1], p, 0, 0);
+    if (vm->errno != OBJ_ERRNO_NONE)  break;
+    obj_set_merge(vm, fp[-1], q, 0, 0);
+    break;
+
+  case OBJ_SET_OP_AND:
+    if (SET_CNT(p) > SET_CNT(q)) {
+      t = p;  p = q;  q = t;
+    }
+    obj_set_newc(vm, &fp[-1], SET_CNT(p));
+    if (vm->errno != OBJ_ERRNO_NONE)  break;
+    obj_set_merge(vm, fp[-1], p, q, 1);
+    break;
+
+  case OBJ_SET_OP_SUB:
+    obj_set_newc(vm, &fp[-1], SET_CNT(p));
+    if (vm->errno != OBJ_ERRNO_NONE)  break;
+    obj_set_merge(vm, fp[-1], p, q, 0);
+    break;
+
+  case OBJ_SET_OP_XOR:
+    obj_set_newc(vm, &fp[-1], SET_CNT(p) + SET_CNT(q));
+    if (vm->errno != OBJ_ERRNO_NONE)  break;
+    obj_set_merge(vm, fp[-1], p, q, 0);
+    if (vm->errno != OBJ_ERRNO_NONE)  break;
+    obj_set_merge(vm, fp[-1], q, p, 0);
+    break;
+
+  default:
+    assert(0);
+  }
+
+  if (vm->errno == OBJ_ERRNO_NONE)  obj_assign(vm, pp, fp[-1]);
+
+  ovm_ffree(vm, fp);
+}
+
+static void
+obj_set_or(struct ovm *vm, struct obj **pp, va_list ap)
+{
+  obj_set_op(vm, pp, OBJ_SET_OP_OR, *_ovm_reg(vm, va_arg(ap, unsigned)));
+}
+
+static void
+obj_set_and(struct ovm *vm, struct obj **pp, va_list ap)
+{
+  obj_set_op(vm, pp, OBJ_SET_OP_AND, *_ovm_reg(vm, va_arg(ap, unsigned)));
+}
+
+static void
+obj_set_sub(struct ovm *vm, struct obj **pp, va_list ap)
+{
+  obj_set_op(vm, pp, OBJ_SET_OP_SUB, *_ovm_reg(vm, va_arg(ap, unsigned)));
+}
+
+static void
+obj_set_xor(struct ovm *vm, struct obj **pp, va_list ap)
+{
+  obj_set_op(vm, pp, OBJ_SET_OP_XOR, *_ovm_reg(vm, va_arg(ap, unsigned)));
+}
+
+/***************************************************************************/
+
+/* Hashing, to a native value: no allocation, and no use of registers.
+   Composites memoize their hash, which is only safe while they are not
+   written: pairs and lists are built before they are handed out, and the
+   one in-place write after that, a DICT updating an unshared entry pair,
+   clears the pair's memo.  Frozen objects may be shared between threads, so
+   are not memoized here, but when frozen.
+*/
+
+static struct objval_hash_memo *
+obj_hash_memo(struct obj *p)
+{
+  return (obj_type(p) == OBJ_TYPE_VLIST ? &p->val.vlistval.hash : &p->val.dptrval.hash);
+}
+
+static void
+obj_hash_memo_put(struct obj *p, unsigned h)
+{
+  struct objval_hash_memo *m = obj_hash_memo(p);
+
+  m->val   = h;
+  m->valid = 1;
+}
+
+/* Returns 0 if successful, or -1 if object is not hashable */
+
+static int
+_obj_hash(struct obj *p, unsigned *h)
+{
+  unsigned         r[1], k;
+  struct list_iter it[1];
+  struct obj       *li;
+  double           d;
+
+  switch (obj_type(p)) {
+  case OBJ_TYPE_NIL:
+    *h = 0;
+    return (0);
+  case OBJ_TYPE_BOOLEAN:
+    *h = BOOLVAL(p) != 0;
+    return (0);
+  case OBJ_TYPE_INTEGER:
+    crc_init(r);
+    *h = crc32(r, sizeof(INTVAL(p)), (unsigned char *) &INTVAL(p));
+    return (0);
+  case OBJ_TYPE_FLOAT:
+    /* Equal values hash alike: one NaN, one zero, and no padding bytes */
+
+    d = FLOATVAL(p) != FLOATVAL(p) ? __builtin_nan("") : FLOATVAL(p) == 0 ? 0.0 : FLOATVAL(p);
+    crc_init(r);
+    *h = crc32(r, sizeof(d), (unsigned char *) &d);
+    return (0);
+  case OBJ_TYPE_STRING:
+    crc_init(r);
+    *h = crc32(r, STR_SIZE(p) - 1, (unsigned char *) STR_DATA(p));
+    return (0);
+
+  case OBJ_TYPE_PAIR:
+    if (obj_hash_memo(p)->valid) {
+      *h = obj_hash_memo(p)->val;
+      return (0);
+    }
+    if (_obj_hash(CAR(p), h) < 0 || _obj_hash(CDR(p), &k) < 0)  return (-1);
+    *h += k;
+    break;
+
+  case OBJ_TYPE_LIST:
+  case OBJ_TYPE_VLIST:
+    /* Sum of elements; stop at a tail with a memoized hash */
+
+    for (*h = 0, list_iter_init(it, p); li = it->li; list_iter_next(it)) {
+      if (it->idx == 0 && obj_hash_memo(li)->valid) {
+	*h += obj_hash_memo(li)->val;
+	break;
+      }
+      if (_obj_hash(list_iter_car(it), &k) < 0)  return (-1);
+      *h += k;
+    }
+    break;
+
+  default:
+    return (-1);
+  }
+
+  if (!obj_is_frozen(p))  obj_hash_memo_put(p, *h);
+
+  return (0);
+}
+
+static void
+obj_hash(struct ovm *vm, struct obj **pp, va_list ap)
+{
+  unsigned h;
+
+  if (_obj_hash(*pp, &h) < 0) {
+    ovm_error(vm, OBJ_ERRNO_BAD_METHOD);
+    return;
+  }
+
+  obj_integer_newc(vm, pp, h);
+}
+
+/***************************************************************************/
+
+/* Structural equality, native for all built-in types: no method dispatch,
+   and no BOOLEAN allocated per comparison.  Identical objects, and shared
+   list tails and vectors, compare equal without descending into them; for
+   that to agree with comparing copies, a FLOAT NaN equals any other NaN.
+   DICTs are compared by identity only.
+
+   Returns 1 if equal, 0 if not, or -1 (and sets error) if an element has no
+   equality.
+*/
+
+/* Whether both composites have memoized hashes, which differ */
+
+static unsigned
+obj_hash_differ(struct obj *p, struct obj *q)
+{
+  return (q != 0
+	  && obj_hash_memo(p)->valid
+	  && obj_hash_memo(q)->valid
+	  && obj_hash_memo(p)->val != obj_hash_memo(q)->val
+	  );
+}
+
+static int
+obj_equal_vec(struct ovm *vm, struct obj **pp, struct obj **qq, unsigned n)
+{
+  int result;
+
+  if (pp == qq)  return (1);
+
+  for ( ; n; --n, ++pp, ++qq) {
+    if ((result = obj_equal(vm, *pp, *qq)) != 1)  return (result);
+  }
+
+  return (1);
+}
+
+static unsigned
+obj_float_equal(obj_float_val_t x, obj_float_val_t y)
+{
+  return (x == y || (x != x && y != y));
+}
+
+static int
+obj_list_equal(struct ovm *vm, struct obj *p, struct obj *q)
+{
+  struct list_iter it1[1], it2[1];
+  unsigned         n;
+  int              result;
+
+  for (list_iter_init(it1, p), list_iter_init(it2, q);
+       it1->li && it2->li;
+       list_iter_next(it1), list_iter_next(it2)
+       ) {
+    if (it1->li == it2->li && it1->idx == it2->idx)  return (1);
+
+    if (obj_type(it1->li) == OBJ_TYPE_VLIST && obj_type(it2->li) == OBJ_TYPE_VLIST) {
+      if ((n = VLIST_SIZE(it1->li) - it1->idx) != VLIST_SIZE(it2->li) - it2->idx)  return (0);
+
+      return (obj_equal_vec(vm, VLIST_DATA(it1->li) + it1->idx, VLIST_DATA(it2->li) + it2->idx, n));
+    }
+
+    if ((result = obj_equal(vm, list_iter_car(it1), list_iter_car(it2))) != 1)  return (result);
+  }
+
+  return (it1->li == 0 && it2->li == 0);
+}
+
+static int
+obj_equal(struct ovm *vm, struct obj *p, struct obj *q)
+{
+  struct obj **rr;
+  unsigned   *h, n;
+  int        result;
+
+ again:
+  if (p == q)  return (1);
+
+  switch (obj_type(p)) {
+  case OBJ_TYPE_NIL:
+    return (0);
+  case OBJ_TYPE_BOOLEAN:
+    return (obj_type(q) == OBJ_TYPE_BOOLEAN && (BOOLVAL(p) != 0) == (BOOLVAL(q) != 0));
+  case OBJ_TYPE_INTEGER:
+    return (obj_type(q) == OBJ_TYPE_INTEGER && INTVAL(p) == INTVAL(q));
+  case OBJ_TYPE_FLOAT:
+    return (obj_type(q) == OBJ_TYPE_FLOAT && obj_float_equal(FLOATVAL(p), FLOATVAL(q)));
+  case OBJ_TYPE_STRING:
+    return (obj_type(q) == OBJ_TYPE_STRING
+	    && STR_SIZE(p) == STR_SIZE(q)
+	    && memcmp(STR_DATA(p), STR_DATA(q), STR_SIZE(p)) == 0
+	    );
+
+  case OBJ_TYPE_PAIR:
+    if (obj_type(q) != OBJ_TYPE_PAIR || obj_hash_differ(p, q))  return (0);
+    if ((result = obj_equal(vm, CAR(p), CAR(q))) != 1)  return (result);
+    p = CDR(p);
+    q = CDR(q);
+    goto again;
+
+  case OBJ_TYPE_LIST:
+  case OBJ_TYPE_VLIST:
+    return (is_list(q) && !obj_hash_differ(p, q) ? obj_list_equal(vm, p, q) : 0);
+
+  case OBJ_TYPE_ARRAY:
+    return (obj_type(q) == OBJ_TYPE_ARRAY && (n = ARRAY_SIZE(p)) == ARRAY_SIZE(q)
+	    ? obj_equal_vec(vm, ARRAY_DATA(p), ARRAY_DATA(q), n) : 0
+	    );
+
+  case OBJ_TYPE_SET:
+    if (obj_type(q) != OBJ_TYPE_SET || SET_CNT(q) != SET_CNT(p))  return (0);
+    for (rr = SET_DATA(p), h = SET_HASH(p), n = SET_SIZE(p); n; --n, ++rr, ++h) {
+      if (*rr && !_obj_set_has(vm, q, *rr, *h)) {
+	return (vm->errno != OBJ_ERRNO_NONE ? -1 : 0);
+      }
+    }
+    return (1);
+
+  case OBJ_TYPE_DICT:
+    /* Compared by identity only */
+
+    return (0);
+
+  default:
+    ;
+  }
+
+  ovm_error(vm, OBJ_ERRNO_BAD_METHOD);
+
+  return (-1);
+}
+
+static void
+obj_eq(struct ovm *vm, struct obj **pp, va_list ap)
+{
+  int result = obj_equal(vm, *pp, *_ovm_reg(vm, va_arg(ap, unsigned)));
+
+  if (result >= 0)  obj_bool_newc(vm, pp, result);
+}
+
+/***************************************************************************/
+
+void (*op_func_tbl[OBJ_NUM_TYPES][OBJ_NUM_OPS])(struct ovm *, struct obj **, va_list) = {
+  /* OBJ_TYPE_OBJECT */
+  { 0 },
+  
+  /* OBJ_TYPE_NIL */
+  { 0,				/* OBJ_OP_ABS */
+    0,				/* OBJ_OP_ADD */
+    0,				/* OBJ_OP_AND */
+    obj_nil_append,		/* OBJ_OP_APPEND */
+    obj_nil_at,			/* OBJ_OP_AT */
+    0,				/* OBJ_OP_AT_PUT */
+    0,				/* OBJ_OP_CAR */
+    0,				/* OBJ_OP_CDR */
+    0,				/* OBJ_OP_COUNT */
+    0,				/* OBJ_OP_DEL */
+    0,				/* OBJ_OP_DIV */
+    obj_eq,			/* OBJ_OP_EQ */
+    obj_nil_filter,		/* OBJ_OP_FILTER */
+    0,				/* OBJ_OP_FIND */
+    0,				/* OBJ_OP_GT */
+    obj_hash,			/* OBJ_OP_HASH */
+    0,				/* OBJ_OP_JOIN */
+    0,				/* OBJ_OP_KEYS */
+    0,				/* OBJ_OP_LT */
+    0,				/* OBJ_OP_MINUS */
+    0,				/* OBJ_OP_MOD */
+    0,				/* OBJ_OP_MULT */
+    0,				/* OBJ_OP_NEXT */
+    0,				/* OBJ_OP_NOT */
+    0,				/* OBJ_OP_OR */
+    obj_nil_reverse,		/* OBJ_OP_REVERSE */
+    obj_nil_size,		/* OBJ_OP_SIZE */
+    obj_nil_slice,		/* OBJ_OP_SLICE */
+    0,				/* OBJ_OP_SORT */
+    0,				/* OBJ_OP_SPLIT */
+    0,				/* OBJ_OP_SUB */
+    0				/* OBJ_OP_XOR */
+  },
+
+  /* OBJ_TYPE_POINTER */
+  { 0 },
+  
+  /* OBJ_TYPE_BOOLEAN */
+  { 0,				/* OBJ_OP_ABS */
+    0,				/* OBJ_OP_ADD */
+    obj_bool_and,		/* OBJ_OP_AND */
+    0,				/* OBJ_OP_APPEND */
+    0,				/* OBJ_OP_AT */
+    0,				/* OBJ_OP_AT_PUT */
+    0,				/* OBJ_OP_CAR */
+    0,				/* OBJ_OP_CDR */
+    0,				/* OBJ_OP_COUNT */
+    0,				/* OBJ_OP_DEL */
+    0,				/* OBJ_OP_DIV */
+    obj_eq,			/* OBJ_OP_EQ */
+    0,				/* OBJ_OP_FILTER */
+    0,				/* OBJ_OP_FIND */
+    0,				/* OBJ_OP_GT */
+    obj_hash,			/* OBJ_OP_HASH */
+    0,				/* OBJ_OP_JOIN */
+    0,				/* OBJ_OP_KEYS */
+    0,				/* OBJ_OP_LT */
+    0,				/* OBJ_OP_MINUS */
+    0,				/* OBJ_OP_MOD */
+    0,				/* OBJ_OP_MULT */
+    0,				/* OBJ_OP_NEXT */
+    obj_bool_not,		/* OBJ_OP_NOT */
+    obj_bool_or,		/* OBJ_OP_OR */
+    0,				/* OBJ_OP_REVERSE */
+    0,				/* OBJ_OP_SIZE */
+    0,				/* OBJ_OP_SLICE */
+    0,				/* OBJ_OP_SORT */
+    0,				/* OBJ_OP_SPLIT */
+    0,				/* OBJ_OP_SUB */
+    obj_bool_xor		/* OBJ_OP_XOR */
+  },
+
+  /* OBJ_TYPE_NUMBER */
+  { 0 },
+
+  /* OBJ_TYPE_INTEGER */
+  { 0,				/* OBJ_OP_ABS */
+    obj_integer_add,		/* OBJ_OP_ADD */
+    obj_integer_and,		/* OBJ_OP_AND */
+    0,				/* OBJ_OP_APPEND */
+    0,				/* OBJ_OP_AT */
+    0,				/* OBJ_OP_AT_PUT */
+    0,				/* OBJ_OP_CAR */
+    0,				/* OBJ_OP_CDR */
+    0,				/* OBJ_OP_COUNT */
+    0,				/* OBJ_OP_DEL */
+    obj_integer_div,		/* OBJ_OP_DIV */
+    obj_eq,			/* OBJ_OP_EQ */
+    0,				/* OBJ_OP_FILTER */
+    0,				/* OBJ_OP_FIND */
+    obj_integer_gt,		/* OBJ_OP_GT */
+    obj_hash,			/* OBJ_OP_HASH */
+    0,				/* OBJ_OP_JOIN */
+    0,				/* OBJ_OP_KEYS */
+    obj_integer_lt,		/* OBJ_OP_LT */
+    obj_integer_minus,		/* OBJ_OP_MINUS */
+    obj_integer_mod,		/* OBJ_OP_MOD */
+    obj_integer_mult,		/* OBJ_OP_MULT */
+    0,				/* OBJ_OP_NEXT */
+    0,				/* OBJ_OP_NOT */
+    obj_integer_or,		/* OBJ_OP_OR */
+    0,				/* OBJ_OP_REVERSE */
+    0,				/* OBJ_OP_SIZE */
+    0,				/* OBJ_OP_SLICE */
+    0,				/* OBJ_OP_SORT */
+    0,				/* OBJ_OP_SPLIT */
+    obj_integer_sub,		/* OBJ_OP_SUB */
+    obj_integer_xor		/* OBJ_OP_XOR */
+  },
+
+  /* OBJ_TYPE_FLOAT */
+  { obj_float_abs,		/* OBJ_OP_ABS */
+    obj_float_add,		/* OBJ_OP_ADD */
+    0,				/* OBJ_OP_AND */
+    0,				/* OBJ_OP_APPEND */
+    0,				/* OBJ_OP_AT */
+    0,				/* OBJ_OP_AT_PUT */
+    0,				/* OBJ_OP_CAR */
+    0,				/* OBJ_OP_CDR */
+    0,				/* OBJ_OP_COUNT */
+    0,				/* OBJ_OP_DEL */
+    obj_float_div,		/* OBJ_OP_DIV */
+    obj_eq,			/* OBJ_OP_EQ */
+    0,				/* OBJ_OP_FILTER */
+    0,				/* OBJ_OP_FIND */
+    obj_float_gt,		/* OBJ_OP_GT */
+    obj_hash,			/* OBJ_OP_HASH */
+    0,				/* OBJ_OP_JOIN */
+    0,				/* OBJ_OP_KEYS */
+    obj_float_lt,		/* OBJ_OP_LT */
+    obj_float_minus,		/* OBJ_OP_MINUS */
+    0,				/* OBJ_OP_MOD */
+    obj_float_mult,		/* OBJ_OP_MULT */
+    0,				/* OBJ_OP_NEXT */
+    0,				/* OBJ_OP_NOT */
+    0,				/* OBJ_OP_OR */
+    0,				/* OBJ_OP_REVERSE */
+    0,				/* OBJ_OP_SIZE */
+    0,				/* OBJ_OP_SLICE */
+    0,				/* OBJ_OP_SORT */
+    0,				/* OBJ_OP_SPLIT */
+    obj_float_sub,		/* OBJ_OP_SUB */
+    0				/* OBJ_OP_XOR */
+  },
+
+  /* OBJ_TYPE_BLOCK */
+  { 0 },
+
+  /* OBJ_TYPE_STRING */
+  { 0,				/* OBJ_OP_ABS */
+    0,				/* OBJ_OP_ADD */
+    0,				/* OBJ_OP_AND */
+    obj_string_append,		/* OBJ_OP_APPEND */
+    obj_string_at,		/* OBJ_OP_AT */
+    0,				/* OBJ_OP_AT_PUT */
+    0,				/* OBJ_OP_CAR */
+    0,				/* OBJ_OP_CDR */
+    obj_string_count,		/* OBJ_OP_COUNT */
+    0,				/* OBJ_OP_DEL */
+    0,				/* OBJ_OP_DIV */
+    obj_eq,			/* OBJ_OP_EQ */
+    0,				/* OBJ_OP_FILTER */
+    obj_string_find,		/* OBJ_OP_FIND */
+    obj_string_gt,		/* OBJ_OP_GT */
+    obj_hash,			/* OBJ_OP_HASH */
+    obj_string_join,		/* OBJ_OP_JOIN */
+    0,				/* OBJ_OP_KEYS */
+    obj_string_lt,		/* OBJ_OP_LT */
+    0,				/* OBJ_OP_MINUS */
+    0,				/* OBJ_OP_MOD */
+    0,				/* OBJ_OP_MULT */
+    0,				/* OBJ_OP_NEXT */
+    0,				/* OBJ_OP_NOT */
+    0,				/* OBJ_OP_OR */
+    obj_string_reverse,		/* OBJ_OP_REVERSE */
+    _obj_string_size,		/* OBJ_OP_SIZE */
+    obj_string_slice,		/* OBJ_OP_SLICE */
+    0,				/* OBJ_OP_SORT */
+    obj_string_split,		/* OBJ_OP_SPLIT */
+    0,				/* OBJ_OP_SUB */
+    0				/* OBJ_OP_XOR */
+  },
+
+  /* OBJ_TYPE_BYTES */
+  { 0 },
+
+  /* OBJ_TYPE_WORDS */
+  { 0 },
+
+  /* OBJ_TYPE_DWORDS */
+  { 0 },
+
+  /* OBJ_TYPE_QWORDS */
+  { 0 },
+
+  /* OBJ_TYPE_BITS */
+  { 0 },
+
+  /* OBJ_TYPE_DPTR */
+  { 0,				/* OBJ_OP_ABS */
+    0,				/* OBJ_OP_ADD */
+    0,				/* OBJ_OP_AND */
+    0,				/* OBJ_OP_APPEND */
+    0,				/* OBJ_OP_AT */
+    0,				/* OBJ_OP_AT_PUT */
+    obj_dptr_car,		/* OBJ_OP_CAR */
     obj_dptr_cdr,		/* OBJ_OP_CDR */
     0,				/* OBJ_OP_COUNT */
     0,				/* OBJ_OP_DEL */
     0,				/* OBJ_OP_DIV */
     0,				/* OBJ_OP_EQ */
     0,				/* OBJ_OP_FILTER */
+    0,				/* OBJ_OP_FIND */
     0,				/* OBJ_OP_GT */
     0,				/* OBJ_OP_HASH */
     0,				/* OBJ_OP_JOIN */
@@ -3067,6 +5070,7 @@ void (*op_func_tbl[OBJ_NUM_TYPES][OBJ_NUM_OPS])(struct ovm *, struct obj **, va_
     0,				/* OBJ_OP_MINUS */
     0,				/* OBJ_OP_MOD */
     0,				/* OBJ_OP_MULT */
+    0,				/* OBJ_OP_NEXT */
     0,				/* OBJ_OP_NOT */
     0,				/* OBJ_OP_OR */
     0,				/* OBJ_OP_REVERSE */
@@ -3090,16 +5094,18 @@ void (*op_func_tbl[OBJ_NUM_TYPES][OBJ_NUM_OPS])(struct ovm *, struct obj **, va_
     0,				/* OBJ_OP_COUNT */
     0,				/* OBJ_OP_DEL */
     0,				/* OBJ_OP_DIV */
-    obj_pair_eq,		/* OBJ_OP_EQ */
+    obj_eq,			/* OBJ_OP_EQ */
     0,				/* OBJ_OP_FILTER */
+    0,				/* OBJ_OP_FIND */
     0,				/* OBJ_OP_GT */
-    obj_pair_hash,		/* OBJ_OP_HASH */
+    obj_hash,			/* OBJ_OP_HASH */
     0,				/* OBJ_OP_JOIN */
     0,				/* OBJ_OP_KEYS */
     0,				/* OBJ_OP_LT */
     0,				/* OBJ_OP_MINUS */
     0,				/* OBJ_OP_MOD */
     0,				/* OBJ_OP_MULT */
+    0,				/* OBJ_OP_NEXT */
     0,				/* OBJ_OP_NOT */
     0,				/* OBJ_OP_OR */
     obj_pair_reverse,		/* OBJ_OP_REVERSE */
@@ -3123,16 +5129,18 @@ void (*op_func_tbl[OBJ_NUM_TYPES][OBJ_NUM_OPS])(struct ovm *, struct obj **, va_
     0,				/* OBJ_OP_COUNT */
     0,				/* OBJ_OP_DEL */
     0,				/* OBJ_OP_DIV */
-    obj_list_eq,		/* OBJ_OP_EQ */
+    obj_eq,			/* OBJ_OP_EQ */
     obj_list_filter,		/* OBJ_OP_FILTER */
+    0,				/* OBJ_OP_FIND */
     0,				/* OBJ_OP_GT */
-    obj_list_hash,		/* OBJ_OP_HASH */
+    obj_hash,			/* OBJ_OP_HASH */
     0,				/* OBJ_OP_JOIN */
     0,				/* OBJ_OP_KEYS */
     0,				/* OBJ_OP_LT */
     0,				/* OBJ_OP_MINUS */
     0,				/* OBJ_OP_MOD */
     0,				/* OBJ_OP_MULT */
+    0,				/* OBJ_OP_NEXT */
     0,				/* OBJ_OP_NOT */
     0,				/* OBJ_OP_OR */
     obj_list_reverse,		/* OBJ_OP_REVERSE */
@@ -3156,8 +5164,9 @@ void (*op_func_tbl[OBJ_NUM_TYPES][OBJ_NUM_OPS])(struct ovm *, struct obj **, va_
     0,				/* OBJ_OP_COUNT */
     0,				/* OBJ_OP_DEL */
     0,				/* OBJ_OP_DIV */
-    obj_array_eq,		/* OBJ_OP_EQ */
+    obj_eq,			/* OBJ_OP_EQ */
     obj_array_filter,		/* OBJ_OP_FILTER */
+    0,				/* OBJ_OP_FIND */
     0,				/* OBJ_OP_GT */
     0,				/* OBJ_OP_HASH */
     0,				/* OBJ_OP_JOIN */
@@ -3166,6 +5175,7 @@ void (*op_func_tbl[OBJ_NUM_TYPES][OBJ_NUM_OPS])(struct ovm *, struct obj **, va_
     0,				/* OBJ_OP_MINUS */
     0,				/* OBJ_OP_MOD */
     0,				/* OBJ_OP_MULT */
+    0,				/* OBJ_OP_NEXT */
     0,				/* OBJ_OP_NOT */
     0,				/* OBJ_OP_OR */
     obj_array_reverse,		/* OBJ_OP_REVERSE */
@@ -3191,321 +5201,1620 @@ void (*op_func_tbl[OBJ_NUM_TYPES][OBJ_NUM_OPS])(struct ovm *, struct obj **, va_
     0,				/* OBJ_OP_DIV */
     0,				/* OBJ_OP_EQ */
     obj_bad_method,		/* OBJ_OP_FILTER */
+    0,				/* OBJ_OP_FIND */
+    0,				/* OBJ_OP_GT */
+    0,				/* OBJ_OP_HASH */
+    0,				/* OBJ_OP_JOIN */
+    obj_dict_keys,		/* OBJ_OP_KEYS */
+    0,				/* OBJ_OP_LT */
+    0,				/* OBJ_OP_MINUS */
+    0,				/* OBJ_OP_MOD */
+    0,				/* OBJ_OP_MULT */
+    0,				/* OBJ_OP_NEXT */
+    0,				/* OBJ_OP_NOT */
+    0,				/* OBJ_OP_OR */
+    obj_bad_method,		/* OBJ_OP_REVERSE */
+    0,				/* OBJ_OP_SIZE */
+    obj_bad_method,		/* OBJ_OP_SLICE */
+    obj_bad_method,		/* OBJ_OP_SORT */
+    0,				/* OBJ_OP_SPLIT */
+    0,				/* OBJ_OP_SUB */
+    0				/* OBJ_OP_XOR */
+  },
+  
+  /* OBJ_TYPE_ITERATOR */
+  { 0,				/* OBJ_OP_ABS */
+    0,				/* OBJ_OP_ADD */
+    0,				/* OBJ_OP_AND */
+    0,				/* OBJ_OP_APPEND */
+    0,				/* OBJ_OP_AT */
+    0,				/* OBJ_OP_AT_PUT */
+    0,				/* OBJ_OP_CAR */
+    0,				/* OBJ_OP_CDR */
+    0,				/* OBJ_OP_COUNT */
+    0,				/* OBJ_OP_DEL */
+    0,				/* OBJ_OP_DIV */
+    0,				/* OBJ_OP_EQ */
+    obj_iter_filter,		/* OBJ_OP_FILTER */
+    0,				/* OBJ_OP_FIND */
+    0,				/* OBJ_OP_GT */
+    0,				/* OBJ_OP_HASH */
+    0,				/* OBJ_OP_JOIN */
+    obj_iter_keys,		/* OBJ_OP_KEYS */
+    0,				/* OBJ_OP_LT */
+    0,				/* OBJ_OP_MINUS */
+    0,				/* OBJ_OP_MOD */
+    0,				/* OBJ_OP_MULT */
+    obj_iter_next,		/* OBJ_OP_NEXT */
+    0,				/* OBJ_OP_NOT */
+    0,				/* OBJ_OP_OR */
+    obj_iter_reverse,		/* OBJ_OP_REVERSE */
+    0,				/* OBJ_OP_SIZE */
+    obj_iter_slice,		/* OBJ_OP_SLICE */
+    obj_bad_method,		/* OBJ_OP_SORT */
+    0,				/* OBJ_OP_SPLIT */
+    0,				/* OBJ_OP_SUB */
+    0				/* OBJ_OP_XOR */
+  },
+  
+  /* OBJ_TYPE_PDICT */
+  { 0,				/* OBJ_OP_ABS */
+    0,				/* OBJ_OP_ADD */
+    0,				/* OBJ_OP_AND */
+    0,				/* OBJ_OP_APPEND */
+    obj_pdict_at,		/* OBJ_OP_AT */
+    obj_pdict_at_put,		/* OBJ_OP_AT_PUT */
+    0,				/* OBJ_OP_CAR */
+    0,				/* OBJ_OP_CDR */
+    obj_pdict_count,		/* OBJ_OP_COUNT */
+    obj_pdict_del,		/* OBJ_OP_DEL */
+    0,				/* OBJ_OP_DIV */
+    0,				/* OBJ_OP_EQ */
+    0,				/* OBJ_OP_FILTER */
+    0,				/* OBJ_OP_FIND */
+    0,				/* OBJ_OP_GT */
+    0,				/* OBJ_OP_HASH */
+    0,				/* OBJ_OP_JOIN */
+    obj_pdict_keys,		/* OBJ_OP_KEYS */
+    0,				/* OBJ_OP_LT */
+    0,				/* OBJ_OP_MINUS */
+    0,				/* OBJ_OP_MOD */
+    0,				/* OBJ_OP_MULT */
+    0,				/* OBJ_OP_NEXT */
+    0,				/* OBJ_OP_NOT */
+    0,				/* OBJ_OP_OR */
+    0,				/* OBJ_OP_REVERSE */
+    0,				/* OBJ_OP_SIZE */
+    0,				/* OBJ_OP_SLICE */
+    0,				/* OBJ_OP_SORT */
+    0,				/* OBJ_OP_SPLIT */
+    0,				/* OBJ_OP_SUB */
+    0				/* OBJ_OP_XOR */
+  },
+  
+  /* OBJ_TYPE_SET */
+  { 0,				/* OBJ_OP_ABS */
+    0,				/* OBJ_OP_ADD */
+    obj_set_and,		/* OBJ_OP_AND */
+    obj_set_append,		/* OBJ_OP_APPEND */
+    obj_set_at,			/* OBJ_OP_AT */
+    obj_set_at_put,		/* OBJ_OP_AT_PUT */
+    0,				/* OBJ_OP_CAR */
+    0,				/* OBJ_OP_CDR */
+    obj_set_count,		/* OBJ_OP_COUNT */
+    obj_set_del,		/* OBJ_OP_DEL */
+    0,				/* OBJ_OP_DIV */
+    obj_eq,			/* OBJ_OP_EQ */
+    obj_bad_method,		/* OBJ_OP_FILTER */
+    0,				/* OBJ_OP_FIND */
+    0,				/* OBJ_OP_GT */
+    obj_bad_method,		/* OBJ_OP_HASH */
+    0,				/* OBJ_OP_JOIN */
+    obj_set_keys,		/* OBJ_OP_KEYS */
+    0,				/* OBJ_OP_LT */
+    0,				/* OBJ_OP_MINUS */
+    0,				/* OBJ_OP_MOD */
+    0,				/* OBJ_OP_MULT */
+    0,				/* OBJ_OP_NEXT */
+    0,				/* OBJ_OP_NOT */
+    obj_set_or,			/* OBJ_OP_OR */
+    obj_bad_method,		/* OBJ_OP_REVERSE */
+    obj_set_count,		/* OBJ_OP_SIZE */
+    obj_bad_method,		/* OBJ_OP_SLICE */
+    obj_bad_method,		/* OBJ_OP_SORT */
+    0,				/* OBJ_OP_SPLIT */
+    obj_set_sub,		/* OBJ_OP_SUB */
+    obj_set_xor			/* OBJ_OP_XOR */
+  },
+
+  /* Internal types */
+
+  /* OBJ_TYPE_HAMT */
+  { 0 },
+
+  /* OBJ_TYPE_VLIST */
+  { 0,				/* OBJ_OP_ABS */
+    0,				/* OBJ_OP_ADD */
+    0,				/* OBJ_OP_AND */
+    0,				/* OBJ_OP_APPEND */
+    obj_vlist_at,		/* OBJ_OP_AT */
+    0,				/* OBJ_OP_AT_PUT */
+    obj_vlist_car,		/* OBJ_OP_CAR */
+    obj_vlist_cdr,		/* OBJ_OP_CDR */
+    0,				/* OBJ_OP_COUNT */
+    0,				/* OBJ_OP_DEL */
+    0,				/* OBJ_OP_DIV */
+    0,				/* OBJ_OP_EQ */
+    0,				/* OBJ_OP_FILTER */
+    0,				/* OBJ_OP_FIND */
     0,				/* OBJ_OP_GT */
     0,				/* OBJ_OP_HASH */
     0,				/* OBJ_OP_JOIN */
-    obj_dict_keys,		/* OBJ_OP_KEYS */
+    0,				/* OBJ_OP_KEYS */
     0,				/* OBJ_OP_LT */
     0,				/* OBJ_OP_MINUS */
     0,				/* OBJ_OP_MOD */
     0,				/* OBJ_OP_MULT */
+    0,				/* OBJ_OP_NEXT */
     0,				/* OBJ_OP_NOT */
     0,				/* OBJ_OP_OR */
-    obj_bad_method,		/* OBJ_OP_REVERSE */
-    0,				/* OBJ_OP_SIZE */
-    obj_bad_method,		/* OBJ_OP_SLICE */
-    obj_bad_method,		/* OBJ_OP_SORT */
+    0,				/* OBJ_OP_REVERSE */
+    obj_vlist_size,		/* OBJ_OP_SIZE */
+    0,				/* OBJ_OP_SLICE */
+    0,				/* OBJ_OP_SORT */
     0,				/* OBJ_OP_SPLIT */
     0,				/* OBJ_OP_SUB */
     0				/* OBJ_OP_XOR */
   }
-};
+};
+
+/***************************************************************************/
+
+/** ************************************************************************
+
+\brief Intialize VM
+
+The object pool region also holds the pool's liveness bitmap, one bit per
+object, after the objects.  So the pool holds the largest n objects such
+that n objects and ceil(n / 32) 32-bit words fit in obj_pool_size, about
+obj_pool_size / (sizeof(struct obj) + 1/8), a few fewer objects than would
+fit in the region alone.  Size the region for the bitmap as well, e.g.
+OVM_POOL_SIZE(n) bytes for n objects.
+
+\param[in] vm            VM instance
+\param[in] obj_pool_size Size of memory region to use as object pool, in bytes
+\param[in] obj_pool      Start of memory region to use as object pool
+\param[in] work_size     Size of memory region to use as object working storage, in bytes
+\param[in] work          Start of memory region to use as object working storage
+\param[in] stack_size    Size of memory region to use as object stack, in bytes
+\param[in] stack         Start of memory region to use as object stack
+
+\returns Nothing
+
+*/
+
+void
+ovm_init(struct ovm  *vm,
+	    unsigned obj_pool_size,
+	    void     *obj_pool,
+	    unsigned work_size,
+	    void     *work,
+	    unsigned stack_size,
+	    void     *stack
+	    )
+{
+  struct obj *p;
+  unsigned   i, n;
+
+  memset(vm, 0, sizeof(*vm));
+
+#ifdef OVM_STATS
+  if ((vm->stats = calloc(1, sizeof(*vm->stats))) == 0) {
+    vm->errno = OBJ_ERRNO_MEM;
+    return;
+  }
+#endif
+  
+  /* Pool region holds objects, followed by occupancy bitmap */
+
+  n = (8ULL * obj_pool_size) / (8 * sizeof(struct obj) + 1);
+  while (n * sizeof(struct obj) + (n + BITS_PER_WORD - 1) / BITS_PER_WORD * sizeof(unsigned) > obj_pool_size) {
+    --n;
+  }
+  vm->obj_pool      = (obj_t) obj_pool;
+  vm->obj_pool_size = n;
+  vm->obj_live      = (unsigned *)(vm->obj_pool + n);
+  memset(vm->obj_live, 0, (n + BITS_PER_WORD - 1) / BITS_PER_WORD * sizeof(unsigned));
+
+  /* Free stack, so that objects are handed out in address order */
+
+  for (p = vm->obj_pool + n; n; --n) {
+    (--p)->val.ptrval = vm->obj_free;
+    vm->obj_free      = p;
+  }
+
+  memset(work, 0, work_size);
+  work_size /= sizeof(obj_t);
+  vm->work = (obj_t *) work;
+  vm->work_end = vm->work + work_size;
+
+  stack_size /= sizeof(obj_t);
+  vm->stack = (obj_t *) stack;
+  vm->stack_end = vm->stack + stack_size;
+  vm->sp = vm->stack_end;
+
+  vm->errno = OBJ_ERRNO_NONE;
+
+  for (i = 0; i < _ARRAY_SIZE(vm->cl_tbl); ++i) {
+    obj_dict_newc(vm, &vm->cl_tbl[i], 32);
+    if (vm->errno != OBJ_ERRNO_NONE)  goto done;
+  }
+
+ done:
+  if (vm->errno != OBJ_ERRNO_NONE)  ovm_fini(vm);
+}
+
+/** ************************************************************************
+
+\brief Free resources used by VM
+
+\param[in] vm VM instance
+
+\returns Nothing
+
+*/
+
+void
+ovm_fini(struct ovm *vm)
+{
+  unsigned i, w, b;
+  obj_t    q;
+
+  for (i = 0; i * BITS_PER_WORD < vm->obj_pool_size; ++i) {
+    for (w = vm->obj_live[i]; w; w &= w - 1) {
+      b = __builtin_ctz(w);
+      q = &vm->obj_pool[i * BITS_PER_WORD + b];
+
+      switch (obj_type(q)) {
+      case OBJ_TYPE_STRING:
+	free(STR_DATA(q));
+	break;
+      case OBJ_TYPE_ARRAY:
+      case OBJ_TYPE_DICT:
+      case OBJ_TYPE_HAMT:
+      case OBJ_TYPE_SET:
+	free(ARRAY_DATA(q));
+	break;
+      case OBJ_TYPE_ITERATOR:
+	free(ITER(q));
+      }
+    }
+  }
+
+  free(vm->stats);
+  vm->stats = 0;
+}
+
+/** ************************************************************************
+
+\brief Copy object from stack into register
+
+\param[in] vm  VM instance
+\param[in] r1  Register to load
+\param[in] ofs Offset into stack
+
+\returns Nothing
+
+*/
+
+void
+ovm_pick(struct ovm *vm, unsigned r1, unsigned ofs)
+{
+  obj_assign(vm, _ovm_reg(vm, r1), *_ovm_pick(vm, ofs));
+}
+
+/** ************************************************************************
+
+\brief Drop objects from stack
+
+\param[in] vm VM instance
+\param[in] n  Number of objects to drop
+
+\returns Nothing
+
+*/
+
+void
+ovm_dropn(struct ovm *vm, unsigned n)
+{
+  struct obj **p;
+  unsigned   nn;
+
+  assert((vm->sp + n) <= vm->stack_end);
+
+  for (p = vm->sp, nn = n; nn; --nn, ++p)  obj_release(vm, *p);
+
+  vm->sp += n;
+}
+
+/** ************************************************************************
+
+\brief Drop object from stack
+
+\param[in] vm VM instance
+
+\returns Nothing
+
+*/
+
+void
+ovm_drop(struct ovm *vm)
+{
+  ovm_dropn(vm, 1);
+}
+
+/** ************************************************************************
+
+\brief Pop registers from stack
+
+\param[in] vm VM instance
+\param[in] r1 Starting register to pop
+\param[in] n  Number of registers to pop
+
+\returns Nothing
+
+*/
+
+void
+ovm_popm(struct ovm *vm, unsigned r1, unsigned n)
+{
+  struct obj **qq;
+
+  assert((vm->sp + n) <= vm->stack_end);
+  assert((r1 + n) <= _ARRAY_SIZE(vm->reg));
+
+  for (qq = &vm->reg[r1 + n - 1]; n; --n, --qq, ++vm->sp) {
+    obj_assign(vm, qq, *vm->sp);
+    obj_release(vm, *vm->sp);
+  }
+}
+
+/** ************************************************************************
+
+\brief Pop a register from stack
+
+\param[in] vm VM instance
+\param[in] r1 Register to pop
+
+\returns Nothing
+
+*/
+
+void
+ovm_pop(struct ovm *vm, unsigned r1)
+{
+  ovm_popm(vm, r1, 1);
+}
+
+/** ************************************************************************
+
+\brief Push registers onto stack
+
+\param[in] vm VM instance
+\param[in] r1 Starting register to push
+\param[in] n  Number of registers to push
+
+\returns Nothing
+
+*/
+
+void
+ovm_pushm(struct ovm *vm, unsigned r1, unsigned n)
+{
+  struct obj **pp, **qq;
+
+  assert((vm->sp - n) >= vm->stack);
+  assert((r1 + n) <= _ARRAY_SIZE(vm->reg));
+
+  pp = vm->sp - n;
+  memset(pp, 0, n * sizeof(*pp));
+  for (qq = &vm->reg[r1]; n; --n, ++qq) {
+    obj_assign(vm, --vm->sp, *qq);
+  }
+}
+
+/** ************************************************************************
+
+\brief Push register onto stack
+
+\param[in] vm VM instance
+\param[in] r1 Register to push
+
+\returns Nothing
+
+*/
+
+void
+ovm_push(struct ovm *vm, unsigned r1)
+{
+  ovm_pushm(vm, r1, 1);
+}
+
+/** ************************************************************************
+
+\brief Load register
+
+\param[in] vm   VM instance
+\param[in] r1   Register to load
+\param[in] work Address in working memory to load from
+
+\returns Nothing
+
+*/
+
+void
+ovm_load(struct ovm *vm, unsigned r1, obj_t *work)
+{
+  assert(work >= vm->work && work < vm->work_end);
+
+  obj_assign(vm, _ovm_reg(vm, r1), *work);
+}
+
+/** ************************************************************************
+
+\brief Store register
+
+\param[in] vm   VM instance
+\param[in] r1   Register to store
+\param[in] work Address in working memory to store to
+
+\returns Nothing
+
+*/
+
+void
+ovm_store(struct ovm *vm, unsigned r1, obj_t *work)
+{
+  assert(work >= vm->work && work < vm->work_end);
+
+  obj_assign(vm, work, *_ovm_reg(vm, r1));
+}
+
+/***************************************************************************/
+
+/* Frozen objects
+
+   Freezing deep-copies an object graph out of the VM's pool, into memory
+   obtained from malloc, shared by all VMs in the process.  Frozen objects
+   are immutable, and carry a sentinel reference count, so that retain and
+   release leave them untouched; any number of VMs, in any number of
+   threads, can therefore reference them without copies or atomic
+   operations.  Frozen objects are freed only by their owner, with
+   ovm_frozen_free(), once no VM refers to them.
+
+   A map from original to frozen object, kept while freezing, preserves
+   sharing (and cycles) within the graph.  Each object a freeze allocates
+   is linked, in order, behind the first, which is the root; the root
+   thus owns exactly what its freeze made, and not objects frozen earlier
+   and shared with it, nor the static booleans.
+*/
+
+struct obj_frozen {
+  struct obj_frozen *next;	/* Next allocated by the same freeze */
+  unsigned char     root;	/* Owns the rest */
+  struct obj        obj;
+};
+
+#define OBJ_FROZEN(p)  ((struct obj_frozen *) ((char *)(p) - offsetof(struct obj_frozen, obj)))
+
+struct obj_freeze_map {
+  unsigned          size, cnt;
+  struct obj        **from, **to;
+  struct obj_frozen *objs, **objs_tail; /* Allocated by freeze */
+};
+
+static struct obj **
+obj_freeze_map_find(struct obj_freeze_map *m, struct obj *p)
+{
+  unsigned i;
+
+  for (i = ((unsigned long) p >> 4) & (m->size - 1); m->from[i]; i = (i + 1) & (m->size - 1)) {
+    if (m->from[i] == p)  break;
+  }
+
+  return (&m->from[i]);
+}
+
+static int
+obj_freeze_map_insert(struct obj_freeze_map *m, struct obj *p, struct obj *q)
+{
+  struct obj **rr;
+
+  if (2 * (m->cnt + 1) > m->size) {
+    struct obj_freeze_map mm[1];
+    unsigned              i;
+
+    mm->size = m->size == 0 ? 64 : 2 * m->size;
+    mm->cnt  = 0;
+    mm->from = calloc(mm->size, sizeof(mm->from[0]));
+    mm->to   = calloc(mm->size, sizeof(mm->to[0]));
+    if (mm->from == 0 || mm->to == 0) {
+      free(mm->from);
+      free(mm->to);
+
+      return (-1);
+    }
+
+    for (i = 0; i < m->size; ++i) {
+      if (m->from[i])  obj_freeze_map_insert(mm, m->from[i], m->to[i]);
+    }
+
+    free(m->from);
+    free(m->to);
+    m->size = mm->size;
+    m->cnt  = mm->cnt;
+    m->from = mm->from;
+    m->to   = mm->to;
+  }
+
+  rr = obj_freeze_map_find(m, p);
+  *rr = p;
+  m->to[rr - m->from] = q;
+  ++m->cnt;
+
+  return (0);
+}
+
+/* Frozen objects are never written once shared, so memoize hash now */
+
+static void
+obj_freeze_hash(struct obj *q)
+{
+  unsigned h;
+
+  if (_obj_hash(q, &h) == 0)  obj_hash_memo_put(q, h);
+}
+
+/* Objects still to be visited in a graph walk, so that long lists do not
+   recurse; kept in order of discovery
+*/
+
+struct obj_worklist {
+  struct obj **data;
+  unsigned   cnt, size;
+};
+
+static int
+obj_worklist_push(struct obj_worklist *w, struct obj *p)
+{
+  struct obj **rr;
+  unsigned   n;
+
+  if (w->cnt == w->size) {
+    n = w->size == 0 ? 64 : 2 * w->size;
+    if ((rr = realloc(w->data, n * sizeof(*rr))) == 0)  return (-1);
+    w->data = rr;
+    w->size = n;
+  }
+  w->data[w->cnt++] = p;
+
+  return (0);
+}
+
+/* Return frozen copy of object, creating it if need be.  A new copy still
+   refers to the original's members, and is queued for them to be frozen.
+*/
+
+static struct obj *
+obj_freeze_ref(struct ovm *vm, struct obj_freeze_map *m, struct obj_worklist *w, struct obj *p)
+{
+  struct obj_frozen *f;
+  struct obj        *q, **rr;
+
+  if (p == 0 || obj_is_frozen(p))  return (p);
+
+  if (m->size != 0) {
+    rr = obj_freeze_map_find(m, p);
+    if (*rr)  return (m->to[rr - m->from]);
+  }
+
+  switch (obj_type(p)) {
+  case OBJ_TYPE_POINTER:
+  case OBJ_TYPE_BOOLEAN:
+  case OBJ_TYPE_INTEGER:
+  case OBJ_TYPE_FLOAT:
+  case OBJ_TYPE_STRING:
+  case OBJ_TYPE_PAIR:
+  case OBJ_TYPE_LIST:
+  case OBJ_TYPE_VLIST:
+  case OBJ_TYPE_ARRAY:
+  case OBJ_TYPE_DICT:
+  case OBJ_TYPE_PDICT:
+  case OBJ_TYPE_HAMT:
+  case OBJ_TYPE_SET:
+    break;
+  default:
+    ovm_error(vm, OBJ_ERRNO_BAD_TYPE);
+
+    return (0);
+  }
+
+  if ((f = calloc(1, sizeof(*f))) == 0 || obj_freeze_map_insert(m, p, q = &f->obj) < 0) {
+    free(f);
+    ovm_error(vm, OBJ_ERRNO_MEM);
+
+    return (0);
+  }
+  if (m->objs_tail == 0)  m->objs_tail = &m->objs;
+  *m->objs_tail = f;
+  m->objs_tail  = &f->next;
+
+  q->ref_cnt = OBJ_REF_CNT_FROZEN;
+  q->type    = p->type;
+  q->val     = p->val;
+
+  switch (obj_type(p)) {
+  case OBJ_TYPE_STRING:
+    if ((STR_DATA(q) = malloc(STR_SIZE(p))) == 0)  break;
+    memcpy(STR_DATA(q), STR_DATA(p), STR_SIZE(p));
+    return (q);
+
+  case OBJ_TYPE_ARRAY:
+  case OBJ_TYPE_DICT:
+  case OBJ_TYPE_HAMT:
+  case OBJ_TYPE_SET:
+    ARRAY_DATA(q) = 0;
+    if (ARRAY_SIZE(p) == 0)  return (q);
+    if ((ARRAY_DATA(q) = malloc(obj_array_bytes(p))) == 0)  break;
+    memcpy(ARRAY_DATA(q), ARRAY_DATA(p), obj_array_bytes(p));
+    /* Fall through */
+
+  case OBJ_TYPE_PAIR:
+  case OBJ_TYPE_LIST:
+  case OBJ_TYPE_VLIST:
+  case OBJ_TYPE_PDICT:
+    if (obj_worklist_push(w, q) < 0)  break;
+    return (q);
+
+  default:
+    return (q);
+  }
+
+  ovm_error(vm, OBJ_ERRNO_MEM);
+
+  return (0);
+}
+
+static struct obj *
+obj_freeze(struct ovm *vm, struct obj_freeze_map *m, struct obj *p)
+{
+  struct obj_worklist w[1];
+  struct obj          *q, *r, **rr;
+  unsigned            i, n;
+
+  memset(w, 0, sizeof(*w));
+
+  q = obj_freeze_ref(vm, m, w, p);
+
+  for (i = 0; i < w->cnt && vm->errno == OBJ_ERRNO_NONE; ++i) {
+    r = w->data[i];
+
+    switch (obj_type(r)) {
+    case OBJ_TYPE_PAIR:
+    case OBJ_TYPE_LIST:
+      CAR(r) = obj_freeze_ref(vm, m, w, CAR(r));
+      CDR(r) = obj_freeze_ref(vm, m, w, CDR(r));
+      break;
+    case OBJ_TYPE_VLIST:
+      VLIST_ARR(r) = obj_freeze_ref(vm, m, w, VLIST_ARR(r));
+      break;
+    case OBJ_TYPE_PDICT:
+      PDICT_ROOT(r) = obj_freeze_ref(vm, m, w, PDICT_ROOT(r));
+      break;
+    default:
+      for (rr = ARRAY_DATA(r), n = ARRAY_SIZE(r); n; --n, ++rr) {
+	*rr = obj_freeze_ref(vm, m, w, *rr);
+      }
+    }
+  }
+
+  /* Memoize hashes, members (found later) first, so that each is one step */
+
+  if (vm->errno == OBJ_ERRNO_NONE) {
+    for (i = w->cnt; i; --i) {
+      switch (obj_type(r = w->data[i - 1])) {
+      case OBJ_TYPE_PAIR:
+      case OBJ_TYPE_LIST:
+      case OBJ_TYPE_VLIST:
+	obj_freeze_hash(r);
+      default:
+	;
+      }
+    }
+  }
+
+  free(w->data);
+
+  return (q);
+}
+
+/* Free objects made by one freeze */
+
+static void
+obj_frozen_list_free(struct obj_frozen *f)
+{
+  struct obj_frozen *g;
+  struct obj        *q;
+
+  for ( ; f; f = g) {
+    g = f->next;
+    q = &f->obj;
+
+    switch (obj_type(q)) {
+    case OBJ_TYPE_STRING:
+      free(STR_DATA(q));
+      break;
+    case OBJ_TYPE_ARRAY:
+    case OBJ_TYPE_DICT:
+    case OBJ_TYPE_HAMT:
+    case OBJ_TYPE_SET:
+      free(ARRAY_DATA(q));
+    default:
+      ;
+    }
+
+    free(f);
+  }
+}
+
+/** ************************************************************************
+
+\brief Freeze object
+
+The object in the given register, and every object reachable from it, is
+copied into shared memory, outside the VM's object pool, and made
+immutable; the register is replaced by the frozen copy.  A frozen object
+can be passed to other VMs, in other threads, with ovm_frozen_val() and
+ovm_frozen_load(), and is freed by ovm_frozen_free().
+
+Operations which would modify a frozen object fail with OBJ_ERRNO_FROZEN.
+Iterators cannot be frozen.
+
+\param[in] vm VM instance
+\param[in] r1 Register holding object to freeze
+
+\returns Nothing
+
+*/
+
+void
+ovm_freeze(struct ovm *vm, unsigned r1)
+{
+  struct obj            **pp = _ovm_reg(vm, r1), *q;
+  struct obj_freeze_map m[1];
+
+  if (vm->errno != OBJ_ERRNO_NONE)  return;
+
+  memset(m, 0, sizeof(*m));
+
+  q = obj_freeze(vm, m, *pp);
+  if (vm->errno != OBJ_ERRNO_NONE) {
+    obj_frozen_list_free(m->objs);
+  } else {
+    if (m->objs != 0)  m->objs->root = 1; /* First made is q */
+    obj_assign(vm, pp, q);
+  }
+
+  free(m->from);
+  free(m->to);
+}
+
+/** ************************************************************************
+
+\brief Return frozen object
+
+\param[in] vm VM instance
+\param[in] r1 Register holding frozen object
+
+\returns Frozen object, which may be loaded into another VM
+
+*/
+
+obj_t
+ovm_frozen_val(struct ovm *vm, unsigned r1)
+{
+  struct obj *p = *_ovm_reg(vm, r1);
+
+  assert(p == 0 || obj_is_frozen(p));
+
+  return (p);
+}
+
+/** ************************************************************************
+
+\brief Load frozen object into register
+
+\param[in] vm  VM instance
+\param[in] r1  Register to load
+\param[in] obj Frozen object, from ovm_frozen_val()
+
+\returns Nothing
+
+*/
+
+void
+ovm_frozen_load(struct ovm *vm, unsigned r1, obj_t obj)
+{
+  assert(obj == 0 || obj_is_frozen(obj));
+
+  obj_assign(vm, _ovm_reg(vm, r1), obj);
+}
+
+/** ************************************************************************
+
+\brief Free frozen object
+
+Frees the objects made by the ovm_freeze() which returned the given
+object; objects it shares that were frozen earlier are left to their own
+owners.  Freeing a member of a frozen graph, or a boolean, does nothing.
+Freezing an object that is already frozen makes nothing, and returns it
+unchanged, still owned by the freeze that made it.  Only the owner may do
+this, once no VM -- in any register, stack slot, object or channel --
+refers to any of them.
+
+\param[in] obj Frozen object, from ovm_frozen_val()
+
+\returns Nothing
+
+*/
+
+void
+ovm_frozen_free(obj_t obj)
+{
+  struct obj_frozen *f;
+
+  if (obj == 0 || obj_type(obj) == OBJ_TYPE_BOOLEAN)  return;
+
+  assert(obj_is_frozen(obj));
+
+  f = OBJ_FROZEN(obj);
+  if (f->root)  obj_frozen_list_free(f);
+}
+
+/***************************************************************************/
+
+/* Channels
+
+   A channel carries object graphs from VMs on any number of threads to the
+   single VM which receives from it, through a bounded lock-free queue (a
+   ring of cells, each with a sequence number saying whether it is free or
+   full for the current lap).
+
+   Objects are not serialized.  The sender copies its graph into a message,
+   as a set of transit objects outside any pool; the receiver allocates
+   objects in its own pool and moves the transit objects' contents into
+   them.  Where the sender uniquely owns part of the graph (it is reachable
+   only through objects with a single reference, starting with the
+   register being sent), string and array storage is taken from the
+   sender's objects rather than copied; other parts are copied, so that
+   the sender's remaining references are unaffected.  Frozen objects are
+   passed as is.
+
+   Sending is in two phases.  The first allocates everything the message
+   needs, and does not modify the sender's objects, so that it can fail
+   cleanly; the second links the transit objects and takes storage from
+   the sender, and cannot fail.
+
+   While sending, a transit object's reference count says whether its
+   storage is taken (1) or copied (0); once sent, it is the object's index
+   in the message.
+*/
+
+struct ovm_msg {
+  struct obj *root;
+  unsigned   cnt, size;
+  struct obj **node;		/* Transit objects */
+  struct obj **src;		/* Original of each, in sender */
+  unsigned char *uniq;		/* Whether each is uniquely owned by sender */
+  unsigned   rel_cnt;
+  struct obj **rel;		/* Sender objects to release, referenced from taken arrays */
+};
+
+struct ovm_chan_cell {
+  _Atomic unsigned seq;
+  struct ovm_msg   *msg;
+};
+
+struct ovm_chan {
+  unsigned             mask;
+  _Atomic unsigned     tail;	/* Next cell to fill, shared by senders */
+  unsigned             head;	/* Next cell to empty, receiver only */
+  struct ovm_chan_cell cell[];
+};
+
+static unsigned
+obj_xfer_is_taken(struct obj *q)
+{
+  return (q->ref_cnt != 0);
+}
+
+static unsigned
+obj_xfer_has_storage(struct obj *p)
+{
+  switch (obj_type(p)) {
+  case OBJ_TYPE_STRING:
+  case OBJ_TYPE_ARRAY:
+  case OBJ_TYPE_DICT:
+  case OBJ_TYPE_HAMT:
+  case OBJ_TYPE_SET:
+    return (1);
+  default:
+    ;
+  }
+
+  return (0);
+}
+
+static void
+ovm_msg_free(struct ovm_msg *msg, unsigned sent)
+{
+  unsigned   i;
+  struct obj *q;
+
+  if (msg == 0)  return;
+
+  for (i = 0; i < msg->cnt; ++i) {
+    q = msg->node[i];
+    if (obj_xfer_has_storage(q) && (sent || !obj_xfer_is_taken(q))) {
+      free(q->val.blockval.ptr);
+    }
+
+    free(q);
+  }
 
-/***************************************************************************/
+  free(msg->node);
+  free(msg->src);
+  free(msg->uniq);
+  free(msg->rel);
+  free(msg);
+}
 
-/** ************************************************************************
+static int
+ovm_msg_append(struct ovm_msg *msg, struct obj *q, struct obj *p, unsigned uniq)
+{
+  if (msg->cnt == msg->size) {
+    unsigned      n = msg->size == 0 ? 16 : 2 * msg->size;
+    struct obj    **node, **src;
+    unsigned char *u;
 
-\brief Intialize VM
+    if ((node = realloc(msg->node, n * sizeof(node[0]))) == 0)  return (-1);
+    msg->node = node;
+    if ((src = realloc(msg->src, n * sizeof(src[0]))) == 0)  return (-1);
+    msg->src = src;
+    if ((u = realloc(msg->uniq, n * sizeof(u[0]))) == 0)  return (-1);
+    msg->uniq = u;
 
-\param[in] vm            VM instance
-\param[in] obj_pool_size Size of memory region to use as object pool, in bytes
-\param[in] obj_pool      Start of memory region to use as object pool
-\param[in] work_size     Size of memory region to use as object working storage, in bytes
-\param[in] work          Start of memory region to use as object working storage
-\param[in] stack_size    Size of memory region to use as object stack, in bytes
-\param[in] stack         Start of memory region to use as object stack
+    msg->size = n;
+  }
 
-\returns Nothing
+  msg->node[msg->cnt] = q;
+  msg->src[msg->cnt]  = p;
+  msg->uniq[msg->cnt] = uniq;
+  ++msg->cnt;
+
+  return (0);
+}
 
+/* Phase 1: make transit objects, copying storage not uniquely owned.  The
+   message's list of objects doubles as the worklist, so that members are
+   visited in turn rather than by recursion, and long lists are safe.
 */
 
-void
-ovm_init(struct ovm  *vm,
-	    unsigned obj_pool_size,
-	    void     *obj_pool,
-	    unsigned work_size,
-	    void     *work,
-	    unsigned stack_size,
-	    void     *stack
-	    )
+static void
+obj_xfer_node(struct ovm *vm, struct ovm_msg *msg, struct obj_freeze_map *m, struct obj *p, unsigned uniq)
 {
-  struct _list *li;
-  struct obj   *p;
-  unsigned     i, n;
+  struct obj *q;
 
-  memset(vm, 0, sizeof(*vm));
-  
-  li = &vm->obj_list._list[vm->obj_list.idx_alloced = 0];
-  list_init(li);
-  li = &vm->obj_list._list[vm->obj_list.idx_free = 1];
-  list_init(li);
-  obj_pool_size /= sizeof(struct obj);
-  vm->obj_pool = (obj_t) obj_pool;
-  for (p = vm->obj_pool, n = obj_pool_size; n; --n, ++p) {
-    list_insert(p->_list_node, list_end(li));
+  if (p == 0 || obj_is_frozen(p))  return;
+
+  if (m->size != 0 && *obj_freeze_map_find(m, p))  return;
+
+  switch (obj_type(p)) {
+  case OBJ_TYPE_POINTER:
+  case OBJ_TYPE_BOOLEAN:
+  case OBJ_TYPE_INTEGER:
+  case OBJ_TYPE_FLOAT:
+  case OBJ_TYPE_STRING:
+  case OBJ_TYPE_PAIR:
+  case OBJ_TYPE_LIST:
+  case OBJ_TYPE_VLIST:
+  case OBJ_TYPE_ARRAY:
+  case OBJ_TYPE_DICT:
+  case OBJ_TYPE_PDICT:
+  case OBJ_TYPE_HAMT:
+  case OBJ_TYPE_SET:
+    break;
+  default:
+    ovm_error(vm, OBJ_ERRNO_BAD_TYPE);
+
+    return;
   }
 
-  memset(work, 0, work_size);
-  work_size /= sizeof(obj_t);
-  vm->work = (obj_t *) work;
-  vm->work_end = vm->work + work_size;
+  uniq = uniq && p->ref_cnt == 1;
 
-  stack_size /= sizeof(obj_t);
-  vm->stack = (obj_t *) stack;
-  vm->stack_end = vm->stack + stack_size;
-  vm->sp = vm->stack_end;
+  if ((q = calloc(1, sizeof(*q))) == 0) {
+    ovm_error(vm, OBJ_ERRNO_MEM);
 
-  vm->errno = OBJ_ERRNO_NONE;
+    return;
+  }
+  if (ovm_msg_append(msg, q, p, uniq) < 0) {
+    free(q);
+    ovm_error(vm, OBJ_ERRNO_MEM);
 
-  for (i = 0; i < _ARRAY_SIZE(vm->cl_tbl); ++i) {
-    obj_dict_newc(vm, &vm->cl_tbl[i], 32);
-    if (vm->errno != OBJ_ERRNO_NONE)  goto done;
+    return;
   }
 
- done:
-  if (vm->errno != OBJ_ERRNO_NONE)  ovm_fini(vm);
+  q->type    = p->type;
+  q->val     = p->val;
+  q->ref_cnt = uniq && obj_xfer_has_storage(p);
+  if (obj_xfer_has_storage(p) && !obj_xfer_is_taken(q))  q->val.blockval.ptr = 0;
+
+  if (obj_freeze_map_insert(m, p, q) < 0)  goto mem_err;
+
+  switch (obj_type(p)) {
+  case OBJ_TYPE_STRING:
+    if (uniq)  break;
+    if ((STR_DATA(q) = malloc(STR_SIZE(p))) == 0)  goto mem_err;
+    memcpy(STR_DATA(q), STR_DATA(p), STR_SIZE(p));
+    break;
+
+  case OBJ_TYPE_ARRAY:
+  case OBJ_TYPE_DICT:
+  case OBJ_TYPE_HAMT:
+  case OBJ_TYPE_SET:
+    if (uniq) {
+      msg->rel_cnt += ARRAY_SIZE(p);
+    } else if (ARRAY_SIZE(p) != 0) {
+      if ((ARRAY_DATA(q) = malloc(obj_array_bytes(p))) == 0)  goto mem_err;
+      memcpy(ARRAY_DATA(q), ARRAY_DATA(p), obj_array_bytes(p));
+    }
+    break;
+
+  default:
+    ;
+  }
+
+  return;
+
+ mem_err:
+  ovm_error(vm, OBJ_ERRNO_MEM);
 }
 
-/** ************************************************************************
+static void
+obj_xfer_copy(struct ovm *vm, struct ovm_msg *msg, struct obj_freeze_map *m, struct obj *p)
+{
+  struct obj **rr;
+  unsigned   i, n, uniq;
 
-\brief Free resources used by VM
+  obj_xfer_node(vm, msg, m, p, 1);
 
-\param[in] vm VM instance
+  for (i = 0; i < msg->cnt && vm->errno == OBJ_ERRNO_NONE; ++i) {
+    p    = msg->src[i];
+    uniq = msg->uniq[i];
 
-\returns Nothing
+    switch (obj_type(p)) {
+    case OBJ_TYPE_PAIR:
+    case OBJ_TYPE_LIST:
+      obj_xfer_node(vm, msg, m, CAR(p), uniq);
+      obj_xfer_node(vm, msg, m, CDR(p), uniq);
+      break;
 
-*/
+    case OBJ_TYPE_VLIST:
+      obj_xfer_node(vm, msg, m, VLIST_ARR(p), uniq);
+      break;
 
-void
-ovm_fini(struct ovm *vm)
+    case OBJ_TYPE_ARRAY:
+    case OBJ_TYPE_DICT:
+    case OBJ_TYPE_HAMT:
+    case OBJ_TYPE_SET:
+      for (rr = ARRAY_DATA(p), n = ARRAY_SIZE(p); n && vm->errno == OBJ_ERRNO_NONE; --n, ++rr) {
+	obj_xfer_node(vm, msg, m, *rr, uniq);
+      }
+      break;
+
+    case OBJ_TYPE_PDICT:
+      obj_xfer_node(vm, msg, m, PDICT_ROOT(p), uniq);
+      break;
+
+    default:
+      ;
+    }
+  }
+}
+
+static struct obj *
+obj_xfer_out(struct obj_freeze_map *m, struct obj *p)
+{
+  return (p == 0 || obj_is_frozen(p) ? p : m->to[obj_freeze_map_find(m, p) - m->from]);
+}
+
+/* Phase 2: link transit objects, and take storage from the sender */
+
+static void
+obj_xfer_link(struct ovm_msg *msg, struct obj_freeze_map *m)
 {
-  struct _list *li, *p;
+  unsigned   i, n;
+  struct obj *p, *q, **rr;
+
+  msg->rel_cnt = 0;
 
-  li = &vm->obj_list._list[vm->obj_list.idx_alloced];
-  for (p = list_first(li); p != list_end(li); p = list_next(p)) {
-    obj_t q = FIELD_PTR_TO_STRUCT_PTR(p, struct obj, _list_node);
+  for (i = 0; i < msg->cnt; ++i) {
+    q = msg->node[i];
+    p = msg->src[i];
 
     switch (obj_type(q)) {
-    case OBJ_TYPE_STRING:
-      free(STR_DATA(q));
+    case OBJ_TYPE_PAIR:
+    case OBJ_TYPE_LIST:
+      CAR(q) = obj_xfer_out(m, CAR(q));
+      CDR(q) = obj_xfer_out(m, CDR(q));
+      break;
+
+    case OBJ_TYPE_VLIST:
+      VLIST_ARR(q) = obj_xfer_out(m, VLIST_ARR(q));
       break;
+
     case OBJ_TYPE_ARRAY:
     case OBJ_TYPE_DICT:
-      free(ARRAY_DATA(q));
+    case OBJ_TYPE_HAMT:
+    case OBJ_TYPE_SET:
+      for (rr = ARRAY_DATA(q), n = ARRAY_SIZE(q); n; --n, ++rr) {
+        if (obj_xfer_is_taken(q))  msg->rel[msg->rel_cnt++] = *rr;
+        *rr = obj_xfer_out(m, *rr);
+      }
+      break;
+
+    case OBJ_TYPE_PDICT:
+      PDICT_ROOT(q) = obj_xfer_out(m, PDICT_ROOT(q));
+      break;
+
+    default:
+      ;
+    }
+
+    if (obj_xfer_is_taken(q)) {
+      p->val.blockval.ptr  = 0;
+      p->val.blockval.size = 0;
     }
   }
+
+  for (i = 0; i < msg->cnt; ++i)  msg->node[i]->ref_cnt = i;
+
+  msg->root = obj_xfer_out(m, msg->src[0]);
 }
 
-/** ************************************************************************
+static struct ovm_msg *
+ovm_msg_new(struct ovm *vm, struct obj **pp)
+{
+  struct ovm_msg        *msg;
+  struct obj_freeze_map m[1];
+  unsigned              i;
 
-\brief Copy object from stack into register
+  if ((msg = calloc(1, sizeof(*msg))) == 0) {
+    ovm_error(vm, OBJ_ERRNO_MEM);
 
-\param[in] vm  VM instance
-\param[in] r1  Register to load
-\param[in] ofs Offset into stack
+    return (0);
+  }
 
-\returns Nothing
+  if (*pp == 0 || obj_is_frozen(*pp)) {
+    msg->root = *pp;
+    obj_assign(vm, pp, 0);
 
-*/
+    return (msg);
+  }
 
-void
-ovm_pick(struct ovm *vm, unsigned r1, unsigned ofs)
-{
-  obj_assign(vm, _ovm_reg(vm, r1), *_ovm_pick(vm, ofs));
-}
+  memset(m, 0, sizeof(*m));
 
-/** ************************************************************************
+  obj_xfer_copy(vm, msg, m, *pp);
+  if (vm->errno == OBJ_ERRNO_NONE && msg->rel_cnt != 0
+      && (msg->rel = malloc(msg->rel_cnt * sizeof(msg->rel[0]))) == 0
+      ) {
+    ovm_error(vm, OBJ_ERRNO_MEM);
+  }
+  if (vm->errno != OBJ_ERRNO_NONE) {
+    free(m->from);
+    free(m->to);
+    ovm_msg_free(msg, 0);
 
-\brief Drop objects from stack
+    return (0);
+  }
 
-\param[in] vm VM instance
-\param[in] n  Number of objects to drop
+  obj_xfer_link(msg, m);
 
-\returns Nothing
+  free(m->from);
+  free(m->to);
 
-*/
+  /* Drop the sender's references */
 
-void
-ovm_dropn(struct ovm *vm, unsigned n)
+  for (i = 0; i < msg->rel_cnt; ++i)  obj_release(vm, msg->rel[i]);
+  obj_assign(vm, pp, 0);
+
+  free(msg->src);
+  free(msg->uniq);
+  free(msg->rel);
+  msg->src  = msg->rel = 0;
+  msg->uniq = 0;
+
+  return (msg);
+}
+
+/* Move a message's contents into the receiver's pool */
+
+static unsigned
+obj_pool_has_free(struct ovm *vm, unsigned n)
 {
-  struct obj **p;
-  unsigned   nn;
+  struct obj *p;
 
-  assert((vm->sp + n) <= vm->stack_end);
+  for (p = vm->obj_free; n && p; --n)  p = p->val.ptrval;
 
-  for (p = vm->sp, nn = n; nn; --nn, ++p)  obj_release(vm, *p);
+  return (n == 0);
+}
 
-  vm->sp += n;
+static struct obj *
+obj_xfer_in(struct obj **dst, struct obj *q)
+{
+  return (obj_retain(q == 0 || obj_is_frozen(q) ? q : dst[q->ref_cnt]));
 }
 
-/** ************************************************************************
+static int
+ovm_msg_recv(struct ovm *vm, struct obj **pp, struct ovm_msg *msg)
+{
+  struct obj **dst, *p, *q, **rr;
+  unsigned   i, n;
 
-\brief Drop object from stack
+  if (msg->cnt == 0) {
+    obj_assign(vm, pp, msg->root);
+    free(msg);
 
-\param[in] vm VM instance
+    return (0);
+  }
 
-\returns Nothing
+  if (!obj_pool_has_free(vm, msg->cnt)
+      || (dst = calloc(msg->cnt, sizeof(dst[0]))) == 0
+      ) {
+    ovm_error(vm, OBJ_ERRNO_MEM);
 
-*/
+    return (-1);
+  }
 
-void
-ovm_drop(struct ovm *vm)
-{
-  ovm_dropn(vm, 1);
+  for (i = 0; i < msg->cnt; ++i)  obj_alloc(vm, &dst[i], obj_type(msg->node[i]));
+
+  for (i = 0; i < msg->cnt; ++i) {
+    q = msg->node[i];
+    p = dst[i];
+
+    p->val = q->val;
+
+    switch (obj_type(p)) {
+    case OBJ_TYPE_PAIR:
+    case OBJ_TYPE_LIST:
+      CAR(p) = obj_xfer_in(dst, CAR(q));
+      CDR(p) = obj_xfer_in(dst, CDR(q));
+      break;
+
+    case OBJ_TYPE_VLIST:
+      VLIST_ARR(p) = obj_xfer_in(dst, VLIST_ARR(q));
+      break;
+
+    case OBJ_TYPE_ARRAY:
+    case OBJ_TYPE_DICT:
+    case OBJ_TYPE_HAMT:
+    case OBJ_TYPE_SET:
+      for (rr = ARRAY_DATA(p), n = ARRAY_SIZE(p); n; --n, ++rr) {
+        *rr = obj_xfer_in(dst, *rr);
+      }
+      break;
+
+    case OBJ_TYPE_PDICT:
+      PDICT_ROOT(p) = obj_xfer_in(dst, PDICT_ROOT(q));
+      break;
+
+    default:
+      ;
+    }
+
+    free(q);
+  }
+
+  obj_assign(vm, pp, dst[0]);
+
+  for (i = 0; i < msg->cnt; ++i)  obj_release(vm, dst[i]);
+
+  free(dst);
+  free(msg->node);
+  free(msg);
+
+  return (0);
 }
 
 /** ************************************************************************
 
-\brief Pop registers from stack
+\brief Create channel
 
-\param[in] vm VM instance
-\param[in] r1 Starting register to pop
-\param[in] n  Number of registers to pop
+\param[in] size Capacity, in messages; rounded up to a power of 2
 
-\returns Nothing
+\returns Pointer to channel, or NULL if memory exhausted
 
 */
 
-void
-ovm_popm(struct ovm *vm, unsigned r1, unsigned n)
+struct ovm_chan *
+ovm_chan_new(unsigned size)
 {
-  struct obj **qq;
+  struct ovm_chan *result;
+  unsigned        n, i;
 
-  assert((vm->sp + n) <= vm->stack_end);
-  assert((r1 + n) <= _ARRAY_SIZE(vm->reg));
+  for (n = 2; n < size; n <<= 1);
 
-  for (qq = &vm->reg[r1 + n - 1]; n; --n, --qq, ++vm->sp) {
-    obj_assign(vm, qq, *vm->sp);
-    obj_release(vm, *vm->sp);
+  if ((result = malloc(sizeof(*result) + n * sizeof(result->cell[0]))) == 0)  return (0);
+
+  result->mask = n - 1;
+  atomic_init(&result->tail, 0);
+  result->head = 0;
+  for (i = 0; i < n; ++i) {
+    atomic_init(&result->cell[i].seq, i);
+    result->cell[i].msg = 0;
   }
+
+  return (result);
 }
 
 /** ************************************************************************
 
-\brief Pop a register from stack
+\brief Free channel
+
+Any messages not received are discarded.  No VM may be sending to or
+receiving from the channel.
 
-\param[in] vm VM instance
-\param[in] r1 Register to pop
+\param[in] ch Channel
 
 \returns Nothing
 
 */
 
 void
-ovm_pop(struct ovm *vm, unsigned r1)
+ovm_chan_free(struct ovm_chan *ch)
 {
-  ovm_popm(vm, r1, 1);
+  struct ovm_chan_cell *c;
+
+  for (;;) {
+    c = &ch->cell[ch->head & ch->mask];
+    if (atomic_load_explicit(&c->seq, memory_order_acquire) != ch->head + 1)  break;
+
+    ovm_msg_free(c->msg, 1);
+    ++ch->head;
+  }
+
+  free(ch);
 }
 
 /** ************************************************************************
 
-\brief Push registers onto stack
+\brief Send object on channel
+
+The object in the given register, and everything reachable from it, is
+moved to the channel, and the register is set to nil.  Any number of
+VMs, in different threads, may send on the same channel.
 
 \param[in] vm VM instance
-\param[in] r1 Starting register to push
-\param[in] n  Number of registers to push
+\param[in] ch Channel
+\param[in] r1 Register holding object to send
 
-\returns Nothing
+\returns 0 if sent, else -1, if the channel is full (the register is left
+unchanged) or on error (see ovm_errno())
 
 */
 
-void
-ovm_pushm(struct ovm *vm, unsigned r1, unsigned n)
+int
+ovm_chan_send(struct ovm *vm, struct ovm_chan *ch, unsigned r1)
 {
-  struct obj **pp, **qq;
+  struct ovm_chan_cell *c;
+  struct ovm_msg       *msg;
+  unsigned             pos, seq;
+  int                  d;
 
-  assert((vm->sp - n) >= vm->stack);
-  assert((r1 + n) <= _ARRAY_SIZE(vm->reg));
+  if (vm->errno != OBJ_ERRNO_NONE)  return (-1);
 
-  pp = vm->sp - n;
-  memset(pp, 0, n * sizeof(*pp));
-  for (qq = &vm->reg[r1]; n; --n, ++qq) {
-    obj_assign(vm, --vm->sp, *qq);
+  /* Claim a cell */
+
+  pos = atomic_load_explicit(&ch->tail, memory_order_relaxed);
+  for (;;) {
+    c   = &ch->cell[pos & ch->mask];
+    seq = atomic_load_explicit(&c->seq, memory_order_acquire);
+    d   = (int) (seq - pos);
+    if (d == 0) {
+      if (atomic_compare_exchange_weak_explicit(&ch->tail, &pos, pos + 1,
+                                                memory_order_relaxed,
+                                                memory_order_relaxed
+                                                )
+          ) {
+        break;
+      }
+    } else if (d < 0) {
+      return (-1);		/* Full */
+    } else {
+      pos = atomic_load_explicit(&ch->tail, memory_order_relaxed);
+    }
   }
+
+  /* Once claimed, the cell must be filled; a failed send fills it with
+     nothing, which the receiver skips
+  */
+
+  c->msg = msg = ovm_msg_new(vm, _ovm_reg(vm, r1));
+  atomic_store_explicit(&c->seq, pos + 1, memory_order_release);
+
+  return (msg == 0 ? -1 : 0);
 }
 
 /** ************************************************************************
 
-\brief Push register onto stack
+\brief Receive object from channel
+
+Only one VM may receive from a given channel.
 
 \param[in] vm VM instance
-\param[in] r1 Register to push
+\param[in] ch Channel
+\param[in] r1 Register to load with received object
 
-\returns Nothing
+\returns 0 if received, else -1, if the channel is empty or on error (see
+ovm_errno()); if the receiver's pool has too few free objects for the
+message, the error is OBJ_ERRNO_MEM, and the message stays in the channel
 
 */
 
-void
-ovm_push(struct ovm *vm, unsigned r1)
+int
+ovm_chan_recv(struct ovm *vm, struct ovm_chan *ch, unsigned r1)
 {
-  ovm_pushm(vm, r1, 1);
+  struct ovm_chan_cell *c;
+  struct ovm_msg       *msg;
+  unsigned             pos;
+
+  if (vm->errno != OBJ_ERRNO_NONE)  return (-1);
+
+  for (;;) {
+    pos = ch->head;
+    c   = &ch->cell[pos & ch->mask];
+    if (atomic_load_explicit(&c->seq, memory_order_acquire) != pos + 1)  return (-1);
+
+    /* Left in the channel if it cannot be received */
+
+    if ((msg = c->msg) != 0 && ovm_msg_recv(vm, _ovm_reg(vm, r1), msg) < 0)  return (-1);
+
+    c->msg   = 0;
+    ch->head = pos + 1;
+    atomic_store_explicit(&c->seq, pos + ch->mask + 1, memory_order_release);
+
+    if (msg != 0)  return (0);
+  }
 }
 
 /** ************************************************************************
 
-\brief Load register
+\brief Return type of object
 
 \param[in] vm   VM instance
-\param[in] r1   Register to load
-\param[in] work Address in working memory to load from
+\param[in] r1   Register
 
-\returns Nothing
+\returns Type of object in given register; the internal list
+representations are all reported as OBJ_TYPE_LIST
 
 */
 
-void
-ovm_load(struct ovm *vm, unsigned r1, obj_t *work)
+unsigned
+ovm_type(struct ovm *vm, unsigned r1)
 {
-  assert(work >= vm->work && work < vm->work_end);
+  unsigned result = obj_type(*_ovm_reg(vm, r1));
 
-  obj_assign(vm, _ovm_reg(vm, r1), *work);
+  return (result == OBJ_TYPE_VLIST ? OBJ_TYPE_LIST : result);
 }
 
 /** ************************************************************************
 
-\brief Store register
+\brief Return name of given type
 
-\param[in] vm   VM instance
-\param[in] r1   Register to store
-\param[in] work Address in working memory to store to
+\param[in] type Object type
 
-\returns Nothing
+\returns Type name, as a constant string
 
 */
 
-void
-ovm_store(struct ovm *vm, unsigned r1, obj_t *work)
-{
-  assert(work >= vm->work && work < vm->work_end);
-
-  obj_assign(vm, work, *_ovm_reg(vm, r1));
+const char *
+ovm_type_name(unsigned type)
+{
+  static const char * const names[] = {
+    "object",
+    "nil",
+    "pointer",
+    "boolean",
+    "number",
+    "integer",
+    "float",
+    "block",
+    "string",
+    "bytes",
+    "words",
+    "dwords",
+    "qwords",
+    "bits",
+    "dptr",
+    "pair",
+    "list",
+    "array",
+    "dict",
+    "iterator",
+    "pdict",
+    "set",
+    "hamt",
+    "vlist"
+  };
+
+  assert(_ARRAY_SIZE(names) == OBJ_NUM_TYPES);
+  assert(type >= OBJ_TYPE_BASE && type < OBJ_TYPE_INTERNAL_LAST);
+
+  return (names[type - OBJ_TYPE_BASE]);
 }
 
 /** ************************************************************************
 
-\brief Return type of object
+\brief Return name of given operation
 
-\param[in] vm   VM instance
-\param[in] r1   Register
+\param[in] op Operation
 
-\returns Type of object in given register
+\returns Operation name, as a constant string
 
 */
 
-unsigned
-ovm_type(struct ovm *vm, unsigned r1)
-{
-  return (obj_type(*_ovm_reg(vm, r1)));
+const char *
+ovm_op_name(unsigned op)
+{
+  static const char * const names[] = {
+    "abs",
+    "add",
+    "and",
+    "append",
+    "at",
+    "at-put",
+    "car",
+    "cdr",
+    "count",
+    "del",
+    "div",
+    "eq",
+    "filter",
+    "find",
+    "gt",
+    "hash",
+    "join",
+    "keys",
+    "lt",
+    "minus",
+    "mod",
+    "mult",
+    "next",
+    "not",
+    "or",
+    "reverse",
+    "size",
+    "slice",
+    "sort",
+    "split",
+    "sub",
+    "xor"
+  };
+
+  assert(_ARRAY_SIZE(names) == OBJ_NUM_OPS);
+  assert(op < OBJ_NUM_OPS);
+
+  return (names[op]);
 }
 
 /** ************************************************************************
@@ -3544,8 +6853,17 @@ obj_type_parent(unsigned type)
   case OBJ_TYPE_PAIR:
   case OBJ_TYPE_LIST:
     return (OBJ_TYPE_DPTR);
+  case OBJ_TYPE_VLIST:
+    return (OBJ_TYPE_LIST);
   case OBJ_TYPE_DICT:
     return (OBJ_TYPE_ARRAY);
+  case OBJ_TYPE_ITERATOR:
+    return (OBJ_TYPE_BLOCK);
+  case OBJ_TYPE_PDICT:
+    return (OBJ_TYPE_OBJECT);
+  case OBJ_TYPE_HAMT:
+  case OBJ_TYPE_SET:
+    return (OBJ_TYPE_ARRAY);
   default:
     assert(0);
   }
@@ -3671,6 +6989,12 @@ ovm_newc(struct ovm *vm, unsigned r1, unsigned type, ...)
   case OBJ_TYPE_DICT:
     obj_dict_newc(vm, pp, va_arg(ap, unsigned));
     break;
+  case OBJ_TYPE_PDICT:
+    obj_pdict_newc(vm, pp, 0, 0);
+    break;
+  case OBJ_TYPE_SET:
+    obj_set_newc(vm, pp, va_arg(ap, unsigned));
+    break;
   default:
     assert(0);
   }
@@ -3747,6 +7071,15 @@ ovm_new(struct ovm *vm, unsigned r1, unsigned type, ...)
   case OBJ_TYPE_DICT:
     obj_dict_new(vm, pp, ap);
     break;
+  case OBJ_TYPE_ITERATOR:
+    obj_iter_new(vm, pp, ap);
+    break;
+  case OBJ_TYPE_PDICT:
+    obj_pdict_new(vm, pp, ap);
+    break;
+  case OBJ_TYPE_SET:
+    obj_set_new(vm, pp, ap);
+    break;
   default:
     assert(0);
   }
@@ -3756,6 +7089,87 @@ ovm_new(struct ovm *vm, unsigned r1, unsigned type, ...)
 
 /** ************************************************************************
 
+\brief Append an element to an array, in place
+
+For building an array an element at a time, without a new array per
+element as OBJ_OP_APPEND makes.  The array's block is grown by doubling;
+its allocated size is kept by the caller in *cap, which may start at 0.
+Once done, ovm_array_fit() trims the block to the array's size.
+
+\param[in] vm VM instance
+\param[in] r1 Register holding array
+\param[in,out] cap Allocated size of array's block
+\param[in] r2 Register holding element
+
+\returns Nothing
+
+*/
+
+void
+ovm_array_add(struct ovm *vm, unsigned r1, unsigned *cap, unsigned r2)
+{
+  struct obj *p = *_ovm_reg(vm, r1), *q = *_ovm_reg(vm, r2), **data;
+  unsigned   n;
+
+  if (vm->errno != OBJ_ERRNO_NONE)  return;
+
+  if (obj_type(p) != OBJ_TYPE_ARRAY) {
+    ovm_error(vm, OBJ_ERRNO_BAD_TYPE);
+    return;
+  }
+  if (obj_frozen_chk(vm, p))  return;
+
+  if (ARRAY_SIZE(p) >= *cap) {
+    n = ARRAY_SIZE(p) ? 2 * ARRAY_SIZE(p) : 16;
+    if ((data = realloc(ARRAY_DATA(p), n * sizeof(*data))) == 0) {
+      ovm_error(vm, OBJ_ERRNO_MEM);
+      return;
+    }
+    OVM_STATS_PAYLOAD(vm, (n - ARRAY_SIZE(p)) * sizeof(*data));
+    ARRAY_DATA(p) = data;
+    *cap = n;
+  }
+
+  ARRAY_DATA(p)[ARRAY_SIZE(p)++] = obj_retain(q);
+}
+
+/** ************************************************************************
+
+\brief Trim an array's block to its size
+
+See ovm_array_add().  If the block cannot be shrunk, it is kept as is.
+
+\param[in] vm VM instance
+\param[in] r1 Register holding array
+
+\returns Nothing
+
+*/
+
+void
+ovm_array_fit(struct ovm *vm, unsigned r1)
+{
+  struct obj *p = *_ovm_reg(vm, r1), **data;
+
+  if (vm->errno != OBJ_ERRNO_NONE)  return;
+
+  if (obj_type(p) != OBJ_TYPE_ARRAY) {
+    ovm_error(vm, OBJ_ERRNO_BAD_TYPE);
+    return;
+  }
+  if (obj_frozen_chk(vm, p))  return;
+
+  if (ARRAY_SIZE(p) == 0) {
+    free(ARRAY_DATA(p));
+    ARRAY_DATA(p) = 0;
+
+    return;
+  }
+  if ((data = realloc(ARRAY_DATA(p), ARRAY_SIZE(p) * sizeof(*data))) != 0)  ARRAY_DATA(p) = data;
+}
+
+/** ************************************************************************
+
 \brief Call a method on an object
 
 \param[in] vm VM instance
@@ -3782,7 +7196,17 @@ ovm_call(struct ovm *vm, unsigned r1, unsigned op, ...)
 
   for (type = obj_type(*pp); type != OBJ_TYPE_OBJECT; type = obj_type_parent(type)) {
     if (f = op_func_tbl[type - OBJ_TYPE_BASE][op]) {
+#ifdef OVM_STATS
+      struct ovm_stats_op *st = &vm->stats->op[obj_type(*pp) - OBJ_TYPE_BASE][op];
+      unsigned long long  t0  = OVM_STATS_CLOCK();
+
+      (*f)(vm, pp, ap);
+
+      st->cycles += OVM_STATS_CLOCK() - t0;
+      ++st->calls;
+#else
       (*f)(vm, pp, ap);
+#endif
       break;
     }
   }
@@ -3793,6 +7217,251 @@ ovm_call(struct ovm *vm, unsigned r1, unsigned op, ...)
 
 /** ************************************************************************
 
+\brief Return instrumentation counters
+
+\param[in]  vm VM instance
+\param[out] st Where to copy counters
+
+\returns 0 on success, -1 if VM was not built with OVM_STATS
+
+*/
+
+int
+ovm_stats_get(struct ovm *vm, struct ovm_stats *st)
+{
+  if (vm->stats == 0)  return (-1);
+
+  *st = *vm->stats;
+
+  return (0);
+}
+
+/** ************************************************************************
+
+\brief Reset instrumentation counters
+
+Pool usage is retained, since it reflects objects still allocated.
+
+\param[in] vm VM instance
+
+\returns Nothing
+
+*/
+
+void
+ovm_stats_clr(struct ovm *vm)
+{
+  unsigned pool_used;
+
+  if (vm->stats == 0)  return;
+
+  pool_used = vm->stats->pool_used;
+  memset(vm->stats, 0, sizeof(*vm->stats));
+  vm->stats->pool_used = vm->stats->pool_peak = pool_used;
+}
+
+/* Heap census */
+
+/* Bytes malloc'd for an object's payload, outside the pool */
+
+static unsigned long long
+obj_payload_bytes(struct obj *p)
+{
+  switch (obj_type(p)) {
+  case OBJ_TYPE_STRING:
+  case OBJ_TYPE_ITERATOR:
+    return (p->val.blockval.size);
+  case OBJ_TYPE_ARRAY:
+  case OBJ_TYPE_DICT:
+  case OBJ_TYPE_HAMT:
+  case OBJ_TYPE_SET:
+    return (obj_array_bytes(p));
+  default:
+    ;
+  }
+
+  return (0);
+}
+
+/* Reachability marking, with an explicit stack so that long lists do not
+   recurse; each object is pushed at most once, so the stack never holds
+   more than the pool
+*/
+
+struct ovm_heap_mark {
+  unsigned   *bits;		/* Marked objects, 1 bit per pool object */
+  struct obj **stack, **sp;	/* Marked objects not yet scanned */
+  unsigned   cnt;		/* Number of objects marked */
+};
+
+static void
+ovm_heap_mark(struct ovm *vm, struct ovm_heap_mark *m, struct obj *p)
+{
+  unsigned i;
+
+  /* Frozen objects are outside the pool, and refer only to each other */
+
+  if (p == 0 || obj_is_frozen(p))  return;
+
+  i = p - vm->obj_pool;
+  if (m->bits[i / BITS_PER_WORD] & (1U << (i % BITS_PER_WORD)))  return;
+
+  m->bits[i / BITS_PER_WORD] |= 1U << (i % BITS_PER_WORD);
+  *m->sp++ = p;
+  ++m->cnt;
+}
+
+static unsigned
+ovm_heap_mark_from(struct ovm *vm, struct ovm_heap_mark *m, struct obj **rr, unsigned n)
+{
+  unsigned        cnt = m->cnt;
+  struct obj      *p, **qq;
+  struct obj_iter *s;
+
+  for ( ; n; --n, ++rr)  ovm_heap_mark(vm, m, *rr);
+
+  while (m->sp > m->stack) {
+    p = *--m->sp;
+
+    switch (obj_type(p)) {
+    case OBJ_TYPE_PAIR:
+    case OBJ_TYPE_LIST:
+      ovm_heap_mark(vm, m, CAR(p));
+      ovm_heap_mark(vm, m, CDR(p));
+      break;
+    case OBJ_TYPE_VLIST:
+      ovm_heap_mark(vm, m, VLIST_ARR(p));
+      break;
+    case OBJ_TYPE_ARRAY:
+    case OBJ_TYPE_DICT:
+    case OBJ_TYPE_HAMT:
+    case OBJ_TYPE_SET:
+      for (qq = ARRAY_DATA(p), n = ARRAY_SIZE(p); n; --n, ++qq)  ovm_heap_mark(vm, m, *qq);
+      break;
+    case OBJ_TYPE_ITERATOR:
+      if ((s = ITER(p)) == 0)  break;
+      ovm_heap_mark(vm, m, s->src);
+      ovm_heap_mark(vm, m, s->sel);
+      ovm_heap_mark(vm, m, s->cell);
+      break;
+    case OBJ_TYPE_PDICT:
+      ovm_heap_mark(vm, m, PDICT_ROOT(p));
+      break;
+    default:
+      ;
+    }
+  }
+
+  return (m->cnt - cnt);
+}
+
+/* Insert into largest-objects list, kept in decreasing order of size */
+
+static void
+ovm_heap_top_insert(struct ovm_heap *h, struct ovm_heap_obj *e)
+{
+  unsigned i;
+
+  if (h->top_cnt == OVM_HEAP_TOP_CNT) {
+    if (e->payload_bytes <= h->top[OVM_HEAP_TOP_CNT - 1].payload_bytes)  return;
+    --h->top_cnt;
+  }
+
+  for (i = h->top_cnt; i > 0 && h->top[i - 1].payload_bytes < e->payload_bytes; --i) {
+    h->top[i] = h->top[i - 1];
+  }
+  h->top[i] = *e;
+  ++h->top_cnt;
+}
+
+/** ************************************************************************
+
+\brief Take a census of the object pool
+
+Every allocated object is visited, and counted by type, payload size and
+reference count; the largest are listed.  Objects are also marked as
+reachable from the roots -- registers, stack, work area and class
+dictionaries, in that order -- so that objects which are allocated but not
+reachable, i.e. retained by a leaked reference or a reference cycle, can be
+found.
+
+Unlike ovm_stats_get(), this does not need a build with OVM_STATS, and
+costs nothing until called.  Working memory for marking is malloc'd, and
+freed before returning.
+
+\param[in]  vm VM instance
+\param[out] h  Where to write census
+
+\returns 0 on success, or -1 and sets OBJ_ERRNO_MEM if working memory could
+not be allocated
+
+*/
+
+int
+ovm_heap_get(struct ovm *vm, struct ovm_heap *h)
+{
+  struct ovm_heap_mark m[1];
+  struct ovm_heap_obj  e[1];
+  struct ovm_heap_type *t;
+  unsigned             nw = (vm->obj_pool_size + BITS_PER_WORD - 1) / BITS_PER_WORD, i, w, k;
+  struct obj           *q;
+
+  memset(h, 0, sizeof(*h));
+  memset(m, 0, sizeof(*m));
+
+  m->bits  = calloc(nw, sizeof(m->bits[0]));
+  m->stack = m->sp = malloc((vm->obj_pool_size + 1) * sizeof(m->stack[0]));
+  if (m->bits == 0 || m->stack == 0) {
+    free(m->bits);
+    free(m->stack);
+    ovm_error(vm, OBJ_ERRNO_MEM);
+
+    return (-1);
+  }
+
+  h->roots.regs  = ovm_heap_mark_from(vm, m, vm->reg, _ARRAY_SIZE(vm->reg));
+  h->roots.stack = ovm_heap_mark_from(vm, m, vm->sp, vm->stack_end - vm->sp);
+  h->roots.work  = ovm_heap_mark_from(vm, m, vm->work, vm->work_end - vm->work);
+  h->roots.cl    = ovm_heap_mark_from(vm, m, vm->cl_tbl, _ARRAY_SIZE(vm->cl_tbl));
+
+  h->pool_size      = vm->obj_pool_size;
+  h->pool_reachable = m->cnt;
+
+  for (i = 0; i < nw; ++i) {
+    for (w = vm->obj_live[i]; w; w &= w - 1) {
+      k = i * BITS_PER_WORD + __builtin_ctz(w);
+      q = &vm->obj_pool[k];
+
+      e->idx           = k;
+      e->type          = obj_type(q);
+      e->ref_cnt       = q->ref_cnt;
+      e->payload_bytes = obj_payload_bytes(q);
+
+      t = &h->type[e->type - OBJ_TYPE_BASE];
+      ++t->cnt;
+      t->payload_bytes += e->payload_bytes;
+      if ((m->bits[i] & (1U << (k % BITS_PER_WORD))) == 0)  ++t->unreachable;
+
+      ++h->pool_used;
+      h->payload_bytes += e->payload_bytes;
+
+      if (e->ref_cnt != 0) {
+	k = 8 * sizeof(e->ref_cnt) - 1 - __builtin_clz(e->ref_cnt);
+	++h->ref_cnt[k < OVM_HEAP_REF_CNT_LOG ? k : OVM_HEAP_REF_CNT_LOG - 1];
+      }
+
+      if (e->payload_bytes != 0)  ovm_heap_top_insert(h, e);
+    }
+  }
+
+  free(m->bits);
+  free(m->stack);
+
+  return (0);
+}
+
+/** ************************************************************************
+
 \brief Return value of a pointer object
 
 \param[in] vm VM instance
@@ -6,12 +6,7 @@ Public interface for Object Virtual Machine
 
 ***************************************************************************/
 
-typedef long long   obj_integer_val_t;
-typedef long double obj_float_val_t;
-
-struct _list {
-  struct _list *prev, *next;
-};
+#include "ovm_cfg.h"
 
 /** @brief Object types */
 
@@ -37,13 +32,29 @@ enum obj_type {
   OBJ_TYPE_LIST,		/**< List */
   OBJ_TYPE_ARRAY,		/**< Array */
   OBJ_TYPE_DICT,		/**< Dictionary */
-  OBJ_TYPE_LAST,
+  OBJ_TYPE_ITERATOR,		/**< Lazy sequence over a collection */
+  OBJ_TYPE_PDICT,		/**< Dictionary, persistent */
+  OBJ_TYPE_SET,			/**< Set */
+  OBJ_TYPE_LAST,		/**< End of public types */
+
+  /* Internal types, never instantiated by callers; they may still be seen
+     in heap and instrumentation reports
+  */
+
+  OBJ_TYPE_HAMT = OBJ_TYPE_LAST, /**< Node of persistent dictionary */
+  OBJ_TYPE_VLIST,		/**< List, vector representation; reported as LIST */
+  OBJ_TYPE_INTERNAL_LAST,
+
+  OBJ_NUM_TYPES  = OBJ_TYPE_INTERNAL_LAST - OBJ_TYPE_BASE
+};
 
-  OBJ_NUM_TYPES  = OBJ_TYPE_LAST - OBJ_TYPE_BASE
+/* Memoized hash of an immutable composite; fits in otherwise unused space */
+
+struct objval_hash_memo {
+  unsigned val, valid;
 };
 
 struct obj {
-  struct _list  _list_node[1];
   unsigned      ref_cnt;
   enum obj_type type;
   union {
@@ -82,10 +93,20 @@ struct obj {
       unsigned long long *data;
     } qwordsval;
     struct objval_dptr {
-      struct obj *car, *cdr;
+      struct obj              *car, *cdr;
+      struct objval_hash_memo hash;
     } dptrval;
 #define CAR(x)  ((x)->val.dptrval.car)
 #define CDR(x)  ((x)->val.dptrval.cdr)
+    struct objval_vlist {
+      struct obj              *arr;
+      unsigned                ofs, size;
+      struct objval_hash_memo hash;
+    } vlistval;
+#define VLIST_ARR(x)   ((x)->val.vlistval.arr)
+#define VLIST_OFS(x)   ((x)->val.vlistval.ofs)
+#define VLIST_SIZE(x)  ((x)->val.vlistval.size)
+#define VLIST_DATA(x)  (ARRAY_DATA(VLIST_ARR(x)) + VLIST_OFS(x))
     struct objval_array {
       unsigned   size;
       struct obj **data;
@@ -99,29 +120,55 @@ struct obj {
 #define DICT_SIZE(x)  ((x)->val.dictval.base.size)
 #define DICT_DATA(x)  ((x)->val.dictval.base.data)
 #define DICT_CNT(x)   ((x)->val.dictval.cnt)
+    struct objval_pdict {
+      struct obj *root;
+      unsigned   cnt;
+    } pdictval;
+#define PDICT_ROOT(x)  ((x)->val.pdictval.root)
+#define PDICT_CNT(x)   ((x)->val.pdictval.cnt)
+    struct objval_hamt {
+      struct objval_array base;
+      unsigned            bitmap;
+    } hamtval;
+#define HAMT_BITMAP(x)  ((x)->val.hamtval.bitmap)
+    struct objval_set {
+      struct objval_array base;
+      unsigned            cnt;
+    } setval;
+#define SET_SIZE(x)  ((x)->val.setval.base.size)
+#define SET_DATA(x)  ((x)->val.setval.base.data)
+#define SET_CNT(x)   ((x)->val.setval.cnt)
   } val;
-  void *dummy[1];		/* Pad up to size 32 (power of 2) */
 };
 typedef struct obj *obj_t, *obj_var[1];
 
+/* Bytes of pool region for n objects, with their liveness bitmap; see
+   ovm_init()
+*/
+#define OVM_POOL_SIZE(n) \
+  ((n) * sizeof(struct obj) + ((n) + 8 * sizeof(unsigned) - 1) / (8 * sizeof(unsigned)) * sizeof(unsigned))
+
 enum {
   OVM_NUM_REGS = 8
 };
 
+struct ovm_stats;
+struct ovm_chan;
+
 struct ovm {
   struct obj *obj_pool;
+  unsigned   obj_pool_size;	/* In objects */
+  unsigned   *obj_live;		/* Occupancy bitmap, 1 bit per pool object */
+  struct obj *obj_free;		/* Free objects, LIFO, linked via val.ptrval */
   struct obj **work, **work_end;
   struct obj **stack, **stack_end;
 
-  struct {
-    struct _list _list[2];
-    unsigned     idx_alloced, idx_free;
-  } obj_list;
   struct obj *reg[OVM_NUM_REGS];
   struct obj **sp;
   struct obj *cl_tbl[OBJ_NUM_TYPES];
   int        errno;
   void       (*err_hook)(struct ovm *);
+  struct ovm_stats *stats;	/* Only if built with OVM_STATS */
 };
 
 enum {
@@ -131,7 +178,8 @@ enum {
   OBJ_ERRNO_BAD_REG    = -3,	/**< Invalid register */
   OBJ_ERRNO_BAD_TYPE   = -4,	/**< Invalid type */
   OBJ_ERRNO_BAD_VALUE  = -5,	/**< Invalid value */
-  OBJ_ERRNO_RANGE      = -6	/**< Index out of range */
+  OBJ_ERRNO_RANGE      = -6,	/**< Index out of range */
+  OBJ_ERRNO_FROZEN     = -7	/**< Object is frozen, cannot be modified */
 };
 
 #define R0  0
@@ -156,9 +204,20 @@ void ovm_push(struct ovm *vm, unsigned r1);
 void ovm_move(struct ovm *vm, unsigned r1, unsigned r2);
 void ovm_load(struct ovm *vm, unsigned r1, obj_t *work);
 void ovm_store(struct ovm *vm, unsigned r1, obj_t *work);
+void ovm_freeze(struct ovm *vm, unsigned r1);
+obj_t ovm_frozen_val(struct ovm *vm, unsigned r1);
+void ovm_frozen_load(struct ovm *vm, unsigned r1, obj_t obj);
+void ovm_frozen_free(obj_t obj);
+struct ovm_chan *ovm_chan_new(unsigned size);
+void ovm_chan_free(struct ovm_chan *ch);
+int ovm_chan_send(struct ovm *vm, struct ovm_chan *ch, unsigned r1);
+int ovm_chan_recv(struct ovm *vm, struct ovm_chan *ch, unsigned r1);
 void ovm_cl_dict(struct ovm *vm, unsigned type, unsigned r1);
 unsigned ovm_type(struct ovm *vm, unsigned r1);
 unsigned obj_type_parent(unsigned type);
+int ovm_errno(struct ovm *vm);
+void ovm_err_clr(struct ovm *vm);
+void ovm_err_hook_set(struct ovm *vm, void (*func)(struct ovm *));
 
 enum obj_op {
   OBJ_OP_ABS,			/**< Absoulte value */
@@ -169,11 +228,12 @@ enum obj_op {
   OBJ_OP_AT_PUT,		/**< Keyed collection update */
   OBJ_OP_CAR,			/**< First element of pair or list */
   OBJ_OP_CDR,			/**< Second element of pair, or rest of list */
-  OBJ_OP_COUNT,			/**< Number of objects in collection */
+  OBJ_OP_COUNT,			/**< Number of objects in collection, or of substring in string */
   OBJ_OP_DEL,			/**< Keyed collection delete */
   OBJ_OP_DIV,			/**< Arithmetic divide */
-  OBJ_OP_EQ,			/**< Test for equality */
+  OBJ_OP_EQ,			/**< Test for equality; structural, except DICT by identity */
   OBJ_OP_FILTER,		/**< Apply boolean filter */
+  OBJ_OP_FIND,			/**< Position of substring */
   OBJ_OP_GT,			/**< Arithmetic > */
   OBJ_OP_HASH,			/**< Hash */
   OBJ_OP_JOIN,			/**< String join, with separator */
@@ -183,6 +243,7 @@ enum obj_op {
   OBJ_OP_MINUS,			/**< Arithmetic negation */
   OBJ_OP_MOD,			/**< Arithmetic modulus */
   OBJ_OP_MULT,			/**< Arithmetic multiplication */
+  OBJ_OP_NEXT,			/**< Next element from iterator */
   OBJ_OP_NOT,			/**< Bitwise one's complement or boolean negation */
   OBJ_OP_OR,			/**< Bitwise or boolean or */
   OBJ_OP_REVERSE,		/**< Reverse ordered collection */
@@ -198,10 +259,69 @@ enum obj_op {
 
 void ovm_call(struct ovm *vm, unsigned r1, unsigned op, ...);
 
+const char *ovm_type_name(unsigned type);
+const char *ovm_op_name(unsigned op);
+
+/** @brief Instrumentation counters, maintained only if built with OVM_STATS */
+
+struct ovm_stats {
+  struct ovm_stats_op {
+    unsigned long long calls;	/**< Number of calls */
+    unsigned long long cycles;	/**< Cumulative time, in TSC cycles */
+  } op[OBJ_NUM_TYPES][OBJ_NUM_OPS]; /**< Indexed by receiver type, op */
+  struct ovm_stats_type {
+    unsigned long long allocs;	/**< Number of instances allocated */
+    unsigned long long frees;	/**< Number of instances freed */
+  } type[OBJ_NUM_TYPES];	/**< Indexed by type */
+  unsigned long long payload_bytes; /**< Bytes malloc'd for object payloads */
+  unsigned           pool_used;	/**< Objects currently allocated from pool */
+  unsigned           pool_peak;	/**< Maximum of pool_used */
+};
+
+int ovm_stats_get(struct ovm *vm, struct ovm_stats *st);
+void ovm_stats_clr(struct ovm *vm);
+
+/** @brief Heap census, from walking the pool; available in any build */
+
+enum {
+  OVM_HEAP_TOP_CNT     = 8,	/**< Number of largest objects reported */
+  OVM_HEAP_REF_CNT_LOG = 8	/**< Number of reference count histogram buckets */
+};
+
+struct ovm_heap {
+  unsigned           pool_size;	/**< Objects in pool */
+  unsigned           pool_used;	/**< Objects allocated */
+  unsigned           pool_reachable; /**< Objects allocated, and reachable from a root */
+  unsigned long long payload_bytes; /**< Bytes malloc'd for payloads of allocated objects */
+  struct ovm_heap_type {
+    unsigned           cnt;	/**< Number allocated */
+    unsigned           unreachable; /**< Number allocated, but not reachable from any root */
+    unsigned long long payload_bytes; /**< Bytes malloc'd for their payloads */
+  } type[OBJ_NUM_TYPES];	/**< Indexed by type */
+  struct ovm_heap_obj {
+    unsigned           idx;	/**< Index in pool */
+    unsigned           type;	/**< Type */
+    unsigned           ref_cnt;	/**< Reference count */
+    unsigned long long payload_bytes; /**< Bytes malloc'd for payload */
+  } top[OVM_HEAP_TOP_CNT];	/**< Largest payloads, largest first */
+  unsigned           top_cnt;	/**< Entries used in top */
+  unsigned           ref_cnt[OVM_HEAP_REF_CNT_LOG]; /**< Objects with reference count in [2^i, 2^(i+1)); last bucket is open-ended */
+  struct ovm_heap_roots {
+    unsigned regs;		/**< Objects reachable from registers */
+    unsigned stack;		/**< ... else from stack */
+    unsigned work;		/**< ... else from work area */
+    unsigned cl;		/**< ... else from class dictionaries */
+  } roots;			/**< Reachable objects, by first root to reach them */
+};
+
+int ovm_heap_get(struct ovm *vm, struct ovm_heap *h);
+
 /* Constructors */
 void ovm_newc(struct ovm *vm, unsigned r1, unsigned type, ...);
 void ovm_new(struct ovm *vm, unsigned r1, unsigned type, ...);
 void ovm_news(struct ovm *vm, unsigned r1, unsigned len, char *s);
+void ovm_array_add(struct ovm *vm, unsigned r1, unsigned *cap, unsigned r2);
+void ovm_array_fit(struct ovm *vm, unsigned r1);
 
 /* Value extractors */
 void *            ovm_ptr_val(struct ovm *vm, unsigned r1);
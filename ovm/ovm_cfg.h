@@ -0,0 +1,29 @@
+#ifndef __OVM_CFG_H
+#define __OVM_CFG_H
+
+/* Base type for INTEGER objects */
+typedef long long obj_integer_val_t;
+
+/* Base type for FLOAT objects
+
+   double by default, so that float arithmetic uses SSE and an object is
+   32 bytes on 64-bit platforms; define OVM_FLOAT_LONG_DOUBLE (make
+   OVM_FLOAT_LONG_DOUBLE=1) for long double, at the cost of x87 arithmetic
+   and 48-byte objects.
+
+   A "tostring-format" set in the FLOAT class dictionary must match the
+   chosen type.
+*/
+#ifdef OVM_FLOAT_LONG_DOUBLE
+typedef long double obj_float_val_t;
+#define OVM_FMT_FLOAT    "%Lg"	/* Format for printf */
+#define OVM_STRTO_FLOAT  strtold	/* Conversion from text */
+#define OVM_FLOAT_ABS(x) (__builtin_fabsl(x))
+#else
+typedef double obj_float_val_t;
+#define OVM_FMT_FLOAT    "%g"
+#define OVM_STRTO_FLOAT  strtod
+#define OVM_FLOAT_ABS(x) (__builtin_fabs(x))
+#endif
+
+#endif /* __OVM_CFG_H */
@@ -0,0 +1,562 @@
+/** ************************************************************************
+
+\file ovm_json.c
+
+JSON support for OVM, built on hp_json
+
+***************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+
+/* hp_json's ARRAY_SIZE (element count) collides with OVM's (array object
+   size); the OVM one is the one wanted here
+*/
+
+#include "ovm_json.h"
+#undef ARRAY_SIZE
+
+#include "ovm.h"
+
+#define TRY(x)  do { if ((x) < 0)  return (-1); } while (0)
+
+static int
+ovm_stats_json_ops(struct ovm_stats *s, struct hp_json_stream *st)
+{
+  struct hp_json_stream ast[1], dst[1];
+  struct ovm_stats_op   *p;
+  unsigned              type, op;
+
+  TRY(hp_json_arr_begin_tostring(st, ast));
+
+  for (type = OBJ_TYPE_BASE; type < OBJ_TYPE_INTERNAL_LAST; ++type) {
+    for (op = 0; op < OBJ_NUM_OPS; ++op) {
+      p = &s->op[type - OBJ_TYPE_BASE][op];
+      if (p->calls == 0)  continue;
+
+      TRY(hp_json_dict_begin_tostring(ast, dst));
+      TRY(hp_json_string_tostring(dst, "type"));
+      TRY(hp_json_string_tostring(dst, (char *) ovm_type_name(type)));
+      TRY(hp_json_string_tostring(dst, "op"));
+      TRY(hp_json_string_tostring(dst, (char *) ovm_op_name(op)));
+      TRY(hp_json_string_tostring(dst, "calls"));
+      TRY(hp_json_llong_tostring(dst, p->calls));
+      TRY(hp_json_string_tostring(dst, "cycles"));
+      TRY(hp_json_llong_tostring(dst, p->cycles));
+      TRY(hp_json_dict_end_tostring(dst));
+    }
+  }
+
+  return (hp_json_arr_end_tostring(ast));
+}
+
+static int
+ovm_stats_json_types(struct ovm_stats *s, struct hp_json_stream *st)
+{
+  struct hp_json_stream ast[1], dst[1];
+  struct ovm_stats_type *p;
+  unsigned              type;
+
+  TRY(hp_json_arr_begin_tostring(st, ast));
+
+  for (type = OBJ_TYPE_BASE; type < OBJ_TYPE_INTERNAL_LAST; ++type) {
+    p = &s->type[type - OBJ_TYPE_BASE];
+    if (p->allocs == 0 && p->frees == 0)  continue;
+
+    TRY(hp_json_dict_begin_tostring(ast, dst));
+    TRY(hp_json_string_tostring(dst, "type"));
+    TRY(hp_json_string_tostring(dst, (char *) ovm_type_name(type)));
+    TRY(hp_json_string_tostring(dst, "allocs"));
+    TRY(hp_json_llong_tostring(dst, p->allocs));
+    TRY(hp_json_string_tostring(dst, "frees"));
+    TRY(hp_json_llong_tostring(dst, p->frees));
+    TRY(hp_json_dict_end_tostring(dst));
+  }
+
+  return (hp_json_arr_end_tostring(ast));
+}
+
+/** ************************************************************************
+
+\brief Write instrumentation counters as JSON
+
+Only (type, op) and type entries with nonzero counts are written.
+
+\param[in] vm VM instance
+\param[in] st JSON stream to write to
+
+\returns 0 on success, -1 on error or if VM was not built with OVM_STATS
+
+*/
+
+int
+ovm_stats_json(struct ovm *vm, struct hp_json_stream *st)
+{
+  struct ovm_stats      s[1];
+  struct hp_json_stream dst[1];
+
+  TRY(ovm_stats_get(vm, s));
+
+  TRY(hp_json_dict_begin_tostring(st, dst));
+  TRY(hp_json_string_tostring(dst, "ops"));
+  TRY(ovm_stats_json_ops(s, dst));
+  TRY(hp_json_string_tostring(dst, "types"));
+  TRY(ovm_stats_json_types(s, dst));
+  TRY(hp_json_string_tostring(dst, "payload-bytes"));
+  TRY(hp_json_llong_tostring(dst, s->payload_bytes));
+  TRY(hp_json_string_tostring(dst, "pool-used"));
+  TRY(hp_json_llong_tostring(dst, s->pool_used));
+  TRY(hp_json_string_tostring(dst, "pool-peak"));
+  TRY(hp_json_llong_tostring(dst, s->pool_peak));
+
+  return (hp_json_dict_end_tostring(dst));
+}
+
+static int
+ovm_heap_json_types(struct ovm_heap *h, struct hp_json_stream *st)
+{
+  struct hp_json_stream ast[1], dst[1];
+  struct ovm_heap_type  *p;
+  unsigned              type;
+
+  TRY(hp_json_arr_begin_tostring(st, ast));
+
+  for (type = OBJ_TYPE_BASE; type < OBJ_TYPE_INTERNAL_LAST; ++type) {
+    p = &h->type[type - OBJ_TYPE_BASE];
+    if (p->cnt == 0)  continue;
+
+    TRY(hp_json_dict_begin_tostring(ast, dst));
+    TRY(hp_json_string_tostring(dst, "type"));
+    TRY(hp_json_string_tostring(dst, (char *) ovm_type_name(type)));
+    TRY(hp_json_string_tostring(dst, "count"));
+    TRY(hp_json_llong_tostring(dst, p->cnt));
+    TRY(hp_json_string_tostring(dst, "unreachable"));
+    TRY(hp_json_llong_tostring(dst, p->unreachable));
+    TRY(hp_json_string_tostring(dst, "payload-bytes"));
+    TRY(hp_json_llong_tostring(dst, p->payload_bytes));
+    TRY(hp_json_dict_end_tostring(dst));
+  }
+
+  return (hp_json_arr_end_tostring(ast));
+}
+
+static int
+ovm_heap_json_top(struct ovm_heap *h, struct hp_json_stream *st)
+{
+  struct hp_json_stream ast[1], dst[1];
+  struct ovm_heap_obj   *p;
+  unsigned              i;
+
+  TRY(hp_json_arr_begin_tostring(st, ast));
+
+  for (p = h->top, i = h->top_cnt; i; --i, ++p) {
+    TRY(hp_json_dict_begin_tostring(ast, dst));
+    TRY(hp_json_string_tostring(dst, "index"));
+    TRY(hp_json_llong_tostring(dst, p->idx));
+    TRY(hp_json_string_tostring(dst, "type"));
+    TRY(hp_json_string_tostring(dst, (char *) ovm_type_name(p->type)));
+    TRY(hp_json_string_tostring(dst, "ref-cnt"));
+    TRY(hp_json_llong_tostring(dst, p->ref_cnt));
+    TRY(hp_json_string_tostring(dst, "payload-bytes"));
+    TRY(hp_json_llong_tostring(dst, p->payload_bytes));
+    TRY(hp_json_dict_end_tostring(dst));
+  }
+
+  return (hp_json_arr_end_tostring(ast));
+}
+
+/* Histogram entries are {"min": m, "count": n}, for reference counts from
+   m up to the next entry's min
+*/
+
+static int
+ovm_heap_json_ref_cnt(struct ovm_heap *h, struct hp_json_stream *st)
+{
+  struct hp_json_stream ast[1], dst[1];
+  unsigned              i;
+
+  TRY(hp_json_arr_begin_tostring(st, ast));
+
+  for (i = 0; i < OVM_HEAP_REF_CNT_LOG; ++i) {
+    TRY(hp_json_dict_begin_tostring(ast, dst));
+    TRY(hp_json_string_tostring(dst, "min"));
+    TRY(hp_json_llong_tostring(dst, 1LL << i));
+    TRY(hp_json_string_tostring(dst, "count"));
+    TRY(hp_json_llong_tostring(dst, h->ref_cnt[i]));
+    TRY(hp_json_dict_end_tostring(dst));
+  }
+
+  return (hp_json_arr_end_tostring(ast));
+}
+
+static int
+ovm_heap_json_roots(struct ovm_heap *h, struct hp_json_stream *st)
+{
+  struct hp_json_stream dst[1];
+
+  TRY(hp_json_dict_begin_tostring(st, dst));
+  TRY(hp_json_string_tostring(dst, "registers"));
+  TRY(hp_json_llong_tostring(dst, h->roots.regs));
+  TRY(hp_json_string_tostring(dst, "stack"));
+  TRY(hp_json_llong_tostring(dst, h->roots.stack));
+  TRY(hp_json_string_tostring(dst, "work"));
+  TRY(hp_json_llong_tostring(dst, h->roots.work));
+  TRY(hp_json_string_tostring(dst, "classes"));
+  TRY(hp_json_llong_tostring(dst, h->roots.cl));
+
+  return (hp_json_dict_end_tostring(dst));
+}
+
+/** ************************************************************************
+
+\brief Write heap census as JSON
+
+See ovm_heap_get().  Only types with allocated instances are written.
+
+\param[in] vm VM instance
+\param[in] st JSON stream to write to
+
+\returns 0 on success, -1 on error
+
+*/
+
+int
+ovm_heap_json(struct ovm *vm, struct hp_json_stream *st)
+{
+  struct ovm_heap       h[1];
+  struct hp_json_stream dst[1];
+
+  TRY(ovm_heap_get(vm, h));
+
+  TRY(hp_json_dict_begin_tostring(st, dst));
+  TRY(hp_json_string_tostring(dst, "pool-size"));
+  TRY(hp_json_llong_tostring(dst, h->pool_size));
+  TRY(hp_json_string_tostring(dst, "pool-used"));
+  TRY(hp_json_llong_tostring(dst, h->pool_used));
+  TRY(hp_json_string_tostring(dst, "pool-reachable"));
+  TRY(hp_json_llong_tostring(dst, h->pool_reachable));
+  TRY(hp_json_string_tostring(dst, "payload-bytes"));
+  TRY(hp_json_llong_tostring(dst, h->payload_bytes));
+  TRY(hp_json_string_tostring(dst, "types"));
+  TRY(ovm_heap_json_types(h, dst));
+  TRY(hp_json_string_tostring(dst, "largest"));
+  TRY(ovm_heap_json_top(h, dst));
+  TRY(hp_json_string_tostring(dst, "ref-cnts"));
+  TRY(ovm_heap_json_ref_cnt(h, dst));
+  TRY(hp_json_string_tostring(dst, "roots"));
+  TRY(ovm_heap_json_roots(h, dst));
+
+  return (hp_json_dict_end_tostring(dst));
+}
+
+/* Converting between JSON and objects, iteratively; nesting is tracked in a
+   malloc'd array of levels, grown as needed.  Each level's JSON stream has
+   the one before as parent, so that is fixed up when the array moves.
+*/
+
+enum {
+  OVM_JSON_LVLS_MIN = 16
+};
+
+struct ovm_json_lvl {
+  struct hp_json_stream js;
+  struct obj            *obj;	/* Object being written */
+  struct obj            *ent;	/* Its dict entry being written */
+  unsigned              idx;	/* Next element to write; key pending, for dict being read */
+  unsigned              cap;	/* Allocated size of array being read */
+  unsigned char         dict;	/* Dict being read */
+};
+
+static int
+ovm_json_lvls_grow(struct ovm_json_lvl **lvls, unsigned *size, struct hp_json_stream *st)
+{
+  struct ovm_json_lvl *p;
+  unsigned            n = *size ? 2 * *size : OVM_JSON_LVLS_MIN, i;
+
+  if ((p = realloc(*lvls, n * sizeof(*p))) == 0)  return (-1);
+
+  if (*size > 0) {
+    p[0].js.parent = st;
+    for (i = 1; i < *size; ++i)  p[i].js.parent = &p[i - 1].js;
+  }
+
+  *lvls = p;
+  *size = n;
+
+  return (0);
+}
+
+/* Scratch registers, any but r1 */
+
+static void
+ovm_json_regs(unsigned r1, unsigned *regs, unsigned n)
+{
+  unsigned r;
+
+  for (r = R0; n; ++r) {
+    if (r == r1)  continue;
+    *regs++ = r;
+    --n;
+  }
+}
+
+/** ************************************************************************
+
+\brief Parse JSON value into object
+
+Dicts become DICTs, arrays ARRAYs, strings STRINGs, and numbers INTEGERs
+or FLOATs.  Objects are built as values are parsed, with no intermediate
+text; enclosing containers are held on the VM stack, 2 entries per level
+of nesting.
+
+\param[in] vm VM instance
+\param[in] r1 Destination register, unchanged on error
+\param[in] st JSON stream to read from
+
+\returns 0 on success, -1 on error; strings must fit in
+OVM_JSON_STR_SIZE_MAX bytes
+
+*/
+
+int
+ovm_json_parse(struct ovm *vm, unsigned r1, struct hp_json_stream *st)
+{
+  struct hp_json_parseval pval[1];
+  struct ovm_json_lvl     *lvls = 0, *lvl;
+  struct hp_json_stream   *cur = st;
+  unsigned                lvls_size = 0, d = 0, regs[3], rc, rk, rv, i;
+  int                     result = -1;
+
+  if (ovm_errno(vm) != OBJ_ERRNO_NONE)  return (-1);
+
+  ovm_json_regs(r1, regs, 3);
+  rc = regs[0];			/* Container being built */
+  rk = regs[1];			/* Its pending key */
+  rv = regs[2];			/* Value */
+
+  if ((pval->strbuf = malloc(OVM_JSON_STR_SIZE_MAX)) == 0)  return (-1);
+  pval->strbufsize = OVM_JSON_STR_SIZE_MAX;
+
+  for (i = 0; i < 3; ++i)  ovm_push(vm, regs[i]);
+
+  for (;;) {
+    if (d == lvls_size) {
+      if (ovm_json_lvls_grow(&lvls, &lvls_size, st) < 0)  goto done;
+      cur = d ? &lvls[d - 1].js : st;
+    }
+    if (hp_json_parse(cur, pval, &lvls[d].js) < 0)  goto done;
+
+    switch (pval->code) {
+    case HP_JSON_PARSE_INT:
+      ovm_newc(vm, rv, OBJ_TYPE_INTEGER, (obj_integer_val_t) pval->intval);
+      break;
+
+    case HP_JSON_PARSE_FLOAT:
+      ovm_newc(vm, rv, OBJ_TYPE_FLOAT, (obj_float_val_t) pval->floatval);
+      break;
+
+    case HP_JSON_PARSE_STRING:
+      if (d > 0 && lvls[d - 1].dict && lvls[d - 1].idx == 0) {
+	ovm_newc(vm, rk, OBJ_TYPE_STRING, pval->str_len, pval->str);
+	lvls[d - 1].idx = 1;
+
+	continue;
+      }
+
+      ovm_newc(vm, rv, OBJ_TYPE_STRING, pval->str_len, pval->str);
+      break;
+
+    case HP_JSON_PARSE_ARRAY_BEGIN:
+    case HP_JSON_PARSE_DICT_BEGIN:
+      if (vm->sp - vm->stack < 2)  goto done;
+      ovm_push(vm, rc);
+      ovm_push(vm, rk);
+
+      lvl = &lvls[d];
+      lvl->idx  = 0;
+      lvl->cap  = 0;
+      lvl->dict = pval->code == HP_JSON_PARSE_DICT_BEGIN;
+      ovm_newc(vm, rc, lvl->dict ? OBJ_TYPE_DICT : OBJ_TYPE_ARRAY, 0);
+      cur = &lvl->js;
+      ++d;
+
+      continue;
+
+    case HP_JSON_PARSE_ARRAY_END:
+    case HP_JSON_PARSE_DICT_END:
+      if (!lvls[d - 1].dict)  ovm_array_fit(vm, rc);
+      ovm_move(vm, rv, rc);
+      ovm_pop(vm, rk);
+      ovm_pop(vm, rc);
+      cur = --d ? &lvls[d - 1].js : st;
+      break;
+
+    default:
+      goto done;
+    }
+
+    if (ovm_errno(vm) != OBJ_ERRNO_NONE)  goto done;
+
+    /* Value complete; add it to its container, or it is the result */
+
+    if (d == 0)  break;
+
+    lvl = &lvls[d - 1];
+    if (lvl->dict) {
+      ovm_call(vm, rc, OBJ_OP_AT_PUT, rk, rv);
+      lvl->idx = 0;
+    } else {
+      ovm_array_add(vm, rc, &lvl->cap, rv);
+    }
+    if (ovm_errno(vm) != OBJ_ERRNO_NONE)  goto done;
+  }
+
+  ovm_move(vm, r1, rv);
+  result = 0;
+
+ done:
+  ovm_dropn(vm, 2 * d);
+  for (i = 3; i; --i)  ovm_pop(vm, regs[i - 1]);
+  free(lvls);
+  free(pval->strbuf);
+
+  return (result);
+}
+
+/* Next element of container being written; for a dict, its key is written
+   first
+*/
+
+static int
+ovm_json_next(struct ovm_json_lvl *lvl, struct obj **q)
+{
+  struct obj *p = lvl->obj, *key;
+
+  switch (p->type) {
+  case OBJ_TYPE_ARRAY:
+    if (lvl->idx >= ARRAY_SIZE(p))  return (0);
+    *q = ARRAY_DATA(p)[lvl->idx++];
+    return (1);
+
+  case OBJ_TYPE_VLIST:
+    if (lvl->idx >= VLIST_SIZE(p))  return (0);
+    *q = VLIST_DATA(p)[lvl->idx++];
+    return (1);
+
+  case OBJ_TYPE_LIST:
+    if (lvl->ent == 0)  return (0);
+    *q = CAR(lvl->ent);
+    lvl->ent = CDR(lvl->ent);
+    return (1);
+
+  case OBJ_TYPE_DICT:
+    while (lvl->ent == 0) {
+      if (lvl->idx >= DICT_SIZE(p))  return (0);
+      lvl->ent = DICT_DATA(p)[lvl->idx++];
+    }
+    key = CAR(CAR(lvl->ent));
+    *q  = CDR(CAR(lvl->ent));
+    lvl->ent = CDR(lvl->ent);
+    if (key == 0 || key->type != OBJ_TYPE_STRING)  return (-1);
+    return (hp_json_string_tostring(&lvl->js, STR_DATA(key)) < 0 ? -1 : 1);
+
+  default:
+    ;
+  }
+
+  return (-1);
+}
+
+/** ************************************************************************
+
+\brief Write object as JSON
+
+The reverse of ovm_json_parse(); LISTs are also written as arrays.  Other
+types have no JSON form, nor do dicts with keys that are not STRINGs.
+
+\param[in] vm VM instance
+\param[in] r1 Register holding object
+\param[in] st JSON stream to write to
+
+\returns 0 on success, -1 on error
+
+*/
+
+int
+ovm_json_tostring(struct ovm *vm, unsigned r1, struct hp_json_stream *st)
+{
+  struct ovm_json_lvl   *lvls = 0, *lvl;
+  struct hp_json_stream *cur = st;
+  struct obj            *q = vm->reg[r1];
+  unsigned              lvls_size = 0, d = 0;
+  int                   result = -1, k;
+
+  for (;;) {
+    switch (q ? q->type : OBJ_TYPE_NIL) {
+    case OBJ_TYPE_INTEGER:
+      if (hp_json_llong_tostring(cur, INTVAL(q)) < 0)  goto done;
+      break;
+
+    case OBJ_TYPE_FLOAT:
+      if (hp_json_float_tostring(cur, FLOATVAL(q)) < 0)  goto done;
+      break;
+
+    case OBJ_TYPE_STRING:
+      if (hp_json_string_tostring(cur, STR_DATA(q)) < 0)  goto done;
+      break;
+
+    case OBJ_TYPE_ARRAY:
+    case OBJ_TYPE_LIST:
+    case OBJ_TYPE_VLIST:
+    case OBJ_TYPE_DICT:
+      if (d == lvls_size) {
+	if (ovm_json_lvls_grow(&lvls, &lvls_size, st) < 0)  goto done;
+	cur = d ? &lvls[d - 1].js : st;
+      }
+      lvl = &lvls[d];
+      lvl->obj = q;
+      lvl->idx = 0;
+      lvl->ent = q->type == OBJ_TYPE_LIST ? q : 0;
+      if ((q->type == OBJ_TYPE_DICT
+	   ? hp_json_dict_begin_tostring(cur, &lvl->js)
+	   : hp_json_arr_begin_tostring(cur, &lvl->js)
+	   ) < 0
+	  ) {
+	goto done;
+      }
+      cur = &lvl->js;
+      ++d;
+      break;
+
+    default:
+      goto done;
+    }
+
+    /* Next value, closing containers that are done */
+
+    for (;;) {
+      if (d == 0) {
+	result = 0;
+	goto done;
+      }
+
+      lvl = &lvls[d - 1];
+      if ((k = ovm_json_next(lvl, &q)) < 0)  goto done;
+      if (k > 0)  break;
+
+      if ((lvl->obj->type == OBJ_TYPE_DICT
+	   ? hp_json_dict_end_tostring(&lvl->js)
+	   : hp_json_arr_end_tostring(&lvl->js)
+	   ) < 0
+	  ) {
+	goto done;
+      }
+      cur = --d ? &lvls[d - 1].js : st;
+    }
+  }
+
+ done:
+  free(lvls);
+
+  return (result);
+}
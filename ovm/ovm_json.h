@@ -0,0 +1,21 @@
+/** ************************************************************************
+
+\file ovm_json.h
+
+JSON support for Object Virtual Machine
+
+***************************************************************************/
+
+#include "json/hp_json.h"
+
+struct ovm;
+
+int ovm_stats_json(struct ovm *vm, struct hp_json_stream *st);
+int ovm_heap_json(struct ovm *vm, struct hp_json_stream *st);
+
+enum {
+  OVM_JSON_STR_SIZE_MAX = 1 << 16 /**< Longest string ovm_json_parse() reads, with NUL */
+};
+
+int ovm_json_parse(struct ovm *vm, unsigned r1, struct hp_json_stream *st);
+int ovm_json_tostring(struct ovm *vm, unsigned r1, struct hp_json_stream *st);
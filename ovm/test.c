@@ -1,5 +1,10 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <assert.h>
+
+#include "ovm_json.h"
+#undef ARRAY_SIZE
 
 #include "ovm.h"
 
@@ -9,7 +14,7 @@
 void
 obj_set_new(struct ovm *vm)
 {
-  ovm_newc(vm, R0, OBJ_TYPE_DICT, 32);
+  ovm_newc(vm, R0, OBJ_TYPE_SET, 32);
 }
 
 void
@@ -19,7 +24,7 @@ obj_set_insert(struct ovm *vm)
 
   ovm_pick(vm, R1, 3);
   ovm_pick(vm, R2, 4);
-  ovm_new(vm, R3, OBJ_TYPE_NIL);
+  ovm_newc(vm, R3, OBJ_TYPE_BOOLEAN, 1);
 
   ovm_call(vm, R1, OBJ_OP_AT_PUT, R2, R3);
 
@@ -46,17 +51,14 @@ obj_set_del(struct ovm *vm)
 void
 obj_set_member(struct ovm *vm)
 {
-  ovm_pushm(vm, R1, 2);
+  ovm_push(vm, R1);
 
-  ovm_pick(vm, R0, 2);
-  ovm_pick(vm, R1, 3);
-  ovm_new(vm, R2, OBJ_TYPE_NIL);
+  ovm_pick(vm, R0, 1);
+  ovm_pick(vm, R1, 2);
 
   ovm_call(vm, R0, OBJ_OP_AT, R1);
-  ovm_call(vm, R0, OBJ_OP_EQ, R2);
-  ovm_call(vm, R0, OBJ_OP_NOT);
 
-  ovm_popm(vm, R1, 2);
+  ovm_pop(vm, R1);
   
   ovm_dropn(vm, 2);
 }
@@ -88,7 +90,24 @@ obj_print(struct ovm *vm)
   obj_fprint(vm, stdout);
 }
 
-struct obj obj_pool[1000], *obj_stack[100];
+void
+obj_check(struct ovm *vm, unsigned r1, char *s)
+{
+  ovm_push(vm, R7);
+
+  ovm_new(vm, R7, OBJ_TYPE_STRING, r1);
+  assert(strcmp(ovm_string_val(vm, R7), s) == 0);
+
+  ovm_pop(vm, R7);
+}
+
+void
+is_even(struct ovm *vm)
+{
+  ovm_newc(vm, R0, OBJ_TYPE_BOOLEAN, (unsigned) ((ovm_integer_val(vm, R0) & 1) == 0));
+}
+
+struct obj obj_pool[10000], *obj_stack[100];
 
 struct {
   obj_var cmd_dict, cmd_func_dict;
@@ -208,6 +227,792 @@ main(void)
   }
 #endif
 
+#if 1
+  {
+    static char s[] = "(1, 2, 3, 4, 5)";
+
+    ovm_news(vm, R0, sizeof(s) - 1, s);
+    assert(ovm_type(vm, R0) == OBJ_TYPE_LIST);
+    assert(strcmp(ovm_type_name(ovm_type(vm, R0)), "list") == 0);
+    obj_check(vm, R0, s);
+
+    ovm_move(vm, R1, R0);
+    ovm_call(vm, R1, OBJ_OP_SIZE);
+    assert(ovm_integer_val(vm, R1) == 5);
+
+    ovm_newc(vm, R2, OBJ_TYPE_INTEGER, (obj_integer_val_t) 3);
+    ovm_move(vm, R1, R0);
+    ovm_call(vm, R1, OBJ_OP_AT, R2);
+    assert(ovm_integer_val(vm, R1) == 4);
+
+    ovm_newc(vm, R3, OBJ_TYPE_INTEGER, (obj_integer_val_t) 1);
+    ovm_move(vm, R1, R0);
+    ovm_call(vm, R1, OBJ_OP_SLICE, R3, R2);
+    obj_check(vm, R1, "(2, 3, 4)");
+
+    ovm_call(vm, R1, OBJ_OP_CDR);
+    obj_check(vm, R1, "(3, 4)");
+    ovm_call(vm, R1, OBJ_OP_CAR);
+    assert(ovm_integer_val(vm, R1) == 3);
+
+    /* Cons cell sharing a vector tail */
+
+    ovm_new(vm, R1, OBJ_TYPE_LIST, 2, R2, R0);
+    assert(ovm_type(vm, R1) == OBJ_TYPE_LIST);
+    obj_check(vm, R1, "(3, 1, 2, 3, 4, 5)");
+    ovm_move(vm, R4, R1);
+    ovm_call(vm, R4, OBJ_OP_AT, R2);
+    assert(ovm_integer_val(vm, R4) == 3);
+    ovm_move(vm, R4, R1);
+    ovm_call(vm, R4, OBJ_OP_SLICE, R3, R2);
+    assert(ovm_type(vm, R4) == OBJ_TYPE_LIST);
+    obj_check(vm, R4, "(1, 2, 3)");
+
+    ovm_move(vm, R4, R1);
+    ovm_call(vm, R4, OBJ_OP_APPEND, R0);
+    assert(ovm_type(vm, R4) == OBJ_TYPE_LIST);
+    obj_check(vm, R4, "(3, 1, 2, 3, 4, 5, 1, 2, 3, 4, 5)");
+
+    ovm_move(vm, R4, R1);
+    ovm_call(vm, R4, OBJ_OP_REVERSE);
+    obj_check(vm, R4, "(5, 4, 3, 2, 1, 3)");
+
+    ovm_new(vm, R4, OBJ_TYPE_LIST, 1, R1);
+    assert(ovm_type(vm, R4) == OBJ_TYPE_LIST);
+    ovm_call(vm, R4, OBJ_OP_EQ, R1);
+    assert(ovm_bool_val(vm, R4));
+
+    assert(ovm_errno(vm) == OBJ_ERRNO_NONE);
+  }
+#endif
+
+#if 1
+  {
+    static char s[] = "[0, 1, 2, 3, 4, 5, 6, 7, 8, 9]";
+
+    ovm_news(vm, R0, sizeof(s) - 1, s);
+    ovm_new(vm, R1, OBJ_TYPE_ITERATOR, R0);
+    obj_check(vm, R1, "#iterator");
+
+    /* Fused slice and reverse, then drain */
+
+    ovm_newc(vm, R2, OBJ_TYPE_INTEGER, (obj_integer_val_t) 2);
+    ovm_newc(vm, R3, OBJ_TYPE_INTEGER, (obj_integer_val_t) 6);
+    ovm_call(vm, R1, OBJ_OP_SLICE, R2, R3);
+    ovm_call(vm, R1, OBJ_OP_REVERSE);
+    ovm_new(vm, R4, OBJ_TYPE_LIST, 1, R1);
+    obj_check(vm, R4, "(7, 6, 5, 4, 3, 2)");
+
+    /* Filter by C predicate, then step by hand */
+
+    ovm_new(vm, R1, OBJ_TYPE_ITERATOR, R0);
+    ovm_newc(vm, R2, OBJ_TYPE_POINTER, is_even);
+    ovm_call(vm, R1, OBJ_OP_FILTER, R2);
+    ovm_newc(vm, R2, OBJ_TYPE_INTEGER, (obj_integer_val_t) 1);
+    ovm_call(vm, R1, OBJ_OP_SLICE, R2, R3);
+    ovm_call(vm, R1, OBJ_OP_NEXT, R4);
+    assert(ovm_integer_val(vm, R4) == 2);
+    ovm_new(vm, R4, OBJ_TYPE_ARRAY, R1);
+    obj_check(vm, R4, "[4, 6, 8]");
+    ovm_call(vm, R1, OBJ_OP_NEXT, R4);
+    assert(ovm_type(vm, R1) == OBJ_TYPE_NIL);
+    obj_check(vm, R0, s);
+
+    /* Slice past the end stops at the end of the source */
+
+    ovm_new(vm, R1, OBJ_TYPE_ITERATOR, R0);
+    ovm_newc(vm, R2, OBJ_TYPE_INTEGER, (obj_integer_val_t) 8);
+    ovm_newc(vm, R3, OBJ_TYPE_INTEGER, (obj_integer_val_t) 100);
+    ovm_call(vm, R1, OBJ_OP_SLICE, R2, R3);
+    ovm_new(vm, R4, OBJ_TYPE_ARRAY, R1);
+    obj_check(vm, R4, "[8, 9]");
+
+    /* Filter by boolean sequence, over a list */
+
+    ovm_news(vm, R0, sizeof("(1, 2, 3)") - 1, "(1, 2, 3)");
+    ovm_news(vm, R2, sizeof("(#true, #false, #true)") - 1, "(#true, #false, #true)");
+    ovm_new(vm, R1, OBJ_TYPE_ITERATOR, R0);
+    ovm_call(vm, R1, OBJ_OP_FILTER, R2);
+    ovm_new(vm, R4, OBJ_TYPE_LIST, 1, R1);
+    obj_check(vm, R4, "(1, 3)");
+
+    /* Keys of dictionary */
+
+    ovm_news(vm, R0, sizeof("{\"a\": 1}") - 1, "{\"a\": 1}");
+    ovm_new(vm, R1, OBJ_TYPE_ITERATOR, R0);
+    ovm_call(vm, R1, OBJ_OP_KEYS);
+    ovm_new(vm, R4, OBJ_TYPE_ARRAY, R1);
+    obj_check(vm, R4, "[\"a\"]");
+
+    assert(ovm_errno(vm) == OBJ_ERRNO_NONE);
+  }
+#endif
+
+#if 1
+  {
+    unsigned i;
+
+    /* Build 1000 entries, keeping a snapshot at 500 */
+
+    ovm_newc(vm, R0, OBJ_TYPE_PDICT);
+    for (i = 0; i < 1000; ++i) {
+      if (i == 500)  ovm_new(vm, R5, OBJ_TYPE_PDICT, R0);
+      ovm_newc(vm, R1, OBJ_TYPE_INTEGER, (obj_integer_val_t) i);
+      ovm_newc(vm, R2, OBJ_TYPE_INTEGER, (obj_integer_val_t) (i * 2));
+      ovm_call(vm, R0, OBJ_OP_AT_PUT, R1, R2);
+    }
+    ovm_move(vm, R1, R0);
+    ovm_call(vm, R1, OBJ_OP_COUNT);
+    assert(ovm_integer_val(vm, R1) == 1000);
+    ovm_move(vm, R1, R5);
+    ovm_call(vm, R1, OBJ_OP_COUNT);
+    assert(ovm_integer_val(vm, R1) == 500);
+
+    for (i = 0; i < 1000; ++i) {
+      ovm_newc(vm, R2, OBJ_TYPE_INTEGER, (obj_integer_val_t) i);
+      ovm_move(vm, R1, R0);
+      ovm_call(vm, R1, OBJ_OP_AT, R2);
+      ovm_call(vm, R1, OBJ_OP_CDR);
+      assert(ovm_integer_val(vm, R1) == i * 2);
+      ovm_move(vm, R1, R5);
+      ovm_call(vm, R1, OBJ_OP_AT, R2);
+      assert((ovm_type(vm, R1) == OBJ_TYPE_NIL) == (i >= 500));
+    }
+
+    /* Update and delete leave older versions intact */
+
+    ovm_newc(vm, R2, OBJ_TYPE_INTEGER, (obj_integer_val_t) 7);
+    ovm_move(vm, R6, R5);
+    ovm_call(vm, R6, OBJ_OP_AT_PUT, R2, R2);
+    ovm_move(vm, R1, R6);
+    ovm_call(vm, R1, OBJ_OP_AT, R2);
+    obj_check(vm, R1, "<7, 7>");
+    ovm_move(vm, R1, R5);
+    ovm_call(vm, R1, OBJ_OP_AT, R2);
+    obj_check(vm, R1, "<7, 14>");
+
+    for (i = 0; i < 1000; i += 2) {
+      ovm_newc(vm, R2, OBJ_TYPE_INTEGER, (obj_integer_val_t) i);
+      ovm_call(vm, R0, OBJ_OP_DEL, R2);
+    }
+    ovm_move(vm, R1, R0);
+    ovm_call(vm, R1, OBJ_OP_COUNT);
+    assert(ovm_integer_val(vm, R1) == 500);
+    ovm_move(vm, R1, R5);
+    ovm_call(vm, R1, OBJ_OP_COUNT);
+    assert(ovm_integer_val(vm, R1) == 500);
+    ovm_newc(vm, R2, OBJ_TYPE_INTEGER, (obj_integer_val_t) 3);
+    ovm_move(vm, R1, R0);
+    ovm_call(vm, R1, OBJ_OP_AT, R2);
+    obj_check(vm, R1, "<3, 6>");
+    ovm_newc(vm, R2, OBJ_TYPE_INTEGER, (obj_integer_val_t) 4);
+    ovm_move(vm, R1, R0);
+    ovm_call(vm, R1, OBJ_OP_AT, R2);
+    assert(ovm_type(vm, R1) == OBJ_TYPE_NIL);
+
+    /* Conversions */
+
+    ovm_news(vm, R1, sizeof("{\"a\": 1}") - 1, "{\"a\": 1}");
+    ovm_new(vm, R1, OBJ_TYPE_PDICT, R1);
+    assert(ovm_type(vm, R1) == OBJ_TYPE_PDICT);
+    obj_check(vm, R1, "{\"a\": 1}");
+    ovm_new(vm, R1, OBJ_TYPE_DICT, R1);
+    assert(ovm_type(vm, R1) == OBJ_TYPE_DICT);
+
+    ovm_new(vm, R0, OBJ_TYPE_NIL);
+    ovm_new(vm, R5, OBJ_TYPE_NIL);
+    ovm_new(vm, R6, OBJ_TYPE_NIL);
+
+    assert(ovm_errno(vm) == OBJ_ERRNO_NONE);
+  }
+#endif
+
+#if 1
+  {
+    unsigned i;
+
+    /* Membership */
+
+    ovm_newc(vm, R0, OBJ_TYPE_SET, 0);
+    ovm_newc(vm, R2, OBJ_TYPE_BOOLEAN, 1);
+    for (i = 0; i < 100; i += 2) {
+      ovm_newc(vm, R1, OBJ_TYPE_INTEGER, (obj_integer_val_t) i);
+      ovm_call(vm, R0, OBJ_OP_AT_PUT, R1, R2);
+    }
+    ovm_newc(vm, R1, OBJ_TYPE_INTEGER, (obj_integer_val_t) 4);
+    ovm_call(vm, R0, OBJ_OP_AT_PUT, R1, R2);
+    ovm_move(vm, R3, R0);
+    ovm_call(vm, R3, OBJ_OP_COUNT);
+    assert(ovm_integer_val(vm, R3) == 50);
+    ovm_move(vm, R3, R0);
+    ovm_call(vm, R3, OBJ_OP_SIZE);
+    assert(ovm_integer_val(vm, R3) == 50);
+    for (i = 0; i < 100; ++i) {
+      ovm_newc(vm, R1, OBJ_TYPE_INTEGER, (obj_integer_val_t) i);
+      ovm_move(vm, R3, R0);
+      ovm_call(vm, R3, OBJ_OP_AT, R1);
+      assert(ovm_bool_val(vm, R3) == (i % 2 == 0));
+    }
+
+    /* Delete, and check that probe sequences survive */
+
+    for (i = 0; i < 100; i += 4) {
+      ovm_newc(vm, R1, OBJ_TYPE_INTEGER, (obj_integer_val_t) i);
+      ovm_call(vm, R0, OBJ_OP_DEL, R1);
+    }
+    for (i = 0; i < 100; ++i) {
+      ovm_newc(vm, R1, OBJ_TYPE_INTEGER, (obj_integer_val_t) i);
+      ovm_move(vm, R3, R0);
+      ovm_call(vm, R3, OBJ_OP_AT, R1);
+      assert(ovm_bool_val(vm, R3) == (i % 4 == 2));
+    }
+    ovm_move(vm, R3, R0);
+    ovm_call(vm, R3, OBJ_OP_COUNT);
+    assert(ovm_integer_val(vm, R3) == 25);
+    ovm_move(vm, R3, R0);
+    ovm_call(vm, R3, OBJ_OP_SIZE);
+    assert(ovm_integer_val(vm, R3) == 25);
+
+    /* Bulk operations */
+
+    ovm_news(vm, R0, sizeof("#{1, 2, \"a\", 3}") - 1, "#{1, 2, \"a\", 3}");
+    ovm_new(vm, R0, OBJ_TYPE_SET, R0);
+    ovm_news(vm, R1, sizeof("#{2, 3, 4}") - 1, "#{2, 3, 4}");
+    ovm_new(vm, R1, OBJ_TYPE_SET, R1);
+
+    ovm_news(vm, R3, sizeof("#{1, 2, 3, 4, \"a\"}") - 1, "#{1, 2, 3, 4, \"a\"}");
+    ovm_new(vm, R3, OBJ_TYPE_SET, R3);
+    ovm_move(vm, R2, R0);
+    ovm_call(vm, R2, OBJ_OP_OR, R1);
+    ovm_call(vm, R2, OBJ_OP_EQ, R3);
+    assert(ovm_bool_val(vm, R2));
+
+    ovm_move(vm, R2, R0);
+    ovm_call(vm, R2, OBJ_OP_AND, R1);
+    ovm_new(vm, R2, OBJ_TYPE_ARRAY, R2);
+    ovm_call(vm, R2, OBJ_OP_SORT);
+    obj_check(vm, R2, "[2, 3]");
+
+    ovm_move(vm, R2, R0);
+    ovm_call(vm, R2, OBJ_OP_SUB, R1);
+    ovm_call(vm, R2, OBJ_OP_COUNT);
+    assert(ovm_integer_val(vm, R2) == 2);
+
+    ovm_move(vm, R2, R0);
+    ovm_call(vm, R2, OBJ_OP_XOR, R1);
+    ovm_news(vm, R3, sizeof("#{\"a\", 4, 1}") - 1, "#{\"a\", 4, 1}");
+    ovm_new(vm, R3, OBJ_TYPE_SET, R3);
+    ovm_call(vm, R2, OBJ_OP_EQ, R3);
+    assert(ovm_bool_val(vm, R2));
+
+    ovm_news(vm, R2, sizeof("#{}") - 1, "#{}");
+    ovm_new(vm, R2, OBJ_TYPE_SET, R2);
+    obj_check(vm, R2, "#{}");
+
+    /* Helpers, as used by applications */
+
+    obj_set_new(vm);
+    ovm_move(vm, R1, R0);
+    ovm_newc(vm, R2, OBJ_TYPE_STRING, 3, "foo");
+    ovm_push(vm, R2);
+    ovm_push(vm, R1);
+    obj_set_insert(vm);
+    ovm_push(vm, R2);
+    ovm_push(vm, R1);
+    obj_set_member(vm);
+    assert(ovm_bool_val(vm, R0));
+    ovm_push(vm, R2);
+    ovm_push(vm, R1);
+    obj_set_del(vm);
+    ovm_push(vm, R2);
+    ovm_push(vm, R1);
+    obj_set_member(vm);
+    assert(!ovm_bool_val(vm, R0));
+
+    for (i = R0; i <= R3; ++i)  ovm_new(vm, i, OBJ_TYPE_NIL);
+
+    assert(ovm_errno(vm) == OBJ_ERRNO_NONE);
+  }
+#endif
+
+#if 1
+  {
+    ovm_newc(vm, R0, OBJ_TYPE_FLOAT, (obj_float_val_t) -2.5);
+    ovm_call(vm, R0, OBJ_OP_ABS);
+    assert(ovm_float_val(vm, R0) == 2.5);
+    obj_check(vm, R0, "2.5");
+    ovm_news(vm, R0, sizeof("1.25e-3") - 1, "1.25e-3");
+    ovm_new(vm, R0, OBJ_TYPE_FLOAT, R0);
+    assert(ovm_float_val(vm, R0) == (obj_float_val_t) 1.25e-3L);
+
+    /* Text longer than the conversion buffer */
+
+    {
+      static char s[] = "0.1000000000000000000000000000000000000000000000000000000000000000000000000000";
+
+      ovm_news(vm, R0, sizeof(s) - 1, s);
+      ovm_new(vm, R0, OBJ_TYPE_FLOAT, R0);
+      assert(ovm_float_val(vm, R0) == (obj_float_val_t) 0.1L);
+    }
+
+    /* Numbers are classified in one scan */
+
+    ovm_news(vm, R0, sizeof("[1, -2.5, 0x10, 017, 09, 9223372036854775808, 1e+2]") - 1,
+	     "[1, -2.5, 0x10, 017, 09, 9223372036854775808, 1e+2]"
+	     );
+    ovm_new(vm, R0, OBJ_TYPE_ARRAY, R0);
+    obj_check(vm, R0, "[1, -2.5, 16, 15, 9, 9.22337e+18, 100]");
+    ovm_news(vm, R0, sizeof("\"1.5\"") - 1, "\"1.5\"");
+    ovm_new(vm, R0, OBJ_TYPE_INTEGER, R0);
+    assert(ovm_errno(vm) == OBJ_ERRNO_BAD_VALUE);
+    ovm_err_clr(vm);
+    ovm_news(vm, R0, sizeof("\"-1e\"") - 1, "\"-1e\"");
+    ovm_new(vm, R0, OBJ_TYPE_FLOAT, R0);
+    assert(ovm_errno(vm) == OBJ_ERRNO_BAD_VALUE);
+    ovm_err_clr(vm);
+
+    ovm_new(vm, R0, OBJ_TYPE_NIL);
+
+    assert(ovm_errno(vm) == OBJ_ERRNO_NONE);
+  }
+#endif
+
+#if 1
+  {
+    static char s[] = "[1, <2, \"foo\">, (3, 4.5), [#true, #nil], #{6}]";
+    unsigned    i;
+
+    ovm_news(vm, R0, sizeof(s) - 1, s);
+    ovm_news(vm, R1, sizeof(s) - 1, s);
+    ovm_move(vm, R2, R0);
+    ovm_call(vm, R2, OBJ_OP_EQ, R1);
+    assert(ovm_bool_val(vm, R2));
+    ovm_move(vm, R2, R0);
+    ovm_call(vm, R2, OBJ_OP_EQ, R0);
+    assert(ovm_bool_val(vm, R2));
+
+    /* Same size, differing element */
+
+    ovm_news(vm, R1, sizeof("[1, <2, \"foo\">, (3, 4.5), [#true, #nil], #{7}]") - 1,
+	     "[1, <2, \"foo\">, (3, 4.5), [#true, #nil], #{7}]"
+	     );
+    ovm_move(vm, R2, R0);
+    ovm_call(vm, R2, OBJ_OP_EQ, R1);
+    assert(!ovm_bool_val(vm, R2));
+
+    /* Cons list against vector list, and slices sharing a vector */
+
+    ovm_news(vm, R0, sizeof("(1, 2, 3, 4)") - 1, "(1, 2, 3, 4)");
+    ovm_newc(vm, R1, OBJ_TYPE_INTEGER, (obj_integer_val_t) 0);
+    ovm_new(vm, R2, OBJ_TYPE_LIST, 2, R1, R0);
+    ovm_news(vm, R3, sizeof("(0, 1, 2, 3, 4)") - 1, "(0, 1, 2, 3, 4)");
+    ovm_call(vm, R3, OBJ_OP_EQ, R2);
+    assert(ovm_bool_val(vm, R3));
+    ovm_call(vm, R2, OBJ_OP_CDR);
+    ovm_move(vm, R3, R0);
+    ovm_call(vm, R3, OBJ_OP_CDR);
+    ovm_call(vm, R2, OBJ_OP_CDR);
+    ovm_call(vm, R2, OBJ_OP_EQ, R3);
+    assert(ovm_bool_val(vm, R2));
+    ovm_move(vm, R2, R0);
+    ovm_call(vm, R2, OBJ_OP_EQ, R3);
+    assert(!ovm_bool_val(vm, R2));
+
+    /* NaN equals NaN, in the same object or in a copy; so do the zeros,
+       including as set members
+    */
+
+    ovm_newc(vm, R0, OBJ_TYPE_ARRAY, 1);
+    ovm_newc(vm, R1, OBJ_TYPE_ARRAY, 1);
+    ovm_newc(vm, R2, OBJ_TYPE_INTEGER, (obj_integer_val_t) 0);
+    ovm_newc(vm, R3, OBJ_TYPE_FLOAT, (obj_float_val_t) __builtin_nan(""));
+    ovm_call(vm, R0, OBJ_OP_AT_PUT, R2, R3);
+    ovm_newc(vm, R3, OBJ_TYPE_FLOAT, (obj_float_val_t) -__builtin_nan(""));
+    ovm_call(vm, R1, OBJ_OP_AT_PUT, R2, R3);
+    ovm_move(vm, R2, R0);
+    ovm_call(vm, R2, OBJ_OP_EQ, R0);
+    assert(ovm_bool_val(vm, R2));
+    ovm_move(vm, R2, R0);
+    ovm_call(vm, R2, OBJ_OP_EQ, R1);
+    assert(ovm_bool_val(vm, R2));
+    ovm_new(vm, R0, OBJ_TYPE_SET, R0);
+    ovm_move(vm, R2, R0);
+    ovm_call(vm, R2, OBJ_OP_AT, R3);
+    assert(ovm_bool_val(vm, R2));
+    ovm_newc(vm, R2, OBJ_TYPE_FLOAT, (obj_float_val_t) 0.0);
+    ovm_newc(vm, R3, OBJ_TYPE_BOOLEAN, 1);
+    ovm_call(vm, R0, OBJ_OP_AT_PUT, R2, R3);
+    ovm_newc(vm, R2, OBJ_TYPE_FLOAT, (obj_float_val_t) -0.0);
+    ovm_call(vm, R0, OBJ_OP_AT, R2);
+    assert(ovm_bool_val(vm, R0));
+
+    /* Dictionaries by identity */
+
+    ovm_news(vm, R0, sizeof("{\"a\": 1}") - 1, "{\"a\": 1}");
+    ovm_news(vm, R1, sizeof("{\"a\": 1}") - 1, "{\"a\": 1}");
+    ovm_move(vm, R2, R0);
+    ovm_call(vm, R2, OBJ_OP_EQ, R0);
+    assert(ovm_bool_val(vm, R2));
+    ovm_move(vm, R2, R0);
+    ovm_call(vm, R2, OBJ_OP_EQ, R1);
+    assert(!ovm_bool_val(vm, R2));
+
+    /* Element without equality */
+
+    ovm_news(vm, R0, sizeof("(1, 2, 3, 4)") - 1, "(1, 2, 3, 4)");
+    ovm_newc(vm, R1, OBJ_TYPE_ARRAY, 1);
+    ovm_newc(vm, R2, OBJ_TYPE_INTEGER, (obj_integer_val_t) 0);
+    ovm_new(vm, R3, OBJ_TYPE_ITERATOR, R0);
+    ovm_call(vm, R1, OBJ_OP_AT_PUT, R2, R3);
+    ovm_newc(vm, R2, OBJ_TYPE_ARRAY, 1);
+    ovm_call(vm, R1, OBJ_OP_EQ, R2);
+    assert(ovm_errno(vm) == OBJ_ERRNO_BAD_METHOD);
+    ovm_err_clr(vm);
+
+    for (i = R0; i <= R3; ++i)  ovm_new(vm, i, OBJ_TYPE_NIL);
+
+    assert(ovm_errno(vm) == OBJ_ERRNO_NONE);
+  }
+#endif
+
+#if 1
+  {
+    obj_t    frozen;
+    unsigned i;
+
+    /* Same list, built two ways; hash is memoized on first use */
+
+    ovm_news(vm, R0, sizeof("(<1, \"a\">, (2, 3), 4)") - 1, "(<1, \"a\">, (2, 3), 4)");
+    ovm_news(vm, R3, sizeof("(4)") - 1, "(4)");
+    ovm_news(vm, R2, sizeof("(2, 3)") - 1, "(2, 3)");
+    ovm_new(vm, R1, OBJ_TYPE_LIST, 2, R2, R3);
+    ovm_news(vm, R2, sizeof("<1, \"a\">") - 1, "<1, \"a\">");
+    ovm_new(vm, R3, OBJ_TYPE_LIST, 2, R2, R1);
+    ovm_move(vm, R1, R3);
+    for (i = 0; i < 2; ++i) {
+      ovm_move(vm, R2, R0);
+      ovm_call(vm, R2, OBJ_OP_HASH);
+      ovm_move(vm, R3, R1);
+      ovm_call(vm, R3, OBJ_OP_HASH);
+      assert(ovm_integer_val(vm, R2) == ovm_integer_val(vm, R3));
+    }
+    ovm_move(vm, R2, R0);
+    ovm_call(vm, R2, OBJ_OP_EQ, R1);
+    assert(ovm_bool_val(vm, R2));
+
+    /* Frozen copy hashes the same */
+
+    ovm_move(vm, R2, R0);
+    ovm_freeze(vm, R2);
+    frozen = ovm_frozen_val(vm, R2);
+    ovm_call(vm, R2, OBJ_OP_HASH);
+    assert(ovm_integer_val(vm, R2) == ovm_integer_val(vm, R3));
+    ovm_frozen_free(frozen);
+
+    /* Lists as dictionary keys */
+
+    ovm_newc(vm, R2, OBJ_TYPE_DICT, 16);
+    ovm_newc(vm, R3, OBJ_TYPE_INTEGER, (obj_integer_val_t) 42);
+    ovm_call(vm, R2, OBJ_OP_AT_PUT, R0, R3);
+    ovm_call(vm, R2, OBJ_OP_AT, R1);
+    ovm_call(vm, R2, OBJ_OP_CDR);
+    assert(ovm_integer_val(vm, R2) == 42);
+
+    /* Dictionary entries are not changed once shared */
+
+    ovm_news(vm, R0, sizeof("{\"a\": 1}") - 1, "{\"a\": 1}");
+    ovm_new(vm, R1, OBJ_TYPE_ARRAY, R0);
+    ovm_news(vm, R2, sizeof("\"a\"") - 1, "\"a\"");
+    ovm_newc(vm, R3, OBJ_TYPE_INTEGER, (obj_integer_val_t) 2);
+    ovm_call(vm, R0, OBJ_OP_AT_PUT, R2, R3);
+    obj_check(vm, R0, "{\"a\": 2}");
+    obj_check(vm, R1, "[<\"a\", 1>]");
+
+    /* Entry updated in place, once unshared, is rehashed */
+
+    ovm_move(vm, R1, R0);
+    ovm_call(vm, R1, OBJ_OP_AT, R2);
+    ovm_call(vm, R1, OBJ_OP_HASH);
+    ovm_newc(vm, R3, OBJ_TYPE_INTEGER, (obj_integer_val_t) 3);
+    ovm_call(vm, R0, OBJ_OP_AT_PUT, R2, R3);
+    ovm_call(vm, R0, OBJ_OP_AT, R2);
+    ovm_call(vm, R0, OBJ_OP_HASH);
+    ovm_news(vm, R3, sizeof("<\"a\", 3>") - 1, "<\"a\", 3>");
+    ovm_call(vm, R3, OBJ_OP_HASH);
+    assert(ovm_integer_val(vm, R0) == ovm_integer_val(vm, R3));
+    ovm_news(vm, R1, sizeof("[1]") - 1, "[1]");
+
+    /* Not hashable */
+
+    ovm_call(vm, R1, OBJ_OP_HASH);
+    assert(ovm_errno(vm) == OBJ_ERRNO_BAD_METHOD);
+    ovm_err_clr(vm);
+
+    for (i = R0; i <= R3; ++i)  ovm_new(vm, i, OBJ_TYPE_NIL);
+
+    assert(ovm_errno(vm) == OBJ_ERRNO_NONE);
+  }
+#endif
+
+#if 1
+  {
+    char     buf[300];
+    unsigned i, n;
+
+    /* Find, count and split, long enough to use vectors */
+
+    for (n = i = 0; i < sizeof(buf) - 1; ++i) {
+      buf[i] = 'a' + i % 7;
+      if (i % 37 == 20 && i + 3 < sizeof(buf) - 1) {
+	memcpy(&buf[i], "-->", 3);
+	i += 2;
+	++n;
+      }
+    }
+    buf[sizeof(buf) - 1] = 0;
+
+    ovm_newc(vm, R0, OBJ_TYPE_STRING, sizeof(buf) - 1, buf);
+    ovm_newc(vm, R1, OBJ_TYPE_STRING, 3, "-->");
+    ovm_move(vm, R2, R0);
+    ovm_call(vm, R2, OBJ_OP_FIND, R1);
+    assert(ovm_integer_val(vm, R2) == 20);
+    ovm_move(vm, R2, R0);
+    ovm_call(vm, R2, OBJ_OP_COUNT, R1);
+    assert(ovm_integer_val(vm, R2) == n);
+    ovm_move(vm, R2, R0);
+    ovm_call(vm, R2, OBJ_OP_SPLIT, R1);
+    ovm_call(vm, R2, OBJ_OP_SIZE);
+    assert(ovm_integer_val(vm, R2) == n + 1);
+
+    ovm_newc(vm, R1, OBJ_TYPE_STRING, 4, "--->");
+    ovm_move(vm, R2, R0);
+    ovm_call(vm, R2, OBJ_OP_FIND, R1);
+    assert(ovm_type(vm, R2) == OBJ_TYPE_NIL);
+
+    ovm_newc(vm, R0, OBJ_TYPE_STRING, 14, "GET /a  HTTP/1");
+    ovm_newc(vm, R1, OBJ_TYPE_STRING, 2, "  ");
+    ovm_call(vm, R0, OBJ_OP_SPLIT, R1);
+    obj_check(vm, R0, "(\"GET /a\", \"HTTP/1\")");
+    ovm_newc(vm, R0, OBJ_TYPE_STRING, 5, "a,,b,");
+    ovm_newc(vm, R1, OBJ_TYPE_STRING, 1, ",");
+    ovm_call(vm, R0, OBJ_OP_SPLIT, R1);
+    obj_check(vm, R0, "(\"a\", \"\", \"b\", \"\")");
+
+    for (i = R0; i <= R2; ++i)  ovm_new(vm, i, OBJ_TYPE_NIL);
+
+    assert(ovm_errno(vm) == OBJ_ERRNO_NONE);
+  }
+#endif
+
+#if 1
+  {
+    static struct ovm        vm2[1];
+    static struct obj        obj_pool2[100], *obj_stack2[10];
+    static obj_var           obj_work2[1];
+    obj_t                    frozen, frozen2;
+
+    /* Freeze a dict holding shared substructure */
+
+    ovm_news(vm, R0, sizeof("{\"a\": [1, 2], \"b\": \"foo\"}") - 1, "{\"a\": [1, 2], \"b\": \"foo\"}");
+    ovm_new(vm, R0, OBJ_TYPE_DICT, R0);
+    ovm_freeze(vm, R0);
+    assert(ovm_errno(vm) == OBJ_ERRNO_NONE);
+    frozen = ovm_frozen_val(vm, R0);
+
+    /* Use it from a second VM */
+
+    ovm_init(vm2, sizeof(obj_pool2), obj_pool2, sizeof(obj_work2), obj_work2, sizeof(obj_stack2), obj_stack2);
+    ovm_frozen_load(vm2, R1, frozen);
+    ovm_newc(vm2, R2, OBJ_TYPE_STRING, 1, "a");
+    ovm_call(vm2, R1, OBJ_OP_AT, R2);
+    ovm_call(vm2, R1, OBJ_OP_CDR);
+    obj_check(vm2, R1, "[1, 2]");
+
+    /* Modification fails, and leaves it intact */
+
+    ovm_newc(vm2, R3, OBJ_TYPE_INTEGER, (obj_integer_val_t) 0);
+    ovm_call(vm2, R1, OBJ_OP_AT_PUT, R3, R3);
+    assert(ovm_errno(vm2) == OBJ_ERRNO_FROZEN);
+    ovm_err_clr(vm2);
+    ovm_frozen_load(vm2, R1, frozen);
+    ovm_call(vm2, R1, OBJ_OP_AT_PUT, R2, R3);
+    assert(ovm_errno(vm2) == OBJ_ERRNO_FROZEN);
+    ovm_err_clr(vm2);
+    obj_check(vm, R0, "{\"b\": \"foo\", \"a\": [1, 2]}");
+
+    ovm_fini(vm2);
+
+    ovm_new(vm, R0, OBJ_TYPE_NIL);
+    ovm_frozen_free(frozen);
+
+    /* Booleans are static, and a graph frozen earlier has its own owner */
+
+    ovm_news(vm, R0, sizeof("[#true, 1]") - 1, "[#true, 1]");
+    ovm_freeze(vm, R0);
+    frozen = ovm_frozen_val(vm, R0);
+    ovm_newc(vm, R1, OBJ_TYPE_ARRAY, 2);
+    ovm_newc(vm, R2, OBJ_TYPE_INTEGER, (obj_integer_val_t) 0);
+    ovm_call(vm, R1, OBJ_OP_AT_PUT, R2, R0);
+    ovm_freeze(vm, R1);
+    ovm_newc(vm, R2, OBJ_TYPE_INTEGER, (obj_integer_val_t) 1);
+    ovm_move(vm, R3, R0);
+    ovm_call(vm, R3, OBJ_OP_AT, R2);
+    ovm_frozen_free(ovm_frozen_val(vm, R3));	/* Not a root; no effect */
+    ovm_move(vm, R3, R0);
+    ovm_freeze(vm, R3);				/* Already frozen; no new owner */
+    assert(ovm_frozen_val(vm, R3) == frozen);
+    ovm_new(vm, R3, OBJ_TYPE_NIL);
+    frozen2 = ovm_frozen_val(vm, R1);
+    ovm_new(vm, R1, OBJ_TYPE_NIL);
+    ovm_frozen_free(frozen2);
+    obj_check(vm, R0, "[#true, 1]");
+    ovm_new(vm, R0, OBJ_TYPE_NIL);
+    ovm_frozen_free(frozen);
+
+    assert(ovm_errno(vm) == OBJ_ERRNO_NONE);
+  }
+#endif
+
+#if 1
+  {
+    static struct ovm        vm2[1];
+    static struct obj        obj_pool2[100], *obj_stack2[10];
+    static obj_var           obj_work2[1];
+    obj_t                    frozen;
+    struct ovm_chan          *ch;
+
+    ovm_init(vm2, sizeof(obj_pool2), obj_pool2, sizeof(obj_work2), obj_work2, sizeof(obj_stack2), obj_stack2);
+    ch = ovm_chan_new(2);
+    assert(ch != 0);
+
+    /* Uniquely owned, except for one array still referenced by sender */
+
+    ovm_news(vm, R0, sizeof("[\"foo\", [1, 2], <3, 4>, 0]") - 1, "[\"foo\", [1, 2], <3, 4>, 0]");
+    ovm_new(vm, R0, OBJ_TYPE_ARRAY, R0);
+    ovm_newc(vm, R2, OBJ_TYPE_INTEGER, (obj_integer_val_t) 1);
+    ovm_move(vm, R1, R0);
+    ovm_call(vm, R1, OBJ_OP_AT, R2);
+    ovm_newc(vm, R2, OBJ_TYPE_INTEGER, (obj_integer_val_t) 3);
+    ovm_call(vm, R0, OBJ_OP_AT_PUT, R2, R1);
+    obj_check(vm, R0, "[\"foo\", [1, 2], <3, 4>, [1, 2]]");
+    assert(ovm_chan_send(vm, ch, R0) == 0);
+    assert(ovm_type(vm, R0) == OBJ_TYPE_NIL);
+    obj_check(vm, R1, "[1, 2]");
+
+    /* Frozen, passed as is */
+
+    ovm_newc(vm, R0, OBJ_TYPE_STRING, 3, "bar");
+    ovm_freeze(vm, R0);
+    frozen = ovm_frozen_val(vm, R0);
+    assert(ovm_chan_send(vm, ch, R0) == 0);
+
+    /* Full */
+
+    ovm_newc(vm, R0, OBJ_TYPE_INTEGER, (obj_integer_val_t) 42);
+    assert(ovm_chan_send(vm, ch, R0) < 0);
+    assert(ovm_errno(vm) == OBJ_ERRNO_NONE);
+    assert(ovm_type(vm, R0) == OBJ_TYPE_INTEGER);
+
+    assert(ovm_chan_recv(vm2, ch, R1) == 0);
+    obj_check(vm2, R1, "[\"foo\", [1, 2], <3, 4>, [1, 2]]");
+    ovm_newc(vm2, R2, OBJ_TYPE_INTEGER, (obj_integer_val_t) 1);
+    ovm_newc(vm2, R3, OBJ_TYPE_INTEGER, (obj_integer_val_t) 0);
+    ovm_move(vm2, R4, R1);
+    ovm_call(vm2, R4, OBJ_OP_AT, R2);
+    ovm_call(vm2, R4, OBJ_OP_AT_PUT, R3, R3);
+    obj_check(vm2, R1, "[\"foo\", [0, 2], <3, 4>, [0, 2]]");
+    obj_check(vm, R1, "[1, 2]");
+
+    assert(ovm_chan_recv(vm2, ch, R1) == 0);
+    assert(ovm_frozen_val(vm2, R1) == frozen);
+    assert(ovm_chan_recv(vm2, ch, R1) < 0);
+
+    /* Failed send is skipped */
+
+    ovm_new(vm, R1, OBJ_TYPE_ITERATOR, R1);
+    assert(ovm_chan_send(vm, ch, R1) < 0);
+    assert(ovm_errno(vm) == OBJ_ERRNO_BAD_TYPE);
+    ovm_err_clr(vm);
+    assert(ovm_chan_send(vm, ch, R0) == 0);
+    assert(ovm_chan_recv(vm2, ch, R1) == 0);
+    assert(ovm_integer_val(vm2, R1) == 42);
+
+    /* Unreceived messages are discarded */
+
+    ovm_news(vm, R0, sizeof("[\"foo\"]") - 1, "[\"foo\"]");
+    ovm_new(vm, R0, OBJ_TYPE_ARRAY, R0);
+    assert(ovm_chan_send(vm, ch, R0) == 0);
+    ovm_chan_free(ch);
+
+    ovm_fini(vm2);
+    ovm_frozen_free(frozen);
+
+    ovm_new(vm, R0, OBJ_TYPE_NIL);
+    ovm_new(vm, R1, OBJ_TYPE_NIL);
+
+    assert(ovm_errno(vm) == OBJ_ERRNO_NONE);
+  }
+#endif
+
+#if 1
+  {
+    enum { N = 1 << 19 };
+    static struct ovm vm5[1];
+    static obj_var    obj_work5[1];
+    static obj_t      obj_stack5[10];
+    static struct ovm vm2[1];
+    static struct obj obj_pool2[100], *obj_stack2[10];
+    static obj_var    obj_work2[1];
+    struct ovm_chan   *ch;
+    struct obj        *obj_pool5;
+    char              *buf;
+    obj_t             frozen;
+    unsigned          i;
+
+    /* Graph walks over a long list do not recurse */
+
+    assert((obj_pool5 = malloc((3 * N) * sizeof(*obj_pool5))) != 0);
+    assert((buf = malloc(2 * N)) != 0);
+    for (i = 0; i < N; ++i)  memcpy(buf + 2 * i, "a,", 2);
+    ovm_init(vm5, (3 * N) * sizeof(*obj_pool5), obj_pool5, sizeof(obj_work5), obj_work5, sizeof(obj_stack5), obj_stack5);
+
+    ovm_newc(vm5, R0, OBJ_TYPE_STRING, 2 * N - 1, buf);
+    ovm_newc(vm5, R1, OBJ_TYPE_STRING, 1, ",");
+    ovm_call(vm5, R0, OBJ_OP_SPLIT, R1);
+    ovm_move(vm5, R2, R0);
+    ovm_call(vm5, R2, OBJ_OP_HASH);
+    ovm_freeze(vm5, R0);
+    assert(ovm_errno(vm5) == OBJ_ERRNO_NONE);
+    frozen = ovm_frozen_val(vm5, R0);
+    ovm_move(vm5, R3, R0);
+    ovm_call(vm5, R3, OBJ_OP_HASH);
+    assert(ovm_integer_val(vm5, R3) == ovm_integer_val(vm5, R2));
+    ovm_call(vm5, R0, OBJ_OP_SIZE);
+    assert(ovm_integer_val(vm5, R0) == N);
+    ovm_frozen_free(frozen);
+
+    /* Sent over a channel; a receiver without room leaves it there */
+
+    ovm_init(vm2, sizeof(obj_pool2), obj_pool2, sizeof(obj_work2), obj_work2, sizeof(obj_stack2), obj_stack2);
+    assert((ch = ovm_chan_new(1)) != 0);
+    ovm_newc(vm5, R0, OBJ_TYPE_STRING, 2 * N - 1, buf);
+    ovm_call(vm5, R0, OBJ_OP_SPLIT, R1);
+    assert(ovm_chan_send(vm5, ch, R0) == 0);
+    assert(ovm_chan_recv(vm2, ch, R0) == -1 && ovm_errno(vm2) == OBJ_ERRNO_MEM);
+    ovm_err_clr(vm2);
+    assert(ovm_chan_recv(vm5, ch, R0) == 0);
+    ovm_call(vm5, R0, OBJ_OP_SIZE);
+    assert(ovm_integer_val(vm5, R0) == N);
+    assert(ovm_chan_recv(vm5, ch, R0) == -1 && ovm_errno(vm5) == OBJ_ERRNO_NONE);
+    ovm_chan_free(ch);
+    ovm_fini(vm2);
+
+    ovm_fini(vm5);
+    free(buf);
+    free(obj_pool5);
+  }
+#endif
+
 #if 0
   ovm_newc(vm, R0, OBJ_TYPE_INTEGER, (obj_integer_val_t) 1234);
   ovm_newc(vm, R1, OBJ_TYPE_INTEGER, (obj_integer_val_t) 5678);
@@ -501,6 +1306,225 @@ main(void)
 
 #endif
 
+#if 1
+  {
+    static struct ovm vm3[1];
+    static struct obj obj_pool3[100], *obj_stack3[10];
+    static obj_var    obj_work3[1];
+    struct ovm_heap   h[1];
+    unsigned          base, i, n;
+
+    /* Pool region also holds the liveness bitmap */
+
+    ovm_init(vm3, OVM_POOL_SIZE(64), obj_pool3, sizeof(obj_work3), obj_work3, sizeof(obj_stack3), obj_stack3);
+    assert(ovm_errno(vm3) == OBJ_ERRNO_NONE && vm3->obj_pool_size == 64);
+    ovm_fini(vm3);
+
+    ovm_init(vm3, sizeof(obj_pool3), obj_pool3, sizeof(obj_work3), obj_work3, sizeof(obj_stack3), obj_stack3);
+    assert(vm3->obj_pool_size == 99);
+
+    /* Fresh VM holds only class dictionaries */
+
+    assert(ovm_heap_get(vm3, h) == 0);
+    base = h->pool_used;
+    assert(base == h->type[OBJ_TYPE_DICT - OBJ_TYPE_BASE].cnt);
+    assert(h->roots.cl == base && h->pool_reachable == base);
+
+    /* One root of each kind */
+
+    ovm_news(vm3, R0, sizeof("[1, \"abc\"]") - 1, "[1, \"abc\"]");
+    ovm_newc(vm3, R1, OBJ_TYPE_INTEGER, (obj_integer_val_t) 7);
+    ovm_push(vm3, R1);
+    ovm_newc(vm3, R1, OBJ_TYPE_STRING, 2, "xy");
+    ovm_store(vm3, R1, obj_work3[0]);
+    ovm_new(vm3, R1, OBJ_TYPE_NIL);
+
+    /* Array holding itself, so retained but unreachable */
+
+    ovm_newc(vm3, R2, OBJ_TYPE_ARRAY, 1);
+    ovm_newc(vm3, R3, OBJ_TYPE_INTEGER, (obj_integer_val_t) 0);
+    ovm_call(vm3, R2, OBJ_OP_AT_PUT, R3, R2);
+    ovm_new(vm3, R2, OBJ_TYPE_NIL);
+    ovm_new(vm3, R3, OBJ_TYPE_NIL);
+    assert(ovm_errno(vm3) == OBJ_ERRNO_NONE);
+
+    assert(ovm_heap_get(vm3, h) == 0);
+    assert(h->pool_used == base + 6);
+    assert(h->pool_reachable == base + 5);
+    assert(h->roots.regs == 3 && h->roots.stack == 1 && h->roots.work == 1);
+    assert(h->type[OBJ_TYPE_ARRAY - OBJ_TYPE_BASE].cnt == 2);
+    assert(h->type[OBJ_TYPE_ARRAY - OBJ_TYPE_BASE].unreachable == 1);
+    assert(h->type[OBJ_TYPE_STRING - OBJ_TYPE_BASE].cnt == 2);
+    assert(h->type[OBJ_TYPE_STRING - OBJ_TYPE_BASE].payload_bytes == sizeof("abc") + sizeof("xy"));
+    for (n = i = 0; i < OVM_HEAP_REF_CNT_LOG; ++i)  n += h->ref_cnt[i];
+    assert(n == h->pool_used);
+    assert(h->top_cnt == OVM_HEAP_TOP_CNT);
+    for (i = 1; i < h->top_cnt; ++i)  assert(h->top[i - 1].payload_bytes >= h->top[i].payload_bytes);
+
+    ovm_fini(vm3);
+  }
+#endif
+
+#if 1
+  {
+    static struct ovm vm4[1];
+    static struct obj obj_pool4[1000], *obj_stack4[128];
+    static obj_var    obj_work4[1];
+    static char       src[] = "{\"a\": [1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18],"
+                              " \"b\": {\"c\": \"x\\\"y\", \"d\": []},"
+                              " \"e\": -2.5, \"f\": [[[\"deep\"]], {}]}";
+    static char       buf[1024], buf2[1024];
+    struct hp_stream_buf  sb[1];
+    struct hp_json_stream jst[1];
+    struct obj            *q;
+    unsigned              i, n;
+
+    ovm_init(vm4, sizeof(obj_pool4), obj_pool4, sizeof(obj_work4), obj_work4, sizeof(obj_stack4), obj_stack4);
+
+    /* Parse, check structure, and scratch registers are preserved */
+
+    for (i = R0; i <= R7; ++i)  ovm_newc(vm4, i, OBJ_TYPE_INTEGER, (obj_integer_val_t) i);
+    hp_json_stream_parse_init(jst, hp_stream_buf_init(sb, src, sizeof(src) - 1)->base);
+    assert(ovm_json_parse(vm4, R3, jst) == 0);
+    assert(vm4->sp == obj_stack4 + _ARRAY_SIZE(obj_stack4));
+    for (i = R0; i <= R7; ++i) {
+      if (i != R3)  assert(ovm_integer_val(vm4, i) == i);
+    }
+    q = vm4->reg[R3];
+    assert(q->type == OBJ_TYPE_DICT && DICT_CNT(q) == 4);
+
+    ovm_newc(vm4, R0, OBJ_TYPE_STRING, 1, "a");
+    ovm_move(vm4, R1, R3);
+    ovm_call(vm4, R1, OBJ_OP_AT, R0);
+    ovm_call(vm4, R1, OBJ_OP_CDR);
+    q = vm4->reg[R1];
+    assert(q->type == OBJ_TYPE_ARRAY && ARRAY_SIZE(q) == 18);
+    assert(INTVAL(ARRAY_DATA(q)[17]) == 18);
+
+    ovm_newc(vm4, R0, OBJ_TYPE_STRING, 1, "b");
+    ovm_move(vm4, R1, R3);
+    ovm_call(vm4, R1, OBJ_OP_AT, R0);
+    ovm_call(vm4, R1, OBJ_OP_CDR);
+    ovm_newc(vm4, R0, OBJ_TYPE_STRING, 1, "c");
+    ovm_call(vm4, R1, OBJ_OP_AT, R0);
+    ovm_call(vm4, R1, OBJ_OP_CDR);
+    assert(strcmp(STR_DATA(vm4->reg[R1]), "x\"y") == 0);
+    assert(ovm_errno(vm4) == OBJ_ERRNO_NONE);
+
+    /* Write, and read back to the same text */
+
+    hp_json_stream_tostring_init(jst, hp_stream_buf_init(sb, buf, sizeof(buf))->base);
+    assert(ovm_json_tostring(vm4, R3, jst) == 0);
+    i = hp_stream_tell(sb->base);
+    buf[i] = 0;
+    hp_json_stream_parse_init(jst, hp_stream_buf_init(sb, buf, i)->base);
+    assert(ovm_json_parse(vm4, R4, jst) == 0);
+    hp_json_stream_tostring_init(jst, hp_stream_buf_init(sb, buf2, sizeof(buf2))->base);
+    assert(ovm_json_tostring(vm4, R4, jst) == 0);
+    buf2[hp_stream_tell(sb->base)] = 0;
+    assert(strcmp(buf, buf2) == 0);
+    assert(strstr(buf, "[[[\"deep\"]],{}]") != 0 && strstr(buf, "-2.5") != 0);
+
+    /* Nesting deeper than the levels first allocated, both ways */
+
+    for (i = 0; i < 40; ++i) {
+      buf[i]          = '[';
+      buf[40 + 1 + i] = ']';
+    }
+    buf[40] = '1';
+    hp_json_stream_parse_init(jst, hp_stream_buf_init(sb, buf, 2 * 40 + 1)->base);
+    assert(ovm_json_parse(vm4, R4, jst) == 0);
+    assert(vm4->sp == obj_stack4 + _ARRAY_SIZE(obj_stack4));
+    for (q = vm4->reg[R4], i = 0; i < 40; ++i, q = ARRAY_DATA(q)[0]) {
+      assert(q->type == OBJ_TYPE_ARRAY && ARRAY_SIZE(q) == 1);
+    }
+    assert(INTVAL(q) == 1);
+    hp_json_stream_tostring_init(jst, hp_stream_buf_init(sb, buf2, sizeof(buf2))->base);
+    assert(ovm_json_tostring(vm4, R4, jst) == 0);
+    assert(hp_stream_tell(sb->base) == 2 * 40 + 1 && memcmp(buf, buf2, 2 * 40 + 1) == 0);
+
+    /* Arrays built in place */
+
+    ovm_newc(vm4, R4, OBJ_TYPE_ARRAY, 2);
+    for (n = 0, i = 0; i < 100; ++i) {
+      ovm_newc(vm4, R5, OBJ_TYPE_INTEGER, (obj_integer_val_t) i);
+      ovm_array_add(vm4, R4, &n, R5);
+    }
+    ovm_array_fit(vm4, R4);
+    q = vm4->reg[R4];
+    assert(ovm_errno(vm4) == OBJ_ERRNO_NONE && ARRAY_SIZE(q) == 102 && n >= 102);
+    assert(ARRAY_DATA(q)[1] == 0 && INTVAL(ARRAY_DATA(q)[2]) == 0 && INTVAL(ARRAY_DATA(q)[101]) == 99);
+    ovm_array_add(vm4, R5, &n, R5);
+    assert(ovm_errno(vm4) == OBJ_ERRNO_BAD_TYPE);
+    ovm_err_clr(vm4);
+
+    /* Integers wider than int */
+
+    strcpy(buf, "[3000000000,12345678901234,-9000000000]");
+    hp_json_stream_parse_init(jst, hp_stream_buf_init(sb, buf, strlen(buf))->base);
+    assert(ovm_json_parse(vm4, R4, jst) == 0);
+    assert(INTVAL(ARRAY_DATA(vm4->reg[R4])[1]) == 12345678901234LL);
+    hp_json_stream_tostring_init(jst, hp_stream_buf_init(sb, buf2, sizeof(buf2))->base);
+    assert(ovm_json_tostring(vm4, R4, jst) == 0);
+    buf2[hp_stream_tell(sb->base)] = 0;
+    assert(strcmp(buf, buf2) == 0);
+
+    /* Lists are written as arrays */
+
+    ovm_news(vm4, R0, sizeof("(1, \"two\", 3)") - 1, "(1, \"two\", 3)");
+    hp_json_stream_tostring_init(jst, hp_stream_buf_init(sb, buf, sizeof(buf))->base);
+    assert(ovm_json_tostring(vm4, R0, jst) == 0);
+    buf[hp_stream_tell(sb->base)] = 0;
+    assert(strcmp(buf, "[1,\"two\",3]") == 0);
+
+    /* Errors: malformed or truncated input, too deep, no JSON form */
+
+    q = vm4->reg[R3];
+    for (i = 1; i < sizeof(src) - 1; i += 7) {
+      hp_json_stream_parse_init(jst, hp_stream_buf_init(sb, src, i)->base);
+      assert(ovm_json_parse(vm4, R3, jst) == -1);
+      assert(vm4->reg[R3] == q);
+      assert(vm4->sp == obj_stack4 + _ARRAY_SIZE(obj_stack4));
+      assert(ovm_integer_val(vm4, R7) == R7);
+    }
+    memset(buf, '[', 20);
+    hp_json_stream_parse_init(jst, hp_stream_buf_init(sb, buf, 20)->base);
+    assert(ovm_json_parse(vm4, R3, jst) == -1);
+    assert(vm4->sp == obj_stack4 + _ARRAY_SIZE(obj_stack4));
+    memset(buf, '[', 100);
+    memset(buf + 100, ']', 100);
+    hp_json_stream_parse_init(jst, hp_stream_buf_init(sb, buf, 200)->base);
+    assert(ovm_json_parse(vm4, R3, jst) == -1);
+    assert(vm4->sp == obj_stack4 + _ARRAY_SIZE(obj_stack4));
+    assert(ovm_integer_val(vm4, R7) == R7);
+
+    ovm_new(vm4, R0, OBJ_TYPE_NIL);
+    hp_json_stream_tostring_init(jst, hp_stream_buf_init(sb, buf, sizeof(buf))->base);
+    assert(ovm_json_tostring(vm4, R0, jst) == -1);
+    assert(ovm_errno(vm4) == OBJ_ERRNO_NONE);
+
+    ovm_fini(vm4);
+  }
+#endif
+
+#ifdef OVM_STATS
+  {
+    struct ovm_stats      st[1];
+    struct hp_stream_file fst[1];
+    struct hp_json_stream jst[1];
+
+    assert(ovm_stats_get(vm, st) == 0);
+    assert(st->op[OBJ_TYPE_INTEGER - OBJ_TYPE_BASE][OBJ_OP_ADD].calls >= 10000000);
+    assert(st->pool_peak >= st->pool_used);
+
+    hp_json_stream_tostring_init(jst, hp_stream_file_init(fst, stdout)->base);
+    assert(ovm_stats_json(vm, jst) >= 0);
+    putchar('\n');
+    assert(ovm_heap_json(vm, jst) >= 0);
+    putchar('\n');
+  }
+#endif
+
   return (0);  
 }
 
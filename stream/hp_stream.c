@@ -1,4 +1,15 @@
+#define _GNU_SOURCE		/* For O_DIRECT */
+
 #include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "hp_stream.h"
 
@@ -19,38 +30,81 @@ hp_stream_init(struct hp_stream *st,
   st->seek   = seek;
   st->eof    = eof;
 
+  return (hp_stream_bulk_init(st, 0, 0, 0, 0));
+}
+
+/* Defaults for bulk operations, one byte at a time */
+
+static int
+hp_stream_getc_read(struct hp_stream *st, char *buf, unsigned n)
+{
+  int result, c;
+
+  for (result = 0; result < n; ++result) {
+    if ((c = hp_stream_getc(st)) < 0)  break;
+    *buf++ = c;
+  }
+
+  return (result);
+}
+
+static int
+hp_stream_putc_write(struct hp_stream *st, const char *buf, unsigned n)
+{
+  int result;
+
+  for (result = 0; result < n; ++result) {
+    if (hp_stream_putc(st, *buf++) < 0)  return (-1);
+  }
+
+  return (result);
+}
+
+static int
+hp_stream_no_window(struct hp_stream *st, char **p)
+{
+  return (-1);
+}
+
+static int
+hp_stream_no_commit(struct hp_stream *st, unsigned n)
+{
+  return (-1);
+}
+
+struct hp_stream *
+hp_stream_bulk_init(struct hp_stream *st,
+		    int (*read)(struct hp_stream *, char *, unsigned),
+		    int (*write)(struct hp_stream *, const char *, unsigned),
+		    int (*get_window)(struct hp_stream *, char **),
+		    int (*commit)(struct hp_stream *, unsigned)
+		    )
+{
+  st->read       = read       ? read       : hp_stream_getc_read;
+  st->write      = write      ? write      : hp_stream_putc_write;
+  st->get_window = get_window ? get_window : hp_stream_no_window;
+  st->commit     = commit     ? commit     : hp_stream_no_commit;
+
   return (st);
 }
 
 int
 hp_stream_gets(struct hp_stream *st, char *buf, unsigned bufsize)
 {
-  int  result;
-  char c;
+  int result;
 
   assert(bufsize > 0);
 
-  for (--bufsize, result = 0; result < bufsize; ++result) {
-    c = hp_stream_getc(st);
-    if (c < 0)  break;
-    *buf++ = c;
-  }
+  if ((result = hp_stream_read(st, buf, bufsize - 1)) < 0)  result = 0;
 
-  *buf = 0;
+  buf[result] = 0;
   return (result);
 }
 
 int
 hp_stream_puts(struct hp_stream *st, char *s)
 {
-  int  result;
-  char c;
-
-  for (result = 0; c = *s; ++s, ++result) {
-    if (hp_stream_putc(st, c) < 0)  return (-1);
-  }
-
-  return (result);
+  return (hp_stream_write(st, s, strlen(s)));
 }
 
 static int
@@ -71,6 +125,25 @@ hp_stream_file_putc(struct hp_stream *st, char c)
   return (fputc(c, ((struct hp_stream_file *) st)->fp));
 }
 
+/* Whole blocks, so that stdio locks once per call, not once per byte */
+
+static int
+hp_stream_file_read(struct hp_stream *st, char *buf, unsigned n)
+{
+  FILE   *fp = ((struct hp_stream_file *) st)->fp;
+  size_t result;
+
+  result = fread(buf, 1, n, fp);
+
+  return (result == 0 && ferror(fp) ? -1 : (int) result);
+}
+
+static int
+hp_stream_file_write(struct hp_stream *st, const char *buf, unsigned n)
+{
+  return (fwrite(buf, 1, n, ((struct hp_stream_file *) st)->fp) == n ? (int) n : -1);
+}
+
 static int
 hp_stream_file_tell(struct hp_stream *st)
 {
@@ -100,6 +173,12 @@ hp_stream_file_init(struct hp_stream_file *st, FILE *fp)
 		 hp_stream_file_seek,
 		 hp_stream_file_eof
 		 );
+  hp_stream_bulk_init(st->base,
+		      hp_stream_file_read,
+		      hp_stream_file_write,
+		      0,
+		      0
+		      );
 
   st->fp = fp;
 
@@ -141,6 +220,59 @@ hp_stream_buf_putc(struct hp_stream *st, char c)
   return (c);
 }
 
+static int
+hp_stream_buf_read(struct hp_stream *st, char *buf, unsigned n)
+{
+  struct hp_stream_buf *stb = (struct hp_stream_buf *) st;
+
+  if (stb->ofs >= stb->bufsize)  return (0);
+  if (n > stb->bufsize - stb->ofs)  n = stb->bufsize - stb->ofs;
+
+  memcpy(buf, stb->buf + stb->ofs, n);
+  stb->ofs += n;
+
+  return (n);
+}
+
+static int
+hp_stream_buf_write(struct hp_stream *st, const char *buf, unsigned n)
+{
+  struct hp_stream_buf *stb = (struct hp_stream_buf *) st;
+
+  /* All or nothing, as for a failed putc */
+
+  if (stb->ofs > stb->bufsize || n > stb->bufsize - stb->ofs)  return (-1);
+
+  memcpy(stb->buf + stb->ofs, buf, n);
+  stb->ofs += n;
+
+  return (n);
+}
+
+static int
+hp_stream_buf_get_window(struct hp_stream *st, char **p)
+{
+  struct hp_stream_buf *stb = (struct hp_stream_buf *) st;
+
+  if (stb->ofs >= stb->bufsize)  return (0);
+
+  *p = stb->buf + stb->ofs;
+
+  return (stb->bufsize - stb->ofs);
+}
+
+static int
+hp_stream_buf_commit(struct hp_stream *st, unsigned n)
+{
+  struct hp_stream_buf *stb = (struct hp_stream_buf *) st;
+
+  if (stb->ofs > stb->bufsize || n > stb->bufsize - stb->ofs)  return (-1);
+
+  stb->ofs += n;
+
+  return (n);
+}
+
 static int
 hp_stream_buf_tell(struct hp_stream *st)
 {
@@ -191,6 +323,12 @@ hp_stream_buf_init(struct hp_stream_buf *st, char *buf, unsigned bufsize)
 		 hp_stream_buf_seek,
 		 hp_stream_buf_eof
 		 );
+  hp_stream_bulk_init(st->base,
+		      hp_stream_buf_read,
+		      hp_stream_buf_write,
+		      hp_stream_buf_get_window,
+		      hp_stream_buf_commit
+		      );
 
   st->buf     = buf;
   st->bufsize = bufsize;
@@ -199,3 +337,1047 @@ hp_stream_buf_init(struct hp_stream_buf *st, char *buf, unsigned bufsize)
   return (st);
 }
 
+
+
+static int
+hp_stream_fd_direct_set(struct hp_stream_fd *st, int direct)
+{
+#ifdef O_DIRECT
+  int flags;
+
+  if ((flags = fcntl(st->fd, F_GETFL)) < 0
+      || fcntl(st->fd, F_SETFL, direct ? flags | O_DIRECT : flags & ~O_DIRECT) < 0
+      ) {
+    return (-1);
+  }
+#endif
+
+  st->direct = direct;
+
+  return (0);
+}
+
+static int
+hp_stream_fd_write_all(struct hp_stream_fd *st, const char *p, unsigned n)
+{
+  ssize_t k;
+
+  for ( ; n; p += k, n -= k) {
+    if ((k = write(st->fd, p, n)) < 0) {
+      if (errno == EINTR) {
+	k = 0;
+	continue;
+      }
+      return (-1);
+    }
+  }
+
+  return (0);
+}
+
+int
+hp_stream_fd_flush(struct hp_stream_fd *st)
+{
+  unsigned n;
+
+  if (!st->dirty)  return (0);
+
+  n = st->len;
+  if (st->direct && n % HP_STREAM_FD_ALIGN != 0) {
+    /* Aligned part as is, then the tail without O_DIRECT; file offset is
+       then unaligned, so O_DIRECT stays off
+    */
+
+    n -= n % HP_STREAM_FD_ALIGN;
+    if (hp_stream_fd_write_all(st, st->buf, n) < 0
+	|| hp_stream_fd_direct_set(st, 0) < 0
+	|| hp_stream_fd_write_all(st, st->buf + n, st->len - n) < 0
+	) {
+      return (-1);
+    }
+  } else if (hp_stream_fd_write_all(st, st->buf, n) < 0) {
+    return (-1);
+  }
+
+  st->pos   += st->len;
+  st->len   = st->ofs = 0;
+  st->dirty = 0;
+
+  return (0);
+}
+
+/* Switch buffer to reading; file offset is then pos + len */
+
+static int
+hp_stream_fd_rd_mode(struct hp_stream_fd *st)
+{
+  return (hp_stream_fd_flush(st));
+}
+
+/* Switch buffer to writing, at the read position */
+
+static int
+hp_stream_fd_wr_mode(struct hp_stream_fd *st)
+{
+  if (st->dirty)  return (0);
+
+  if (st->len != 0) {
+    if (st->direct) {
+      /* Keep data before read position, so that buffer stays aligned; it is
+	 rewritten unchanged
+      */
+
+      if (lseek(st->fd, st->pos, SEEK_SET) < 0)  return (-1);
+      st->len = st->ofs;
+    } else {
+      if (st->ofs != st->len && lseek(st->fd, st->pos + st->ofs, SEEK_SET) < 0)  return (-1);
+      st->pos += st->ofs;
+      st->len = 0;
+    }
+  }
+
+  st->ofs   = 0;
+  st->dirty = 1;
+  st->eof   = 0;
+
+  return (0);
+}
+
+/* Refill read buffer, after reading directly into dst, if given; returns
+   bytes read into dst, or -1 on error
+*/
+
+static int
+hp_stream_fd_fill(struct hp_stream_fd *st, char *dst, unsigned n)
+{
+  struct iovec iov[2];
+  ssize_t      k;
+  unsigned     cnt = 0;
+
+  st->pos += st->len;
+  st->len = st->ofs = 0;
+
+  if (st->direct) {
+    /* Only whole, aligned buffers */
+
+    n = 0;
+  } else if (n != 0) {
+    iov[cnt].iov_base = dst;
+    iov[cnt].iov_len  = n;
+    ++cnt;
+  }
+  iov[cnt].iov_base = st->buf;
+  iov[cnt].iov_len  = st->bufsize;
+  ++cnt;
+
+  while ((k = readv(st->fd, iov, cnt)) < 0) {
+    if (errno != EINTR)  return (-1);
+  }
+
+  if (k == 0) {
+    st->eof = 1;
+
+    return (0);
+  }
+  if (k <= n) {
+    st->pos += k;
+
+    return (k);
+  }
+
+  st->pos += n;
+  st->len = k - n;
+
+  return (n);
+}
+
+static int
+hp_stream_fd_read(struct hp_stream *st, char *buf, unsigned n)
+{
+  struct hp_stream_fd *stf = (struct hp_stream_fd *) st;
+  unsigned            k, result = 0;
+  int                 r;
+
+  if (hp_stream_fd_rd_mode(stf) < 0)  return (-1);
+
+  while (n) {
+    if (stf->ofs < stf->len) {
+      k = stf->len - stf->ofs;
+      if (k > n)  k = n;
+      memcpy(buf, stf->buf + stf->ofs, k);
+      stf->ofs += k;
+    } else {
+      if (stf->eof)  break;
+      if ((r = hp_stream_fd_fill(stf, buf, n)) < 0)  return (result ? result : -1);
+      k = r;
+    }
+
+    buf    += k;
+    n      -= k;
+    result += k;
+  }
+
+  return (result);
+}
+
+static int
+hp_stream_fd_getc(struct hp_stream *st)
+{
+  struct hp_stream_fd *stf = (struct hp_stream_fd *) st;
+
+  if (stf->dirty || stf->ofs >= stf->len) {
+    if (hp_stream_fd_rd_mode(stf) < 0)  return (-1);
+    while (stf->ofs >= stf->len) {
+      if (stf->eof || hp_stream_fd_fill(stf, 0, 0) < 0)  return (-1);
+    }
+  }
+
+  return ((unsigned char) stf->buf[stf->ofs++]);
+}
+
+static int
+hp_stream_fd_ungetc(struct hp_stream *st, char c)
+{
+  struct hp_stream_fd *stf = (struct hp_stream_fd *) st;
+
+  if (stf->dirty || stf->ofs == 0)  return (-1);
+
+  stf->buf[--stf->ofs] = c;
+
+  return ((unsigned char) c);
+}
+
+static int
+hp_stream_fd_write(struct hp_stream *st, const char *buf, unsigned n)
+{
+  struct hp_stream_fd *stf = (struct hp_stream_fd *) st;
+  struct iovec        iov[2];
+  ssize_t             k;
+  unsigned            m, result = n;
+
+  if (hp_stream_fd_wr_mode(stf) < 0)  return (-1);
+
+  if (n <= stf->bufsize - stf->len) {
+    memcpy(stf->buf + stf->len, buf, n);
+    stf->len += n;
+
+    return (n);
+  }
+
+  if (stf->direct) {
+    /* Only whole, aligned buffers */
+
+    for ( ; n; buf += m, n -= m) {
+      if ((m = stf->bufsize - stf->len) > n)  m = n;
+      memcpy(stf->buf + stf->len, buf, m);
+      stf->len += m;
+      if (stf->len == stf->bufsize && hp_stream_fd_flush(stf) < 0)  return (-1);
+      stf->dirty = 1;
+    }
+
+    return (result);
+  }
+
+  /* Buffered data and caller's, in one call */
+
+  iov[0].iov_base = stf->buf;
+  iov[0].iov_len  = stf->len;
+  iov[1].iov_base = (char *) buf;
+  iov[1].iov_len  = n;
+  while (iov[1].iov_len != 0) {
+    if ((k = writev(stf->fd, iov, 2)) < 0) {
+      if (errno == EINTR)  continue;
+      return (-1);
+    }
+    stf->pos += k;
+    if (k >= iov[0].iov_len) {
+      k -= iov[0].iov_len;
+      iov[0].iov_len = 0;
+      iov[1].iov_base = (char *) iov[1].iov_base + k;
+      iov[1].iov_len -= k;
+    } else {
+      iov[0].iov_base = (char *) iov[0].iov_base + k;
+      iov[0].iov_len -= k;
+    }
+  }
+  stf->len = 0;
+
+  return (result);
+}
+
+static int
+hp_stream_fd_putc(struct hp_stream *st, char c)
+{
+  struct hp_stream_fd *stf = (struct hp_stream_fd *) st;
+
+  if (hp_stream_fd_wr_mode(stf) < 0)  return (-1);
+  if (stf->len == stf->bufsize) {
+    if (hp_stream_fd_flush(stf) < 0)  return (-1);
+    stf->dirty = 1;
+  }
+
+  stf->buf[stf->len++] = c;
+
+  return ((unsigned char) c);
+}
+
+static int
+hp_stream_fd_get_window(struct hp_stream *st, char **p)
+{
+  struct hp_stream_fd *stf = (struct hp_stream_fd *) st;
+
+  if (stf->dirty) {
+    if (stf->len == stf->bufsize) {
+      if (hp_stream_fd_flush(stf) < 0)  return (-1);
+      stf->dirty = 1;
+    }
+    *p = stf->buf + stf->len;
+
+    return (stf->bufsize - stf->len);
+  }
+
+  while (stf->ofs >= stf->len) {
+    if (stf->eof)  return (0);
+    if (hp_stream_fd_fill(stf, 0, 0) < 0)  return (-1);
+  }
+  *p = stf->buf + stf->ofs;
+
+  return (stf->len - stf->ofs);
+}
+
+static int
+hp_stream_fd_commit(struct hp_stream *st, unsigned n)
+{
+  struct hp_stream_fd *stf = (struct hp_stream_fd *) st;
+
+  if (stf->dirty) {
+    if (n > stf->bufsize - stf->len)  return (-1);
+    stf->len += n;
+  } else {
+    if (n > stf->len - stf->ofs)  return (-1);
+    stf->ofs += n;
+  }
+
+  return (n);
+}
+
+static int
+hp_stream_fd_tell(struct hp_stream *st)
+{
+  struct hp_stream_fd *stf = (struct hp_stream_fd *) st;
+
+  return (stf->pos + (stf->dirty ? stf->len : stf->ofs));
+}
+
+static int
+hp_stream_fd_seek(struct hp_stream *st, int ofs, int whence)
+{
+  struct hp_stream_fd *stf = (struct hp_stream_fd *) st;
+  long long           target, base;
+  off_t               end;
+
+  if (hp_stream_fd_rd_mode(stf) < 0)  return (-1);
+
+  switch (whence) {
+  case SEEK_SET:
+    target = ofs;
+    break;
+  case SEEK_CUR:
+    target = stf->pos + stf->ofs + ofs;
+    break;
+  case SEEK_END:
+    if ((end = lseek(stf->fd, 0, SEEK_END)) < 0)  return (-1);
+    target = end + ofs;
+    /* File offset has moved, so buffer is no longer valid */
+    stf->pos = end;
+    stf->len = stf->ofs = 0;
+    break;
+  default:
+    return (-1);
+  }
+
+  if (target < 0)  return (-1);
+
+  /* Within buffered input, no system call */
+
+  if (target >= stf->pos && target <= stf->pos + stf->len && stf->len != 0) {
+    stf->ofs = target - stf->pos;
+    stf->eof = 0;
+
+    return (0);
+  }
+
+  base = stf->direct ? target - target % HP_STREAM_FD_ALIGN : target;
+  if (lseek(stf->fd, base, SEEK_SET) < 0)  return (-1);
+  stf->pos = base;
+  stf->len = stf->ofs = 0;
+  stf->eof = 0;
+
+  if (base != target) {
+    if (hp_stream_fd_fill(stf, 0, 0) < 0)  return (-1);
+    stf->ofs = target - base < stf->len ? target - base : stf->len;
+  }
+
+  return (0);
+}
+
+static int
+hp_stream_fd_eof(struct hp_stream *st)
+{
+  struct hp_stream_fd *stf = (struct hp_stream_fd *) st;
+
+  return (!stf->dirty && stf->ofs >= stf->len && stf->eof);
+}
+
+struct hp_stream_fd *
+hp_stream_fd_init(struct hp_stream_fd *st, int fd, char *buf, unsigned bufsize)
+{
+  int flags;
+
+  if (bufsize == 0 || (flags = fcntl(fd, F_GETFL)) < 0)  return (0);
+
+  memset(st, 0, sizeof(*st));
+
+#ifdef O_DIRECT
+  if (flags & O_DIRECT) {
+    if ((unsigned long) buf % HP_STREAM_FD_ALIGN != 0 || bufsize % HP_STREAM_FD_ALIGN != 0)  return (0);
+    st->direct = 1;
+  }
+#endif
+
+  hp_stream_init(st->base,
+		 hp_stream_fd_getc,
+		 hp_stream_fd_ungetc,
+		 hp_stream_fd_putc,
+		 hp_stream_fd_tell,
+		 hp_stream_fd_seek,
+		 hp_stream_fd_eof
+		 );
+  hp_stream_bulk_init(st->base,
+		      hp_stream_fd_read,
+		      hp_stream_fd_write,
+		      hp_stream_fd_get_window,
+		      hp_stream_fd_commit
+		      );
+
+  st->fd      = fd;
+  st->buf     = buf;
+  st->bufsize = bufsize;
+  if ((st->pos = lseek(fd, 0, SEEK_CUR)) < 0)  st->pos = 0; /* Not seekable */
+
+  return (st);
+}
+
+
+static int
+hp_stream_mmap_getc(struct hp_stream *st)
+{
+  struct hp_stream_mmap *stm = (struct hp_stream_mmap *) st;
+
+  if (stm->ofs >= stm->size)  return (-1);
+
+  return ((unsigned char) stm->data[stm->ofs++]);
+}
+
+static int
+hp_stream_mmap_ungetc(struct hp_stream *st, char c)
+{
+  struct hp_stream_mmap *stm = (struct hp_stream_mmap *) st;
+
+  if (stm->ofs == 0)  return (-1);
+
+  --stm->ofs;
+
+  return ((unsigned char) c);
+}
+
+static int
+hp_stream_mmap_putc(struct hp_stream *st, char c)
+{
+  return (-1);
+}
+
+static int
+hp_stream_mmap_read(struct hp_stream *st, char *buf, unsigned n)
+{
+  struct hp_stream_mmap *stm = (struct hp_stream_mmap *) st;
+
+  if (n > stm->size - stm->ofs)  n = stm->size - stm->ofs;
+  if (n > INT_MAX)  n = INT_MAX;
+
+  memcpy(buf, stm->data + stm->ofs, n);
+  stm->ofs += n;
+
+  return (n);
+}
+
+static int
+hp_stream_mmap_write(struct hp_stream *st, const char *buf, unsigned n)
+{
+  return (-1);
+}
+
+static int
+hp_stream_mmap_get_window(struct hp_stream *st, char **p)
+{
+  struct hp_stream_mmap *stm = (struct hp_stream_mmap *) st;
+  unsigned long         n = stm->size - stm->ofs;
+
+  *p = stm->data + stm->ofs;
+
+  return (n > INT_MAX ? INT_MAX : n);
+}
+
+static int
+hp_stream_mmap_commit(struct hp_stream *st, unsigned n)
+{
+  struct hp_stream_mmap *stm = (struct hp_stream_mmap *) st;
+
+  if (n > stm->size - stm->ofs)  return (-1);
+
+  stm->ofs += n;
+
+  return (n);
+}
+
+static int
+hp_stream_mmap_tell(struct hp_stream *st)
+{
+  return (((struct hp_stream_mmap *) st)->ofs);
+}
+
+static int
+hp_stream_mmap_seek(struct hp_stream *st, int ofs, int whence)
+{
+  struct hp_stream_mmap *stm = (struct hp_stream_mmap *) st;
+  long long             nofs;
+
+  switch (whence) {
+  case SEEK_SET:
+    nofs = ofs;
+    break;
+  case SEEK_CUR:
+    nofs = (long long) stm->ofs + ofs;
+    break;
+  case SEEK_END:
+    nofs = (long long) stm->size + ofs;
+    break;
+  default:
+    return (-1);
+  }
+
+  if (nofs < 0 || nofs > (long long) stm->size)  return (-1);
+
+  stm->ofs = nofs;
+
+  return (0);
+}
+
+static int
+hp_stream_mmap_eof(struct hp_stream *st)
+{
+  struct hp_stream_mmap *stm = (struct hp_stream_mmap *) st;
+
+  return (stm->ofs >= stm->size);
+}
+
+struct hp_stream_mmap *
+hp_stream_mmap_init(struct hp_stream_mmap *st, const char *path)
+{
+  int         fd;
+  struct stat sb;
+  void        *p = 0;
+
+  if ((fd = open(path, O_RDONLY)) < 0)  return (0);
+  if (fstat(fd, &sb) < 0) {
+    close(fd);
+    return (0);
+  }
+
+  /* Empty file cannot be mapped, but is a valid, empty stream */
+
+  if (sb.st_size != 0) {
+    p = mmap(0, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (p == MAP_FAILED) {
+      close(fd);
+      return (0);
+    }
+    madvise(p, sb.st_size, MADV_SEQUENTIAL);
+  }
+  close(fd);
+
+  hp_stream_init(st->base,
+		 hp_stream_mmap_getc,
+		 hp_stream_mmap_ungetc,
+		 hp_stream_mmap_putc,
+		 hp_stream_mmap_tell,
+		 hp_stream_mmap_seek,
+		 hp_stream_mmap_eof
+		 );
+  hp_stream_bulk_init(st->base,
+		      hp_stream_mmap_read,
+		      hp_stream_mmap_write,
+		      hp_stream_mmap_get_window,
+		      hp_stream_mmap_commit
+		      );
+
+  st->data = p;
+  st->size = sb.st_size;
+  st->ofs  = 0;
+
+  return (st);
+}
+
+void
+hp_stream_mmap_fini(struct hp_stream_mmap *st)
+{
+  if (st->size != 0)  munmap(st->data, st->size);
+
+  st->data = 0;
+  st->size = st->ofs = 0;
+}
+
+
+static struct hp_stream_mem_chunk *
+hp_stream_mem_grow(struct hp_stream_mem *st)
+{
+  struct hp_stream_mem_chunk *c;
+
+  if ((c = malloc(sizeof(*c) + st->chunk_size)) == 0)  return (0);
+
+  c->next = 0;
+  c->size = st->chunk_size;
+  c->len  = 0;
+
+  if (st->tail) {
+    st->tail->next = c;
+  } else {
+    st->head     = c;
+    st->head_ofs = 0;
+    st->head_pos = st->len;
+  }
+  st->tail = c;
+
+  if (st->chunk_size < HP_STREAM_MEM_CHUNK_MAX)  st->chunk_size *= 2;
+
+  return (c);
+}
+
+/* Find chunk holding given position; at a chunk boundary, the earlier one */
+
+static void
+hp_stream_mem_locate(struct hp_stream_mem *st, unsigned long long pos)
+{
+  struct hp_stream_mem_chunk *c;
+  unsigned long long         p;
+
+  st->pos = pos;
+
+  for (p = st->head_pos, c = st->head; c; p += c->len, c = c->next) {
+    if (pos - p <= c->len) {
+      st->cur     = c;
+      st->cur_ofs = pos - p;
+
+      return;
+    }
+  }
+
+  st->cur     = 0;
+  st->cur_ofs = 0;
+}
+
+/* Past a full chunk, to the start of the next, if any */
+
+static void
+hp_stream_mem_norm(struct hp_stream_mem *st)
+{
+  if (st->cur && st->cur_ofs == st->cur->len && st->cur->next) {
+    st->cur     = st->cur->next;
+    st->cur_ofs = 0;
+  }
+}
+
+/* Space for writing at position; returns number of bytes, or -1 */
+
+static int
+hp_stream_mem_space(struct hp_stream_mem *st)
+{
+  struct hp_stream_mem_chunk *c;
+
+  if (st->cur == 0 || st->cur_ofs == st->cur->size) {
+    if (st->cur && st->cur->next) {
+      c = st->cur->next;
+    } else if ((c = hp_stream_mem_grow(st)) == 0) {
+      return (-1);
+    }
+    st->cur     = c;
+    st->cur_ofs = 0;
+  }
+
+  return (st->cur->size - st->cur_ofs);
+}
+
+static void
+hp_stream_mem_advance(struct hp_stream_mem *st, unsigned n)
+{
+  st->cur_ofs += n;
+  st->pos     += n;
+
+  /* Only the last chunk is ever partly filled */
+
+  if (st->cur_ofs > st->cur->len)  st->cur->len = st->cur_ofs;
+  if (st->pos > st->len)  st->len = st->pos;
+}
+
+static int
+hp_stream_mem_write(struct hp_stream *st, const char *buf, unsigned n)
+{
+  struct hp_stream_mem *stm = (struct hp_stream_mem *) st;
+  int                  k;
+  unsigned             result = n;
+
+  for ( ; n; buf += k, n -= k) {
+    if ((k = hp_stream_mem_space(stm)) < 0)  return (-1);
+    if (k > n)  k = n;
+
+    memcpy(stm->cur->data + stm->cur_ofs, buf, k);
+    hp_stream_mem_advance(stm, k);
+  }
+
+  return (result);
+}
+
+static int
+hp_stream_mem_putc(struct hp_stream *st, char c)
+{
+  struct hp_stream_mem *stm = (struct hp_stream_mem *) st;
+
+  if (hp_stream_mem_space(stm) < 0)  return (-1);
+
+  stm->cur->data[stm->cur_ofs] = c;
+  hp_stream_mem_advance(stm, 1);
+
+  return ((unsigned char) c);
+}
+
+static int
+hp_stream_mem_read(struct hp_stream *st, char *buf, unsigned n)
+{
+  struct hp_stream_mem *stm = (struct hp_stream_mem *) st;
+  unsigned             k, result = 0;
+
+  for ( ; n; buf += k, n -= k, result += k) {
+    hp_stream_mem_norm(stm);
+    if (stm->cur == 0 || (k = stm->cur->len - stm->cur_ofs) == 0)  break;
+    if (k > n)  k = n;
+
+    memcpy(buf, stm->cur->data + stm->cur_ofs, k);
+    stm->cur_ofs += k;
+    stm->pos     += k;
+  }
+
+  return (result);
+}
+
+static int
+hp_stream_mem_getc(struct hp_stream *st)
+{
+  struct hp_stream_mem *stm = (struct hp_stream_mem *) st;
+
+  hp_stream_mem_norm(stm);
+  if (stm->cur == 0 || stm->cur_ofs == stm->cur->len)  return (-1);
+
+  ++stm->pos;
+
+  return ((unsigned char) stm->cur->data[stm->cur_ofs++]);
+}
+
+static int
+hp_stream_mem_ungetc(struct hp_stream *st, char c)
+{
+  struct hp_stream_mem *stm = (struct hp_stream_mem *) st;
+
+  if (stm->pos == stm->head_pos + stm->head_ofs)  return (-1);
+
+  if (stm->cur_ofs != 0) {
+    --stm->cur_ofs;
+    --stm->pos;
+  } else {
+    hp_stream_mem_locate(stm, stm->pos - 1);
+  }
+
+  return ((unsigned char) c);
+}
+
+static int
+hp_stream_mem_get_window(struct hp_stream *st, char **p)
+{
+  struct hp_stream_mem *stm = (struct hp_stream_mem *) st;
+  int                  n;
+
+  if (stm->pos < stm->len) {
+    hp_stream_mem_norm(stm);
+    n = stm->cur->len - stm->cur_ofs;
+  } else if ((n = hp_stream_mem_space(stm)) < 0) {
+    return (-1);
+  }
+
+  *p = stm->cur->data + stm->cur_ofs;
+
+  return (n);
+}
+
+static int
+hp_stream_mem_commit(struct hp_stream *st, unsigned n)
+{
+  struct hp_stream_mem *stm = (struct hp_stream_mem *) st;
+
+  if (n == 0)  return (0);
+
+  hp_stream_mem_norm(stm);
+  if (stm->cur == 0
+      || n > (stm->pos < stm->len ? stm->cur->len : stm->cur->size) - stm->cur_ofs
+      ) {
+    return (-1);
+  }
+
+  hp_stream_mem_advance(stm, n);
+
+  return (n);
+}
+
+static int
+hp_stream_mem_tell(struct hp_stream *st)
+{
+  return (((struct hp_stream_mem *) st)->pos);
+}
+
+static int
+hp_stream_mem_seek(struct hp_stream *st, int ofs, int whence)
+{
+  struct hp_stream_mem *stm = (struct hp_stream_mem *) st;
+  long long            npos;
+
+  switch (whence) {
+  case SEEK_SET:
+    npos = ofs;
+    break;
+  case SEEK_CUR:
+    npos = (long long) stm->pos + ofs;
+    break;
+  case SEEK_END:
+    npos = (long long) stm->len + ofs;
+    break;
+  default:
+    return (-1);
+  }
+
+  if (npos < (long long) (stm->head_pos + stm->head_ofs) || npos > (long long) stm->len)  return (-1);
+
+  hp_stream_mem_locate(stm, npos);
+
+  return (0);
+}
+
+static int
+hp_stream_mem_eof(struct hp_stream *st)
+{
+  struct hp_stream_mem *stm = (struct hp_stream_mem *) st;
+
+  return (stm->pos >= stm->len);
+}
+
+struct hp_stream_mem *
+hp_stream_mem_init(struct hp_stream_mem *st, unsigned chunk_size)
+{
+  memset(st, 0, sizeof(*st));
+
+  hp_stream_init(st->base,
+		 hp_stream_mem_getc,
+		 hp_stream_mem_ungetc,
+		 hp_stream_mem_putc,
+		 hp_stream_mem_tell,
+		 hp_stream_mem_seek,
+		 hp_stream_mem_eof
+		 );
+  hp_stream_bulk_init(st->base,
+		      hp_stream_mem_read,
+		      hp_stream_mem_write,
+		      hp_stream_mem_get_window,
+		      hp_stream_mem_commit
+		      );
+
+  st->chunk_size = chunk_size < HP_STREAM_MEM_CHUNK_MIN ? HP_STREAM_MEM_CHUNK_MIN
+    : chunk_size > HP_STREAM_MEM_CHUNK_MAX ? HP_STREAM_MEM_CHUNK_MAX : chunk_size;
+
+  return (st);
+}
+
+void
+hp_stream_mem_fini(struct hp_stream_mem *st)
+{
+  struct hp_stream_mem_chunk *c;
+
+  while (c = st->head) {
+    st->head = c->next;
+    free(c);
+  }
+
+  st->tail = st->cur = 0;
+}
+
+/* Number of bytes not yet drained */
+
+unsigned long long
+hp_stream_mem_size(struct hp_stream_mem *st)
+{
+  return (st->len - (st->head_pos + st->head_ofs));
+}
+
+/* Describe undrained data in up to n iovecs; returns number used */
+
+int
+hp_stream_mem_iov(struct hp_stream_mem *st, struct iovec *iov, unsigned n)
+{
+  struct hp_stream_mem_chunk *c;
+  unsigned                   ofs;
+  int                        result = 0;
+
+  for (c = st->head, ofs = st->head_ofs; c && n; c = c->next, ofs = 0) {
+    if (c->len == ofs)  continue;
+
+    iov->iov_base = c->data + ofs;
+    iov->iov_len  = c->len - ofs;
+    ++iov;
+    --n;
+    ++result;
+  }
+
+  return (result);
+}
+
+/* Discard n bytes from the front, freeing chunks emptied */
+
+int
+hp_stream_mem_drain(struct hp_stream_mem *st, unsigned long long n)
+{
+  struct hp_stream_mem_chunk *c;
+  unsigned                   k;
+
+  if (n > hp_stream_mem_size(st))  return (-1);
+
+  while (n) {
+    c = st->head;
+    k = c->len - st->head_ofs;
+    if (k > n)  k = n;
+    st->head_ofs += k;
+    n -= k;
+
+    /* Last chunk is kept while it has room, for writing */
+
+    if (st->head_ofs < c->size)  break;
+
+    st->head     = c->next;
+    st->head_pos += c->size;
+    st->head_ofs = 0;
+    if (st->head == 0)  st->tail = 0;
+    free(c);
+  }
+
+  hp_stream_mem_locate(st, st->pos < st->head_pos + st->head_ofs ? st->head_pos + st->head_ofs : st->pos);
+
+  return (0);
+}
+
+
+static int
+hp_stream_tee_getc(struct hp_stream *st)
+{
+  return (-1);
+}
+
+static int
+hp_stream_tee_ungetc(struct hp_stream *st, char c)
+{
+  return (-1);
+}
+
+static int
+hp_stream_tee_putc(struct hp_stream *st, char c)
+{
+  struct hp_stream_tee *stt = (struct hp_stream_tee *) st;
+  unsigned             i;
+  int                  result = (unsigned char) c;
+
+  for (i = 0; i < stt->n; ++i) {
+    if (hp_stream_putc(stt->sinks[i], c) < 0)  result = -1;
+  }
+
+  return (result);
+}
+
+static int
+hp_stream_tee_write(struct hp_stream *st, const char *buf, unsigned n)
+{
+  struct hp_stream_tee *stt = (struct hp_stream_tee *) st;
+  unsigned             i;
+  int                  result = n;
+
+  for (i = 0; i < stt->n; ++i) {
+    if (hp_stream_write(stt->sinks[i], buf, n) < 0)  result = -1;
+  }
+
+  return (result);
+}
+
+static int
+hp_stream_tee_tell(struct hp_stream *st)
+{
+  struct hp_stream_tee *stt = (struct hp_stream_tee *) st;
+
+  return (stt->n == 0 ? -1 : hp_stream_tell(stt->sinks[0]));
+}
+
+static int
+hp_stream_tee_seek(struct hp_stream *st, int ofs, int whence)
+{
+  struct hp_stream_tee *stt = (struct hp_stream_tee *) st;
+  unsigned             i;
+  int                  result = 0;
+
+  for (i = 0; i < stt->n; ++i) {
+    if (hp_stream_seek(stt->sinks[i], ofs, whence) < 0)  result = -1;
+  }
+
+  return (result);
+}
+
+static int
+hp_stream_tee_eof(struct hp_stream *st)
+{
+  return (0);
+}
+
+struct hp_stream_tee *
+hp_stream_tee_init(struct hp_stream_tee *st, struct hp_stream **sinks, unsigned n)
+{
+  hp_stream_init(st->base,
+		 hp_stream_tee_getc,
+		 hp_stream_tee_ungetc,
+		 hp_stream_tee_putc,
+		 hp_stream_tee_tell,
+		 hp_stream_tee_seek,
+		 hp_stream_tee_eof
+		 );
+  hp_stream_bulk_init(st->base,
+		      0,
+		      hp_stream_tee_write,
+		      0,
+		      0
+		      );
+
+  st->sinks = sinks;
+  st->n     = n;
+
+  return (st);
+}
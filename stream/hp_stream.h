@@ -1,4 +1,8 @@
+#ifndef __HP_STREAM_H
+#define __HP_STREAM_H
+
 #include <stdio.h>
+#include <sys/uio.h>
 
 struct hp_stream {
   int (*getc)(struct hp_stream *);
@@ -7,6 +11,13 @@ struct hp_stream {
   int (*tell)(struct hp_stream *);
   int (*seek)(struct hp_stream *, int, int);
   int (*eof)(struct hp_stream *);
+
+  /* Bulk operations; defaulted by hp_stream_init(), in terms of the above */
+
+  int (*read)(struct hp_stream *, char *, unsigned);
+  int (*write)(struct hp_stream *, const char *, unsigned);
+  int (*get_window)(struct hp_stream *, char **);
+  int (*commit)(struct hp_stream *, unsigned);
 };
 
 struct hp_stream *hp_stream_init(struct hp_stream *st, 
@@ -18,6 +29,13 @@ struct hp_stream *hp_stream_init(struct hp_stream *st,
 				 int (*eof)(struct hp_stream *)
 				 );
 
+struct hp_stream *hp_stream_bulk_init(struct hp_stream *st,
+				      int (*read)(struct hp_stream *, char *, unsigned),
+				      int (*write)(struct hp_stream *, const char *, unsigned),
+				      int (*get_window)(struct hp_stream *, char **),
+				      int (*commit)(struct hp_stream *, unsigned)
+				      );
+
 static inline
 int hp_stream_getc(struct hp_stream *st)
 {
@@ -39,6 +57,41 @@ int hp_stream_putc(struct hp_stream *st, char c)
 int hp_stream_gets(struct hp_stream *st, char *buf, unsigned bufsize);
 int hp_stream_puts(struct hp_stream *st, char *s);
 
+/* Read up to n bytes; returns number read, 0 at end of stream, or -1 on error */
+
+static inline
+int hp_stream_read(struct hp_stream *st, char *buf, unsigned n)
+{
+  return ((*st->read)(st, buf, n));
+}
+
+/* Write n bytes; returns n, or -1 on error */
+
+static inline
+int hp_stream_write(struct hp_stream *st, const char *buf, unsigned n)
+{
+  return ((*st->write)(st, buf, n));
+}
+
+/* Borrow the stream's own storage at the current position: sets *p, and
+   returns number of bytes there, which may be read, or overwritten to
+   write without copying; 0 at end of stream, or -1 if the stream has no
+   window.  Borrowing does not move the position; hp_stream_commit() moves
+   it forward by at most the window size.
+*/
+
+static inline
+int hp_stream_get_window(struct hp_stream *st, char **p)
+{
+  return ((*st->get_window)(st, p));
+}
+
+static inline
+int hp_stream_commit(struct hp_stream *st, unsigned n)
+{
+  return ((*st->commit)(st, n));
+}
+
 static inline
 int hp_stream_tell(struct hp_stream *st)
 {
@@ -73,3 +126,102 @@ struct hp_stream_buf {
 
 struct hp_stream_buf *hp_stream_buf_init(struct hp_stream_buf *st, char *buf, unsigned bufsize);
 
+
+/* Buffered stream over a file descriptor, with caller-supplied buffer
+
+   If the descriptor was opened with O_DIRECT, buf and bufsize must be
+   multiples of HP_STREAM_FD_ALIGN, and file I/O is done a whole buffer at a
+   time; a final partial buffer is written with O_DIRECT turned off.
+
+   After a write, the stream's window is free buffer space, to be filled and
+   committed; otherwise, it is buffered input.  Written data must be flushed
+   with hp_stream_fd_flush() before the descriptor is closed.
+*/
+
+enum {
+  HP_STREAM_FD_ALIGN = 4096
+};
+
+struct hp_stream_fd {
+  struct hp_stream base[1];
+  int              fd;
+  char             *buf;
+  unsigned         bufsize;
+  unsigned         len;		/* Bytes in buf, read or to be written */
+  unsigned         ofs;		/* Read position in buf */
+  long long        pos;		/* File offset of buf[0] */
+  unsigned char    dirty;	/* buf holds data to be written */
+  unsigned char    direct;	/* fd opened with O_DIRECT */
+  unsigned char    eof;
+};
+
+struct hp_stream_fd *hp_stream_fd_init(struct hp_stream_fd *st, int fd, char *buf, unsigned bufsize);
+int hp_stream_fd_flush(struct hp_stream_fd *st);
+
+/* Read-only stream over a memory-mapped file; the window is the whole rest
+   of the file, and must not be written
+*/
+
+struct hp_stream_mmap {
+  struct hp_stream base[1];
+  char             *data;
+  unsigned long    size;
+  unsigned long    ofs;
+};
+
+struct hp_stream_mmap *hp_stream_mmap_init(struct hp_stream_mmap *st, const char *path);
+void hp_stream_mmap_fini(struct hp_stream_mmap *st);
+
+/* Growable memory stream: a list of chunks, each larger than the last up to
+   HP_STREAM_MEM_CHUNK_MAX, so that earlier data is never copied.  Reads,
+   writes and seeks share one position, as for hp_stream_buf; writing past
+   the end grows the stream.  At the end of data the window is free space,
+   to be filled and committed; elsewhere, it is data to read or overwrite.
+
+   hp_stream_mem_iov() describes the data as an iovec array, e.g. for
+   writev(), and hp_stream_mem_drain() then frees what has been consumed
+   from the front; drained data can no longer be read, but positions are
+   not renumbered.
+*/
+
+enum {
+  HP_STREAM_MEM_CHUNK_MIN = 256,
+  HP_STREAM_MEM_CHUNK_MAX = 1 << 20
+};
+
+struct hp_stream_mem_chunk {
+  struct hp_stream_mem_chunk *next;
+  unsigned                   size, len;
+  char                       data[];
+};
+
+struct hp_stream_mem {
+  struct hp_stream           base[1];
+  struct hp_stream_mem_chunk *head, *tail;
+  unsigned                   head_ofs;	/* Bytes drained from head */
+  unsigned long long         head_pos;	/* Position of head->data[0] */
+  struct hp_stream_mem_chunk *cur;	/* Chunk holding position */
+  unsigned                   cur_ofs;
+  unsigned long long         pos, len;
+  unsigned                   chunk_size; /* Size of next chunk */
+};
+
+struct hp_stream_mem *hp_stream_mem_init(struct hp_stream_mem *st, unsigned chunk_size);
+void hp_stream_mem_fini(struct hp_stream_mem *st);
+unsigned long long hp_stream_mem_size(struct hp_stream_mem *st);
+int hp_stream_mem_iov(struct hp_stream_mem *st, struct iovec *iov, unsigned n);
+int hp_stream_mem_drain(struct hp_stream_mem *st, unsigned long long n);
+
+/* Output to several streams at once, e.g. a file and a log; writes and
+   seeks go to every sink, and fail if any does.  Reading is not supported.
+*/
+
+struct hp_stream_tee {
+  struct hp_stream base[1];
+  struct hp_stream **sinks;
+  unsigned         n;
+};
+
+struct hp_stream_tee *hp_stream_tee_init(struct hp_stream_tee *st, struct hp_stream **sinks, unsigned n);
+
+#endif /* __HP_STREAM_H */
@@ -0,0 +1,219 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "hp_stream_async.h"
+
+static void *
+hp_stream_async_thread(void *arg)
+{
+  struct hp_stream_async *st = (struct hp_stream_async *) arg;
+  unsigned               n;
+  int                    k;
+
+  pthread_mutex_lock(&st->mutex);
+  for (;;) {
+    while (st->pending == 0 && !st->done)  pthread_cond_wait(&st->cond, &st->mutex);
+    if (st->pending == 0)  break;
+
+    /* Producer does not touch buf[cur ^ 1] while pending */
+
+    n = st->pending;
+    pthread_mutex_unlock(&st->mutex);
+    k = hp_stream_write(st->sink, st->buf[st->cur ^ 1], n);
+    pthread_mutex_lock(&st->mutex);
+
+    if (k != n)  st->err = 1;
+    st->pending = 0;
+    pthread_cond_broadcast(&st->cond);
+  }
+  pthread_mutex_unlock(&st->mutex);
+
+  return (0);
+}
+
+/* Hand current buffer to thread, waiting for it to finish the other one */
+
+static int
+hp_stream_async_submit(struct hp_stream_async *st)
+{
+  int result;
+
+  pthread_mutex_lock(&st->mutex);
+  while (st->pending != 0)  pthread_cond_wait(&st->cond, &st->mutex);
+  if ((result = st->err ? -1 : 0) == 0 && st->len != 0) {
+    st->pending = st->len;
+    st->cur     ^= 1;
+    st->pos     += st->len;
+    st->len     = 0;
+    pthread_cond_broadcast(&st->cond);
+  }
+  pthread_mutex_unlock(&st->mutex);
+
+  return (result);
+}
+
+static int
+hp_stream_async_getc(struct hp_stream *st)
+{
+  return (-1);
+}
+
+static int
+hp_stream_async_ungetc(struct hp_stream *st, char c)
+{
+  return (-1);
+}
+
+static int
+hp_stream_async_putc(struct hp_stream *st, char c)
+{
+  struct hp_stream_async *sta = (struct hp_stream_async *) st;
+
+  if (sta->len == sta->bufsize && hp_stream_async_submit(sta) < 0)  return (-1);
+  sta->buf[sta->cur][sta->len++] = c;
+
+  return ((unsigned char) c);
+}
+
+static int
+hp_stream_async_write(struct hp_stream *st, const char *buf, unsigned n)
+{
+  struct hp_stream_async *sta = (struct hp_stream_async *) st;
+  unsigned               k, result = n;
+
+  for ( ; n; buf += k, n -= k) {
+    if (sta->len == sta->bufsize && hp_stream_async_submit(sta) < 0)  return (-1);
+    if ((k = sta->bufsize - sta->len) > n)  k = n;
+    memcpy(sta->buf[sta->cur] + sta->len, buf, k);
+    sta->len += k;
+  }
+
+  return (result);
+}
+
+static int
+hp_stream_async_get_window(struct hp_stream *st, char **p)
+{
+  struct hp_stream_async *sta = (struct hp_stream_async *) st;
+
+  if (sta->len == sta->bufsize && hp_stream_async_submit(sta) < 0)  return (-1);
+  *p = sta->buf[sta->cur] + sta->len;
+
+  return (sta->bufsize - sta->len);
+}
+
+static int
+hp_stream_async_commit(struct hp_stream *st, unsigned n)
+{
+  struct hp_stream_async *sta = (struct hp_stream_async *) st;
+
+  if (n > sta->bufsize - sta->len)  return (-1);
+  sta->len += n;
+
+  return (n);
+}
+
+static int
+hp_stream_async_tell(struct hp_stream *st)
+{
+  struct hp_stream_async *sta = (struct hp_stream_async *) st;
+
+  return (sta->pos + sta->len);
+}
+
+static int
+hp_stream_async_seek(struct hp_stream *st, int ofs, int whence)
+{
+  struct hp_stream_async *sta = (struct hp_stream_async *) st;
+
+  if (hp_stream_async_flush(sta) < 0 || hp_stream_seek(sta->sink, ofs, whence) < 0)  return (-1);
+  if ((sta->pos = hp_stream_tell(sta->sink)) < 0)  return (-1);
+
+  return (0);
+}
+
+static int
+hp_stream_async_eof(struct hp_stream *st)
+{
+  return (0);
+}
+
+struct hp_stream_async *
+hp_stream_async_init(struct hp_stream_async *st, struct hp_stream *sink, unsigned bufsize)
+{
+  memset(st, 0, sizeof(*st));
+
+  hp_stream_init(st->base,
+		 hp_stream_async_getc,
+		 hp_stream_async_ungetc,
+		 hp_stream_async_putc,
+		 hp_stream_async_tell,
+		 hp_stream_async_seek,
+		 hp_stream_async_eof
+		 );
+  hp_stream_bulk_init(st->base,
+		      0,
+		      hp_stream_async_write,
+		      hp_stream_async_get_window,
+		      hp_stream_async_commit
+		      );
+
+  st->sink    = sink;
+  st->bufsize = bufsize;
+  if ((st->pos = hp_stream_tell(sink)) < 0)  st->pos = 0; /* Not seekable */
+
+  if (bufsize == 0
+      || (st->buf[0] = malloc(bufsize)) == 0
+      || (st->buf[1] = malloc(bufsize)) == 0
+      ) {
+    free(st->buf[0]);
+
+    return (0);
+  }
+
+  pthread_mutex_init(&st->mutex, 0);
+  pthread_cond_init(&st->cond, 0);
+  if (pthread_create(&st->thread, 0, hp_stream_async_thread, st) != 0) {
+    pthread_cond_destroy(&st->cond);
+    pthread_mutex_destroy(&st->mutex);
+    free(st->buf[0]);
+    free(st->buf[1]);
+
+    return (0);
+  }
+
+  return (st);
+}
+
+int
+hp_stream_async_flush(struct hp_stream_async *st)
+{
+  int result = hp_stream_async_submit(st);
+
+  pthread_mutex_lock(&st->mutex);
+  while (st->pending != 0)  pthread_cond_wait(&st->cond, &st->mutex);
+  if (st->err)  result = -1;
+  st->err = 0;			/* Reported once */
+  pthread_mutex_unlock(&st->mutex);
+
+  return (result);
+}
+
+int
+hp_stream_async_fini(struct hp_stream_async *st)
+{
+  int result = hp_stream_async_flush(st);
+
+  pthread_mutex_lock(&st->mutex);
+  st->done = 1;
+  pthread_cond_broadcast(&st->cond);
+  pthread_mutex_unlock(&st->mutex);
+  pthread_join(st->thread, 0);
+
+  pthread_cond_destroy(&st->cond);
+  pthread_mutex_destroy(&st->mutex);
+  free(st->buf[0]);
+  free(st->buf[1]);
+
+  return (result);
+}
@@ -0,0 +1,38 @@
+#ifndef __HP_STREAM_ASYNC_H
+#define __HP_STREAM_ASYNC_H
+
+#include <pthread.h>
+
+#include "hp_stream.h"
+
+/* Asynchronous output: writes fill one buffer while a background thread
+   writes the other to the sink, so the caller blocks only when both are
+   full.  The sink must not be used directly until hp_stream_async_fini().
+
+   hp_stream_async_flush() is a fence: it returns once everything written
+   so far has been passed to the sink, and reports any sink error since the
+   last flush.  Seeking implies a flush, then seeks the sink; it works, but
+   is expensive, e.g. for TLV back-patching.  Reading is not supported.
+*/
+
+struct hp_stream_async {
+  struct hp_stream base[1];
+  struct hp_stream *sink;
+  char             *buf[2];
+  unsigned         bufsize;
+  unsigned         cur;		/* Buffer being filled */
+  unsigned         len;		/* Bytes in buf[cur] */
+  long long        pos;		/* Sink position of buf[cur][0] */
+  pthread_t        thread;
+  pthread_mutex_t  mutex;
+  pthread_cond_t   cond;
+  unsigned         pending;	/* Bytes in buf[cur ^ 1] not yet written */
+  unsigned char    done;	/* Thread to exit */
+  unsigned char    err;		/* Sink write failed */
+};
+
+struct hp_stream_async *hp_stream_async_init(struct hp_stream_async *st, struct hp_stream *sink, unsigned bufsize);
+int hp_stream_async_flush(struct hp_stream_async *st);
+int hp_stream_async_fini(struct hp_stream_async *st);
+
+#endif /* __HP_STREAM_ASYNC_H */
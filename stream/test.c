@@ -0,0 +1,395 @@
+#define _GNU_SOURCE		/* For O_DIRECT */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include "hp_stream.h"
+#include "hp_stream_async.h"
+
+/* Stream with only per-byte operations, to exercise bulk defaults */
+
+struct cnt_stream {
+  struct hp_stream base[1];
+  unsigned         n, ofs;
+  char             last;
+};
+
+static int
+cnt_getc(struct hp_stream *st)
+{
+  struct cnt_stream *s = (struct cnt_stream *) st;
+
+  return (s->ofs >= s->n ? -1 : 'a' + s->ofs++ % 26);
+}
+
+static int
+cnt_putc(struct hp_stream *st, char c)
+{
+  struct cnt_stream *s = (struct cnt_stream *) st;
+
+  if (s->ofs >= s->n)  return (-1);
+  ++s->ofs;
+
+  return (s->last = c);
+}
+
+static char tmpname[] = "/tmp/hp_stream_testXXXXXX";
+
+static void
+fd_test(void)
+{
+  static char         big[100000], back[100000];
+  char                buf[16], out[32], *p;
+  struct hp_stream_fd st[1];
+  int                 fd, i, n;
+
+  for (i = 0; i < sizeof(big); ++i)  big[i] = 'a' + i % 23;
+
+  assert((fd = mkstemp(tmpname)) >= 0);
+  assert(hp_stream_fd_init(st, fd, buf, sizeof(buf)) == st);
+
+  /* Small writes through buffer, large one around it */
+
+  assert(hp_stream_puts(st->base, "hello, ") == 7);
+  assert(hp_stream_putc(st->base, 'w') == 'w');
+  assert(hp_stream_write(st->base, big, sizeof(big)) == sizeof(big));
+  assert(hp_stream_write(st->base, "0123456789", 10) == 10);
+  assert(hp_stream_tell(st->base) == 8 + sizeof(big) + 10);
+
+  /* Window for output */
+
+  assert((n = hp_stream_get_window(st->base, &p)) > 0);
+  *p = '!';
+  assert(hp_stream_commit(st->base, 1) == 1);
+  assert(hp_stream_fd_flush(st) == 0);
+  assert(lseek(fd, 0, SEEK_END) == 8 + sizeof(big) + 11);
+
+  /* Read back, through buffer and around it */
+
+  assert(hp_stream_seek(st->base, 0, SEEK_SET) == 0);
+  assert(hp_stream_getc(st->base) == 'h');
+  assert(hp_stream_ungetc(st->base, 'h') == 'h');
+  assert(hp_stream_read(st->base, out, 8) == 8 && memcmp(out, "hello, w", 8) == 0);
+  assert(hp_stream_read(st->base, back, sizeof(back)) == sizeof(back));
+  assert(memcmp(back, big, sizeof(big)) == 0);
+  assert(hp_stream_get_window(st->base, &p) > 0 && *p == '0');
+  assert(hp_stream_commit(st->base, 1) == 1);
+  assert(hp_stream_gets(st->base, out, sizeof(out)) == 10 && strcmp(out, "123456789!") == 0);
+  assert(hp_stream_eof(st->base));
+  assert(hp_stream_getc(st->base) < 0);
+
+  /* Seek within buffer, and outside it, then overwrite */
+
+  assert(hp_stream_seek(st->base, -3, SEEK_END) == 0);
+  assert(hp_stream_getc(st->base) == '8');
+  assert(hp_stream_seek(st->base, -2, SEEK_CUR) == 0);
+  assert(hp_stream_getc(st->base) == '7');
+  assert(hp_stream_seek(st->base, 1, SEEK_SET) == 0);
+  assert(hp_stream_putc(st->base, 'E') == 'E');
+  assert(hp_stream_getc(st->base) == 'l');
+  assert(hp_stream_seek(st->base, 0, SEEK_SET) == 0);
+  assert(hp_stream_read(st->base, out, 3) == 3 && memcmp(out, "hEl", 3) == 0);
+
+  close(fd);
+
+#ifdef O_DIRECT
+  /* Direct I/O, if the file system supports it */
+
+  if ((fd = open(tmpname, O_RDWR | O_TRUNC | O_DIRECT)) >= 0) {
+    char *abuf;
+
+    assert(posix_memalign((void **) &abuf, HP_STREAM_FD_ALIGN, 2 * HP_STREAM_FD_ALIGN) == 0);
+    assert(hp_stream_fd_init(st, fd, abuf + 1, HP_STREAM_FD_ALIGN) == 0);
+    assert(hp_stream_fd_init(st, fd, abuf, 2 * HP_STREAM_FD_ALIGN) == st);
+    assert(hp_stream_write(st->base, big, sizeof(big)) == sizeof(big));
+    assert(hp_stream_fd_flush(st) == 0);
+    close(fd);
+
+    /* Unaligned seek reads the aligned block around it */
+
+    assert((fd = open(tmpname, O_RDONLY | O_DIRECT)) >= 0);
+    assert(hp_stream_fd_init(st, fd, abuf, 2 * HP_STREAM_FD_ALIGN) == st);
+    assert(hp_stream_seek(st->base, 5000, SEEK_SET) == 0);
+    assert(hp_stream_tell(st->base) == 5000);
+    assert(hp_stream_read(st->base, back, sizeof(back)) == sizeof(big) - 5000);
+    assert(memcmp(back, big + 5000, sizeof(big) - 5000) == 0);
+    free(abuf);
+    close(fd);
+  }
+#endif
+}
+
+static void
+mmap_test(void)
+{
+  struct hp_stream_mmap st[1];
+  char                  out[8], *p;
+  FILE                  *fp;
+
+  assert((fp = fopen(tmpname, "w")) != 0);
+  fputs("0123456789", fp);
+  fclose(fp);
+
+  assert(hp_stream_mmap_init(st, tmpname) == st);
+  assert(hp_stream_getc(st->base) == '0');
+  assert(hp_stream_get_window(st->base, &p) == 9 && memcmp(p, "123456789", 9) == 0);
+  assert(hp_stream_commit(st->base, 4) == 4);
+  assert(hp_stream_read(st->base, out, sizeof(out)) == 5 && memcmp(out, "56789", 5) == 0);
+  assert(hp_stream_eof(st->base));
+  assert(hp_stream_putc(st->base, 'x') < 0 && hp_stream_puts(st->base, "x") < 0);
+  assert(hp_stream_seek(st->base, -3, SEEK_END) == 0 && hp_stream_getc(st->base) == '7');
+  hp_stream_mmap_fini(st);
+
+  /* Empty file */
+
+  assert((fp = fopen(tmpname, "w")) != 0);
+  fclose(fp);
+  assert(hp_stream_mmap_init(st, tmpname) == st);
+  assert(hp_stream_getc(st->base) < 0 && hp_stream_eof(st->base));
+  hp_stream_mmap_fini(st);
+
+  assert(hp_stream_mmap_init(st, "/nonexistent") == 0);
+
+  unlink(tmpname);
+}
+
+static void
+mem_test(void)
+{
+  static char          big[100000], back[100000];
+  struct hp_stream_mem st[1];
+  struct iovec         iov[32];
+  char                 out[16], *p;
+  int                  i, n, k;
+  unsigned long long   sum;
+
+  for (i = 0; i < sizeof(big); ++i)  big[i] = 'a' + i % 23;
+
+  hp_stream_mem_init(st, 0);
+  assert(hp_stream_getc(st->base) < 0 && hp_stream_eof(st->base));
+
+  /* Grows past many chunks; earlier ones stay put */
+
+  assert(hp_stream_puts(st->base, "hdr:") == 4);
+  p = st->head->data;
+  assert(hp_stream_write(st->base, big, sizeof(big)) == sizeof(big));
+  assert(hp_stream_putc(st->base, '$') == '$');
+  assert(st->head->data == p && st->head != st->tail);
+  assert(hp_stream_tell(st->base) == 4 + sizeof(big) + 1);
+  assert(hp_stream_mem_size(st) == 4 + sizeof(big) + 1);
+
+  /* Back-patch a header, as the TLV encoder does */
+
+  assert(hp_stream_seek(st->base, 0, SEEK_SET) == 0);
+  assert(hp_stream_puts(st->base, "HDR") == 3);
+  assert(hp_stream_seek(st->base, 0, SEEK_END) == 0);
+
+  /* Window at end is free space */
+
+  assert((n = hp_stream_get_window(st->base, &p)) > 0);
+  memcpy(p, "!!", 2);
+  assert(hp_stream_commit(st->base, 2) == 2);
+  assert(hp_stream_mem_size(st) == 4 + sizeof(big) + 3);
+
+  /* Read back */
+
+  assert(hp_stream_seek(st->base, 0, SEEK_SET) == 0);
+  assert(hp_stream_read(st->base, out, 4) == 4 && memcmp(out, "HDR:", 4) == 0);
+  assert(hp_stream_read(st->base, back, sizeof(back)) == sizeof(back));
+  assert(memcmp(back, big, sizeof(big)) == 0);
+  assert(hp_stream_get_window(st->base, &p) == 3 && memcmp(p, "$!!", 3) == 0);
+  assert(hp_stream_ungetc(st->base, 'x') == 'x' && hp_stream_getc(st->base) == big[sizeof(big) - 1]);
+  assert(hp_stream_gets(st->base, out, sizeof(out)) == 3 && strcmp(out, "$!!") == 0);
+  assert(hp_stream_eof(st->base));
+
+  /* Drain as iovecs, in pieces */
+
+  n = hp_stream_mem_iov(st, iov, 32);
+  for (sum = i = 0; i < n; ++i)  sum += iov[i].iov_len;
+  assert(sum == hp_stream_mem_size(st));
+  assert(memcmp(iov[0].iov_base, "HDR:", 4) == 0);
+
+  assert(hp_stream_mem_drain(st, 1000) == 0);
+  assert(hp_stream_mem_iov(st, iov, 1) == 1 && memcmp(iov[0].iov_base, big + 996, 8) == 0);
+  assert(hp_stream_seek(st->base, 999, SEEK_SET) < 0);
+  assert(hp_stream_seek(st->base, 1000, SEEK_SET) == 0 && hp_stream_getc(st->base) == big[996]);
+  while ((k = hp_stream_mem_iov(st, iov, 2)) > 0) {
+    assert(hp_stream_mem_drain(st, iov[0].iov_len) == 0);
+  }
+  assert(hp_stream_mem_size(st) == 0 && hp_stream_mem_drain(st, 1) < 0);
+
+  /* Keeps going after all drained */
+
+  assert(hp_stream_puts(st->base, "more") == 4);
+  assert(hp_stream_tell(st->base) == 4 + sizeof(big) + 3 + 4);
+  assert(hp_stream_mem_iov(st, iov, 32) == 1 && memcmp(iov[0].iov_base, "more", 4) == 0);
+
+  hp_stream_mem_fini(st);
+}
+
+static void
+tee_test(void)
+{
+  char                 buf1[16], buf2[8];
+  struct hp_stream_buf st1[1], st2[1];
+  struct hp_stream_mem st3[1];
+  struct hp_stream     *sinks[3];
+  struct hp_stream_tee st[1];
+  struct iovec         iov[1];
+
+  sinks[0] = hp_stream_buf_init(st1, buf1, sizeof(buf1))->base;
+  sinks[1] = hp_stream_buf_init(st2, buf2, sizeof(buf2))->base;
+  sinks[2] = hp_stream_mem_init(st3, 0)->base;
+  hp_stream_tee_init(st, sinks, 3);
+
+  assert(hp_stream_puts(st->base, "abcd") == 4);
+  assert(hp_stream_putc(st->base, 'e') == 'e');
+  assert(hp_stream_tell(st->base) == 5);
+  assert(hp_stream_seek(st->base, 0, SEEK_SET) == 0);
+  assert(hp_stream_putc(st->base, 'A') == 'A');
+  assert(memcmp(buf1, "Abcde", 5) == 0 && memcmp(buf2, "Abcde", 5) == 0);
+  assert(hp_stream_mem_iov(st3, iov, 1) == 1 && memcmp(iov[0].iov_base, "Abcde", 5) == 0);
+
+  /* One sink full fails the write */
+
+  assert(hp_stream_seek(st->base, 5, SEEK_SET) == 0);
+  assert(hp_stream_puts(st->base, "fghi") < 0);
+  assert(hp_stream_getc(st->base) < 0);
+
+  hp_stream_mem_fini(st3);
+}
+
+static void
+async_test(void)
+{
+  static char            data[200000], back[200000];
+  char                   small[10], *p;
+  struct hp_stream_mem   stm[1];
+  struct hp_stream_buf   stb[1];
+  struct hp_stream_async st[1];
+  int                    i, n;
+
+  for (i = 0; i < sizeof(data); ++i)  data[i] = 'a' + i % 19;
+
+  /* Many buffers' worth, by every kind of write */
+
+  hp_stream_mem_init(stm, 0);
+  assert(hp_stream_async_init(st, stm->base, 0) == 0);
+  assert(hp_stream_async_init(st, stm->base, 100) == st);
+  assert(hp_stream_putc(st->base, data[0]) == data[0]);
+  assert((n = hp_stream_get_window(st->base, &p)) == 99);
+  memcpy(p, data + 1, 50);
+  assert(hp_stream_commit(st->base, 50) == 50);
+  for (i = 51; i < 1000; ++i)  assert(hp_stream_putc(st->base, data[i]) == data[i]);
+  assert(hp_stream_write(st->base, data + 1000, sizeof(data) - 1000) == sizeof(data) - 1000);
+  assert(hp_stream_tell(st->base) == sizeof(data));
+  assert(hp_stream_getc(st->base) < 0);
+  assert(hp_stream_async_flush(st) == 0);
+  assert(hp_stream_mem_size(stm) == sizeof(data));
+
+  /* Seek is a fence, then overwrites */
+
+  assert(hp_stream_puts(st->base, "tail") == 4);
+  assert(hp_stream_seek(st->base, 10, SEEK_SET) == 0);
+  assert(hp_stream_tell(st->base) == 10);
+  assert(hp_stream_puts(st->base, "XY") == 2);
+  assert(hp_stream_async_fini(st) == 0);
+
+  hp_stream_seek(stm->base, 0, SEEK_SET);
+  assert(hp_stream_read(stm->base, back, sizeof(back)) == sizeof(back));
+  memcpy(data + 10, "XY", 2);
+  assert(memcmp(back, data, sizeof(data)) == 0);
+  assert(hp_stream_read(stm->base, back, 8) == 4 && memcmp(back, "tail", 4) == 0);
+  hp_stream_mem_fini(stm);
+
+  /* Sink error is reported by flush, once */
+
+  hp_stream_buf_init(stb, small, sizeof(small));
+  assert(hp_stream_async_init(st, stb->base, 8) == st);
+  assert(hp_stream_puts(st->base, "0123456789abcdef") == 16);
+  assert(hp_stream_async_flush(st) == -1);
+  assert(hp_stream_async_flush(st) == 0);
+  assert(hp_stream_async_fini(st) == 0);
+}
+
+int
+main(void)
+{
+  char                  buf[64], out[16], *p;
+  struct hp_stream_buf  stb[1];
+  struct hp_stream_file stf[1];
+  struct cnt_stream     cst[1];
+  FILE                  *fp;
+  int                   n;
+
+  /* Buffer stream */
+
+  hp_stream_buf_init(stb, buf, 10);
+  assert(hp_stream_write(stb->base, "hello", 5) == 5);
+  assert(hp_stream_write(stb->base, "world!", 6) == -1);
+  assert(hp_stream_tell(stb->base) == 5);
+  assert(hp_stream_puts(stb->base, "world") == 5);
+  assert(hp_stream_putc(stb->base, 'x') < 0);
+
+  hp_stream_seek(stb->base, 0, SEEK_SET);
+  assert(hp_stream_read(stb->base, out, 3) == 3 && memcmp(out, "hel", 3) == 0);
+  assert(hp_stream_get_window(stb->base, &p) == 7 && memcmp(p, "loworld", 7) == 0);
+  assert(hp_stream_tell(stb->base) == 3);
+  assert(hp_stream_commit(stb->base, 2) == 2);
+  assert(hp_stream_getc(stb->base) == 'w');
+  assert(hp_stream_commit(stb->base, 5) == -1);
+  assert(hp_stream_gets(stb->base, out, sizeof(out)) == 4 && strcmp(out, "orld") == 0);
+  assert(hp_stream_read(stb->base, out, sizeof(out)) == 0);
+  assert(hp_stream_get_window(stb->base, &p) == 0);
+
+  /* Window written in place */
+
+  hp_stream_buf_init(stb, buf, sizeof(buf));
+  assert((n = hp_stream_get_window(stb->base, &p)) == sizeof(buf));
+  memcpy(p, "abc", 3);
+  assert(hp_stream_commit(stb->base, 3) == 3);
+  assert(hp_stream_tell(stb->base) == 3 && memcmp(buf, "abc", 3) == 0);
+
+  /* File stream */
+
+  assert((fp = tmpfile()) != 0);
+  hp_stream_file_init(stf, fp);
+  assert(hp_stream_puts(stf->base, "0123456789") == 10);
+  assert(hp_stream_write(stf->base, "abc", 3) == 3);
+  assert(hp_stream_get_window(stf->base, &p) == -1);
+  hp_stream_seek(stf->base, 0, SEEK_SET);
+  assert(hp_stream_getc(stf->base) == '0');
+  assert(hp_stream_ungetc(stf->base, '0') == '0');
+  assert(hp_stream_read(stf->base, out, 4) == 4 && memcmp(out, "0123", 4) == 0);
+  assert(hp_stream_gets(stf->base, out, sizeof(out)) == 9 && strcmp(out, "456789abc") == 0);
+  assert(hp_stream_read(stf->base, out, sizeof(out)) == 0);
+  fclose(fp);
+
+  /* Per-byte stream, through default bulk operations */
+
+  memset(cst, 0, sizeof(*cst));
+  hp_stream_init(cst->base, cnt_getc, 0, cnt_putc, 0, 0, 0);
+  cst->n = 30;
+  assert(hp_stream_read(cst->base, buf, 28) == 28 && memcmp(buf + 25, "zab", 3) == 0);
+  assert(hp_stream_read(cst->base, buf, 28) == 2);
+  assert(hp_stream_get_window(cst->base, &p) == -1);
+  assert(hp_stream_commit(cst->base, 1) == -1);
+  cst->ofs = 0;
+  cst->n   = 4;
+  assert(hp_stream_write(cst->base, "xyz", 3) == 3 && cst->last == 'z');
+  assert(hp_stream_puts(cst->base, "pq") == -1);
+
+  fd_test();
+  mmap_test();
+  mem_test();
+  tee_test();
+  async_test();
+
+  printf("All tests passed\n");
+
+  return (0);
+}